@@ -176,6 +176,42 @@ bool Run(const std::string &title,
   return true;
 }
 
+// Measure the first run after the engine memory is trimmed, which pays for
+// allocating the memory and rebuilding the derived caches.
+bool RunAfterTrim(const std::string &title,
+                  MaceEngine *engine,
+                  const std::map<std::string, mace::MaceTensor> &input_infos,
+                  std::map<std::string, mace::MaceTensor> *output_infos,
+                  int num_runs,
+                  bool prewarm) {
+  MACE_CHECK_NOTNULL(output_infos);
+  TimeInfo<int64_t> time_info;
+  for (int i = 0; i < num_runs; ++i) {
+    if (engine->Trim() != mace::MaceStatus::MACE_SUCCESS) {
+      LOG(ERROR) << "Failed to trim engine";
+      return false;
+    }
+    if (prewarm && engine->Prewarm() != mace::MaceStatus::MACE_SUCCESS) {
+      LOG(ERROR) << "Failed to prewarm engine";
+      return false;
+    }
+    int64_t inference_time_us = 0;
+    if (!RunInference(engine, input_infos, output_infos,
+                      &inference_time_us, nullptr)) {
+      LOG(INFO) << "Failed on run " << i;
+      return false;
+    }
+    time_info.UpdateTime(inference_time_us);
+  }
+
+  std::stringstream stream(time_info.ToString(title));
+  stream << std::endl;
+  for (std::string line; std::getline(stream, line);) {
+    LOG(INFO) << line;
+  }
+  return true;
+}
+
 DEFINE_string(model_name, "", "model name in yaml");
 DEFINE_string(device, "CPU", "Device [CPU|GPU|DSP]");
 DEFINE_string(input_node, "input_node0,input_node1",
@@ -188,6 +224,9 @@ DEFINE_string(input_file, "", "input file name");
 DEFINE_int32(max_num_runs, 100, "number of runs max");
 DEFINE_string(max_time, "10.0", "length to run max");
 DEFINE_int32(warmup_runs, 1, "how many runs to initialize model");
+DEFINE_int32(trim_runs, 0, "how many runs right after trimming memory");
+DEFINE_bool(prewarm_after_trim, false,
+            "prewarm engine memory before each run after trimming");
 DEFINE_string(opencl_binary_file,
               "",
               "compiled opencl binary file path");
@@ -223,6 +262,8 @@ int Main(int argc, char **argv) {
   LOG(INFO) << "Warmup runs: [" << FLAGS_warmup_runs << "]";
   LOG(INFO) << "Num runs: [" << FLAGS_max_num_runs << "]";
   LOG(INFO) << "Max run time: [" << FLAGS_max_time << "]";
+  LOG(INFO) << "Trim runs: [" << FLAGS_trim_runs << "]";
+  LOG(INFO) << "Prewarm after trim: [" << FLAGS_prewarm_after_trim << "]";
 
   const double max_benchmark_time_seconds =
       std::strtod(FLAGS_max_time.c_str(), nullptr);
@@ -374,6 +415,14 @@ int Main(int argc, char **argv) {
 
   statistician->PrintStat();
 
+  if (FLAGS_trim_runs > 0) {
+    status = RunAfterTrim("Run after trim", engine.get(), inputs, &outputs,
+                          FLAGS_trim_runs, FLAGS_prewarm_after_trim);
+    if (!status) {
+      LOG(ERROR) << "Failed at run after trim";
+    }
+  }
+
   return 0;
 }
 
@@ -111,6 +111,7 @@ void OpStat::StatMetadata(const RunMetadata &meta_data) {
       record->type = op_stat.type;
       record->args = op_stat.args;
       record->output_shape = op_stat.output_shape;
+      record->algorithm = op_stat.algorithm;
       record->order = order_idx;
       order_idx += 1;
     }
@@ -148,7 +149,8 @@ std::string OpStat::StatByMetric(const Metric metric,
   std::string title = "Sort by " + MetricToString(metric);
   const std::vector<std::string> header = {
       "Node Type", "Start", "First", "Avg(ms)", "%", "cdf%",
-      "Stride", "Pad", "Filter Shape", "Output Shape", "Dilation", "name"
+      "Stride", "Pad", "Filter Shape", "Output Shape", "Dilation",
+      "Algorithm", "name"
   };
   std::vector<std::vector<std::string>> data;
   int count = top_limit;
@@ -177,6 +179,7 @@ std::string OpStat::StatByMetric(const Metric metric,
     tuple.push_back(VectorToString<int64_t>(record.args.kernels));
     tuple.push_back(ShapeToString(record.output_shape));
     tuple.push_back(VectorToString<int>(record.args.dilations));
+    tuple.push_back(record.algorithm);
     tuple.push_back(record.name);
     data.emplace_back(tuple);
   }
@@ -144,6 +144,7 @@ class OpStat{
     std::string type;
     std::vector<std::vector<int64_t>> output_shape;
     ConvPoolArgs args;
+    std::string algorithm;
     int64_t order;
     TimeInfo<int64_t> start;
     TimeInfo<int64_t> rel_end;
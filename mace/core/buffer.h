@@ -22,6 +22,7 @@
 
 #include "mace/core/allocator.h"
 #include "mace/core/macros.h"
+#include "mace/core/runtime/cpu/cpu_runtime.h"
 #include "mace/core/types.h"
 
 namespace mace {
@@ -63,6 +64,10 @@ class BufferBase {
 
   virtual void Clear(index_t size) = 0;
 
+  // Free the memory but keep this object, so tensors pointing to it stay
+  // valid and the memory could be allocated again later.
+  virtual void Release() = 0;
+
   virtual index_t offset() const { return 0; }
 
   template <typename T>
@@ -207,6 +212,19 @@ class Buffer : public BufferBase {
     memset(reinterpret_cast<char*>(raw_mutable_data()), 0, size);
   }
 
+  void Release() {
+    MACE_CHECK(is_data_owner_,
+               "data is not owned by this buffer, cannot release");
+    if (mapped_buf_ != nullptr) {
+      UnMap();
+    }
+    if (buf_ != nullptr) {
+      allocator_->Delete(buf_);
+      buf_ = nullptr;
+    }
+    size_ = 0;
+  }
+
  protected:
   Allocator *allocator_;
   void *buf_;
@@ -250,6 +268,8 @@ class Image : public BufferBase {
 
   std::vector<size_t> image_shape() const { return shape_; }
 
+  DataType dtype() const { return data_type_; }
+
   MaceStatus Allocate(index_t nbytes) {
     MACE_UNUSED(nbytes);
     LOG(FATAL) << "Image should not call this allocate function";
@@ -323,6 +343,18 @@ class Image : public BufferBase {
     MACE_NOT_IMPLEMENTED;
   }
 
+  // Image shape and data type are kept to allocate the same image again.
+  void Release() {
+    if (mapped_buf_ != nullptr) {
+      UnMap();
+    }
+    if (buf_ != nullptr) {
+      allocator_->DeleteImage(buf_);
+      buf_ = nullptr;
+    }
+    size_ = 0;
+  }
+
  private:
   Allocator *allocator_;
   std::vector<size_t> shape_;
@@ -449,6 +481,10 @@ class BufferSlice : public BufferBase {
     memset(raw_mutable_data(), 0, size);
   }
 
+  void Release() {
+    MACE_NOT_IMPLEMENTED;
+  }
+
  private:
   BufferBase *buffer_;
   void *mapped_buf_;
@@ -491,10 +527,59 @@ class ScratchBuffer: public Buffer {
     offset_ = 0;
   }
 
+  void Release() {
+    Buffer::Release();
+    offset_ = 0;
+  }
+
  private:
   index_t offset_;
 };
 
+// Scratch space private to each thread of a parallel region. The size needed
+// by one thread is reserved before entering the region, then every thread
+// gets its own slice, so kernels need neither locks nor allocations inside.
+class ThreadScratchBuffer {
+ public:
+  explicit ThreadScratchBuffer(Allocator *allocator)
+    : buffer_(allocator),
+      size_per_thread_(0) {}
+
+  MaceStatus GrowSize(index_t size_per_thread) {
+    // align slices to avoid false sharing between threads
+    const index_t alignment = static_cast<index_t>(kMaceAlignment);
+    size_per_thread_ = (size_per_thread + alignment - 1)
+        / alignment * alignment;
+    const index_t size = size_per_thread_ * GetOpenMPMaxThreads();
+    if (size > buffer_.size()) {
+      return buffer_.Resize(size);
+    }
+    return MaceStatus::MACE_SUCCESS;
+  }
+
+  // Called within a parallel region, returns the slice of calling thread.
+  template <typename T>
+  T *Scratch() {
+    const index_t offset = size_per_thread_ * GetOpenMPThreadNum();
+    MACE_CHECK(offset + size_per_thread_ <= buffer_.size(),
+               "thread scratch size not enough: ", offset, " + ",
+               size_per_thread_, " > ", buffer_.size());
+    return reinterpret_cast<T *>(
+        static_cast<char *>(buffer_.raw_mutable_data()) + offset);
+  }
+
+  index_t size() const { return buffer_.size(); }
+
+  // Grown again by the next GrowSize.
+  void Release() { buffer_.Release(); }
+
+ private:
+  Buffer buffer_;
+  index_t size_per_thread_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(ThreadScratchBuffer);
+};
+
 }  // namespace mace
 
 #endif  // MACE_CORE_BUFFER_H_
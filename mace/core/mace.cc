@@ -18,7 +18,10 @@
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 
 #include "mace/core/net.h"
 #include "mace/core/types.h"
@@ -85,6 +88,110 @@ const std::shared_ptr<float> MaceTensor::data() const { return impl_->data; }
 
 std::shared_ptr<float> MaceTensor::data() { return impl_->data; }
 
+namespace {
+index_t FloorDiv(index_t a, index_t b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+index_t Gcd(index_t a, index_t b) {
+  return b == 0 ? a : Gcd(b, a % b);
+}
+
+// A tile along an axis: the input indices it reads and the output indices
+// it computes as the whole input does.
+struct TileSpan {
+  index_t input_offset;
+  index_t input_size;
+  index_t tile_output_offset;
+  index_t output_offset;
+  index_t output_size;
+};
+
+// Split input_size indices into tiles of at most max_tile_size, with
+// outputs reading the input through window. Tiles start at multiples of
+// align and keep the size of the input modulo align, so strided ops pad
+// them as they pad the whole input.
+MaceStatus PlanTileSpans(index_t input_size,
+                         index_t max_tile_size,
+                         index_t align,
+                         const AxisWindow &window,
+                         index_t output_size,
+                         const std::function<index_t(index_t)> &tile_outputs,
+                         std::vector<TileSpan> *spans) {
+  const index_t stride = window.stride;
+  index_t output_offset = 0;
+  while (output_offset < output_size) {
+    const index_t first_input = output_offset * stride + window.begin;
+    const index_t offset = first_input <= 0 ? 0 : first_input / align * align;
+    index_t size = input_size - offset;
+    if (size > max_tile_size) {
+      size = max_tile_size
+          - ((max_tile_size - input_size) % align + align) % align;
+    }
+    if (size <= 0) {
+      LOG(ERROR) << "Tile of " << max_tile_size << " is smaller than the "
+                 << "total stride " << align;
+      return MACE_INVALID_ARGS;
+    }
+    // outputs reading inside the tile, or the paddings of the whole input
+    const index_t tile_offset = offset / stride;
+    const index_t valid_begin =
+        offset == 0 ? 0 : std::max<index_t>(0, RoundUpDiv(-window.begin,
+                                                          stride));
+    const index_t valid_end =
+        offset + size == input_size
+        ? tile_outputs(size)
+        : FloorDiv(size - 1 - window.end, stride) + 1;
+    const index_t begin = output_offset - tile_offset;
+    const index_t end = std::min(valid_end, output_size - tile_offset);
+    if (begin < valid_begin || begin >= end) {
+      LOG(ERROR) << "Tile of " << max_tile_size << " is smaller than the "
+                 << "receptive field [" << window.begin << ", "
+                 << window.end << "]";
+      return MACE_INVALID_ARGS;
+    }
+    spans->push_back({offset, size, begin, output_offset, end - begin});
+    output_offset += end - begin;
+  }
+  return MACE_SUCCESS;
+}
+
+// Copy the block of size at src_offset of src to dst_offset of dst, both
+// dense and row major.
+void CopyBlock(const float *src,
+               const std::vector<index_t> &src_shape,
+               const std::vector<index_t> &src_offset,
+               const std::vector<index_t> &size,
+               float *dst,
+               const std::vector<index_t> &dst_shape,
+               const std::vector<index_t> &dst_offset) {
+  const int rank = static_cast<int>(size.size());
+  if (rank == 0 || std::find(size.begin(), size.end(), 0) != size.end()) {
+    return;
+  }
+  std::vector<index_t> index(rank, 0);
+  while (true) {
+    index_t src_index = 0;
+    index_t dst_index = 0;
+    for (int i = 0; i < rank; ++i) {
+      src_index = src_index * src_shape[i] + src_offset[i] + index[i];
+      dst_index = dst_index * dst_shape[i] + dst_offset[i] + index[i];
+    }
+    memcpy(dst + dst_index, src + src_index, size[rank - 1] * sizeof(float));
+    int axis = rank - 2;
+    for (; axis >= 0; --axis) {
+      if (++index[axis] < size[axis]) {
+        break;
+      }
+      index[axis] = 0;
+    }
+    if (axis < 0) {
+      break;
+    }
+  }
+}
+}  // namespace
+
 // Mace Engine
 class MaceEngine::Impl {
  public:
@@ -95,19 +202,39 @@ class MaceEngine::Impl {
   MaceStatus Init(const NetDef *net_def,
                   const std::vector<std::string> &input_nodes,
                   const std::vector<std::string> &output_nodes,
-                  const unsigned char *model_data);
+                  const unsigned char *model_data,
+                  const std::vector<std::vector<int64_t>> &input_shapes);
 
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata);
 
+  MaceStatus RunTiled(const std::map<std::string, MaceTensor> &inputs,
+                      std::map<std::string, MaceTensor> *outputs);
+
+  MaceStatus GetMemoryStats(MemoryStats *stats);
+
+  MaceStatus Trim();
+
+  MaceStatus Prewarm();
+
  private:
+  MaceStatus PreallocateTensors(
+      const NetDef &net_def,
+      const std::vector<std::string> &input_nodes,
+      const std::vector<std::vector<int64_t>> &input_shapes);
+
   std::shared_ptr<OperatorRegistry> op_registry_;
   DeviceType device_type_;
   std::unique_ptr<Workspace> ws_;
   std::unique_ptr<NetBase> net_;
   std::map<std::string, mace::InputInfo> input_info_map_;
   std::map<std::string, mace::OutputInfo> output_info_map_;
+  // Ops and the shapes of weights, for tiled runs to trace the tensors
+  NetDef net_def_;
+  std::map<std::string, std::vector<index_t>> weight_shapes_;
+  // Serializes Trim and Prewarm with Run
+  std::mutex mutex_;
 #ifdef MACE_ENABLE_HEXAGON
   std::unique_ptr<HexagonControlWrapper> hexagon_controller_;
 #endif
@@ -131,8 +258,11 @@ MaceStatus MaceEngine::Impl::Init(
     const NetDef *net_def,
     const std::vector<std::string> &input_nodes,
     const std::vector<std::string> &output_nodes,
-    const unsigned char *model_data) {
+    const unsigned char *model_data,
+    const std::vector<std::vector<int64_t>> &input_shapes) {
   LOG(INFO) << "Initializing MaceEngine";
+  MACE_CHECK(input_shapes.empty() || input_shapes.size() == input_nodes.size(),
+             "input shapes should be given for all input nodes");
   // Get input and output information.
   for (auto &input_info : net_def->input_info()) {
     input_info_map_[input_info.name()] = input_info;
@@ -180,16 +310,63 @@ MaceStatus MaceEngine::Impl::Init(
         *net_def, device_type_, model_data));
 
     // Init model
+    const std::vector<std::string> model_tensors = ws_->Tensors();
     auto net = CreateNet(op_registry_, *net_def, ws_.get(), device_type_,
                          NetMode::INIT);
+    // Outputs of init net are computed from model weights
+    for (auto &tensor_name : ws_->Tensors()) {
+      if (std::find(model_tensors.begin(), model_tensors.end(), tensor_name)
+          == model_tensors.end()) {
+        ws_->MarkTensorDerived(tensor_name);
+      }
+    }
     MACE_RETURN_IF_ERROR(net->Run());
+    if (device_type_ == DeviceType::CPU) {
+      *net_def_.mutable_op() = net_def->op();
+      for (auto &const_tensor : net_def->tensors()) {
+        weight_shapes_[const_tensor.name()] = std::vector<index_t>(
+            const_tensor.dims().begin(), const_tensor.dims().end());
+      }
+      for (auto &tensor_name : ws_->Tensors()) {
+        if (std::find(model_tensors.begin(), model_tensors.end(),
+                      tensor_name) == model_tensors.end()) {
+          weight_shapes_[tensor_name] = ws_->GetTensor(tensor_name)->shape();
+        }
+      }
+    }
     net_ = CreateNet(op_registry_, *net_def, ws_.get(), device_type_);
+    if (!input_shapes.empty() && device_type_ == DeviceType::CPU) {
+      MACE_RETURN_IF_ERROR(PreallocateTensors(*net_def, input_nodes,
+                                              input_shapes));
+    }
+    ws_->UpdateMemoryStats();
 #ifdef MACE_ENABLE_HEXAGON
   }
 #endif
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus MaceEngine::Impl::PreallocateTensors(
+    const NetDef &net_def,
+    const std::vector<std::string> &input_nodes,
+    const std::vector<std::vector<int64_t>> &input_shapes) {
+  std::map<std::string, std::vector<index_t>> shapes;
+  for (auto &const_tensor : net_def.tensors()) {
+    shapes[const_tensor.name()] = std::vector<index_t>(
+        const_tensor.dims().begin(), const_tensor.dims().end());
+  }
+  for (size_t i = 0; i < input_nodes.size(); ++i) {
+    const std::string input_name = MakeString("mace_input_node_",
+                                              input_nodes[i]);
+    const std::vector<index_t> shape(input_shapes[i].begin(),
+                                     input_shapes[i].end());
+    MACE_RETURN_IF_ERROR(ws_->GetTensor(input_name)->Resize(shape));
+    shapes[input_name] = shape;
+  }
+  InferNetShapes(*op_registry_, net_def, device_type_, &shapes);
+  return ws_->PreallocateTensors(net_def, device_type_, shapes);
+}
+
 MaceEngine::Impl::~Impl() {
   LOG(INFO) << "Destroying MaceEngine";
 #ifdef MACE_ENABLE_HEXAGON
@@ -209,6 +386,8 @@ MaceStatus MaceEngine::Impl::Run(
     std::map<std::string, MaceTensor> *outputs,
     RunMetadata *run_metadata) {
   MACE_CHECK_NOTNULL(outputs);
+  std::lock_guard<std::mutex> lock(mutex_);
+  MACE_RETURN_IF_ERROR(ws_->Rematerialize());
   std::vector<Tensor *> input_tensors;
   std::vector<Tensor *> output_tensors;
   for (auto &input : inputs) {
@@ -246,6 +425,7 @@ MaceStatus MaceEngine::Impl::Run(
   } else {
 #endif
     MACE_RETURN_IF_ERROR(net_->Run(run_metadata));
+    ws_->UpdateMemoryStats();
 #ifdef MACE_ENABLE_HEXAGON
   }
 #endif
@@ -277,6 +457,221 @@ MaceStatus MaceEngine::Impl::Run(
   return MACE_SUCCESS;
 }
 
+MaceStatus MaceEngine::Impl::RunTiled(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  MACE_CHECK_NOTNULL(outputs);
+  if (device_type_ != DeviceType::CPU || inputs.size() != 1) {
+    LOG(ERROR) << "Tiled run takes a single input on CPU";
+    return MACE_INVALID_ARGS;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  const std::string &input_name = inputs.begin()->first;
+  const MaceTensor &input = inputs.begin()->second;
+  auto input_info = input_info_map_.find(input_name);
+  if (input_info == input_info_map_.end()) {
+    LOG(FATAL) << "'" << input_name
+               << "' is not belong to model's inputs: "
+               << MakeString(MapKeys(input_info_map_));
+  }
+  const std::vector<index_t> input_shape(input.shape().begin(),
+                                         input.shape().end());
+  const std::vector<index_t> max_tile_shape(
+      input_info->second.dims().begin(), input_info->second.dims().end());
+  const size_t rank = input_shape.size();
+  if (max_tile_shape.size() != rank) {
+    LOG(ERROR) << "Model input shape of " << input_name << " is unknown";
+    return MACE_INVALID_ARGS;
+  }
+
+  // Shapes and receptive fields of the tensors at the whole input
+  const std::string input_node = MakeString("mace_input_node_", input_name);
+  auto infer_shapes = [&](const std::vector<index_t> &shape) {
+    std::map<std::string, std::vector<index_t>> shapes = weight_shapes_;
+    shapes[input_node] = shape;
+    InferNetShapes(*op_registry_, net_def_, device_type_, &shapes);
+    return shapes;
+  };
+  const std::map<std::string, std::vector<index_t>> shapes =
+      infer_shapes(input_shape);
+  std::map<std::string, std::vector<AxisWindow>> fields;
+  InferNetReceptiveFields(*op_registry_, net_def_, device_type_, input_node,
+                          shapes, &fields);
+
+  if (outputs->empty()) {
+    return MACE_INVALID_ARGS;
+  }
+  for (auto &output : *outputs) {
+    if (output_info_map_.find(output.first) == output_info_map_.end()) {
+      LOG(FATAL) << "'" << output.first
+                 << "' is not belong to model's outputs: "
+                 << MakeString(MapKeys(output_info_map_));
+    }
+    const std::string output_node =
+        MakeString("mace_output_node_", output.first);
+    auto shape = shapes.find(output_node);
+    auto field = fields.find(output_node);
+    if (shape == shapes.end() || field == fields.end()
+        || field->second.size() != shape->second.size()
+        || output.second.data() == nullptr) {
+      LOG(ERROR) << "Output " << output.first << " can not be tiled";
+      return MACE_INVALID_ARGS;
+    }
+    const std::vector<int64_t> output_shape(shape->second.begin(),
+                                            shape->second.end());
+    MACE_CHECK(output_shape == output.second.shape())
+        << "Output shape mismatch: "
+        << MakeString<int64_t>(output.second.shape())
+        << " != " << MakeString<int64_t>(output_shape);
+  }
+
+  // Tile the axes larger than the model input along all outputs
+  std::vector<std::vector<TileSpan>> spans(rank);
+  std::vector<int> tiled_axes;
+  for (size_t i = 0; i < rank; ++i) {
+    const int axis = static_cast<int>(i);
+    if (input_shape[i] <= max_tile_shape[i]) {
+      spans[i].push_back({0, input_shape[i], 0, 0, 0});
+      continue;
+    }
+    tiled_axes.push_back(axis);
+    // strided tensors align the tiles, reading outputs take the union of
+    // their windows
+    index_t align = 1;
+    for (auto &field : fields) {
+      for (const AxisWindow &window : field.second) {
+        if (window.axis == axis) {
+          align = align / Gcd(align, window.stride) * window.stride;
+        }
+      }
+    }
+    AxisWindow window = {-1, 0, 0, 0};
+    int output_axis = -1;
+    index_t output_size = 0;
+    for (auto &output : *outputs) {
+      const std::string output_node =
+          MakeString("mace_output_node_", output.first);
+      const std::vector<AxisWindow> &field = fields[output_node];
+      auto output_window =
+          std::find_if(field.begin(), field.end(),
+                       [axis](const AxisWindow &w) { return w.axis == axis; });
+      const int window_axis =
+          static_cast<int>(output_window - field.begin());
+      if (output_window == field.end()
+          || (window.axis >= 0
+              && (window.stride != output_window->stride
+                  || output_size != shapes.at(output_node)[window_axis]))) {
+        LOG(ERROR) << "Outputs can not be tiled along axis " << axis;
+        return MACE_INVALID_ARGS;
+      }
+      if (window.axis < 0) {
+        window = *output_window;
+        output_axis = window_axis;
+        output_size = shapes.at(output_node)[window_axis];
+      }
+      window.begin = std::min(window.begin, output_window->begin);
+      window.end = std::max(window.end, output_window->end);
+    }
+    const std::string output_node =
+        MakeString("mace_output_node_", outputs->begin()->first);
+    auto tile_outputs = [&](index_t size) {
+      std::vector<index_t> shape = input_shape;
+      shape[i] = size;
+      return infer_shapes(shape)[output_node][output_axis];
+    };
+    MACE_RETURN_IF_ERROR(PlanTileSpans(input_shape[i], max_tile_shape[i],
+                                       align, window, output_size,
+                                       tile_outputs, &spans[i]));
+  }
+  size_t tile_count = 1;
+  for (auto &axis_spans : spans) {
+    tile_count *= axis_spans.size();
+  }
+  VLOG(2) << "Run " << input_name << " in " << tile_count << " tiles";
+
+  MACE_RETURN_IF_ERROR(ws_->Rematerialize());
+  Tensor *input_tensor = ws_->GetTensor(input_node);
+  std::vector<size_t> tile(rank, 0);
+  while (true) {
+    std::vector<index_t> tile_shape(rank), tile_offset(rank);
+    for (size_t i = 0; i < rank; ++i) {
+      tile_shape[i] = spans[i][tile[i]].input_size;
+      tile_offset[i] = spans[i][tile[i]].input_offset;
+    }
+    MACE_RETURN_IF_ERROR(input_tensor->Resize(tile_shape));
+    {
+      Tensor::MappingGuard input_guard(input_tensor);
+      CopyBlock(input.data().get(), input_shape, tile_offset, tile_shape,
+                input_tensor->mutable_data<float>(), tile_shape,
+                std::vector<index_t>(rank, 0));
+    }
+    MACE_RETURN_IF_ERROR(net_->Run());
+
+    for (auto &output : *outputs) {
+      const std::string output_node =
+          MakeString("mace_output_node_", output.first);
+      Tensor *output_tensor = ws_->GetTensor(output_node);
+      const std::vector<index_t> &output_shape = shapes.at(output_node);
+      const std::vector<AxisWindow> &field = fields[output_node];
+      std::vector<index_t> src_offset(output_shape.size(), 0);
+      std::vector<index_t> dst_offset(output_shape.size(), 0);
+      std::vector<index_t> size = output_shape;
+      for (size_t d = 0; d < output_shape.size(); ++d) {
+        const int axis = field[d].axis;
+        if (std::find(tiled_axes.begin(), tiled_axes.end(), axis)
+            != tiled_axes.end()) {
+          const TileSpan &span = spans[axis][tile[axis]];
+          src_offset[d] = span.tile_output_offset;
+          dst_offset[d] = span.output_offset;
+          size[d] = span.output_size;
+        } else if (output_tensor->dim(d) != output_shape[d]) {
+          LOG(ERROR) << "Output " << output_node << " of tiles mismatch";
+          return MACE_INVALID_ARGS;
+        }
+      }
+      Tensor::MappingGuard output_guard(output_tensor);
+      CopyBlock(output_tensor->data<float>(), output_tensor->shape(),
+                src_offset, size, output.second.data().get(), output_shape,
+                dst_offset);
+    }
+
+    int axis = static_cast<int>(rank) - 1;
+    for (; axis >= 0; --axis) {
+      if (++tile[axis] < spans[axis].size()) {
+        break;
+      }
+      tile[axis] = 0;
+    }
+    if (axis < 0) {
+      break;
+    }
+  }
+  ws_->UpdateMemoryStats();
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::GetMemoryStats(MemoryStats *stats) {
+  MACE_CHECK_NOTNULL(stats);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ws_->UpdateMemoryStats();
+  *stats = ws_->memory_stats();
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ws_->Trim();
+  ws_->UpdateMemoryStats();
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::Prewarm() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MACE_RETURN_IF_ERROR(ws_->Rematerialize());
+  ws_->UpdateMemoryStats();
+  return MACE_SUCCESS;
+}
+
 MaceEngine::MaceEngine(DeviceType device_type):
     impl_(new MaceEngine::Impl(device_type)) {}
 
@@ -286,7 +681,17 @@ MaceStatus MaceEngine::Init(const NetDef *net_def,
                             const std::vector<std::string> &input_nodes,
                             const std::vector<std::string> &output_nodes,
                             const unsigned char *model_data) {
-  return impl_->Init(net_def, input_nodes, output_nodes, model_data);
+  return impl_->Init(net_def, input_nodes, output_nodes, model_data, {});
+}
+
+MaceStatus MaceEngine::Init(
+    const NetDef *net_def,
+    const std::vector<std::string> &input_nodes,
+    const std::vector<std::string> &output_nodes,
+    const unsigned char *model_data,
+    const std::vector<std::vector<int64_t>> &input_shapes) {
+  return impl_->Init(net_def, input_nodes, output_nodes, model_data,
+                     input_shapes);
 }
 
 MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
@@ -300,6 +705,24 @@ MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
   return impl_->Run(inputs, outputs, nullptr);
 }
 
+MaceStatus MaceEngine::RunTiled(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs) {
+  return impl_->RunTiled(inputs, outputs);
+}
+
+MaceStatus MaceEngine::GetMemoryStats(MemoryStats *stats) const {
+  return impl_->GetMemoryStats(stats);
+}
+
+MaceStatus MaceEngine::Trim() {
+  return impl_->Trim();
+}
+
+MaceStatus MaceEngine::Prewarm() {
+  return impl_->Prewarm();
+}
+
 const unsigned char *LoadModelData(const std::string &model_data_file,
                                    const size_t &data_size) {
   int fd = open(model_data_file.c_str(), O_RDONLY);
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 
 #include "mace/core/macros.h"
@@ -55,6 +58,51 @@ SerialNet::SerialNet(const std::shared_ptr<const OperatorRegistry> op_registry,
       }
     }
   }
+
+  // Collect live range of activations, model weights are excluded.
+  std::unordered_set<const Tensor *> weights;
+  for (auto &const_tensor : net_def->tensors()) {
+    if (ws->HasTensor(const_tensor.name())) {
+      weights.insert(ws->GetTensor(const_tensor.name()));
+    }
+  }
+  std::unordered_map<const Tensor *, size_t> range_idx;
+  const int op_count = static_cast<int>(operators_.size());
+  for (int i = 0; i < op_count; ++i) {
+    for (const Tensor *input : operators_[i]->Inputs()) {
+      if (weights.count(input) > 0) continue;
+      if (range_idx.count(input) == 0) {
+        // net inputs are alive from the beginning
+        range_idx[input] = live_ranges_.size();
+        live_ranges_.push_back({input, 0, i});
+      }
+      live_ranges_[range_idx[input]].last_op = i;
+    }
+    for (const Tensor *output : operators_[i]->Outputs()) {
+      if (range_idx.count(output) == 0) {
+        // last op is updated by consumers, net outputs are kept to the end
+        range_idx[output] = live_ranges_.size();
+        live_ranges_.push_back({output, i, op_count - 1});
+      }
+    }
+  }
+}
+
+int64_t SerialNet::LiveActivationBytes(int op_idx) const {
+  std::unordered_map<const BufferBase *, int64_t> buffer_bytes;
+  for (auto &range : live_ranges_) {
+    const BufferBase *buffer = range.tensor->UnderlyingBuffer();
+    if (range.first_op <= op_idx && op_idx <= range.last_op
+        && buffer != nullptr) {
+      buffer_bytes[buffer] = std::max<int64_t>(buffer_bytes[buffer],
+                                               range.tensor->raw_size());
+    }
+  }
+  int64_t live_bytes = 0;
+  for (auto &entry : buffer_bytes) {
+    live_bytes += entry.second;
+  }
+  return live_bytes;
 }
 
 MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
@@ -62,6 +110,7 @@ MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
   MACE_LATENCY_LOGGER(1, "Running net");
   for (auto iter = operators_.begin(); iter != operators_.end(); ++iter) {
     auto &op = *iter;
+    const int op_idx = static_cast<int>(iter - operators_.begin());
     MACE_LATENCY_LOGGER(2, "Running operator ", op->debug_def().name(), "(",
                         op->debug_def().type(), "), mem_id: ",
                         MakeListString(op->debug_def().mem_id().data(),
@@ -118,7 +167,9 @@ MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
       OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
                                 output_shapes,
                                 {strides, padding_type, paddings, dilations,
-                                 kernels}, call_stats};
+                                 kernels}, call_stats,
+                                LiveActivationBytes(op_idx),
+                                op->Algorithm()};
       run_metadata->op_stats.emplace_back(op_stats);
     }
 
@@ -150,4 +201,143 @@ std::unique_ptr<NetBase> CreateNet(
   return net;
 }
 
+void InferNetShapes(const OperatorRegistry &op_registry,
+                    const NetDef &net_def,
+                    DeviceType type,
+                    std::map<std::string, std::vector<index_t>> *shapes) {
+  MACE_CHECK_NOTNULL(shapes);
+  for (auto &op : net_def.op()) {
+    const int op_device = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+        op, "device", static_cast<int>(type));
+    const int op_mode = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+        op, "mode", static_cast<int>(NetMode::NORMAL));
+    if (op_device != type || op_mode != NetMode::NORMAL) {
+      continue;
+    }
+    const ShapeInferenceFunc *infer_shape =
+        op_registry.GetShapeInference(op.type());
+    if (infer_shape == nullptr) {
+      VLOG(3) << "No shape inference for " << op.name()
+              << "(" << op.type() << ")";
+      continue;
+    }
+    std::vector<std::vector<index_t>> input_shapes;
+    for (auto &input : op.input()) {
+      auto shape = shapes->find(input);
+      if (shape == shapes->end()) {
+        break;
+      }
+      input_shapes.push_back(shape->second);
+    }
+    if (input_shapes.size() != static_cast<size_t>(op.input_size())) {
+      continue;
+    }
+    std::vector<std::vector<index_t>> output_shapes;
+    if ((*infer_shape)(op, input_shapes, &output_shapes)
+        != MaceStatus::MACE_SUCCESS) {
+      VLOG(3) << "Failed to infer output shapes of " << op.name()
+              << "(" << op.type() << ")";
+      continue;
+    }
+    MACE_CHECK(output_shapes.size() <= static_cast<size_t>(op.output_size()));
+    for (size_t i = 0; i < output_shapes.size(); ++i) {
+      VLOG(3) << "Infer shape of " << op.output(i) << ": "
+              << MakeString(output_shapes[i]);
+      (*shapes)[op.output(i)] = output_shapes[i];
+    }
+  }
+}
+
+namespace {
+// The window of an op output over the net input through an op input.
+AxisWindow ComposeWindow(const AxisWindow &window,
+                         const std::vector<AxisWindow> &input_field) {
+  if (window.axis < 0 || input_field[window.axis].axis < 0) {
+    return {-1, 1, 0, 0};
+  }
+  const AxisWindow &field = input_field[window.axis];
+  return {field.axis, field.stride * window.stride,
+          field.begin + window.begin * field.stride,
+          field.end + window.end * field.stride};
+}
+}  // namespace
+
+void InferNetReceptiveFields(
+    const OperatorRegistry &op_registry,
+    const NetDef &net_def,
+    DeviceType type,
+    const std::string &input,
+    const std::map<std::string, std::vector<index_t>> &shapes,
+    std::map<std::string, std::vector<AxisWindow>> *fields) {
+  MACE_CHECK_NOTNULL(fields);
+  auto input_shape = shapes.find(input);
+  MACE_CHECK(input_shape != shapes.end(), "Unknown shape of ", input);
+  std::vector<AxisWindow> input_field;
+  for (size_t i = 0; i < input_shape->second.size(); ++i) {
+    input_field.push_back({static_cast<int>(i), 1, 0, 0});
+  }
+  (*fields)[input] = input_field;
+
+  for (auto &op : net_def.op()) {
+    const int op_device = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+        op, "device", static_cast<int>(type));
+    const int op_mode = ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+        op, "mode", static_cast<int>(NetMode::NORMAL));
+    if (op_device != type || op_mode != NetMode::NORMAL) {
+      continue;
+    }
+    std::vector<const std::vector<AxisWindow> *> input_fields;
+    std::vector<std::vector<index_t>> input_shapes;
+    for (auto &op_input : op.input()) {
+      auto field = fields->find(op_input);
+      if (field != fields->end()) {
+        input_fields.push_back(&field->second);
+      }
+      auto shape = shapes.find(op_input);
+      if (shape != shapes.end()) {
+        input_shapes.push_back(shape->second);
+      }
+    }
+    if (input_fields.empty()) {
+      continue;
+    }
+
+    std::vector<AxisWindow> output_field;
+    const ReceptiveFieldFunc *receptive_field =
+        op_registry.GetReceptiveField(op.type());
+    std::vector<AxisWindow> windows;
+    if (receptive_field != nullptr
+        && input_shapes.size() == static_cast<size_t>(op.input_size())
+        && (*receptive_field)(op, input_shapes, &windows)
+            == MaceStatus::MACE_SUCCESS
+        && std::all_of(input_fields.begin(), input_fields.end(),
+                       [&windows](const std::vector<AxisWindow> *field) {
+                         return field->size() == windows.size();
+                       })) {
+      for (const AxisWindow &window : windows) {
+        AxisWindow output_window = ComposeWindow(window, *input_fields[0]);
+        for (size_t i = 1; i < input_fields.size(); ++i) {
+          const AxisWindow other = ComposeWindow(window, *input_fields[i]);
+          if (other.axis != output_window.axis
+              || other.stride != output_window.stride) {
+            output_window = {-1, 1, 0, 0};
+          } else {
+            output_window.begin = std::min(output_window.begin, other.begin);
+            output_window.end = std::max(output_window.end, other.end);
+          }
+        }
+        output_field.push_back(output_window);
+      }
+    } else {
+      VLOG(3) << op.name() << "(" << op.type()
+              << ") reads whole axes of its inputs";
+    }
+    for (auto &output : op.output()) {
+      (*fields)[output] = output_field;
+      // windows are of the first output
+      output_field.clear();
+    }
+  }
+}
+
 }  // namespace mace
@@ -15,6 +15,7 @@
 #ifndef MACE_CORE_NET_H_
 #define MACE_CORE_NET_H_
 
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -58,7 +59,18 @@ class SerialNet : public NetBase {
   MaceStatus Run(RunMetadata *run_metadata = nullptr) override;
 
  protected:
+  struct TensorLiveRange {
+    const Tensor *tensor;
+    int first_op;
+    int last_op;
+  };
+
+  // Bytes of activations alive while the op_idx-th operator runs,
+  // tensors sharing the same buffer are counted once.
+  int64_t LiveActivationBytes(int op_idx) const;
+
   std::vector<std::unique_ptr<OperatorBase> > operators_;
+  std::vector<TensorLiveRange> live_ranges_;
   DeviceType device_type_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(SerialNet);
@@ -77,6 +89,27 @@ std::unique_ptr<NetBase> CreateNet(
     DeviceType type,
     const NetMode mode = NetMode::NORMAL);
 
+// Propagate the shapes of known tensors, i.e. inputs and weights, through the
+// ops of net_def running on the device. Outputs of ops without shape
+// inference and the tensors depending on them are left unknown.
+void InferNetShapes(const OperatorRegistry &op_registry,
+                    const NetDef &net_def,
+                    DeviceType type,
+                    std::map<std::string, std::vector<index_t>> *shapes);
+
+// Trace the axes of tensors computed from the tensor named input through
+// the ops of net_def running on the device, given the shapes inferred by
+// InferNetShapes. Each traced tensor is mapped to the windows of its axes
+// over the axes of input, or to no windows if it is computed by ops reading
+// whole axes of their inputs.
+void InferNetReceptiveFields(
+    const OperatorRegistry &op_registry,
+    const NetDef &net_def,
+    DeviceType type,
+    const std::string &input,
+    const std::map<std::string, std::vector<index_t>> &shapes,
+    std::map<std::string, std::vector<AxisWindow>> *fields);
+
 }  // namespace mace
 
 #endif  // MACE_CORE_NET_H_
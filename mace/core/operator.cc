@@ -72,6 +72,34 @@ std::unique_ptr<OperatorBase> OperatorRegistry::CreateOperator(
   }
 }
 
+void OperatorRegistry::RegisterShapeInference(const std::string &op_type,
+                                              ShapeInferenceFunc func) {
+  shape_inference_funcs_[op_type] = func;
+}
+
+const ShapeInferenceFunc *OperatorRegistry::GetShapeInference(
+    const std::string &op_type) const {
+  auto func = shape_inference_funcs_.find(op_type);
+  if (func == shape_inference_funcs_.end()) {
+    return nullptr;
+  }
+  return &func->second;
+}
+
+void OperatorRegistry::RegisterReceptiveField(const std::string &op_type,
+                                              ReceptiveFieldFunc func) {
+  receptive_field_funcs_[op_type] = func;
+}
+
+const ReceptiveFieldFunc *OperatorRegistry::GetReceptiveField(
+    const std::string &op_type) const {
+  auto func = receptive_field_funcs_.find(op_type);
+  if (func == receptive_field_funcs_.end()) {
+    return nullptr;
+  }
+  return &func->second;
+}
+
 namespace ops {
 // Keep in lexicographical order
 extern void Register_Activation(OperatorRegistry *op_registry);
@@ -99,11 +127,15 @@ extern void Register_Pad(OperatorRegistry *op_registry);
 extern void Register_Pooling(OperatorRegistry *op_registry);
 extern void Register_Proposal(OperatorRegistry *op_registry);
 extern void Register_Quantize(OperatorRegistry *op_registry);
+extern void Register_ReceptiveField(OperatorRegistry *op_registry);
 extern void Register_ReduceMean(OperatorRegistry *op_registry);
+extern void Register_Reorder(OperatorRegistry *op_registry);
 extern void Register_Requantize(OperatorRegistry *op_registry);
 extern void Register_Reshape(OperatorRegistry *op_registry);
 extern void Register_ResizeBilinear(OperatorRegistry *op_registry);
+extern void Register_SeparableConv2d(OperatorRegistry *op_registry);
 extern void Register_Shape(OperatorRegistry *op_registry);
+extern void Register_ShapeInference(OperatorRegistry *op_registry);
 extern void Register_Slice(OperatorRegistry *op_registry);
 extern void Register_Softmax(OperatorRegistry *op_registry);
 extern void Register_Stack(OperatorRegistry *op_registry);
@@ -111,6 +143,7 @@ extern void Register_StridedSlice(OperatorRegistry *op_registry);
 extern void Register_SpaceToBatchND(OperatorRegistry *op_registry);
 extern void Register_SpaceToDepth(OperatorRegistry *op_registry);
 extern void Register_Squeeze(OperatorRegistry *op_registry);
+extern void Register_TiledChain(OperatorRegistry *op_registry);
 extern void Register_Transpose(OperatorRegistry *op_registry);
 extern void Register_WinogradInverseTransform(OperatorRegistry *op_registry);
 extern void Register_WinogradTransform(OperatorRegistry *op_registry);
@@ -148,11 +181,15 @@ OperatorRegistry::OperatorRegistry() {
   ops::Register_Pooling(this);
   ops::Register_Proposal(this);
   ops::Register_Quantize(this);
+  ops::Register_ReceptiveField(this);
   ops::Register_ReduceMean(this);
+  ops::Register_Reorder(this);
   ops::Register_Requantize(this);
   ops::Register_Reshape(this);
   ops::Register_ResizeBilinear(this);
+  ops::Register_SeparableConv2d(this);
   ops::Register_Shape(this);
+  ops::Register_ShapeInference(this);
   ops::Register_Slice(this);
   ops::Register_Softmax(this);
   ops::Register_Stack(this);
@@ -160,6 +197,7 @@ OperatorRegistry::OperatorRegistry() {
   ops::Register_SpaceToBatchND(this);
   ops::Register_SpaceToDepth(this);
   ops::Register_Squeeze(this);
+  ops::Register_TiledChain(this);
   ops::Register_Transpose(this);
   ops::Register_WinogradInverseTransform(this);
   ops::Register_WinogradTransform(this);
@@ -15,8 +15,10 @@
 #ifndef MACE_CORE_OPERATOR_H_
 #define MACE_CORE_OPERATOR_H_
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <map>
 
@@ -65,6 +67,9 @@ class OperatorBase {
   // Run Op asynchronously (depends on device), return a future if not nullptr.
   virtual MaceStatus Run(StatsFuture *future) = 0;
 
+  // Kernels the last run picked, for ops that have more than one.
+  virtual std::string Algorithm() const { return ""; }
+
   inline const OperatorDef &debug_def() const {
     MACE_CHECK(has_debug_def(), "operator_def was null!");
     return *operator_def_;
@@ -163,6 +168,30 @@ OpKeyBuilder &OpKeyBuilder::TypeConstraint(const char *attr_name) {
   return this->TypeConstraint(attr_name, DataTypeToEnum<T>::value);
 }
 
+// Computes output shapes of an op from its input shapes without running it,
+// shapes are in the layout used by CPU ops.
+typedef std::function<MaceStatus(const OperatorDef &,
+                                 const std::vector<std::vector<index_t>> &,
+                                 std::vector<std::vector<index_t>> *)>
+    ShapeInferenceFunc;
+
+// Index x along an axis of an op output reads indices
+// [x * stride + begin, x * stride + end] along `axis` of the op inputs, or
+// all indices of the input axes no other window reads if axis is -1.
+struct AxisWindow {
+  int axis;
+  index_t stride;
+  index_t begin;
+  index_t end;
+};
+
+// Computes the window of each axis of the output of an op from its input
+// shapes, applying to all its inputs with the output shape.
+typedef std::function<MaceStatus(const OperatorDef &,
+                                 const std::vector<std::vector<index_t>> &,
+                                 std::vector<AxisWindow> *)>
+    ReceptiveFieldFunc;
+
 class OperatorRegistry {
  public:
   typedef Registry<std::string, OperatorBase, const OperatorDef &, Workspace *>
@@ -175,8 +204,24 @@ class OperatorRegistry {
                                                DeviceType type,
                                                const NetMode mode) const;
 
+  void RegisterShapeInference(const std::string &op_type,
+                              ShapeInferenceFunc func);
+
+  // Returns nullptr if the output shapes of op_type can not be inferred.
+  const ShapeInferenceFunc *GetShapeInference(
+      const std::string &op_type) const;
+
+  void RegisterReceptiveField(const std::string &op_type,
+                              ReceptiveFieldFunc func);
+
+  // Returns nullptr if op_type does not read local windows of its inputs.
+  const ReceptiveFieldFunc *GetReceptiveField(
+      const std::string &op_type) const;
+
  private:
   RegistryType registry_;
+  std::unordered_map<std::string, ShapeInferenceFunc> shape_inference_funcs_;
+  std::unordered_map<std::string, ReceptiveFieldFunc> receptive_field_funcs_;
   MACE_DISABLE_COPY_AND_ASSIGN(OperatorRegistry);
 };
 
@@ -46,6 +46,10 @@ class PreallocatedPooledAllocator {
     return buffers_.find(mem_id) != buffers_.end();
   }
 
+  const std::unordered_map<int, std::unique_ptr<BufferBase>> &buffers() const {
+    return buffers_;
+  }
+
  private:
   std::unordered_map<int, std::unique_ptr<BufferBase>> buffers_;
 };
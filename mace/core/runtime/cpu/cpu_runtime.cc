@@ -195,6 +195,53 @@ MaceStatus SetOpenMPThreadsAndAffinityPolicy(int omp_num_threads_hint,
   return MACE_SUCCESS;
 }
 
+int GetOpenMPMaxThreads() {
+#ifdef MACE_ENABLE_OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+int GetOpenMPThreadNum() {
+#ifdef MACE_ENABLE_OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+int GetCPUL2CacheSize() {
+  static const int size = [] {
+    for (int index = 0; ; ++index) {
+      char path[64];
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+      FILE *fp = fopen(path, "rb");
+      if (!fp) break;
+      int level = 0;
+      int items_read = fscanf(fp, "%d", &level);
+      fclose(fp);
+      if (items_read != 1 || level != 2) continue;
+
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+      fp = fopen(path, "rb");
+      if (!fp) break;
+      int value = 0;
+      char unit = 'K';
+      items_read = fscanf(fp, "%d%c", &value, &unit);
+      fclose(fp);
+      if (items_read >= 1 && value > 0) {
+        return unit == 'M' ? value << 20 : value << 10;
+      }
+    }
+    LOG(WARNING) << "Cannot get CPU0's l2 cache size, assume 256 KB.";
+    return 256 * 1024;
+  }();
+  return size;
+}
+
 MaceStatus SetOpenMPThreadPolicy(int num_threads_hint,
                                  CPUAffinityPolicy policy) {
   VLOG(1) << "Set OpenMP threads number hint: " << num_threads_hint
@@ -31,6 +31,15 @@ void SetOpenMPThreadsAndAffinityCPUs(int omp_num_threads,
 MaceStatus SetOpenMPThreadsAndAffinityPolicy(int omp_num_threads_hint,
                                              CPUAffinityPolicy policy);
 
+// Max number of threads used by a parallel region, 1 without OpenMP.
+int GetOpenMPMaxThreads();
+
+// Id of the calling thread within its parallel region, 0 without OpenMP.
+int GetOpenMPThreadNum();
+
+// Bytes of the l2 cache of cpu0 as sysfs reports it, 256 KB if it does not.
+int GetCPUL2CacheSize();
+
 }  // namespace mace
 
 #endif  // MACE_CORE_RUNTIME_CPU_CPU_RUNTIME_H_
@@ -0,0 +1,156 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/runtime/cpu/cpu_tuner.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/utils/env_time.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+
+extern std::shared_ptr<KVStorageFactory> kStorageFactory;
+
+namespace {
+const char *kCPUTunedParamsFileName = "mace_cpu_tuned_params.bin";
+
+// Timed runs of each candidate after the warm up, fewer if they take long.
+const int kTuningRuns = 5;
+const int64_t kTuningMicros = 100000;
+}  // namespace
+
+CPUTuner *CPUTuner::Get() {
+  static CPUTuner tuner;
+  return &tuner;
+}
+
+CPUTuner::CPUTuner() : loaded_(false) {}
+
+bool CPUTuner::IsTuning() const {
+  const char *tuning = getenv("MACE_TUNING");
+  return tuning != nullptr && strlen(tuning) == 1 && tuning[0] == '1';
+}
+
+std::string CPUTuner::ThreadKey(const std::string &key) const {
+  return MakeString(key, "_t", GetOpenMPMaxThreads());
+}
+
+void CPUTuner::LoadLocked() {
+  if (loaded_) {
+    return;
+  }
+  loaded_ = true;
+  params_.clear();
+  storage_.reset();
+  if (kStorageFactory == nullptr) {
+    return;
+  }
+  storage_ = kStorageFactory->CreateStorage(kCPUTunedParamsFileName);
+  if (storage_->Load() != 0) {
+    LOG(WARNING) << "Load cpu tuned parameters failed. "
+                 << "Please make sure the storage directory exist "
+                 << "and you have Write&Read permission";
+  }
+}
+
+void CPUTuner::Reload() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  loaded_ = false;
+  LoadLocked();
+}
+
+bool CPUTuner::Find(const std::string &key, std::vector<int> *params) {
+  const std::string thread_key = ThreadKey(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+  LoadLocked();
+  auto it = params_.find(thread_key);
+  if (it == params_.end()) {
+    const std::vector<unsigned char> *value =
+        storage_ == nullptr ? nullptr : storage_->Find(thread_key);
+    if (value == nullptr || value->empty()
+        || value->size() % sizeof(int) != 0) {
+      return false;
+    }
+    std::vector<int> stored(value->size() / sizeof(int));
+    memcpy(stored.data(), value->data(), value->size());
+    it = params_.emplace(thread_key, stored).first;
+  }
+  *params = it->second;
+  return true;
+}
+
+MaceStatus CPUTuner::Tune(const std::string &key,
+                          const std::vector<std::vector<int>> &candidates,
+                          const RunFunc &func,
+                          std::vector<int> *best_params) {
+  int64_t best_micros = std::numeric_limits<int64_t>::max();
+  for (const std::vector<int> &params : candidates) {
+    // warm up
+    MACE_RETURN_IF_ERROR(func(params));
+    int64_t min_micros = std::numeric_limits<int64_t>::max();
+    int64_t total_micros = 0;
+    for (int i = 0; i < kTuningRuns && total_micros < kTuningMicros; ++i) {
+      const int64_t start = NowMicros();
+      MACE_RETURN_IF_ERROR(func(params));
+      const int64_t micros = NowMicros() - start;
+      min_micros = std::min(min_micros, micros);
+      total_micros += micros;
+    }
+    VLOG(2) << "Tuning " << key << " with " << MakeString(params) << ": "
+            << min_micros << " us";
+    if (min_micros < best_micros) {
+      best_micros = min_micros;
+      *best_params = params;
+    }
+  }
+  // the output is that of the last candidate, which all of them produce
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus CPUTuner::TuneOrRun(const std::string &key,
+                               const std::vector<int> &default_params,
+                               const std::vector<std::vector<int>> &candidates,
+                               const RunFunc &func) {
+  if (!IsTuning() || candidates.size() <= 1) {
+    std::vector<int> params;
+    return func(Find(key, &params) ? params : default_params);
+  }
+
+  std::vector<int> best_params = default_params;
+  MACE_RETURN_IF_ERROR(Tune(key, candidates, func, &best_params));
+  VLOG(1) << "Tuned " << key << ": " << MakeString(best_params);
+
+  const std::string thread_key = ThreadKey(key);
+  std::lock_guard<std::mutex> lock(mutex_);
+  LoadLocked();
+  params_[thread_key] = best_params;
+  if (storage_ != nullptr) {
+    const unsigned char *bytes =
+        reinterpret_cast<const unsigned char *>(best_params.data());
+    storage_->Insert(thread_key, std::vector<unsigned char>(
+        bytes, bytes + best_params.size() * sizeof(int)));
+    if (storage_->Flush() != 0) {
+      LOG(WARNING) << "Write cpu tuned parameters failed.";
+    }
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+}  // namespace mace
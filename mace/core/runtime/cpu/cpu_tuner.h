@@ -0,0 +1,81 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_CORE_RUNTIME_CPU_CPU_TUNER_H_
+#define MACE_CORE_RUNTIME_CPU_CPU_TUNER_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
+#include <vector>
+
+#include "mace/public/mace.h"
+#include "mace/public/mace_runtime.h"
+
+namespace mace {
+
+// Picks the parameters of cpu kernels, such as the algorithm and the
+// blocking of a convolution, for the shapes of a layer and the number of
+// threads. When MACE_TUNING=1, as for the opencl Tuner, each candidate is
+// timed and the fastest one is kept, and written to the storage of the
+// KVStorageFactory set with SetKVStorageFactory; otherwise the parameters
+// kept for the layer, or the default ones, are replayed.
+class CPUTuner {
+ public:
+  typedef std::function<MaceStatus(const std::vector<int> &)> RunFunc;
+
+  static CPUTuner *Get();
+
+  bool IsTuning() const;
+
+  // Run func with the parameters tuned for key, or with default_params if
+  // there are none. When tuning, func is run with each of candidates and
+  // the parameters of the fastest run are kept, which is why func must
+  // produce the same output for all of them.
+  MaceStatus TuneOrRun(const std::string &key,
+                       const std::vector<int> &default_params,
+                       const std::vector<std::vector<int>> &candidates,
+                       const RunFunc &func);
+
+  // Copy the parameters kept for key to params, false if there are none.
+  bool Find(const std::string &key, std::vector<int> *params);
+
+  // Drop the parameters kept in memory and read them again from storage.
+  void Reload();
+
+ private:
+  CPUTuner();
+
+  // key with the number of threads, which the best parameters depend on
+  std::string ThreadKey(const std::string &key) const;
+  MaceStatus Tune(const std::string &key,
+                  const std::vector<std::vector<int>> &candidates,
+                  const RunFunc &func,
+                  std::vector<int> *best_params);
+  void LoadLocked();
+
+  std::mutex mutex_;
+  bool loaded_;
+  std::unique_ptr<KVStorage> storage_;
+  std::map<std::string, std::vector<int>> params_;
+
+  CPUTuner(const CPUTuner &) = delete;
+  CPUTuner &operator=(const CPUTuner &) = delete;
+};
+
+}  // namespace mace
+
+#endif  // MACE_CORE_RUNTIME_CPU_CPU_TUNER_H_
@@ -96,7 +96,9 @@ inline std::ostream &operator<<(std::ostream &os, unsigned char c) {
 }
 }  // namespace numerical_chars
 
-enum DataFormat { NHWC = 0, NCHW = 1, HWOI = 2, OIHW = 3, HWIO = 4 };
+enum DataFormat {
+  NHWC = 0, NCHW = 1, HWOI = 2, OIHW = 3, HWIO = 4, NCHWc = 5
+};
 
 class Tensor {
  public:
@@ -211,8 +213,11 @@ class Tensor {
     if (buffer_ != nullptr) {
       MACE_CHECK(!has_opencl_image(), "Cannot resize image, use ResizeImage.");
       if (raw_size() + MACE_EXTRA_BUFFER_PAD_SIZE > buffer_->size()) {
-        LOG(WARNING) << "Resize buffer from size " << buffer_->size() << " to "
-                     << raw_size() + MACE_EXTRA_BUFFER_PAD_SIZE;
+        // Empty buffer was released by Workspace::Trim, so it is expected
+        if (buffer_->size() > 0) {
+          LOG(WARNING) << "Resize buffer from size " << buffer_->size()
+                       << " to " << raw_size() + MACE_EXTRA_BUFFER_PAD_SIZE;
+        }
         return buffer_->Resize(raw_size() + MACE_EXTRA_BUFFER_PAD_SIZE);
       }
       return MaceStatus::MACE_SUCCESS;
@@ -305,6 +310,8 @@ class Tensor {
 
   inline BufferBase *UnderlyingBuffer() const { return buffer_; }
 
+  inline bool is_buffer_owner() const { return is_buffer_owner_; }
+
   inline void SetSourceOpName(const std::string name) { name_ = name; }
 
   inline void DebugPrint() const {
@@ -12,8 +12,11 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <string>
+#include <typeinfo>
 #include <vector>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
@@ -30,10 +33,34 @@ bool ShouldPreallocateMemoryForOp(const OperatorDef &op) {
   };
   return reuse_buffer_ops.find(op.type()) == reuse_buffer_ops.end();
 }
+
+// These ops write each output element right after reading the input element
+// at the same position, so the memory optimizer may let the output share the
+// memory block of an input which has no other consumers.
+bool CanRunInPlace(const OperatorDef &op) {
+  static const std::unordered_set<std::string> inplace_ops {
+      "Activation", "BatchNorm", "BiasAdd", "Eltwise", "FoldedBatchNorm"
+  };
+  return inplace_ops.find(op.type()) != inplace_ops.end();
+}
+
+bool IsImage(const BufferBase *buffer) {
+  return typeid(*buffer) == typeid(Image);
+}
+
+void UpdateMemoryUsage(const index_t current_bytes, MemoryUsage *usage) {
+  usage->current_bytes = current_bytes;
+  usage->peak_bytes = std::max<int64_t>(usage->peak_bytes, current_bytes);
+}
 }  // namespace
 
-Workspace::Workspace() : host_scratch_buffer_(new ScratchBuffer(
-  GetDeviceAllocator(DeviceType::CPU))) {}
+Workspace::Workspace()
+    : host_scratch_buffer_(
+          new ScratchBuffer(GetDeviceAllocator(DeviceType::CPU))),
+      host_thread_scratch_buffer_(
+          new ThreadScratchBuffer(GetDeviceAllocator(DeviceType::CPU))),
+      is_trimmed_(false),
+      memory_stats_() {}
 
 Tensor *Workspace::CreateTensor(const std::string &name,
                                 Allocator *alloc,
@@ -48,6 +75,17 @@ Tensor *Workspace::CreateTensor(const std::string &name,
   return GetTensor(name);
 }
 
+Tensor *Workspace::CreateDerivedTensor(const std::string &name,
+                                       Allocator *alloc,
+                                       DataType type) {
+  derived_tensors_[name] = true;
+  return CreateTensor(name, alloc, type);
+}
+
+void Workspace::MarkTensorDerived(const std::string &name) {
+  derived_tensors_[name] = false;
+}
+
 const Tensor *Workspace::GetTensor(const std::string &name) const {
   if (tensor_map_.count(name)) {
     return tensor_map_.at(name).get();
@@ -183,16 +221,26 @@ MaceStatus Workspace::CreateOutputTensorBuffer(const NetDef &net_def,
     }
   }
   VLOG(3) << "Preallocate buffer to tensors";
+  std::unordered_map<std::string, int> tensor_mem_ids;
   for (auto &op : net_def.op()) {
     // TODO(liuqi): refactor based on PB
     const int op_device =
         ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
             op, "device", static_cast<int>(device_type));
-    if (op_device == device_type && !op.mem_id().empty()
-        && ShouldPreallocateMemoryForOp(op)) {
-      auto mem_ids = op.mem_id();
-      int count = mem_ids.size();
+    if (op_device != device_type || op.mem_id().empty()) {
+      continue;
+    }
+    auto mem_ids = op.mem_id();
+    int count = mem_ids.size();
+    if (ShouldPreallocateMemoryForOp(op)) {
       for (int i = 0; i < count; ++i) {
+        for (auto &input : op.input()) {
+          auto input_mem_id = tensor_mem_ids.find(input);
+          MACE_CHECK(input_mem_id == tensor_mem_ids.end()
+                         || input_mem_id->second != mem_ids[i]
+                         || CanRunInPlace(op),
+                     op.name(), "(", op.type(), ") can not run in place");
+        }
         DataType output_type;
         if (i < op.output_type_size()) {
           output_type = op.output_type(i);
@@ -220,6 +268,33 @@ MaceStatus Workspace::CreateOutputTensorBuffer(const NetDef &net_def,
         tensor_map_[op.output(i)] = std::move(tensor);
       }
     }
+    for (int i = 0; i < count && i < op.output_size(); ++i) {
+      tensor_mem_ids[op.output(i)] = mem_ids[i];
+    }
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus Workspace::PreallocateTensors(
+    const NetDef &net_def,
+    DeviceType device_type,
+    const std::map<std::string, std::vector<index_t>> &shapes) {
+  MACE_LATENCY_LOGGER(1, "Preallocate tensors");
+  for (auto &op : net_def.op()) {
+    const int op_device =
+        ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+            op, "device", static_cast<int>(device_type));
+    if (op_device != device_type || !ShouldPreallocateMemoryForOp(op)) {
+      continue;
+    }
+    for (auto &output : op.output()) {
+      auto shape = shapes.find(output);
+      auto tensor = tensor_map_.find(output);
+      if (shape == shapes.end() || tensor == tensor_map_.end()) {
+        continue;
+      }
+      MACE_RETURN_IF_ERROR(tensor->second->Resize(shape->second));
+    }
   }
   return MaceStatus::MACE_SUCCESS;
 }
@@ -232,4 +307,103 @@ ScratchBuffer *Workspace::GetScratchBuffer(DeviceType device_type) {
   }
 }
 
+ThreadScratchBuffer *Workspace::GetThreadScratchBuffer(
+    DeviceType device_type) {
+  if (device_type == CPU) {
+    return host_thread_scratch_buffer_.get();
+  } else {
+    return nullptr;
+  }
+}
+
+void Workspace::UpdateMemoryStats() {
+  index_t derived_size = 0;
+  index_t activation_size = 0;
+  index_t image_size = 0;
+  for (auto &mem_block : preallocated_allocator_.buffers()) {
+    const BufferBase *buffer = mem_block.second.get();
+    if (IsImage(buffer)) {
+      image_size += buffer->size();
+    } else {
+      activation_size += buffer->size();
+    }
+  }
+  // Tensors backed by model data or the arena do not own their buffers,
+  // so every buffer below is counted only once.
+  for (auto &entry : tensor_map_) {
+    const Tensor *tensor = entry.second.get();
+    const BufferBase *buffer = tensor->UnderlyingBuffer();
+    if (!tensor->is_buffer_owner() || buffer == nullptr) {
+      continue;
+    }
+    if (IsImage(buffer)) {
+      image_size += buffer->size();
+    } else if (derived_tensors_.count(entry.first) > 0) {
+      derived_size += buffer->size();
+    } else {
+      activation_size += buffer->size();
+    }
+  }
+
+  UpdateMemoryUsage(tensor_buffer_ == nullptr ? 0 : tensor_buffer_->size(),
+                    &memory_stats_.model_weights);
+  UpdateMemoryUsage(derived_size, &memory_stats_.derived_tensors);
+  UpdateMemoryUsage(activation_size, &memory_stats_.activations);
+  UpdateMemoryUsage(host_scratch_buffer_->size()
+                        + host_thread_scratch_buffer_->size(),
+                    &memory_stats_.scratch);
+  UpdateMemoryUsage(image_size, &memory_stats_.opencl_images);
+}
+
+void Workspace::Trim() {
+  if (is_trimmed_) {
+    return;
+  }
+  for (auto &mem_block : preallocated_allocator_.buffers()) {
+    BufferBase *buffer = mem_block.second.get();
+    if (!IsImage(buffer)) {
+      trimmed_buffer_sizes_[mem_block.first] = buffer->size();
+    }
+    buffer->Release();
+  }
+  // Owned OpenCL images are kept, as they may be outputs of init net, whose
+  // inputs are gone after the model data is unloaded.
+  for (auto &entry : tensor_map_) {
+    Tensor *tensor = entry.second.get();
+    BufferBase *buffer = tensor->UnderlyingBuffer();
+    if (!tensor->is_buffer_owner() || buffer == nullptr || IsImage(buffer)) {
+      continue;
+    }
+    auto derived = derived_tensors_.find(entry.first);
+    if (derived != derived_tensors_.end() && !derived->second) {
+      continue;
+    }
+    buffer->Release();
+  }
+  host_scratch_buffer_->Release();
+  host_thread_scratch_buffer_->Release();
+  is_trimmed_ = true;
+}
+
+MaceStatus Workspace::Rematerialize() {
+  if (!is_trimmed_) {
+    return MaceStatus::MACE_SUCCESS;
+  }
+  MACE_LATENCY_LOGGER(1, "Rematerialize memory arena");
+  for (auto &mem_block : preallocated_allocator_.buffers()) {
+    BufferBase *buffer = mem_block.second.get();
+    if (IsImage(buffer)) {
+      Image *image = static_cast<Image *>(buffer);
+      MACE_RETURN_IF_ERROR(
+          image->Allocate(image->image_shape(), image->dtype()));
+    } else {
+      MACE_RETURN_IF_ERROR(
+          buffer->Allocate(trimmed_buffer_sizes_.at(mem_block.first)));
+    }
+  }
+  trimmed_buffer_sizes_.clear();
+  is_trimmed_ = false;
+  return MaceStatus::MACE_SUCCESS;
+}
+
 }  // namespace mace
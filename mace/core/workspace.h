@@ -19,6 +19,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 
 #include "mace/core/preallocated_pooled_allocator.h"
 #include "mace/core/tensor.h"
@@ -37,6 +38,16 @@ class Workspace {
                        Allocator *alloc,
                        DataType type);
 
+  // Derived tensors are computed from model weights and kept across runs,
+  // e.g. transformed filters, they are accounted apart from activations.
+  // Tensors created here are computed again by their ops once released.
+  Tensor *CreateDerivedTensor(const std::string &name,
+                              Allocator *alloc,
+                              DataType type);
+
+  // Mark outputs of init net, which are kept by Trim.
+  void MarkTensorDerived(const std::string &name);
+
   inline bool HasTensor(const std::string &name) const {
     return tensor_map_.find(name) != tensor_map_.end();
   }
@@ -51,8 +62,32 @@ class Workspace {
                              DeviceType type,
                              const unsigned char *model_data);
 
+  // Resize output tensors of ops to their inferred shapes ahead of running,
+  // tensors reusing the buffer of their inputs are skipped.
+  MaceStatus PreallocateTensors(
+      const NetDef &net_def,
+      DeviceType device_type,
+      const std::map<std::string, std::vector<index_t>> &shapes);
+
   ScratchBuffer *GetScratchBuffer(DeviceType device_type);
 
+  ThreadScratchBuffer *GetThreadScratchBuffer(DeviceType device_type);
+
+  // Recompute the current memory usage and update the peaks.
+  void UpdateMemoryStats();
+
+  // Release activations, scratch buffers and derived tensors which could be
+  // computed again. Tensors owning their buffers are allocated again when
+  // they are resized by the next run, the memory arena by Rematerialize.
+  void Trim();
+
+  // Allocate the memory arena released by Trim.
+  MaceStatus Rematerialize();
+
+  inline bool is_trimmed() const { return is_trimmed_; }
+
+  inline const MemoryStats &memory_stats() const { return memory_stats_; }
+
  private:
   MaceStatus CreateOutputTensorBuffer(const NetDef &net_def,
                                       DeviceType device_type);
@@ -65,6 +100,18 @@ class Workspace {
 
   std::unique_ptr<ScratchBuffer> host_scratch_buffer_;
 
+  std::unique_ptr<ThreadScratchBuffer> host_thread_scratch_buffer_;
+
+  // derived tensor name -> whether it is computed again after released
+  std::unordered_map<std::string, bool> derived_tensors_;
+
+  // mem id -> size of the arena buffer released by Trim
+  std::unordered_map<int, index_t> trimmed_buffer_sizes_;
+
+  bool is_trimmed_;
+
+  MemoryStats memory_stats_;
+
   MACE_DISABLE_COPY_AND_ASSIGN(Workspace);
 };
 
@@ -138,7 +138,25 @@ class ActivationFunctor<DeviceType::CPU, float> {
     MACE_UNUSED(future);
     const float *input_ptr = input->data<float>();
     float *output_ptr = output->mutable_data<float>();
-    if (activation_ == PRELU) {
+    if (activation_ == PRELU && input->dim_size() == 5) {
+      // NCHWc, lane l of channel block cb is channel cb * block + l
+      MACE_CHECK_NOTNULL(alpha);
+      const float *alpha_ptr = alpha->data<float>();
+      const index_t channel_blocks = input->dim(1);
+      const index_t block = input->dim(4);
+      const index_t image_size = input->dim(2) * input->dim(3);
+#pragma omp parallel for collapse(2)
+      for (index_t b = 0; b < input->dim(0); ++b) {
+        for (index_t cb = 0; cb < channel_blocks; ++cb) {
+          const index_t offset = (b * channel_blocks + cb) * image_size * block;
+          const float *alpha_block = alpha_ptr + cb * block;
+          for (index_t i = 0; i < image_size * block; ++i) {
+            const float in = input_ptr[offset + i];
+            output_ptr[offset + i] = in < 0 ? in * alpha_block[i % block] : in;
+          }
+        }
+      }
+    } else if (activation_ == PRELU) {
       MACE_CHECK_NOTNULL(alpha);
       const float *alpha_ptr = alpha->data<float>();
       const index_t outer_size = output->dim(0);
@@ -20,14 +20,13 @@
 namespace mace {
 namespace kernels {
 
-void Conv2dNeonK1x1S1(const float *input,
-                      const float *filter,
-                      const index_t batch,
-                      const index_t height,
-                      const index_t width,
-                      const index_t in_channels,
-                      const index_t out_channels,
-                      float *output);
+// Any stride, the input is not padded beyond the strided pixels read.
+void Conv2dNeonK1x1(const float *input,
+                    const float *filter,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *strides,
+                    float *output);
 
 void Conv2dNeonK3x3S1(const float *input,
                       const float *filter,
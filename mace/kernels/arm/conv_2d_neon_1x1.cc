@@ -22,18 +22,24 @@
 namespace mace {
 namespace kernels {
 
-void Conv2dNeonK1x1S1(const float *input,
-                      const float *filter,
-                      const index_t batch,
-                      const index_t height,
-                      const index_t width,
-                      const index_t in_channels,
-                      const index_t out_channels,
-                      float *output) {
-  for (index_t b = 0; b < batch; ++b) {
-    Gemm(filter, input + b * in_channels * height * width, 1, out_channels,
-         in_channels, height * width,
-         output + b * out_channels * height * width);
+void Conv2dNeonK1x1(const float *input,
+                    const float *filter,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *strides,
+                    float *output) {
+  const index_t batch = out_shape[0];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  // the whole batch is one gemm sharing the filter, so small images still
+  // fill the gemm blocks and threads
+  if (in_shape[2] == out_shape[2] && in_shape[3] == out_shape[3]) {
+    GemmSharedA(filter, input, batch, out_shape[1], in_shape[1],
+                out_image_size, output);
+  } else {
+    const GemmImage image = {in_shape[2], in_shape[3], out_shape[3],
+                             {strides[0], strides[1]}};
+    GemmSharedA(filter, input, batch, out_shape[1], in_shape[1],
+                out_image_size, output, &image);
   }
 }
 
@@ -0,0 +1,243 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/gemm.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// Column buffer is sized for L2 cache, and tiles are aligned to gemm blocks.
+const index_t kIm2ColBufferBytes = 1024 * 1024;
+const index_t kIm2ColTileAlignment = 64;
+
+// One image of CHW => [C * KH * KW, tile_end - tile_begin], the taps in the
+// padding are zero.
+void Im2Col(const float *input,
+            const index_t *in_shape,
+            const index_t *out_shape,
+            const index_t *filter_shape,
+            const int *strides,
+            const int *dilations,
+            const int *pad_hw,
+            const index_t tile_begin,
+            const index_t tile_end,
+            float *col) {
+  const index_t in_channels = in_shape[1];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_width = out_shape[3];
+  const index_t filter_height = filter_shape[2];
+  const index_t filter_width = filter_shape[3];
+  const index_t tile_len = tile_end - tile_begin;
+
+#pragma omp parallel for collapse(3)
+  for (index_t c = 0; c < in_channels; ++c) {
+    for (index_t kh = 0; kh < filter_height; ++kh) {
+      for (index_t kw = 0; kw < filter_width; ++kw) {
+        float *col_ptr =
+            col + ((c * filter_height + kh) * filter_width + kw) * tile_len;
+        const float *in_ptr = input + c * in_height * in_width;
+        const index_t h_offset = kh * dilations[0] - pad_hw[0];
+        const index_t w_offset = kw * dilations[1] - pad_hw[1];
+        // outputs [w_begin, w_end) of a row read inside the input
+        const index_t w_begin = std::min(
+            out_width, RoundUpDiv<index_t>(std::max<index_t>(0, -w_offset),
+                                           strides[1]));
+        const index_t w_end = std::max(w_begin, std::min(
+            out_width,
+            RoundUpDiv<index_t>(in_width - w_offset, strides[1])));
+        index_t oh = tile_begin / out_width;
+        index_t ow = tile_begin % out_width;
+        index_t j = 0;
+        while (j < tile_len) {
+          const index_t len = std::min(out_width - ow, tile_len - j);
+          const index_t ih = oh * strides[0] + h_offset;
+          float *col_row = col_ptr + j - ow;
+          const index_t begin = std::max(ow, w_begin);
+          const index_t end = std::min(ow + len, w_end);
+          if (ih < 0 || ih >= in_height || begin >= end) {
+            memset(col_row + ow, 0, len * sizeof(float));
+          } else {
+            memset(col_row + ow, 0, (begin - ow) * sizeof(float));
+            const float *in_row =
+                in_ptr + ih * in_width + begin * strides[1] + w_offset;
+            if (strides[1] == 1) {
+              memcpy(col_row + begin, in_row, (end - begin) * sizeof(float));
+            } else {
+              for (index_t i = 0; i < end - begin; ++i) {
+                col_row[begin + i] = in_row[i * strides[1]];
+              }
+            }
+            memset(col_row + end, 0, (ow + len - end) * sizeof(float));
+          }
+          j += len;
+          ow = 0;
+          ++oh;
+        }
+      }
+    }
+  }
+}
+}  // namespace
+
+index_t Im2ColTileSize(const index_t *filter_shape,
+                       const index_t out_image_size,
+                       const index_t group) {
+  const index_t col_height = group * filter_shape[1] * filter_shape[2]
+      * filter_shape[3];
+  index_t tile_size = kIm2ColBufferBytes / (col_height * sizeof(float))
+      / kIm2ColTileAlignment * kIm2ColTileAlignment;
+  tile_size = std::max(tile_size, kIm2ColTileAlignment);
+  return std::min(tile_size, out_image_size);
+}
+
+index_t Im2ColBufferSize(const index_t *filter_shape,
+                         const index_t out_image_size,
+                         const index_t tile_size,
+                         const index_t group) {
+  const index_t col_height = group * filter_shape[1] * filter_shape[2]
+      * filter_shape[3];
+  index_t size = col_height * tile_size;
+  if (tile_size < out_image_size) {
+    // output of a tile is gathered before copied to output planes
+    size += filter_shape[0] * tile_size;
+  }
+  return size;
+}
+
+void Im2ColConv(const float *input,
+                const float *filter,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *strides,
+                const int *dilations,
+                const int *pad_hw,
+                const index_t tile_size,
+                float *buffer,
+                float *output,
+                const ConvEpilogue *epilogue) {
+  const index_t batch = in_shape[0];
+  const index_t in_batch_size = in_shape[1] * in_shape[2] * in_shape[3];
+  const index_t out_channels = out_shape[1];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t group = in_shape[1] / filter_shape[1];
+  const index_t group_channels = out_channels / group;
+  // columns of each group, the groups follow each other in the buffer like
+  // their filters and outputs, which makes them the batches of one gemm
+  const index_t col_height = filter_shape[1] * filter_shape[2]
+      * filter_shape[3];
+  float *col = buffer;
+  float *out_tile = buffer + group * col_height * tile_size;
+
+  for (index_t b = 0; b < batch; ++b) {
+    float *out_base = output + b * out_channels * out_image_size;
+    for (index_t tile_begin = 0; tile_begin < out_image_size;
+         tile_begin += tile_size) {
+      const index_t tile_end =
+          std::min(tile_begin + tile_size, out_image_size);
+      const index_t tile_len = tile_end - tile_begin;
+      Im2Col(input + b * in_batch_size, in_shape, out_shape, filter_shape,
+             strides, dilations, pad_hw, tile_begin, tile_end, col);
+      if (tile_len == out_image_size) {
+        Gemm(filter, col, group, group_channels, col_height, tile_len,
+             out_base);
+        if (epilogue != nullptr) {
+#pragma omp parallel for
+          for (index_t m = 0; m < out_channels; ++m) {
+            float *out = out_base + m * out_image_size;
+            ApplyConvEpilogue(*epilogue, m, out - output, out, tile_len, out);
+          }
+        }
+      } else {
+        Gemm(filter, col, group, group_channels, col_height, tile_len,
+             out_tile);
+        // the epilogue is applied as the tile is copied to output planes
+        const ConvEpilogue copy;
+#pragma omp parallel for
+        for (index_t m = 0; m < out_channels; ++m) {
+          float *out = out_base + m * out_image_size + tile_begin;
+          ApplyConvEpilogue(epilogue == nullptr ? copy : *epilogue, m,
+                            out - output, out_tile + m * tile_len, tile_len,
+                            out);
+        }
+      }
+    }
+  }
+}
+
+void ConvRef(const float *input,
+             const float *filter,
+             const index_t *in_shape,
+             const index_t *out_shape,
+             const index_t *filter_shape,
+             const int *strides,
+             const int *dilations,
+             const int *pad_hw,
+             float *output) {
+  const index_t batch = in_shape[0];
+  const index_t in_channels = in_shape[1];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_channels = out_shape[1];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t filter_channels = filter_shape[1];
+  const index_t filter_height = filter_shape[2];
+  const index_t filter_width = filter_shape[3];
+  const index_t group_channels =
+      out_channels / (in_channels / filter_channels);
+
+#pragma omp parallel for collapse(4)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t m = 0; m < out_channels; ++m) {
+      for (index_t h = 0; h < out_height; ++h) {
+        for (index_t w = 0; w < out_width; ++w) {
+          index_t out_offset =
+              ((b * out_channels + m) * out_height + h) * out_width + w;
+          float sum = 0;
+          const index_t in_channel_begin = m / group_channels * filter_channels;
+          for (index_t c = 0; c < filter_channels; ++c) {
+            for (index_t kh = 0; kh < filter_height; ++kh) {
+              for (index_t kw = 0; kw < filter_width; ++kw) {
+                index_t ih = h * strides[0] + kh * dilations[0] - pad_hw[0];
+                index_t iw = w * strides[1] + kw * dilations[1] - pad_hw[1];
+                if (ih < 0 || ih >= in_height || iw < 0 || iw >= in_width) {
+                  continue;
+                }
+                index_t in_offset =
+                    ((b * in_channels + in_channel_begin + c) * in_height
+                        + ih) * in_width + iw;
+                index_t filter_offset =
+                    ((m * filter_channels + c) * filter_height + kh)
+                        * filter_width + kw;
+                sum += input[in_offset] * filter[filter_offset];
+              }
+            }
+          }
+          output[out_offset] = sum;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
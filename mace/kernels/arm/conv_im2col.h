@@ -0,0 +1,69 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_ARM_CONV_IM2COL_H_
+#define MACE_KERNELS_ARM_CONV_IM2COL_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/conv_epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+// Number of output pixels lowered to columns at a time, it keeps the column
+// buffer of in_channels * filter_height * filter_width rows cache friendly.
+index_t Im2ColTileSize(const index_t *filter_shape,
+                       const index_t out_image_size,
+                       const index_t group = 1);
+
+// Number of floats Im2ColConv needs in its buffer.
+index_t Im2ColBufferSize(const index_t *filter_shape,
+                         const index_t out_image_size,
+                         const index_t tile_size,
+                         const index_t group = 1);
+
+// input is NCHW without padding, pad_hw is the top and left padding and the
+// taps past the input are zero; filter is OIHW. Each output tile gets
+// epilogue right after its gemm, unless it is nullptr.
+// A filter of fewer input channels than the input is grouped: the output
+// channels fall into in_channels / filter_shape[1] groups which convolve
+// their own slice of the input channels, as one batched gemm.
+void Im2ColConv(const float *input,
+                const float *filter,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *strides,
+                const int *dilations,
+                const int *pad_hw,
+                const index_t tile_size,
+                float *buffer,
+                float *output,
+                const ConvEpilogue *epilogue = nullptr);
+
+// Direct loops over the windows, grouped as Im2ColConv.
+void ConvRef(const float *input,
+             const float *filter,
+             const index_t *in_shape,
+             const index_t *out_shape,
+             const index_t *filter_shape,
+             const int *strides,
+             const int *dilations,
+             const int *pad_hw,
+             float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_ARM_CONV_IM2COL_H_
@@ -0,0 +1,119 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/core/types.h"
+#include "mace/kernels/arm/conv_im2col.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+void TestIm2ColConv(const index_t batch,
+                    const index_t in_channels,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t out_channels,
+                    const index_t kernel_h,
+                    const index_t kernel_w,
+                    const int stride,
+                    const int dilation,
+                    const index_t tile_size,
+                    const int pad = 0,
+                    const index_t group = 1) {
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+  const int pad_hw[2] = {pad, pad};
+  const index_t out_height =
+      (in_height + 2 * pad - (kernel_h - 1) * dilation - 1) / stride + 1;
+  const index_t out_width =
+      (in_width + 2 * pad - (kernel_w - 1) * dilation - 1) / stride + 1;
+  const index_t in_shape[4] = {batch, in_channels, in_height, in_width};
+  const index_t out_shape[4] = {batch, out_channels, out_height, out_width};
+  const index_t filter_shape[4] = {out_channels, in_channels / group,
+                                   kernel_h, kernel_w};
+
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * filter_shape[1] * kernel_h
+                                * kernel_w);
+  std::vector<float> output(batch * out_channels * out_height * out_width);
+  std::vector<float> output_ref(output.size());
+  std::vector<float> buffer(Im2ColBufferSize(
+      filter_shape, out_height * out_width, tile_size, group));
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(input.begin(), input.end(), [&gen, &nd] {
+    return std::max(-1.0f, std::min(1.0f, nd(gen)));
+  });
+  std::generate(filter.begin(), filter.end(), [&gen, &nd] {
+    return std::max(-1.0f, std::min(1.0f, nd(gen)));
+  });
+
+  ConvRef(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+          strides, dilations, pad_hw, output_ref.data());
+  Im2ColConv(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+             strides, dilations, pad_hw, tile_size, buffer.data(),
+             output.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3) << " with index " << i;
+  }
+}
+}  // namespace
+
+TEST(ConvIm2ColTest, SingleTile) {
+  const index_t filter_shape[4] = {16, 8, 3, 3};
+  TestIm2ColConv(2, 8, 17, 19, 16, 3, 3, 2, 1,
+                 Im2ColTileSize(filter_shape, 8 * 9));
+  TestIm2ColConv(1, 5, 20, 20, 13, 5, 3, 1, 2, 14 * 16);
+}
+
+TEST(ConvIm2ColTest, MultiTile) {
+  TestIm2ColConv(1, 8, 31, 33, 16, 3, 3, 1, 1, 64);
+  TestIm2ColConv(2, 3, 40, 37, 9, 7, 7, 2, 1, 64);
+  TestIm2ColConv(1, 4, 33, 35, 8, 3, 5, 3, 2, 100);
+}
+
+TEST(ConvIm2ColTest, Padding) {
+  // the input is not padded, taps in the padding are zero
+  TestIm2ColConv(1, 8, 31, 33, 16, 3, 3, 1, 1, 64, 1);
+  TestIm2ColConv(2, 3, 40, 37, 9, 7, 7, 2, 1, 64, 3);
+  TestIm2ColConv(1, 4, 33, 35, 8, 3, 5, 3, 2, 100, 2);
+  TestIm2ColConv(1, 5, 6, 7, 13, 5, 5, 1, 1, 30, 4);
+}
+
+TEST(ConvIm2ColTest, Grouped) {
+  TestIm2ColConv(2, 16, 17, 19, 32, 3, 3, 1, 1, 17 * 19, 1, 4);
+  TestIm2ColConv(1, 12, 31, 33, 6, 3, 3, 2, 1, 64, 1, 3);
+  TestIm2ColConv(2, 8, 20, 21, 8, 1, 1, 1, 1, 100, 0, 8);
+  TestIm2ColConv(1, 6, 25, 24, 9, 5, 5, 1, 2, 64, 2, 3);
+}
+
+TEST(ConvIm2ColTest, TileSize) {
+  const index_t filter_shape[4] = {64, 64, 3, 3};
+  EXPECT_EQ(10, Im2ColTileSize(filter_shape, 10));
+  const index_t tile_size = Im2ColTileSize(filter_shape, 224 * 224);
+  EXPECT_EQ(0, tile_size % 64);
+  EXPECT_EQ(64 * 9 * tile_size + 64 * tile_size,
+            Im2ColBufferSize(filter_shape, 224 * 224, tile_size));
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -21,6 +21,7 @@
 
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
+#include "mace/kernels/nchwc.h"
 #include "mace/public/mace.h"
 
 #ifdef MACE_ENABLE_OPENCL
@@ -60,7 +61,10 @@ struct BiasAddFunctor<DeviceType::CPU, float> : BiasAddFunctorBase {
     const float *bias_ptr = bias->data<float>();
     float *output_ptr = output->mutable_data<float>();
 
-    if (input->dim_size() == 4 && data_format_ == NCHW) {
+    if (input->dim_size() == 5 && data_format_ == NCHWc) {
+      const std::vector<index_t> shape = NCHWShape(input->shape());
+      BiasAddNCHWc(input_ptr, bias_ptr, shape.data(), output_ptr);
+    } else if (input->dim_size() == 4 && data_format_ == NCHW) {
       const index_t batch = input->dim(0);
       const index_t channels = input->dim(1);
       const index_t height_width = input->dim(2) * input->dim(3);
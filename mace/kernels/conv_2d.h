@@ -21,14 +21,24 @@
 #include <algorithm>
 #include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "mace/core/future.h"
+#include "mace/core/runtime/cpu/cpu_tuner.h"
 #include "mace/core/tensor.h"
 #include "mace/kernels/activation.h"
+#include "mace/kernels/conv_epilogue.h"
 #include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/conv_pool_specialized.h"
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/nchwc.h"
+#include "mace/kernels/nhwc.h"
+#include "mace/kernels/winograd.h"
 #include "mace/kernels/arm/conv_2d_neon.h"
+#include "mace/kernels/arm/conv_im2col.h"
 #include "mace/kernels/arm/conv_winograd.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
 #include "mace/utils/utils.h"
 
 #ifdef MACE_ENABLE_OPENCL
@@ -38,17 +48,28 @@
 namespace mace {
 namespace kernels {
 
+// Kernels of a NCHW cpu convolution, picked by shape or by the CPUTuner.
+enum ConvAlgorithm {
+  CONV_AUTO = 0,
+  CONV_WINOGRAD = 1,
+  CONV_DIRECT = 2,
+  CONV_IM2COL = 3,
+  CONV_GENERAL = 4,
+};
+
 struct Conv2dFunctorBase {
   Conv2dFunctorBase(const int *strides,
                     const Padding &padding_type,
                     const std::vector<int> &paddings,
                     const int *dilations,
+                    const int group,
                     const ActivationType activation,
                     const float relux_max_limit)
     : strides_(strides),
       padding_type_(padding_type),
       paddings_(paddings),
       dilations_(dilations),
+      group_(group),
       activation_(activation),
       relux_max_limit_(relux_max_limit) {}
 
@@ -56,8 +77,13 @@ struct Conv2dFunctorBase {
   const Padding padding_type_;
   std::vector<int> paddings_;
   const int *dilations_;  // [dilation_h, dilation_w]
+  // the output channels of each group only see their slice of the input
+  // channels, the filter is [out_channels, in_channels / group, h, w]
+  const int group_;
   const ActivationType activation_;
   const float relux_max_limit_;
+  // kernels and blocking of the last run, reported in the op stats
+  std::string algorithm_;
 };
 
 template<DeviceType D, typename T>
@@ -69,18 +95,26 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                 const Padding &padding_type,
                 const std::vector<int> &paddings,
                 const int *dilations,
+                const int group,
                 const ActivationType activation,
                 const float relux_max_limit,
                 const bool is_filter_transformed,
-                ScratchBuffer *scratch)
+                ScratchBuffer *scratch,
+                Tensor *transformed_filter,
+                const DataFormat data_format)
     : Conv2dFunctorBase(strides,
                         padding_type,
                         paddings,
                         dilations,
+                        group,
                         activation,
                         relux_max_limit),
+      transformed_filter_(transformed_filter),
+      is_transformed_filter_ready_(false),
       is_filter_transformed_(is_filter_transformed),
-      scratch_(scratch) {}
+      scratch_(scratch),
+      data_format_(data_format),
+      winograd_out_tile_size_{0, 0} {}
 
   void Conv2dGeneral(const float *input,
                      const float *filter,
@@ -90,175 +124,277 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                      const int *stride_hw,
                      const int *dilation_hw,
                      float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = filter_shape[1] * in_image_size;
-    const index_t out_batch_size = filter_shape[0] * out_image_size;
-    const index_t filter_size = filter_shape[2] * filter_shape[3];
-
-#pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < in_shape[0]; b++) {
-      for (index_t m = 0; m < filter_shape[0]; m += 4) {
-        const index_t in_width = in_shape[3];
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        const index_t out_channels = filter_shape[0];
-        const index_t in_channels = filter_shape[1];
-
-        const int stride_h = stride_hw[0];
-        const int stride_w = stride_hw[1];
-        const int dilation_h = dilation_hw[0];
-        const int dilation_w = dilation_hw[1];
-        if (m + 3 < out_channels) {
-          float *out_ptr0_base =
-              output + b * out_batch_size + m * out_image_size;
-          float *out_ptr1_base = out_ptr0_base + out_image_size;
-          float *out_ptr2_base = out_ptr1_base + out_image_size;
-          float *out_ptr3_base = out_ptr2_base + out_image_size;
-          for (index_t c = 0; c < in_channels; ++c) {
-            const float *in_ptr_base =
-                input + b * in_batch_size + c * in_image_size;
-            const float *filter_ptr0 =
-                filter + m * in_channels * filter_size + c * filter_size;
-            const float *filter_ptr1 = filter_ptr0 + in_channels * filter_size;
-            const float *filter_ptr2 = filter_ptr1 + in_channels * filter_size;
-            const float *filter_ptr3 = filter_ptr2 + in_channels * filter_size;
-            for (index_t h = 0; h < out_height; ++h) {
-              for (index_t w = 0; w + 3 < out_width; w += 4) {
-                 // input offset
-                index_t ih = h * stride_h;
-                index_t iw = w * stride_w;
-                index_t in_offset = ih * in_width + iw;
-                // output (4 outch x 1 height x 4 width): vo_outch_height
-                float vo0[4], vo1[4], vo2[4], vo3[4];
-                // load output
-                index_t out_offset = h * out_width + w;
-                for (index_t ow = 0; ow < 4; ++ow) {
-                   vo0[ow] = out_ptr0_base[out_offset + ow];
-                   vo1[ow] = out_ptr1_base[out_offset + ow];
-                   vo2[ow] = out_ptr2_base[out_offset + ow];
-                   vo3[ow] = out_ptr3_base[out_offset + ow];
-                }
-                // calc by row
-                for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
-                  for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
-                    // outch 0
-                    vo0[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    // outch 1
-                    vo1[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    // outch 2
-                    vo2[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    // outch 3
-                    vo3[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                  }  // kw
-
-                  in_offset += dilation_h * in_width;
-                  filter_ptr0 += filter_shape[3];
-                  filter_ptr1 += filter_shape[3];
-                  filter_ptr2 += filter_shape[3];
-                  filter_ptr3 += filter_shape[3];
-                }  // kh
-
-                for (index_t ow = 0; ow < 4; ++ow) {
-                  out_ptr0_base[out_offset + ow] = vo0[ow];
-                  out_ptr1_base[out_offset + ow] = vo1[ow];
-                  out_ptr2_base[out_offset + ow] = vo2[ow];
-                  out_ptr3_base[out_offset + ow] = vo3[ow];
-                }
-
-                filter_ptr0 -= filter_size;
-                filter_ptr1 -= filter_size;
-                filter_ptr2 -= filter_size;
-                filter_ptr3 -= filter_size;
-              }  // w
-            }  // h
-          }  // c
-        } else {
-          for (index_t mm = m; mm < out_channels; ++mm) {
-            float *out_ptr0_base =
-                output + b * out_batch_size + mm * out_image_size;
-            for (index_t c = 0; c < in_channels; ++c) {
-              const float *in_ptr_base =
-                  input + b * in_batch_size + c * in_image_size;
-              const float *filter_ptr0 =
-                  filter + mm * in_channels * filter_size + c * filter_size;
-
-              for (index_t h = 0; h < out_height; ++h) {
-                for (index_t w = 0; w + 3 < out_width; w += 4) {
-                  // input offset
-                  index_t ih = h * stride_h;
-                  index_t iw = w * stride_w;
-                  index_t in_offset = ih * in_width + iw;
-                  // output (1 outch x 1 height x 4 width): vo_outch_height
-                  float vo0[4];
-                  // load output
-                  index_t out_offset = h * out_width + w;
-                  for (index_t ow = 0; ow < 4; ++ow) {
-                     vo0[ow] = out_ptr0_base[out_offset + ow];
-                  }
-
-                  // calc by row
-                  for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
-                    for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
-                      // outch 0
-                      vo0[0] += in_ptr_base[in_offset
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[1] += in_ptr_base[in_offset + stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[2] += in_ptr_base[in_offset + 2 * stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[3] += in_ptr_base[in_offset + 3 * stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                    }  // kw
-
-                    in_offset += dilation_h * in_width;
-                    filter_ptr0 += filter_shape[3];
-                  }  // kh
-
-                  for (index_t ow = 0; ow < 4; ++ow) {
-                    out_ptr0_base[out_offset + ow] = vo0[ow];
-                  }
-                  filter_ptr0 -= filter_size;
-                }  // w
-              }  // h
-            }  // c
-          }  // mm
-        }  // if
-      }  // m
-    }  // b
+    Conv2dGeneralKernel(filter_shape[2], filter_shape[3], stride_hw,
+                        dilation_hw)(input, filter, in_shape, out_shape,
+                                     filter_shape, stride_hw, dilation_hw,
+                                     output);
+  }
+
+  // input and output are blocked NCHWc tensors, the filter is OIHW and is
+  // reordered once into transformed_filter_.
+  MaceStatus Conv2dNCHWcLayout(const Tensor *input,
+                               const Tensor *filter,
+                               const Tensor *bias,
+                               Tensor *output) {
+    MACE_CHECK(!is_filter_transformed_,
+               "NCHWc convolution needs an OIHW filter");
+    const std::vector<index_t> in_shape = NCHWShape(input->shape());
+    const std::vector<index_t> &filter_shape = filter->shape();
+    MACE_CHECK(filter_shape[1] == in_shape[1], filter_shape[1], " != ",
+               in_shape[1]);
+
+    std::vector<index_t> output_shape(4);
+    std::vector<int> paddings(2);
+    if (paddings_.empty()) {
+      CalcNCHWPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape.data(),
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   output_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcNCHWOutputSize(in_shape.data(),
+                         filter_shape.data(),
+                         paddings_.data(),
+                         dilations_,
+                         strides_,
+                         RoundType::FLOOR,
+                         output_shape.data());
+    }
+    MACE_RETURN_IF_ERROR(output->Resize(NCHWcShape(output_shape)));
+
+    Tensor::MappingGuard filter_guard(filter);
+    // the reordered filter may have been released by Workspace::Trim
+    if (!is_transformed_filter_ready_
+        || transformed_filter_->UnderlyingBuffer()->size() == 0) {
+      MACE_RETURN_IF_ERROR(transformed_filter_->Resize(filter_shape));
+      ReorderConv2dFilterToNCHWc(filter->data<float>(), filter_shape.data(),
+                                 transformed_filter_->mutable_data<float>());
+      is_transformed_filter_ready_ = true;
+    }
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard output_guard(output);
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+    float *output_data = output->mutable_data<float>();
+    Conv2dNCHWc(input->data<float>(),
+                transformed_filter_->data<float>(),
+                bias == nullptr ? nullptr : bias->data<float>(),
+                in_shape.data(),
+                output_shape.data(),
+                filter_shape.data(),
+                strides_,
+                dilations_,
+                pad_hw,
+                output_data);
+    DoActivation(output_data, output_data, output->size(), activation_,
+                 relux_max_limit_);
+    return MACE_SUCCESS;
+  }
+
+  // input and output are NHWC, the filter is OIHW and is reordered once
+  // into transformed_filter_ as the right hand side of a gemm.
+  MaceStatus Conv2dNHWCLayout(const Tensor *input,
+                              const Tensor *filter,
+                              const Tensor *bias,
+                              Tensor *output) {
+    MACE_CHECK(!is_filter_transformed_,
+               "NHWC convolution needs an OIHW filter");
+    const std::vector<index_t> &in_shape = input->shape();
+    const std::vector<index_t> &filter_shape = filter->shape();
+    MACE_CHECK(filter_shape[1] == in_shape[3], filter_shape[1], " != ",
+               in_shape[3]);
+
+    std::vector<index_t> output_shape(4);
+    std::vector<int> paddings(2);
+    if (paddings_.empty()) {
+      CalcNHWCPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape.data(),
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   output_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcOutputSize(in_shape.data(),
+                     filter_shape.data(),
+                     paddings_.data(),
+                     dilations_,
+                     strides_,
+                     RoundType::FLOOR,
+                     output_shape.data());
+    }
+    MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+
+    Tensor::MappingGuard filter_guard(filter);
+    // the reordered filter may have been released by Workspace::Trim
+    if (!is_transformed_filter_ready_
+        || transformed_filter_->UnderlyingBuffer()->size() == 0) {
+      MACE_RETURN_IF_ERROR(transformed_filter_->Resize(filter_shape));
+      ReorderConv2dFilterToNHWC(filter->data<float>(), filter_shape.data(),
+                                transformed_filter_->mutable_data<float>());
+      is_transformed_filter_ready_ = true;
+    }
+
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+    const index_t buffer_size =
+        Conv2dNHWCBufferSize(in_shape.data(), output_shape.data(),
+                             filter_shape.data(), strides_, pad_hw)
+            * sizeof(float);
+    scratch_->Rewind();
+    MACE_RETURN_IF_ERROR(scratch_->GrowSize(buffer_size));
+    Tensor buffer(scratch_->Scratch(buffer_size), DT_FLOAT);
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard output_guard(output);
+    float *output_data = output->mutable_data<float>();
+    Conv2dNHWC(input->data<float>(),
+               transformed_filter_->data<float>(),
+               bias == nullptr ? nullptr : bias->data<float>(),
+               in_shape.data(),
+               output_shape.data(),
+               filter_shape.data(),
+               strides_,
+               dilations_,
+               pad_hw,
+               buffer_size == 0 ? nullptr : buffer.mutable_data<float>(),
+               output_data);
+    DoActivation(output_data, output_data, output->size(), activation_,
+                 relux_max_limit_);
+    return MACE_SUCCESS;
+  }
+
+  // NCHW grouped convolution on the whole tensors, without slicing them by
+  // group: the avx2 kernels run on each group of each image, the others
+  // lower the input to columns and run the groups as one batched gemm.
+  MaceStatus Conv2dGrouped(const Tensor *input,
+                           const Tensor *filter,
+                           const Tensor *bias,
+                           const Tensor *residual,
+                           Tensor *output) {
+    MACE_CHECK(!is_filter_transformed_,
+               "grouped convolution needs an OIHW filter");
+    const std::vector<index_t> &in_shape = input->shape();
+    const std::vector<index_t> &filter_shape = filter->shape();
+    MACE_CHECK(filter_shape[1] * group_ == in_shape[1], filter_shape[1],
+               " * ", group_, " != ", in_shape[1]);
+    MACE_CHECK(filter_shape[0] % group_ == 0, "output channels ",
+               filter_shape[0], " are not a multiple of group ", group_);
+
+    std::vector<index_t> output_shape(4);
+    std::vector<int> paddings(2);
+    if (paddings_.empty()) {
+      CalcNCHWPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape.data(),
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   output_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcNCHWOutputSize(in_shape.data(),
+                         filter_shape.data(),
+                         paddings_.data(),
+                         dilations_,
+                         strides_,
+                         RoundType::FLOOR,
+                         output_shape.data());
+    }
+    MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+    MACE_CHECK(residual == nullptr || residual->shape() == output_shape,
+               "residual and output shapes differ");
+    MACE_CHECK(activation_ != PRELU, "convolution does not fuse prelu");
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard filter_guard(filter);
+    Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard residual_guard(residual);
+    Tensor::MappingGuard output_guard(output);
+    const float *input_data = input->data<float>();
+    const float *filter_data = filter->data<float>();
+    float *output_data = output->mutable_data<float>();
+    ConvEpilogue epilogue;
+    epilogue.bias = bias == nullptr ? nullptr : bias->data<float>();
+    epilogue.residual = residual == nullptr ? nullptr : residual->data<float>();
+    epilogue.activation = activation_;
+    epilogue.relux_max_limit = relux_max_limit_;
+    const ConvEpilogue *kernel_epilogue =
+        IsNoopEpilogue(epilogue) ? nullptr : &epilogue;
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+
+    Conv2dAvx2Func avx2_func = Conv2dAvx2Kernel(
+        filter_shape[2], filter_shape[3], strides_[0], strides_[1]);
+    if (avx2_func != nullptr) {
+      // a group of an image is contiguous in NCHW
+      const index_t group_in_shape[4] = {1, filter_shape[1], in_shape[2],
+                                         in_shape[3]};
+      const index_t group_out_shape[4] = {1, filter_shape[0] / group_,
+                                          output_shape[2], output_shape[3]};
+      const index_t group_in_size =
+          group_in_shape[1] * group_in_shape[2] * group_in_shape[3];
+      const index_t group_out_size =
+          group_out_shape[1] * group_out_shape[2] * group_out_shape[3];
+      const index_t group_filter_size = group_out_shape[1] * filter_shape[1]
+          * filter_shape[2] * filter_shape[3];
+      for (index_t b = 0; b < in_shape[0]; ++b) {
+        for (int g = 0; g < group_; ++g) {
+          const index_t out_offset = (b * group_ + g) * group_out_size;
+          // the epilogue of the group sees its channels from 0
+          ConvEpilogue group_epilogue = epilogue;
+          if (epilogue.bias != nullptr) {
+            group_epilogue.bias += g * group_out_shape[1];
+          }
+          if (epilogue.residual != nullptr) {
+            group_epilogue.residual += out_offset;
+          }
+          avx2_func(input_data + (b * group_ + g) * group_in_size,
+                    filter_data + g * group_filter_size,
+                    group_in_shape,
+                    group_out_shape,
+                    pad_hw,
+                    dilations_,
+                    kernel_epilogue == nullptr ? nullptr : &group_epilogue,
+                    output_data + out_offset);
+        }
+      }
+      return MACE_SUCCESS;
+    }
+
+    const index_t out_image_size = output_shape[2] * output_shape[3];
+    const index_t tile_size =
+        Im2ColTileSize(filter_shape.data(), out_image_size, group_);
+    const index_t buffer_size = Im2ColBufferSize(
+        filter_shape.data(), out_image_size, tile_size, group_)
+        * sizeof(float);
+    scratch_->Rewind();
+    MACE_RETURN_IF_ERROR(scratch_->GrowSize(buffer_size));
+    Tensor buffer(scratch_->Scratch(buffer_size), DT_FLOAT);
+    Im2ColConv(input_data,
+               filter_data,
+               in_shape.data(),
+               output_shape.data(),
+               filter_shape.data(),
+               strides_,
+               dilations_,
+               pad_hw,
+               tile_size,
+               buffer.mutable_data<float>(),
+               output_data,
+               kernel_epilogue);
+    return MACE_SUCCESS;
   }
 
+  // residual, if not nullptr, is added to the output before the activation.
   MaceStatus operator()(const Tensor *input,
                   const Tensor *filter,
                   const Tensor *bias,
+                  const Tensor *residual,
                   Tensor *output,
                   StatsFuture *future) {
     MACE_UNUSED(future);
@@ -266,6 +402,34 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
     MACE_CHECK_NOTNULL(filter);
     MACE_CHECK_NOTNULL(output);
 
+    if (input->dim_size() == 5 || data_format_ == NHWC) {
+      MACE_CHECK(residual == nullptr,
+                 "only NCHW convolution adds a residual");
+      MACE_CHECK(group_ == 1, "only NCHW convolution is grouped");
+    }
+    if (input->dim_size() == 5) {
+      algorithm_ = "nchwc";
+      return Conv2dNCHWcLayout(input, filter, bias, output);
+    } else if (data_format_ == NHWC) {
+      algorithm_ = "nhwc";
+      return Conv2dNHWCLayout(input, filter, bias, output);
+    } else if (group_ > 1) {
+      algorithm_ = "grouped";
+      return Conv2dGrouped(input, filter, bias, residual, output);
+    }
+    return Conv2dNCHW(input, filter, bias, residual, output, nullptr);
+  }
+
+  // params are the ConvAlgorithm and the gemm block and im2col tile sizes,
+  // 0 for the sizes picked by shape. Without params the CPUTuner runs this
+  // again with the params tuned for the shape, or with each candidate when
+  // tuning.
+  MaceStatus Conv2dNCHW(const Tensor *input,
+                        const Tensor *filter,
+                        const Tensor *bias,
+                        const Tensor *residual,
+                        Tensor *output,
+                        const std::vector<int> *params) {
     std::vector<index_t> filter_shape(4);
     if (is_filter_transformed_) {
       // TOC -> OIHW
@@ -297,6 +461,9 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                          output_shape.data());
     }
     MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+    MACE_CHECK(residual == nullptr || residual->shape() == output_shape,
+               "residual and output shapes differ");
+    MACE_CHECK(activation_ != PRELU, "convolution does not fuse prelu");
 
     index_t batch = output->dim(0);
     index_t channels = output->dim(1);
@@ -337,24 +504,43 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
     Tensor::MappingGuard input_guard(input);
     Tensor::MappingGuard filter_guard(filter);
     Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard residual_guard(residual);
     Tensor::MappingGuard output_guard(output);
 
     auto filter_data = filter->data<float>();
-    auto bias_data = bias == nullptr ? nullptr : bias->data<float>();
     auto output_data = output->mutable_data<float>();
+    ConvEpilogue epilogue;
+    epilogue.bias = bias == nullptr ? nullptr : bias->data<float>();
+    epilogue.residual = residual == nullptr ? nullptr : residual->data<float>();
+    epilogue.activation = activation_;
+    epilogue.relux_max_limit = relux_max_limit_;
 
     std::function<void(const float *input, float *output)> conv_func;
 
-    bool
-      use_winograd = is_filter_transformed_ || (filter_h == 3 && filter_w == 3
+    // winograd picks its tile size from the shape and is only used when it
+    // saves enough work over the direct kernels; filters transformed offline
+    // keep the fixed 3x3 tiles they were transformed for
+    int winograd_tile_size[2] = {0, 0};
+    bool use_winograd_general = !is_filter_transformed_
       && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1
-      && input_channels >= 8 && channels >= 8);
+      && WinogradOutTileSize(filter_shape.data(), height, width,
+                             winograd_tile_size);
+    bool use_winograd = is_filter_transformed_;
+    // the neon kernels are scalar on x86, run their avx2 ports instead when
+    // the cpu supports them; these also take dilated filters, which would
+    // otherwise fall to the general convolution
+    Conv2dAvx2Func avx2_func = nullptr;
+    if (!use_winograd) {
+      avx2_func = Conv2dAvx2Kernel(filter_h, filter_w, stride_h, stride_w);
+    }
+    bool use_avx2 = avx2_func != nullptr;
     bool use_neon_3x3_s1 = filter_h == 3 && filter_w == 3
       && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_3x3_s2 = filter_h == 3 && filter_w == 3
       && stride_h == 2 && stride_w == 2 && dilation_h == 1 && dilation_w == 1;
-    bool use_neon_1x1_s1 = filter_h == 1 && filter_w == 1
-      && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
+    // 1x1 of any stride is one gemm over the batch, strided pixels are
+    // gathered while packing the gemm blocks
+    bool use_neon_1x1 = filter_h == 1 && filter_w == 1;
     bool use_neon_5x5_s1 = filter_h == 5 && filter_w == 5
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_1x7_s1 = filter_h == 1 && filter_w == 7
@@ -371,6 +557,88 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_15x1_s1 = filter_h == 15 && filter_w == 1
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
+    // lower the rest to gemm when there are enough output channels to fill
+    // gemm blocks, otherwise the direct general convolution is faster
+    bool use_im2col = !(use_winograd || use_winograd_general
+        || use_neon_3x3_s1 || use_neon_3x3_s2
+        || use_neon_1x1 || use_neon_5x5_s1 || use_neon_1x7_s1
+        || use_neon_7x1_s1 || use_neon_7x7_s1 || use_neon_7x7_s2
+        || use_neon_7x7_s3 || use_neon_1x15_s1 || use_neon_15x1_s1)
+        && channels >= 8;
+#if !defined(MACE_ENABLE_NEON)
+    // gemm is scalar without neon and only beats the direct loop on 1x1
+    use_im2col = use_im2col && filter_h == 1 && filter_w == 1;
+#endif
+    const bool use_direct = use_avx2 || use_neon_3x3_s1 || use_neon_3x3_s2
+        || use_neon_1x1 || use_neon_5x5_s1 || use_neon_1x7_s1
+        || use_neon_7x1_s1 || use_neon_7x7_s1 || use_neon_7x7_s2
+        || use_neon_7x7_s3 || use_neon_1x15_s1 || use_neon_15x1_s1;
+
+    // The choice above is the default, the tuner times it against the other
+    // kernels that run the shape. Filters transformed offline only run
+    // winograd.
+    if (params == nullptr && !use_winograd) {
+      const int algorithm = use_winograd_general ? CONV_WINOGRAD
+          : use_direct ? CONV_DIRECT
+          : use_im2col ? CONV_IM2COL : CONV_GENERAL;
+      const int im2col_tile =
+          static_cast<int>(Im2ColTileSize(filter_shape.data(),
+                                          height * width));
+      std::vector<std::vector<int>> candidates;
+      if (use_winograd_general) {
+        candidates.push_back({CONV_WINOGRAD, 0, 0});
+      }
+      for (int block_size : {0, 32, 128}) {
+        if (use_neon_1x1 || (use_direct && block_size == 0)) {
+          candidates.push_back({CONV_DIRECT, block_size, 0});
+        }
+        candidates.push_back({CONV_IM2COL, block_size, 0});
+        if (im2col_tile > 1) {
+          candidates.push_back({CONV_IM2COL, block_size, im2col_tile / 2});
+        }
+      }
+      candidates.push_back({CONV_GENERAL, 0, 0});
+      const std::string key = MakeString(
+          "conv2d_", MakeString(input->shape()), "_",
+          MakeString(filter_shape), "_", strides_[0], "x", strides_[1], "_",
+          dilations_[0], "x", dilations_[1], "_", MakeString(paddings));
+      const std::vector<int> default_params = {algorithm, 0, 0};
+      return CPUTuner::Get()->TuneOrRun(
+          key, default_params, candidates,
+          [&](const std::vector<int> &tuned_params) -> MaceStatus {
+            // parameters stored by another version may not fit
+            return Conv2dNCHW(input, filter, bias, residual, output,
+                              tuned_params.size() == default_params.size()
+                                  ? &tuned_params : &default_params);
+          });
+    }
+    if (params != nullptr) {
+      const int algorithm = (*params)[0];
+      const bool direct = algorithm == CONV_DIRECT;
+      use_winograd_general =
+          use_winograd_general && algorithm == CONV_WINOGRAD;
+      use_avx2 = use_avx2 && direct;
+      use_neon_3x3_s1 = use_neon_3x3_s1 && direct;
+      use_neon_3x3_s2 = use_neon_3x3_s2 && direct;
+      use_neon_1x1 = use_neon_1x1 && direct;
+      use_neon_5x5_s1 = use_neon_5x5_s1 && direct;
+      use_neon_1x7_s1 = use_neon_1x7_s1 && direct;
+      use_neon_7x1_s1 = use_neon_7x1_s1 && direct;
+      use_neon_7x7_s1 = use_neon_7x7_s1 && direct;
+      use_neon_7x7_s2 = use_neon_7x7_s2 && direct;
+      use_neon_7x7_s3 = use_neon_7x7_s3 && direct;
+      use_neon_1x15_s1 = use_neon_1x15_s1 && direct;
+      use_neon_15x1_s1 = use_neon_15x1_s1 && direct;
+      use_im2col = algorithm == CONV_IM2COL;
+    }
+    const index_t gemm_block_size = params == nullptr ? 0 : (*params)[1];
+
+    // These kernels take the unpadded input and treat the windows past it as
+    // zero, and write outputs that are not a whole number of tiles; the rest
+    // run on a padded copy of the input and into a padded output.
+    const bool pad_free = use_avx2 || use_winograd_general || use_im2col
+        || (use_neon_1x1 && paddings[0] == 0 && paddings[1] == 0);
+    const int pad_hw[2] = {pad_top, pad_left};
 
     std::vector<index_t> transformed_input_shape;
     std::vector<index_t> transformed_output_shape;
@@ -410,9 +678,12 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                                        tile_count});
       transformed_filter_shape.insert(transformed_filter_shape.end(),
                                       {in_tile_area, channels, input_channels});
+    } else if (pad_free) {
+      extra_input_height = input_height;
+      extra_input_width = input_width;
     } else {
       index_t tile_h, tile_w;
-      if (use_neon_1x1_s1) {
+      if (use_neon_1x1) {
         tile_h = 1;
         tile_w = 1;
       } else if (use_neon_3x3_s1) {
@@ -447,6 +718,9 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
     index_t transformed_output_size = 0;
     index_t padded_input_size = 0;
     index_t padded_output_size = 0;
+    index_t im2col_tile_size = 0;
+    index_t im2col_size = 0;
+    index_t winograd_buffer_size = 0;
     if (use_winograd) {
       transformed_input_size =
         std::accumulate(transformed_input_shape.begin(),
@@ -474,6 +748,20 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
           * sizeof(float);
       total_scratch_size += padded_output_size;
     }
+    if (use_im2col) {
+      im2col_tile_size = params != nullptr && (*params)[2] > 0
+          ? std::min<index_t>((*params)[2], height * width)
+          : Im2ColTileSize(filter_shape.data(), height * width);
+      im2col_size = Im2ColBufferSize(filter_shape.data(), height * width,
+                                     im2col_tile_size) * sizeof(float);
+      total_scratch_size += im2col_size;
+    }
+    if (use_winograd_general) {
+      winograd_buffer_size = WinogradBufferSize(filter_shape.data(),
+                                                winograd_tile_size)
+          * sizeof(float);
+      total_scratch_size += winograd_buffer_size;
+    }
     // Init scratch buffer
     scratch_->Rewind();
     scratch_->GrowSize(total_scratch_size);
@@ -483,41 +771,68 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
       transformed_output(scratch_->Scratch(transformed_output_size), DT_FLOAT);
     Tensor padded_input(scratch_->Scratch(padded_input_size), DT_FLOAT);
     Tensor padded_output(scratch_->Scratch(padded_output_size), DT_FLOAT);
+    Tensor im2col_buffer(scratch_->Scratch(im2col_size), DT_FLOAT);
+    Tensor winograd_buffer(scratch_->Scratch(winograd_buffer_size), DT_FLOAT);
     const index_t extra_input_shape[4] =
         {batch, input_channels, extra_input_height, extra_input_width};
     const index_t extra_output_shape[4] =
         {batch, channels, extra_output_height, extra_output_width};
+    const bool pad_output =
+        extra_output_height != height || extra_output_width != width;
+    // These kernels apply the epilogue to the tiles they store, the others
+    // are followed by one pass over the output. A padded output is unpacked
+    // by that pass, it has other offsets than the residual.
+    const bool fuse_epilogue =
+        !pad_output && (use_avx2 || use_winograd_general || use_im2col);
+    const ConvEpilogue *kernel_epilogue =
+        fuse_epilogue && !IsNoopEpilogue(epilogue) ? &epilogue : nullptr;
+
+    if (use_winograd || use_winograd_general) {
+      algorithm_ = "winograd";
+    } else if (use_avx2) {
+      algorithm_ = "direct_avx2";
+    } else if (use_im2col) {
+      algorithm_ = MakeString("im2col tile ", im2col_tile_size);
+    } else if (use_direct && (*params)[0] == CONV_DIRECT) {
+      algorithm_ = "direct";
+    } else {
+      algorithm_ = "general";
+    }
+    if (gemm_block_size > 0 && (use_im2col || use_neon_1x1)) {
+      algorithm_ += MakeString(" gemm block ", gemm_block_size);
+    }
 
     // decide which convolution function to call
     if (use_winograd) {
       transformed_input.Reshape(transformed_input_shape);
       transformed_output.Reshape(transformed_output_shape);
       const float *transformed_filter_ptr;
-      if (transformed_filter_.dim_size() == 0) {
-        if (is_filter_transformed_) {
-          transformed_filter_ptr = filter_data;
-        } else {
-          MACE_RETURN_IF_ERROR(transformed_filter_.Resize(
+      if (is_filter_transformed_) {
+        transformed_filter_ptr = filter_data;
+      } else {
+        // the transformed filter may have been released by Workspace::Trim
+        if (!is_transformed_filter_ready_
+            || transformed_filter_->UnderlyingBuffer()->size() == 0) {
+          MACE_RETURN_IF_ERROR(transformed_filter_->Resize(
               transformed_filter_shape));
           switch (winograd_out_tile_size) {
             case 2:
               TransformFilter4x4(filter_data,
                                  filter_shape[1],
                                  filter_shape[0],
-                                 transformed_filter_.mutable_data<float>());
+                                 transformed_filter_->mutable_data<float>());
               break;
             case 6:
               TransformFilter8x8(filter_data,
                                  filter_shape[1],
                                  filter_shape[0],
-                                 transformed_filter_.mutable_data<float>());
+                                 transformed_filter_->mutable_data<float>());
               break;
             default:MACE_NOT_IMPLEMENTED;
           }
-          transformed_filter_ptr = transformed_filter_.data<float>();
+          is_transformed_filter_ready_ = true;
         }
-      } else {
-        transformed_filter_ptr = transformed_filter_.data<float>();
+        transformed_filter_ptr = transformed_filter_->data<float>();
       }
 
       float *transformed_input_data = transformed_input.mutable_data<float>();
@@ -536,6 +851,49 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                           transformed_output_data,
                           pad_output);
       };
+    } else if (use_winograd_general) {
+      // the transformed filter depends on the tile size picked for the shape
+      if (!is_transformed_filter_ready_
+          || transformed_filter_->UnderlyingBuffer()->size() == 0
+          || winograd_out_tile_size_[0] != winograd_tile_size[0]
+          || winograd_out_tile_size_[1] != winograd_tile_size[1]) {
+        MACE_RETURN_IF_ERROR(transformed_filter_->Resize(
+            {WinogradTransformedFilterSize(filter_shape.data(),
+                                           winograd_tile_size)}));
+        WinogradTransformFilter(filter_data,
+                                filter_shape.data(),
+                                winograd_tile_size,
+                                transformed_filter_->mutable_data<float>());
+        winograd_out_tile_size_[0] = winograd_tile_size[0];
+        winograd_out_tile_size_[1] = winograd_tile_size[1];
+        is_transformed_filter_ready_ = true;
+      }
+      const float *transformed_filter_ptr = transformed_filter_->data<float>();
+      float *winograd_data = winograd_buffer.mutable_data<float>();
+
+      conv_func = [=](const float *pad_input, float *pad_output) {
+        WinogradConv2d(pad_input,
+                       transformed_filter_ptr,
+                       extra_input_shape,
+                       extra_output_shape,
+                       filter_shape.data(),
+                       pad_hw,
+                       winograd_tile_size,
+                       winograd_data,
+                       pad_output,
+                       kernel_epilogue);
+      };
+    } else if (use_avx2) {
+      conv_func = [=](const float *pad_input, float *pad_output) {
+        avx2_func(pad_input,
+                  filter_data,
+                  extra_input_shape,
+                  extra_output_shape,
+                  pad_hw,
+                  dilations_,
+                  kernel_epilogue,
+                  pad_output);
+      };
     } else if (use_neon_3x3_s1) {
       conv_func = [=](const float *pad_input, float *pad_output) {
         Conv2dNeonK3x3S1(pad_input,
@@ -552,16 +910,14 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                          extra_output_shape,
                          pad_output);
       };
-    } else if (use_neon_1x1_s1) {
+    } else if (use_neon_1x1) {
       conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK1x1S1(pad_input,
-                         filter_data,
-                         batch,
-                         extra_input_height,
-                         extra_input_width,
-                         input_channels,
-                         channels,
-                         pad_output);
+        Conv2dNeonK1x1(pad_input,
+                       filter_data,
+                       extra_input_shape,
+                       extra_output_shape,
+                       strides_,
+                       pad_output);
       };
     } else if (use_neon_5x5_s1) {
       conv_func = [=](const float *pad_input, float *pad_output) {
@@ -627,6 +983,22 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                           extra_output_shape,
                           pad_output);
       };
+    } else if (use_im2col) {
+      float *im2col_data = im2col_buffer.mutable_data<float>();
+      conv_func = [=](const float *pad_input, float *pad_output) {
+        Im2ColConv(pad_input,
+                   filter_data,
+                   extra_input_shape,
+                   extra_output_shape,
+                   filter_shape.data(),
+                   strides_,
+                   dilations_,
+                   pad_hw,
+                   im2col_tile_size,
+                   im2col_data,
+                   pad_output,
+                   kernel_epilogue);
+      };
     } else {
       conv_func = [=](const float *pad_input, float *pad_output) {
         Conv2dGeneral(pad_input,
@@ -653,62 +1025,55 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
       pad_input_ptr = &padded_input;
     }
 
-    // TODO(libin): don't need clear after bias is integrated in each conv
+    // the neon kernels accumulate into the output
+    const bool overwrite_output =
+        use_avx2 || use_neon_1x1 || use_im2col || use_winograd_general;
     Tensor *pad_output_ptr = output;
-    if (extra_output_height != height || extra_output_width != width) {
+    if (pad_output) {
       padded_output.Reshape({batch, channels, extra_output_height,
                             extra_output_width});
-      padded_output.Clear();
       pad_output_ptr = &padded_output;
-    } else if (!use_neon_1x1_s1) {
-      output->Clear();
+    }
+    if (!overwrite_output) {
+      pad_output_ptr->Clear();
     }
 
     const float *pad_input_data = pad_input_ptr->data<float>();
     float *pad_output_data = pad_output_ptr->mutable_data<float>();
 
+    const index_t saved_gemm_block_size = GemmBlockSize();
+    SetGemmBlockSize(gemm_block_size);
     conv_func(pad_input_data, pad_output_data);
+    SetGemmBlockSize(saved_gemm_block_size);
 
-    // unpack output
-    if (extra_output_height != height || extra_output_width != width) {
-#pragma omp parallel for collapse(2)
+    // unpack output, with the epilogue if the kernel did not apply it
+    if (pad_output || (!fuse_epilogue && !IsNoopEpilogue(epilogue))) {
+#pragma omp parallel for collapse(3)
       for (index_t b = 0; b < batch; ++b) {
         for (index_t c = 0; c < channels; ++c) {
           for (index_t h = 0; h < height; ++h) {
-            memcpy(
-              output_data + b * channels * height * width + c * height * width
-                + h * width,
-              pad_output_data
-                + b * channels * extra_output_height * extra_output_width
-                + c * extra_output_height * extra_output_width
-                + h * extra_output_width,
-              sizeof(float) * width);
-          }
-        }
-      }
-    }
-
-    if (bias_data != nullptr) {
-#pragma omp parallel for collapse(2)
-      for (index_t b = 0; b < batch; ++b) {
-        for (index_t c = 0; c < channels; ++c) {
-          for (index_t i = 0; i < height * width; ++i) {
-            output_data[(b * channels + c) * height * width + i] +=
-              bias_data[c];
+            const index_t offset = ((b * channels + c) * height + h) * width;
+            ApplyConvEpilogue(epilogue, c, offset,
+                              pad_output_data
+                                + ((b * channels + c) * extra_output_height
+                                  + h) * extra_output_width,
+                              width,
+                              output_data + offset);
           }
         }
       }
     }
 
-    DoActivation(output_data, output_data, output->size(), activation_,
-                 relux_max_limit_);
-
     return MACE_SUCCESS;
   }
 
-  Tensor transformed_filter_;
+  Tensor *transformed_filter_;
+  bool is_transformed_filter_ready_;
   bool is_filter_transformed_;
   ScratchBuffer *scratch_;
+  const DataFormat data_format_;
+  // tile size transformed_filter_ was transformed for by winograd
+  int winograd_out_tile_size_[2];
 };
 
 #ifdef MACE_ENABLE_OPENCL
@@ -718,23 +1083,31 @@ struct Conv2dFunctor<DeviceType::GPU, T> : Conv2dFunctorBase {
                 const Padding &padding_type,
                 const std::vector<int> &paddings,
                 const int *dilations,
+                const int group,
                 const ActivationType activation,
                 const float relux_max_limit,
                 const bool is_filter_transformed,
-                ScratchBuffer *scratch)
+                ScratchBuffer *scratch,
+                Tensor *transformed_filter,
+                const DataFormat data_format)
     : Conv2dFunctorBase(strides,
                         padding_type,
                         paddings,
                         dilations,
+                        group,
                         activation,
                         relux_max_limit) {
     MACE_UNUSED(is_filter_transformed);
     MACE_UNUSED(scratch);
+    MACE_UNUSED(transformed_filter);
+    // images are always NHWC
+    MACE_UNUSED(data_format);
   }
 
   MaceStatus operator()(const Tensor *input,
                   const Tensor *filter,
                   const Tensor *bias,
+                  const Tensor *residual,
                   Tensor *output,
                   StatsFuture *future);
 
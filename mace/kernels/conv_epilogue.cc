@@ -0,0 +1,112 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include "mace/kernels/conv_epilogue.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+const int kBlockSize = 8;
+
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+// bias, residual and relu/relux a block at a time, tanh and sigmoid and the
+// tail are scalar.
+__attribute__((always_inline))
+inline void ApplyConvEpilogueImpl(const ConvEpilogue &epilogue,
+                                  const index_t channel,
+                                  const index_t offset,
+                                  const float *input,
+                                  const index_t size,
+                                  float *output) {
+  const ActivationType activation = epilogue.activation;
+  index_t i = 0;
+  if (activation == NOOP || activation == RELU || activation == RELUX) {
+    const float bias =
+        epilogue.bias == nullptr ? 0.f : epilogue.bias[channel];
+    const float limit =
+        activation == RELUX ? epilogue.relux_max_limit : 0.f;
+    const Block zero = {};
+    const Block max_limit = zero + limit;
+    for (; i + kBlockSize <= size; i += kBlockSize) {
+      Block v = AsBlock(input + i) + bias;
+      if (epilogue.residual != nullptr) {
+        v += AsBlock(epilogue.residual + offset + i);
+      }
+      if (activation != NOOP) v = v > zero ? v : zero;
+      if (activation == RELUX) v = v < max_limit ? v : max_limit;
+      AsBlock(output + i) = v;
+    }
+  }
+  for (; i < size; ++i) {
+    output[i] = ApplyConvEpilogue(epilogue, channel, offset + i, input[i]);
+  }
+}
+
+void ApplyConvEpilogueSimd(const ConvEpilogue &epilogue,
+                           const index_t channel,
+                           const index_t offset,
+                           const float *input,
+                           const index_t size,
+                           float *output) {
+  ApplyConvEpilogueImpl(epilogue, channel, offset, input, size, output);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+MACE_AVX2_TARGET void ApplyConvEpilogueAvx2(const ConvEpilogue &epilogue,
+                                            const index_t channel,
+                                            const index_t offset,
+                                            const float *input,
+                                            const index_t size,
+                                            float *output) {
+  ApplyConvEpilogueImpl(epilogue, channel, offset, input, size, output);
+}
+#endif
+}  // namespace
+
+void ApplyConvEpilogue(const ConvEpilogue &epilogue,
+                       const index_t channel,
+                       const index_t offset,
+                       const float *input,
+                       const index_t size,
+                       float *output) {
+  if (IsNoopEpilogue(epilogue)) {
+    if (input != output) {
+      memcpy(output, input, size * sizeof(float));
+    }
+    return;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuSupportsAvx2()) {
+    ApplyConvEpilogueAvx2(epilogue, channel, offset, input, size, output);
+    return;
+  }
+#endif
+  ApplyConvEpilogueSimd(epilogue, channel, offset, input, size, output);
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,83 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_CONV_EPILOGUE_H_
+#define MACE_KERNELS_CONV_EPILOGUE_H_
+
+#include <algorithm>
+#include <cmath>
+
+#include "mace/core/types.h"
+#include "mace/kernels/activation.h"
+
+// What is left of a convolution once the sums are computed: the bias, a
+// residual tensor of the output shape added for skip connections, and the
+// activation, in that order. Kernels apply it to each tile they store, while
+// it is still in registers or cache, instead of passes over the output.
+
+namespace mace {
+namespace kernels {
+
+struct ConvEpilogue {
+  ConvEpilogue()
+      : bias(nullptr),
+        residual(nullptr),
+        activation(NOOP),
+        relux_max_limit(0) {}
+
+  const float *bias;      // [out_channels], or nullptr
+  const float *residual;  // NCHW like the output, or nullptr
+  ActivationType activation;
+  float relux_max_limit;
+};
+
+inline bool IsNoopEpilogue(const ConvEpilogue &epilogue) {
+  return epilogue.bias == nullptr && epilogue.residual == nullptr
+      && epilogue.activation == NOOP;
+}
+
+// The output at offset in the NCHW output, of the given channel.
+inline float ApplyConvEpilogue(const ConvEpilogue &epilogue,
+                               const index_t channel,
+                               const index_t offset,
+                               float value) {
+  if (epilogue.bias != nullptr) value += epilogue.bias[channel];
+  if (epilogue.residual != nullptr) value += epilogue.residual[offset];
+  switch (epilogue.activation) {
+    case RELU:
+      return std::max(value, 0.f);
+    case RELUX:
+      return std::min(std::max(value, 0.f), epilogue.relux_max_limit);
+    case TANH:
+      return std::tanh(value);
+    case SIGMOID:
+      return 1 / (1 + std::exp(-value));
+    default:
+      return value;
+  }
+}
+
+// size outputs of one channel, starting at offset in the NCHW output; input
+// holds their sums and may be output.
+void ApplyConvEpilogue(const ConvEpilogue &epilogue,
+                       const index_t channel,
+                       const index_t offset,
+                       const float *input,
+                       const index_t size,
+                       float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_CONV_EPILOGUE_H_
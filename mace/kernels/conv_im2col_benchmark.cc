@@ -0,0 +1,141 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/conv_2d.h"
+
+namespace mace {
+namespace kernels {
+namespace test {
+
+// Compare im2col + gemm with the direct general convolution it replaces
+
+namespace {
+
+const int kNoPadding[2] = {0, 0};
+
+struct ConvShapes {
+  ConvShapes(int c, int h, int w, int kh, int kw, int s, int d, int oc)
+      : strides{s, s}, dilations{d, d} {
+    const index_t oh = (h - (kh - 1) * d - 1) / s + 1;
+    const index_t ow = (w - (kw - 1) * d - 1) / s + 1;
+    in_shape = {1, c, h, w};
+    out_shape = {1, oc, oh, ow};
+    filter_shape = {oc, c, kh, kw};
+  }
+  std::vector<index_t> in_shape;
+  std::vector<index_t> out_shape;
+  std::vector<index_t> filter_shape;
+  int strides[2];
+  int dilations[2];
+};
+
+void ConvBenchmark_Im2Col(int iters, const ConvShapes &s) {
+  mace::testing::StopTiming();
+  std::vector<float> input(s.in_shape[1] * s.in_shape[2] * s.in_shape[3]);
+  std::vector<float> filter(s.filter_shape[0] * s.filter_shape[1]
+                                * s.filter_shape[2] * s.filter_shape[3]);
+  std::vector<float> output(s.out_shape[1] * s.out_shape[2]
+                                * s.out_shape[3]);
+  const index_t out_image_size = s.out_shape[2] * s.out_shape[3];
+  const index_t tile_size =
+      Im2ColTileSize(s.filter_shape.data(), out_image_size);
+  std::vector<float> buffer(
+      Im2ColBufferSize(s.filter_shape.data(), out_image_size, tile_size));
+  // warm up
+  Im2ColConv(input.data(), filter.data(), s.in_shape.data(),
+             s.out_shape.data(), s.filter_shape.data(), s.strides,
+             s.dilations, kNoPadding, tile_size, buffer.data(),
+             output.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    Im2ColConv(input.data(), filter.data(), s.in_shape.data(),
+               s.out_shape.data(), s.filter_shape.data(), s.strides,
+               s.dilations, kNoPadding, tile_size, buffer.data(),
+             output.data());
+  }
+}
+
+void ConvBenchmark_Direct(int iters, const ConvShapes &s) {
+  mace::testing::StopTiming();
+  std::vector<float> input(s.in_shape[1] * s.in_shape[2] * s.in_shape[3]);
+  std::vector<float> filter(s.filter_shape[0] * s.filter_shape[1]
+                                * s.filter_shape[2] * s.filter_shape[3]);
+  std::vector<float> output(s.out_shape[1] * s.out_shape[2]
+                                * s.out_shape[3]);
+  Conv2dFunctor<DeviceType::CPU, float> functor(
+      s.strides, Padding::VALID, {}, s.dilations, 1, ActivationType::NOOP,
+      0.f, false, nullptr, nullptr, NCHW);
+  // warm up
+  functor.Conv2dGeneral(input.data(), filter.data(), s.in_shape.data(),
+                        s.out_shape.data(), s.filter_shape.data(), s.strides,
+                        s.dilations, output.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    std::fill(output.begin(), output.end(), 0);
+    functor.Conv2dGeneral(input.data(), filter.data(), s.in_shape.data(),
+                          s.out_shape.data(), s.filter_shape.data(),
+                          s.strides, s.dilations, output.data());
+  }
+}
+
+}  // namespace
+
+#define MACE_BM_CONV_IM2COL_FUNC(C, H, W, KH, KW, S, D, OC, FUNC)             \
+  static void                                                                  \
+      MACE_BM_CONV_IM2COL_##C##_##H##_##W##_K##KH##x##KW##S##S##_D##D##_##OC\
+##_##FUNC(int iters) {                                                         \
+    const ConvShapes shapes(C, H, W, KH, KW, S, D, OC);                        \
+    const int64_t macc = static_cast<int64_t>(iters) * shapes.out_shape[2]     \
+        * shapes.out_shape[3] * OC * C * KH * KW;                              \
+    const int64_t tot = static_cast<int64_t>(iters) * (C * H * W              \
+        + OC * C * KH * KW);                                                   \
+    mace::testing::MaccProcessed(macc);                                        \
+    mace::testing::BytesProcessed(tot * sizeof(float));                        \
+    ConvBenchmark_##FUNC(iters, shapes);                                       \
+  }                                                                            \
+  MACE_BENCHMARK(                                                              \
+      MACE_BM_CONV_IM2COL_##C##_##H##_##W##_K##KH##x##KW##S##S##_D##D##_##OC\
+##_##FUNC)
+
+#define MACE_BM_CONV_IM2COL(C, H, W, KH, KW, S, D, OC)            \
+  MACE_BM_CONV_IM2COL_FUNC(C, H, W, KH, KW, S, D, OC, Im2Col);  \
+  MACE_BM_CONV_IM2COL_FUNC(C, H, W, KH, KW, S, D, OC, Direct);
+
+// kernel sizes without a specialized kernel
+MACE_BM_CONV_IM2COL(64, 32, 32, 3, 5, 1, 1, 64);
+MACE_BM_CONV_IM2COL(64, 32, 32, 5, 5, 2, 1, 64);
+MACE_BM_CONV_IM2COL(32, 64, 64, 9, 9, 1, 1, 32);
+MACE_BM_CONV_IM2COL(128, 28, 28, 2, 2, 1, 1, 128);
+
+// strided
+MACE_BM_CONV_IM2COL(3, 224, 224, 3, 3, 2, 1, 32);
+MACE_BM_CONV_IM2COL(64, 56, 56, 3, 3, 3, 1, 64);
+MACE_BM_CONV_IM2COL(128, 56, 56, 1, 1, 2, 1, 256);
+
+// dilated
+MACE_BM_CONV_IM2COL(32, 64, 64, 3, 3, 1, 2, 32);
+MACE_BM_CONV_IM2COL(64, 64, 64, 3, 3, 1, 4, 64);
+MACE_BM_CONV_IM2COL(256, 33, 33, 3, 3, 1, 6, 256);
+
+// few output channels
+MACE_BM_CONV_IM2COL(32, 64, 64, 3, 3, 2, 1, 4);
+MACE_BM_CONV_IM2COL(16, 64, 64, 5, 5, 1, 2, 8);
+
+}  // namespace test
+}  // namespace kernels
+}  // namespace mace
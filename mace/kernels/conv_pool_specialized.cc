@@ -0,0 +1,319 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "mace/kernels/conv_pool_specialized.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// V if it is a compile time constant, value otherwise.
+template <int V>
+inline index_t Fixed(const index_t value) {
+  return V > 0 ? V : value;
+}
+
+// N output channels of the output tiles of one image, over all input
+// channels.
+template <int N, int KH, int KW, int SH, int SW, int DH, int DW>
+inline void Conv2dOutChannels(const float *input,
+                              const float *filter,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const index_t *filter_shape,
+                              const int *stride_hw,
+                              const int *dilation_hw,
+                              float *output) {
+  const index_t in_width = in_shape[3];
+  const index_t in_image_size = in_shape[2] * in_width;
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t out_image_size = out_height * out_width;
+  const index_t in_channels = filter_shape[1];
+  const index_t filter_height = Fixed<KH>(filter_shape[2]);
+  const index_t filter_width = Fixed<KW>(filter_shape[3]);
+  const index_t filter_size = filter_height * filter_width;
+  const index_t stride_h = Fixed<SH>(stride_hw[0]);
+  const index_t stride_w = Fixed<SW>(stride_hw[1]);
+  const index_t dilation_h = Fixed<DH>(dilation_hw[0]);
+  const index_t dilation_w = Fixed<DW>(dilation_hw[1]);
+
+  for (index_t c = 0; c < in_channels; ++c) {
+    const float *in_ptr_base = input + c * in_image_size;
+    const float *filter_ptr[N];
+    for (int n = 0; n < N; ++n) {
+      filter_ptr[n] = filter + (n * in_channels + c) * filter_size;
+    }
+    for (index_t h = 0; h < out_height; ++h) {
+      for (index_t w = 0; w + 3 < out_width; w += 4) {
+        index_t in_offset = h * stride_h * in_width + w * stride_w;
+        // output (N outch x 1 height x 4 width)
+        float vo[N][4];
+        const index_t out_offset = h * out_width + w;
+        for (int n = 0; n < N; ++n) {
+          for (index_t ow = 0; ow < 4; ++ow) {
+            vo[n][ow] = output[n * out_image_size + out_offset + ow];
+          }
+        }
+        // calc by row
+        for (index_t kh = 0; kh < filter_height; ++kh) {
+          for (index_t kw = 0; kw < filter_width; ++kw) {
+            const float *in_ptr = in_ptr_base + in_offset + kw * dilation_w;
+            for (int n = 0; n < N; ++n) {
+              const float f = filter_ptr[n][kh * filter_width + kw];
+              for (index_t ow = 0; ow < 4; ++ow) {
+                vo[n][ow] += in_ptr[ow * stride_w] * f;
+              }
+            }
+          }  // kw
+          in_offset += dilation_h * in_width;
+        }  // kh
+        for (int n = 0; n < N; ++n) {
+          for (index_t ow = 0; ow < 4; ++ow) {
+            output[n * out_image_size + out_offset + ow] = vo[n][ow];
+          }
+        }
+      }  // w
+    }  // h
+  }  // c
+}
+
+template <int KH, int KW, int SH, int SW, int DH, int DW>
+void Conv2dGeneralImpl(const float *input,
+                       const float *filter,
+                       const index_t *in_shape,
+                       const index_t *out_shape,
+                       const index_t *filter_shape,
+                       const int *stride_hw,
+                       const int *dilation_hw,
+                       float *output) {
+  const index_t in_batch_size = filter_shape[1] * in_shape[2] * in_shape[3];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t out_batch_size = filter_shape[0] * out_image_size;
+  const index_t filter_oc_size =
+      filter_shape[1] * filter_shape[2] * filter_shape[3];
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < in_shape[0]; b++) {
+    for (index_t m = 0; m < filter_shape[0]; m += 4) {
+      const float *in_ptr = input + b * in_batch_size;
+      float *out_ptr = output + b * out_batch_size;
+      if (m + 3 < filter_shape[0]) {
+        Conv2dOutChannels<4, KH, KW, SH, SW, DH, DW>(
+            in_ptr, filter + m * filter_oc_size, in_shape, out_shape,
+            filter_shape, stride_hw, dilation_hw,
+            out_ptr + m * out_image_size);
+      } else {
+        for (index_t mm = m; mm < filter_shape[0]; ++mm) {
+          Conv2dOutChannels<1, KH, KW, SH, SW, DH, DW>(
+              in_ptr, filter + mm * filter_oc_size, in_shape, out_shape,
+              filter_shape, stride_hw, dilation_hw,
+              out_ptr + mm * out_image_size);
+        }
+      }
+    }  // m
+  }  // b
+}
+
+template <bool MAX, int KH, int KW, int SH, int SW, int DH, int DW>
+void PoolingImpl(const float *input,
+                 const index_t *in_shape,
+                 const index_t *out_shape,
+                 const int *filter_hw,
+                 const int *stride_hw,
+                 const int *dilation_hw,
+                 const int *pad_hw,
+                 float *output) {
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t in_batch_size = in_shape[1] * in_image_size;
+  const index_t out_batch_size = out_shape[1] * out_image_size;
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t c = 0; c < out_shape[1]; ++c) {
+      const index_t out_base = b * out_batch_size + c * out_image_size;
+      const index_t in_base = b * in_batch_size + c * in_image_size;
+      const index_t out_height = out_shape[2];
+      const index_t out_width = out_shape[3];
+      const index_t in_height = in_shape[2];
+      const index_t in_width = in_shape[3];
+      const index_t filter_height = Fixed<KH>(filter_hw[0]);
+      const index_t filter_width = Fixed<KW>(filter_hw[1]);
+      const index_t stride_h = Fixed<SH>(stride_hw[0]);
+      const index_t stride_w = Fixed<SW>(stride_hw[1]);
+      const index_t dilation_h = Fixed<DH>(dilation_hw[0]);
+      const index_t dilation_w = Fixed<DW>(dilation_hw[1]);
+
+      for (index_t h = 0; h < out_height; ++h) {
+        for (index_t w = 0; w < out_width; ++w) {
+          const index_t out_offset = out_base + h * out_width + w;
+          float res = MAX ? std::numeric_limits<float>::lowest() : 0;
+          int block_size = 0;
+          for (index_t fh = 0; fh < filter_height; ++fh) {
+            for (index_t fw = 0; fw < filter_width; ++fw) {
+              index_t inh = h * stride_h + dilation_h * fh - pad_hw[0];
+              index_t inw = w * stride_w + dilation_w * fw - pad_hw[1];
+              if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
+                index_t input_offset = in_base + inh * in_width + inw;
+                if (MAX) {
+                  res = std::max(res, input[input_offset]);
+                } else {
+                  res += input[input_offset];
+                  ++block_size;
+                }
+              }
+            }
+          }
+          output[out_offset] = MAX ? res : res / block_size;
+        }
+      }
+    }
+  }
+}
+
+struct KernelShape {
+  int filter_height;
+  int filter_width;
+  int stride;
+  int dilation;
+};
+
+// Filter sizes and strides of the shapes that have no other kernel on some
+// cpus, at dilation 1 unless noted.
+#define MACE_CONV_GENERAL_SHAPES(M) \
+  M(1, 3, 1, 1)                     \
+  M(3, 1, 1, 1)                     \
+  M(2, 2, 2, 1)                     \
+  M(3, 3, 1, 1)                     \
+  M(3, 3, 2, 1)                     \
+  M(3, 3, 1, 2)                     \
+  M(5, 5, 1, 1)                     \
+  M(5, 5, 2, 1)
+
+#define MACE_POOLING_SHAPES(M) \
+  M(2, 2, 2, 1)                \
+  M(3, 3, 1, 1)                \
+  M(3, 3, 2, 1)
+
+template <typename Func>
+struct KernelEntry {
+  KernelShape shape;
+  Func func;
+};
+
+template <typename Func, size_t SIZE>
+Func FindKernel(const KernelEntry<Func> (&kernels)[SIZE],
+                const index_t filter_height,
+                const index_t filter_width,
+                const int *stride_hw,
+                const int *dilation_hw,
+                Func any_shape) {
+  if (stride_hw[0] != stride_hw[1] || dilation_hw[0] != dilation_hw[1]) {
+    return any_shape;
+  }
+  for (const KernelEntry<Func> &kernel : kernels) {
+    if (kernel.shape.filter_height == filter_height
+        && kernel.shape.filter_width == filter_width
+        && kernel.shape.stride == stride_hw[0]
+        && kernel.shape.dilation == dilation_hw[0]) {
+      return kernel.func;
+    }
+  }
+  return any_shape;
+}
+}  // namespace
+
+void Conv2dGeneralAnyShape(const float *input,
+                           const float *filter,
+                           const index_t *in_shape,
+                           const index_t *out_shape,
+                           const index_t *filter_shape,
+                           const int *stride_hw,
+                           const int *dilation_hw,
+                           float *output) {
+  Conv2dGeneralImpl<0, 0, 0, 0, 0, 0>(input, filter, in_shape, out_shape,
+                                      filter_shape, stride_hw, dilation_hw,
+                                      output);
+}
+
+void MaxPoolingAnyShape(const float *input,
+                        const index_t *in_shape,
+                        const index_t *out_shape,
+                        const int *filter_hw,
+                        const int *stride_hw,
+                        const int *dilation_hw,
+                        const int *pad_hw,
+                        float *output) {
+  PoolingImpl<true, 0, 0, 0, 0, 0, 0>(input, in_shape, out_shape, filter_hw,
+                                      stride_hw, dilation_hw, pad_hw, output);
+}
+
+void AvgPoolingAnyShape(const float *input,
+                        const index_t *in_shape,
+                        const index_t *out_shape,
+                        const int *filter_hw,
+                        const int *stride_hw,
+                        const int *dilation_hw,
+                        const int *pad_hw,
+                        float *output) {
+  PoolingImpl<false, 0, 0, 0, 0, 0, 0>(input, in_shape, out_shape, filter_hw,
+                                       stride_hw, dilation_hw, pad_hw, output);
+}
+
+Conv2dGeneralFunc Conv2dGeneralKernel(const index_t filter_height,
+                                      const index_t filter_width,
+                                      const int *stride_hw,
+                                      const int *dilation_hw) {
+#define MACE_CONV_GENERAL_ENTRY(KH, KW, S, D) \
+  {{KH, KW, S, D}, Conv2dGeneralImpl<KH, KW, S, S, D, D>},
+  static const KernelEntry<Conv2dGeneralFunc> kKernels[] = {
+      MACE_CONV_GENERAL_SHAPES(MACE_CONV_GENERAL_ENTRY)
+  };
+#undef MACE_CONV_GENERAL_ENTRY
+  return FindKernel(kKernels, filter_height, filter_width, stride_hw,
+                    dilation_hw, Conv2dGeneralAnyShape);
+}
+
+PoolingFunc MaxPoolingKernel(const int *filter_hw,
+                             const int *stride_hw,
+                             const int *dilation_hw) {
+#define MACE_MAX_POOLING_ENTRY(KH, KW, S, D) \
+  {{KH, KW, S, D}, PoolingImpl<true, KH, KW, S, S, D, D>},
+  static const KernelEntry<PoolingFunc> kKernels[] = {
+      MACE_POOLING_SHAPES(MACE_MAX_POOLING_ENTRY)
+  };
+#undef MACE_MAX_POOLING_ENTRY
+  return FindKernel(kKernels, filter_hw[0], filter_hw[1], stride_hw,
+                    dilation_hw, MaxPoolingAnyShape);
+}
+
+PoolingFunc AvgPoolingKernel(const int *filter_hw,
+                             const int *stride_hw,
+                             const int *dilation_hw) {
+#define MACE_AVG_POOLING_ENTRY(KH, KW, S, D) \
+  {{KH, KW, S, D}, PoolingImpl<false, KH, KW, S, S, D, D>},
+  static const KernelEntry<PoolingFunc> kKernels[] = {
+      MACE_POOLING_SHAPES(MACE_AVG_POOLING_ENTRY)
+  };
+#undef MACE_AVG_POOLING_ENTRY
+  return FindKernel(kKernels, filter_hw[0], filter_hw[1], stride_hw,
+                    dilation_hw, AvgPoolingAnyShape);
+}
+
+}  // namespace kernels
+}  // namespace mace
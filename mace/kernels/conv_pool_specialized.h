@@ -0,0 +1,94 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_CONV_POOL_SPECIALIZED_H_
+#define MACE_KERNELS_CONV_POOL_SPECIALIZED_H_
+
+#include "mace/core/types.h"
+
+// The general NCHW convolution and pooling loops, instantiated with the
+// filter size, strides and dilations as compile time constants for common
+// shapes so that the loops over the filter taps are unrolled. Other shapes
+// run the instantiation reading them from the runtime arrays.
+
+namespace mace {
+namespace kernels {
+
+// filter is OIHW, output is accumulated into and is a whole number of 4
+// wide tiles, input is padded to cover them.
+typedef void (*Conv2dGeneralFunc)(const float *input,
+                                  const float *filter,
+                                  const index_t *in_shape,
+                                  const index_t *out_shape,
+                                  const index_t *filter_shape,
+                                  const int *stride_hw,
+                                  const int *dilation_hw,
+                                  float *output);
+
+// Taps past the input are skipped, average pooling divides by the taps read.
+typedef void (*PoolingFunc)(const float *input,
+                            const index_t *in_shape,
+                            const index_t *out_shape,
+                            const int *filter_hw,
+                            const int *stride_hw,
+                            const int *dilation_hw,
+                            const int *pad_hw,
+                            float *output);
+
+void Conv2dGeneralAnyShape(const float *input,
+                           const float *filter,
+                           const index_t *in_shape,
+                           const index_t *out_shape,
+                           const index_t *filter_shape,
+                           const int *stride_hw,
+                           const int *dilation_hw,
+                           float *output);
+
+void MaxPoolingAnyShape(const float *input,
+                        const index_t *in_shape,
+                        const index_t *out_shape,
+                        const int *filter_hw,
+                        const int *stride_hw,
+                        const int *dilation_hw,
+                        const int *pad_hw,
+                        float *output);
+
+void AvgPoolingAnyShape(const float *input,
+                        const index_t *in_shape,
+                        const index_t *out_shape,
+                        const int *filter_hw,
+                        const int *stride_hw,
+                        const int *dilation_hw,
+                        const int *pad_hw,
+                        float *output);
+
+// Return the kernel specialized for the shape, or the AnyShape one if there
+// is none.
+Conv2dGeneralFunc Conv2dGeneralKernel(const index_t filter_height,
+                                      const index_t filter_width,
+                                      const int *stride_hw,
+                                      const int *dilation_hw);
+
+PoolingFunc MaxPoolingKernel(const int *filter_hw,
+                             const int *stride_hw,
+                             const int *dilation_hw);
+
+PoolingFunc AvgPoolingKernel(const int *filter_hw,
+                             const int *stride_hw,
+                             const int *dilation_hw);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_CONV_POOL_SPECIALIZED_H_
@@ -0,0 +1,141 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/conv_pool_specialized.h"
+
+namespace mace {
+namespace kernels {
+namespace test {
+
+// Compare the kernels specialized for a shape with the AnyShape ones
+
+namespace {
+
+const int kNoPadding[2] = {0, 0};
+
+void ConvGeneralBenchmark(int iters, int c, int h, int w, int kh, int kw,
+                          int s, int d, int oc, bool specialized) {
+  mace::testing::StopTiming();
+  const int strides[2] = {s, s};
+  const int dilations[2] = {d, d};
+  const index_t in_shape[4] = {1, c, h, w};
+  // whole 4 wide output tiles
+  const index_t out_shape[4] = {1, oc, (h - (kh - 1) * d - 1) / s + 1,
+                                ((w - (kw - 1) * d - 1) / s + 1) / 4 * 4};
+  const index_t filter_shape[4] = {oc, c, kh, kw};
+  std::vector<float> input(c * h * w);
+  std::vector<float> filter(oc * c * kh * kw);
+  std::vector<float> output(oc * out_shape[2] * out_shape[3]);
+  Conv2dGeneralFunc func = specialized
+      ? Conv2dGeneralKernel(kh, kw, strides, dilations)
+      : Conv2dGeneralAnyShape;
+  mace::testing::MaccProcessed(static_cast<int64_t>(iters) * oc
+                               * out_shape[2] * out_shape[3] * c * kh * kw);
+  mace::testing::BytesProcessed(static_cast<int64_t>(iters)
+                                * (input.size() + output.size())
+                                * sizeof(float));
+  // warm up
+  func(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+       strides, dilations, output.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    func(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+         strides, dilations, output.data());
+  }
+}
+
+void PoolingBenchmark(int iters, int c, int h, int w, int k, int s, bool max,
+                      bool specialized) {
+  mace::testing::StopTiming();
+  const int filter_hw[2] = {k, k};
+  const int strides[2] = {s, s};
+  const int dilations[2] = {1, 1};
+  const index_t in_shape[4] = {1, c, h, w};
+  const index_t out_shape[4] = {1, c, (h - k) / s + 1, (w - k) / s + 1};
+  std::vector<float> input(c * h * w);
+  std::vector<float> output(c * out_shape[2] * out_shape[3]);
+  PoolingFunc func;
+  if (specialized) {
+    func = max ? MaxPoolingKernel(filter_hw, strides, dilations)
+               : AvgPoolingKernel(filter_hw, strides, dilations);
+  } else {
+    func = max ? MaxPoolingAnyShape : AvgPoolingAnyShape;
+  }
+  mace::testing::MaccProcessed(static_cast<int64_t>(iters) * c
+                               * out_shape[2] * out_shape[3] * k * k);
+  mace::testing::BytesProcessed(static_cast<int64_t>(iters)
+                                * (input.size() + output.size())
+                                * sizeof(float));
+  // warm up
+  func(input.data(), in_shape, out_shape, filter_hw, strides, dilations,
+       kNoPadding, output.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    func(input.data(), in_shape, out_shape, filter_hw, strides, dilations,
+         kNoPadding, output.data());
+  }
+}
+
+}  // namespace
+
+#define MACE_BM_CONV_GENERAL_FUNC(C, H, W, KH, KW, S, D, OC, FUNC, SPEC)       \
+  static void                                                                  \
+      MACE_BM_CONV_GENERAL_##C##_##H##_##W##_K##KH##x##KW##S##S##_D##D##_##OC\
+##_##FUNC(int iters) {                                                         \
+    ConvGeneralBenchmark(iters, C, H, W, KH, KW, S, D, OC, SPEC);              \
+  }                                                                            \
+  MACE_BENCHMARK(                                                              \
+      MACE_BM_CONV_GENERAL_##C##_##H##_##W##_K##KH##x##KW##S##S##_D##D##_##OC\
+##_##FUNC)
+
+#define MACE_BM_CONV_GENERAL(C, H, W, KH, KW, S, D, OC)                      \
+  MACE_BM_CONV_GENERAL_FUNC(C, H, W, KH, KW, S, D, OC, Specialized, true);  \
+  MACE_BM_CONV_GENERAL_FUNC(C, H, W, KH, KW, S, D, OC, AnyShape, false);
+
+#define MACE_BM_POOLING_FUNC(TYPE, C, H, W, K, S, FUNC, SPECIALIZED)          \
+  static void                                                                 \
+      MACE_BM_POOLING_##TYPE##_##C##_##H##_##W##_K##K##S##S##_##FUNC(         \
+          int iters) {                                                        \
+    PoolingBenchmark(iters, C, H, W, K, S, #TYPE[0] == 'M', SPECIALIZED);     \
+  }                                                                           \
+  MACE_BENCHMARK(MACE_BM_POOLING_##TYPE##_##C##_##H##_##W##_K##K##S##S##_\
+##FUNC)
+
+#define MACE_BM_POOLING(TYPE, C, H, W, K, S)                      \
+  MACE_BM_POOLING_FUNC(TYPE, C, H, W, K, S, Specialized, true);  \
+  MACE_BM_POOLING_FUNC(TYPE, C, H, W, K, S, AnyShape, false);
+
+// one per specialization
+MACE_BM_CONV_GENERAL(32, 64, 64, 1, 3, 1, 1, 32);
+MACE_BM_CONV_GENERAL(32, 64, 64, 3, 1, 1, 1, 32);
+MACE_BM_CONV_GENERAL(32, 64, 64, 2, 2, 2, 1, 64);
+MACE_BM_CONV_GENERAL(32, 64, 64, 3, 3, 1, 1, 32);
+MACE_BM_CONV_GENERAL(3, 224, 224, 3, 3, 2, 1, 32);
+MACE_BM_CONV_GENERAL(32, 64, 64, 3, 3, 1, 2, 32);
+MACE_BM_CONV_GENERAL(32, 64, 64, 5, 5, 1, 1, 32);
+MACE_BM_CONV_GENERAL(32, 64, 64, 5, 5, 2, 1, 64);
+
+MACE_BM_POOLING(MAX, 64, 112, 112, 2, 2);
+MACE_BM_POOLING(MAX, 64, 56, 56, 3, 1);
+MACE_BM_POOLING(MAX, 64, 112, 112, 3, 2);
+MACE_BM_POOLING(AVG, 64, 112, 112, 2, 2);
+MACE_BM_POOLING(AVG, 64, 56, 56, 3, 1);
+MACE_BM_POOLING(AVG, 64, 112, 112, 3, 2);
+
+}  // namespace test
+}  // namespace kernels
+}  // namespace mace
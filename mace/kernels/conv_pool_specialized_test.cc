@@ -0,0 +1,137 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/conv_pool_specialized.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+void RandomFill(std::vector<float> *data) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(data->begin(), data->end(), [&gen, &nd] { return nd(gen); });
+}
+
+// out_width is a whole number of the 4 wide tiles the kernel writes.
+void TestConv2dGeneral(const index_t filter_height,
+                       const index_t filter_width,
+                       const int stride,
+                       const int dilation,
+                       const bool specialized) {
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+  Conv2dGeneralFunc func =
+      Conv2dGeneralKernel(filter_height, filter_width, strides, dilations);
+  EXPECT_EQ(specialized, func != Conv2dGeneralAnyShape);
+
+  const index_t batch = 2;
+  const index_t in_channels = 3;
+  const index_t out_channels = 6;
+  const index_t out_height = 5;
+  const index_t out_width = 12;
+  const index_t in_shape[4] = {
+      batch, in_channels, (out_height - 1) * stride
+          + (filter_height - 1) * dilation + 1,
+      (out_width - 1) * stride + (filter_width - 1) * dilation + 1};
+  const index_t out_shape[4] = {batch, out_channels, out_height, out_width};
+  const index_t filter_shape[4] = {out_channels, in_channels, filter_height,
+                                   filter_width};
+  const int pad_hw[2] = {0, 0};
+
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_shape[2]
+                               * in_shape[3]);
+  std::vector<float> filter(out_channels * in_channels * filter_height
+                                * filter_width);
+  std::vector<float> output(batch * out_channels * out_height * out_width);
+  std::vector<float> output_ref(output.size());
+  RandomFill(&input);
+  RandomFill(&filter);
+
+  ConvRef(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+          strides, dilations, pad_hw, output_ref.data());
+  func(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+       strides, dilations, output.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3) << " with index " << i;
+  }
+}
+
+// Compared with the AnyShape kernel, at SAME padding.
+void TestPooling(const int kernel,
+                 const int stride,
+                 const bool max,
+                 const bool specialized) {
+  const int filter_hw[2] = {kernel, kernel};
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {1, 1};
+  PoolingFunc func = max ? MaxPoolingKernel(filter_hw, strides, dilations)
+                         : AvgPoolingKernel(filter_hw, strides, dilations);
+  PoolingFunc any_shape = max ? MaxPoolingAnyShape : AvgPoolingAnyShape;
+  EXPECT_EQ(specialized, func != any_shape);
+
+  const index_t in_shape[4] = {2, 3, 17, 22};
+  const index_t out_shape[4] = {2, 3, (17 - 1) / stride + 1,
+                                (22 - 1) / stride + 1};
+  const int pad_hw[2] = {(kernel - 1) / 2, (kernel - 1) / 2};
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_shape[2]
+                               * in_shape[3]);
+  std::vector<float> output(out_shape[0] * out_shape[1] * out_shape[2]
+                                * out_shape[3]);
+  std::vector<float> output_ref(output.size());
+  RandomFill(&input);
+
+  any_shape(input.data(), in_shape, out_shape, filter_hw, strides,
+            dilations, pad_hw, output_ref.data());
+  func(input.data(), in_shape, out_shape, filter_hw, strides, dilations,
+       pad_hw, output.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-5) << " with index " << i;
+  }
+}
+}  // namespace
+
+TEST(ConvPoolSpecializedTest, Conv2dGeneral) {
+  TestConv2dGeneral(1, 3, 1, 1, true);
+  TestConv2dGeneral(3, 1, 1, 1, true);
+  TestConv2dGeneral(2, 2, 2, 1, true);
+  TestConv2dGeneral(3, 3, 1, 1, true);
+  TestConv2dGeneral(3, 3, 2, 1, true);
+  TestConv2dGeneral(3, 3, 1, 2, true);
+  TestConv2dGeneral(5, 5, 1, 1, true);
+  TestConv2dGeneral(5, 5, 2, 1, true);
+  TestConv2dGeneral(4, 3, 3, 1, false);
+  TestConv2dGeneral(3, 3, 2, 3, false);
+}
+
+TEST(ConvPoolSpecializedTest, Pooling) {
+  for (bool max : {true, false}) {
+    TestPooling(2, 2, max, true);
+    TestPooling(3, 1, max, true);
+    TestPooling(3, 2, max, true);
+    TestPooling(4, 3, max, false);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,342 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/kernels/deconv_2d.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+const int kBlockSize = 8;
+
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+// Output channels handled by one task, their columns stay in l2 cache until
+// col2im scatters them.
+const index_t kChannelBlock = 4;
+const index_t kTileBytes = 64 * 1024;
+
+index_t TileRows(const index_t *in_shape, const index_t *filter_shape) {
+  const index_t width = in_shape[3];
+  const index_t row_bytes = kChannelBlock * filter_shape[2] * filter_shape[3]
+      * width * sizeof(float);
+  const index_t min_rows = RoundUpDiv<index_t>(2 * kBlockSize, width);
+  return std::min(in_shape[2], std::max(min_rows, kTileBytes / row_bytes));
+}
+
+// Four rows of the columns, 16 pixels starting at col.
+__attribute__((always_inline))
+inline void ColumnBlock4(const float *filter,
+                         const float *input,
+                         const index_t channels,
+                         const index_t in_image_size,
+                         const index_t tile_size,
+                         const index_t col,
+                         float *columns) {
+  const float *f0 = filter;
+  const float *f1 = f0 + channels;
+  const float *f2 = f1 + channels;
+  const float *f3 = f2 + channels;
+  Block c00 = {}, c01 = {}, c10 = {}, c11 = {};
+  Block c20 = {}, c21 = {}, c30 = {}, c31 = {};
+  for (index_t c = 0; c < channels; ++c) {
+    const Block &v0 = AsBlock(input + c * in_image_size + col);
+    const Block &v1 = AsBlock(input + c * in_image_size + col + kBlockSize);
+    c00 += v0 * f0[c];
+    c01 += v1 * f0[c];
+    c10 += v0 * f1[c];
+    c11 += v1 * f1[c];
+    c20 += v0 * f2[c];
+    c21 += v1 * f2[c];
+    c30 += v0 * f3[c];
+    c31 += v1 * f3[c];
+  }
+  float *out0 = columns + col;
+  float *out1 = out0 + tile_size;
+  float *out2 = out1 + tile_size;
+  float *out3 = out2 + tile_size;
+  AsBlock(out0) = c00;
+  AsBlock(out0 + kBlockSize) = c01;
+  AsBlock(out1) = c10;
+  AsBlock(out1 + kBlockSize) = c11;
+  AsBlock(out2) = c20;
+  AsBlock(out2 + kBlockSize) = c21;
+  AsBlock(out3) = c30;
+  AsBlock(out3 + kBlockSize) = c31;
+}
+
+// One row of the columns, kBlockSize pixels starting at col.
+__attribute__((always_inline))
+inline void ColumnBlock1(const float *filter,
+                         const float *input,
+                         const index_t channels,
+                         const index_t in_image_size,
+                         const index_t col,
+                         float *columns) {
+  Block sum = {};
+  for (index_t c = 0; c < channels; ++c) {
+    sum += AsBlock(input + c * in_image_size + col) * filter[c];
+  }
+  AsBlock(columns + col) = sum;
+}
+
+// [rows][C] * [C][tile_size] => columns, the input planes are in_image_size
+// apart; the last pixels overlap the previous block instead of a scalar
+// tail.
+__attribute__((always_inline))
+inline void ColumnsImpl(const float *filter,
+                        const float *input,
+                        const index_t rows,
+                        const index_t channels,
+                        const index_t in_image_size,
+                        const index_t tile_size,
+                        float *columns) {
+  if (tile_size < kBlockSize) {
+    for (index_t r = 0; r < rows; ++r) {
+      for (index_t t = 0; t < tile_size; ++t) {
+        float sum = 0;
+        for (index_t c = 0; c < channels; ++c) {
+          sum += filter[r * channels + c] * input[c * in_image_size + t];
+        }
+        columns[r * tile_size + t] = sum;
+      }
+    }
+    return;
+  }
+
+  index_t r = 0;
+  if (tile_size >= 2 * kBlockSize) {
+    for (; r + 4 <= rows; r += 4) {
+      float *out = columns + r * tile_size;
+      index_t t = 0;
+      for (; t + 2 * kBlockSize <= tile_size; t += 2 * kBlockSize) {
+        ColumnBlock4(filter + r * channels, input, channels, in_image_size,
+                     tile_size, t, out);
+      }
+      if (t < tile_size) {
+        ColumnBlock4(filter + r * channels, input, channels, in_image_size,
+                     tile_size, tile_size - 2 * kBlockSize, out);
+      }
+    }
+  }
+  for (; r < rows; ++r) {
+    float *out = columns + r * tile_size;
+    index_t t = 0;
+    for (; t + kBlockSize <= tile_size; t += kBlockSize) {
+      ColumnBlock1(filter + r * channels, input, channels, in_image_size, t,
+                   out);
+    }
+    if (t < tile_size) {
+      ColumnBlock1(filter + r * channels, input, channels, in_image_size,
+                   tile_size - kBlockSize, out);
+    }
+  }
+}
+
+typedef void (*ColumnsFunc)(const float *filter,
+                            const float *input,
+                            const index_t rows,
+                            const index_t channels,
+                            const index_t in_image_size,
+                            const index_t tile_size,
+                            float *columns);
+
+void Columns(const float *filter,
+             const float *input,
+             const index_t rows,
+             const index_t channels,
+             const index_t in_image_size,
+             const index_t tile_size,
+             float *columns) {
+  ColumnsImpl(filter, input, rows, channels, in_image_size, tile_size,
+              columns);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+MACE_AVX2_TARGET void ColumnsAvx2(const float *filter,
+                                  const float *input,
+                                  const index_t rows,
+                                  const index_t channels,
+                                  const index_t in_image_size,
+                                  const index_t tile_size,
+                                  float *columns) {
+  ColumnsImpl(filter, input, rows, channels, in_image_size, tile_size,
+              columns);
+}
+#endif
+
+// [first, last) of the input indices i with 0 <= i * stride + offset < size.
+void ValidRange(const index_t offset,
+                const index_t stride,
+                const index_t size,
+                const index_t in_size,
+                index_t *first,
+                index_t *last) {
+  *first = offset >= 0 ? 0 : (-offset + stride - 1) / stride;
+  *last = size - 1 - offset < 0
+      ? 0 : std::min(in_size, (size - 1 - offset) / stride + 1);
+}
+
+// Scatter the columns of rows [row_begin, row_end) of the input into the
+// output planes of the channels; output[s * i + f - pad] += columns.
+void Col2Im(const float *columns,
+            const index_t channels,
+            const index_t *kernel_hw,
+            const int *strides,
+            const index_t *pad_hw,
+            const index_t in_width,
+            const index_t row_begin,
+            const index_t row_end,
+            const index_t out_height,
+            const index_t out_width,
+            float *output) {
+  const index_t tile_size = (row_end - row_begin) * in_width;
+  const index_t out_image_size = out_height * out_width;
+  for (index_t c = 0; c < channels; ++c) {
+    float *out = output + c * out_image_size;
+    for (index_t fy = 0; fy < kernel_hw[0]; ++fy) {
+      index_t ih_begin, ih_end;
+      ValidRange(fy - pad_hw[0], strides[0], out_height, row_end,
+                 &ih_begin, &ih_end);
+      ih_begin = std::max(ih_begin, row_begin);
+      for (index_t fx = 0; fx < kernel_hw[1]; ++fx) {
+        const float *col = columns
+            + ((c * kernel_hw[0] + fy) * kernel_hw[1] + fx) * tile_size;
+        index_t iw_begin, iw_end;
+        ValidRange(fx - pad_hw[1], strides[1], out_width, in_width,
+                   &iw_begin, &iw_end);
+        const index_t count = iw_end - iw_begin;
+        for (index_t ih = ih_begin; ih < ih_end; ++ih) {
+          const float *col_row =
+              col + (ih - row_begin) * in_width + iw_begin;
+          float *out_row = out
+              + (ih * strides[0] + fy - pad_hw[0]) * out_width
+              + iw_begin * strides[1] + fx - pad_hw[1];
+          if (strides[1] == 1) {
+            for (index_t iw = 0; iw < count; ++iw) {
+              out_row[iw] += col_row[iw];
+            }
+          } else {
+            for (index_t iw = 0; iw < count; ++iw) {
+              out_row[iw * strides[1]] += col_row[iw];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+}  // namespace
+
+index_t Deconv2dBufferSize(const index_t *in_shape,
+                           const index_t *filter_shape) {
+  const index_t filter_size =
+      filter_shape[0] * filter_shape[1] * filter_shape[2] * filter_shape[3];
+  const index_t columns_size = kChannelBlock * filter_shape[2]
+      * filter_shape[3] * TileRows(in_shape, filter_shape) * in_shape[3];
+  return filter_size + GetOpenMPMaxThreads() * columns_size;
+}
+
+void Deconv2d(const float *input,
+              const float *filter,
+              const float *bias,
+              const index_t *in_shape,
+              const index_t *filter_shape,
+              const index_t *out_shape,
+              const int *strides,
+              const int *padding,
+              const ActivationType activation,
+              const float relux_max_limit,
+              float *buffer,
+              float *output) {
+  const index_t out_channels = filter_shape[0];
+  const index_t in_channels = filter_shape[1];
+  const index_t kernel_size = filter_shape[2] * filter_shape[3];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t in_image_size = in_height * in_width;
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t kernel_hw[2] = {filter_shape[2], filter_shape[3]};
+  // output[s * i + f - pad] is input[i] * filter[f]
+  const index_t pad_hw[2] = {filter_shape[2] - 1 - padding[0],
+                             filter_shape[3] - 1 - padding[1]};
+  const index_t tile_rows = TileRows(in_shape, filter_shape);
+  const index_t columns_size =
+      kChannelBlock * kernel_size * tile_rows * in_width;
+  ColumnsFunc columns_func = Columns;
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuSupportsAvx2()) {
+    columns_func = ColumnsAvx2;
+  }
+#endif
+
+  // [O][I][H][W] => [O][H][W][I], one row of the gemm per filter tap
+  float *packed_filter = buffer;
+  float *columns_buffer = buffer + out_channels * in_channels * kernel_size;
+#pragma omp parallel for collapse(2)
+  for (index_t o = 0; o < out_channels; ++o) {
+    for (index_t i = 0; i < in_channels; ++i) {
+      for (index_t k = 0; k < kernel_size; ++k) {
+        packed_filter[(o * kernel_size + k) * in_channels + i] =
+            filter[(o * in_channels + i) * kernel_size + k];
+      }
+    }
+  }
+
+  const index_t channel_blocks = RoundUpDiv(out_channels, kChannelBlock);
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < in_shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      const index_t o_begin = cb * kChannelBlock;
+      const index_t channels =
+          std::min(out_channels, o_begin + kChannelBlock) - o_begin;
+      const float *in_base = input + b * in_channels * in_image_size;
+      float *out_base = output + (b * out_channels + o_begin) * out_image_size;
+      float *columns = columns_buffer + GetOpenMPThreadNum() * columns_size;
+
+      for (index_t c = 0; c < channels; ++c) {
+        std::fill_n(out_base + c * out_image_size, out_image_size,
+                    bias == nullptr ? 0.f : bias[o_begin + c]);
+      }
+      for (index_t row_begin = 0; row_begin < in_height;
+           row_begin += tile_rows) {
+        const index_t row_end = std::min(in_height, row_begin + tile_rows);
+        columns_func(packed_filter + o_begin * kernel_size * in_channels,
+                     in_base + row_begin * in_width, channels * kernel_size,
+                     in_channels, in_image_size,
+                     (row_end - row_begin) * in_width, columns);
+        Col2Im(columns, channels, kernel_hw, strides, pad_hw, in_width,
+               row_begin, row_end, out_shape[2], out_shape[3], out_base);
+      }
+      DoActivation(out_base, out_base, channels * out_image_size, activation,
+                   relux_max_limit);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -37,6 +37,7 @@ namespace kernels {
 
 namespace deconv {
 
+// Reference implementation, the CPU functor runs Deconv2d below.
 template<typename T>
 void Deconv2dNCHW(const T *input,
                   const T *filter,
@@ -89,6 +90,28 @@ void Deconv2dNCHW(const T *input,
 }
 }  // namespace deconv
 
+// Number of floats Deconv2d needs in its buffer, for all threads.
+index_t Deconv2dBufferSize(const index_t *in_shape,
+                           const index_t *filter_shape);
+
+// Transposed convolution as a gemm of the filter taps with the input
+// followed by col2im: a few input rows at a time the columns of four output
+// channels are computed and scattered into their planes, which start from
+// the bias and get the activation once complete. input and output are
+// NCHW, filter is OIHW and padding is the one Deconv2dNCHW takes.
+void Deconv2d(const float *input,
+              const float *filter,
+              const float *bias,
+              const index_t *in_shape,
+              const index_t *filter_shape,
+              const index_t *out_shape,
+              const int *strides,
+              const int *padding,
+              const ActivationType activation,
+              const float relux_max_limit,
+              float *buffer,
+              float *output);
+
 struct Deconv2dFunctorBase {
   Deconv2dFunctorBase(const int *strides,
                       const Padding &padding_type,
@@ -212,19 +235,24 @@ struct Deconv2dFunctorBase {
 };
 
 template <DeviceType D, typename T>
-struct Deconv2dFunctor : Deconv2dFunctorBase {
+struct Deconv2dFunctor;
+
+template <>
+struct Deconv2dFunctor<DeviceType::CPU, float> : Deconv2dFunctorBase {
   Deconv2dFunctor(const int *strides,
                   const Padding &padding_type,
                   const std::vector<int> &paddings,
                   const std::vector<index_t> &output_shape,
                   const ActivationType activation,
-                  const float relux_max_limit)
+                  const float relux_max_limit,
+                  ScratchBuffer *scratch)
       : Deconv2dFunctorBase(strides,
                             padding_type,
                             paddings,
                             output_shape,
                             activation,
-                            relux_max_limit) {}
+                            relux_max_limit),
+        scratch_(scratch) {}
 
   MaceStatus operator()(const Tensor *input,   // NCHW
                   const Tensor *filter,  // OIHW
@@ -272,35 +300,40 @@ struct Deconv2dFunctor : Deconv2dFunctorBase {
     MACE_CHECK(filter->dim(1) == in_shape[1], filter->dim(1), " != ",
                in_shape[1]);
     MACE_CHECK(in_shape[0] == out_shape[0], "Input/Output batch size mismatch");
+    const index_t buffer_size =
+        Deconv2dBufferSize(in_shape, filter->shape().data()) * sizeof(float);
+    scratch_->Rewind();
+    MACE_RETURN_IF_ERROR(scratch_->GrowSize(buffer_size));
+    Tensor buffer(scratch_->Scratch(buffer_size), DT_FLOAT);
+
     Tensor::MappingGuard input_mapper(input);
     Tensor::MappingGuard filter_mapper(filter);
     Tensor::MappingGuard bias_mapper(bias);
     Tensor::MappingGuard output_mapper(output);
-    auto input_data = input->data<T>();
-    auto filter_data = filter->data<T>();
-    auto bias_data = bias == nullptr ? nullptr : bias->data<T>();
-    auto output_data = output->mutable_data<T>();
+    auto input_data = input->data<float>();
+    auto filter_data = filter->data<float>();
+    auto bias_data = bias == nullptr ? nullptr : bias->data<float>();
+    auto output_data = output->mutable_data<float>();
     int padding[2];
     padding[0] = (paddings_[0] + 1) >> 1;
     padding[1] = (paddings_[1] + 1) >> 1;
-    deconv::Deconv2dNCHW(input_data,
-                         filter_data,
-                         bias_data,
-                         in_shape,
-                         out_shape,
-                         kernel_hw,
-                         strides_,
-                         padding,
-                         output_data);
-
-    DoActivation(output_data,
-                 output_data,
-                 output->size(),
-                 activation_,
-                 relux_max_limit_);
+    Deconv2d(input_data,
+             filter_data,
+             bias_data,
+             in_shape,
+             filter->shape().data(),
+             out_shape,
+             strides_,
+             padding,
+             activation_,
+             relux_max_limit_,
+             buffer.mutable_data<float>(),
+             output_data);
 
     return MACE_SUCCESS;
   }
+
+  ScratchBuffer *scratch_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
@@ -311,13 +344,16 @@ struct Deconv2dFunctor<DeviceType::GPU, T> : Deconv2dFunctorBase {
                   const std::vector<int> &paddings,
                   const std::vector<index_t> &output_shape,
                   const ActivationType activation,
-                  const float relux_max_limit)
+                  const float relux_max_limit,
+                  ScratchBuffer *scratch)
       : Deconv2dFunctorBase(strides,
                             padding_type,
                             paddings,
                             output_shape,
                             activation,
-                            relux_max_limit) {}
+                            relux_max_limit) {
+    MACE_UNUSED(scratch);
+  }
 
   MaceStatus operator()(const Tensor *input,
                   const Tensor *filter,
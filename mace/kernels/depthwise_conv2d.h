@@ -25,6 +25,9 @@
 #include "mace/core/future.h"
 #include "mace/kernels/conv_pool_2d_util.h"
 #include "mace/kernels/activation.h"
+#include "mace/kernels/depthwise_conv2d_simd.h"
+#include "mace/kernels/nchwc.h"
+#include "mace/kernels/nhwc.h"
 #include "mace/kernels/arm/depthwise_conv2d_neon.h"
 #include "mace/public/mace.h"
 
@@ -68,13 +71,16 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                          const std::vector<int> &paddings,
                          const int *dilations,
                          const ActivationType activation,
-                         const float relux_max_limit)
+                         const float relux_max_limit,
+                         const DataFormat data_format)
     : DepthwiseConv2dFunctorBase(strides,
                                  padding_type,
                                  paddings,
                                  dilations,
                                  activation,
-                                 relux_max_limit) {}
+                                 relux_max_limit),
+      is_reordered_filter_ready_(false),
+      data_format_(data_format) {}
 
   void DepthwiseConv2dGeneral(const float *input,
                               const float *filter,
@@ -127,6 +133,131 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
     }
   }
 
+  // input and output are blocked NCHWc tensors, only channel multiplier 1
+  // is supported.
+  MaceStatus DepthwiseConv2dNCHWcLayout(const Tensor *input,
+                                        const Tensor *filter,
+                                        const Tensor *bias,
+                                        Tensor *output) {
+    const std::vector<index_t> in_shape = NCHWShape(input->shape());
+    MACE_CHECK(filter->dim(0) == 1 && filter->dim(1) == in_shape[1],
+               "NCHWc depthwise convolution needs multiplier 1");
+    std::vector<index_t> output_shape(4);
+    std::vector<int> paddings(2);
+    std::vector<index_t> filter_shape
+      {filter->dim(1), filter->dim(1), filter->dim(2), filter->dim(3)};
+    if (paddings_.empty()) {
+      CalcNCHWPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape.data(),
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   output_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcNCHWOutputSize(in_shape.data(),
+                         filter_shape.data(),
+                         paddings_.data(),
+                         dilations_,
+                         strides_,
+                         RoundType::FLOOR,
+                         output_shape.data());
+    }
+    MACE_RETURN_IF_ERROR(output->Resize(NCHWcShape(output_shape)));
+
+    Tensor::MappingGuard filter_guard(filter);
+    if (!is_reordered_filter_ready_) {
+      MACE_RETURN_IF_ERROR(reordered_filter_.Resize(filter->shape()));
+      ReorderDepthwiseFilterToNCHWc(filter->data<float>(),
+                                    filter->shape().data(),
+                                    reordered_filter_.mutable_data<float>());
+      is_reordered_filter_ready_ = true;
+    }
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard output_guard(output);
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+    float *output_data = output->mutable_data<float>();
+    DepthwiseConv2dNCHWc(input->data<float>(),
+                         reordered_filter_.data<float>(),
+                         bias == nullptr ? nullptr : bias->data<float>(),
+                         in_shape.data(),
+                         output_shape.data(),
+                         filter_shape.data(),
+                         strides_,
+                         dilations_,
+                         pad_hw,
+                         output_data);
+    DoActivation(output_data, output_data, output->size(), activation_,
+                 relux_max_limit_);
+    return MACE_SUCCESS;
+  }
+
+  // input and output are NHWC, channels of a pixel are multiplied by the
+  // filter taps reordered to [H][W][C * M].
+  MaceStatus DepthwiseConv2dNHWCLayout(const Tensor *input,
+                                       const Tensor *filter,
+                                       const Tensor *bias,
+                                       Tensor *output) {
+    const std::vector<index_t> &in_shape = input->shape();
+    MACE_CHECK(filter->dim(1) == in_shape[3], filter->dim(1), " != ",
+               in_shape[3]);
+    std::vector<index_t> output_shape(4);
+    std::vector<int> paddings(2);
+    std::vector<index_t> filter_shape
+      {filter->dim(0) * filter->dim(1), filter->dim(1), filter->dim(2),
+       filter->dim(3)};
+    if (paddings_.empty()) {
+      CalcNHWCPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape.data(),
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   output_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcOutputSize(in_shape.data(),
+                     filter_shape.data(),
+                     paddings_.data(),
+                     dilations_,
+                     strides_,
+                     RoundType::FLOOR,
+                     output_shape.data());
+    }
+    MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+
+    Tensor::MappingGuard filter_guard(filter);
+    if (!is_reordered_filter_ready_) {
+      MACE_RETURN_IF_ERROR(reordered_filter_.Resize(filter->shape()));
+      ReorderDepthwiseFilterToNHWC(filter->data<float>(),
+                                   filter->shape().data(),
+                                   reordered_filter_.mutable_data<float>());
+      is_reordered_filter_ready_ = true;
+    }
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard bias_guard(bias);
+    Tensor::MappingGuard output_guard(output);
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+    float *output_data = output->mutable_data<float>();
+    DepthwiseConv2dNHWC(input->data<float>(),
+                        reordered_filter_.data<float>(),
+                        bias == nullptr ? nullptr : bias->data<float>(),
+                        in_shape.data(),
+                        output_shape.data(),
+                        filter_shape.data(),
+                        strides_,
+                        dilations_,
+                        pad_hw,
+                        output_data);
+    DoActivation(output_data, output_data, output->size(), activation_,
+                 relux_max_limit_);
+    return MACE_SUCCESS;
+  }
+
   MaceStatus operator()(const Tensor *input,
                   const Tensor *filter,
                   const Tensor *bias,
@@ -137,6 +268,12 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
     MACE_CHECK_NOTNULL(filter);
     MACE_CHECK_NOTNULL(output);
 
+    if (input->dim_size() == 5) {
+      return DepthwiseConv2dNCHWcLayout(input, filter, bias, output);
+    } else if (data_format_ == NHWC) {
+      return DepthwiseConv2dNHWCLayout(input, filter, bias, output);
+    }
+
     std::vector<index_t> output_shape(4);
     std::vector<int> paddings(2);
     std::vector<index_t> filter_shape
@@ -162,7 +299,6 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                          output_shape.data());
     }
     MACE_RETURN_IF_ERROR(output->Resize(output_shape));
-    output->Clear();
 
     index_t batch = output->dim(0);
     index_t channels = output->dim(1);
@@ -217,8 +353,22 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
     const index_t input_shape[4] =
         {batch, input_channels, input_height, input_width};
 
-    if (filter_h == 3 && filter_w == 3 && stride_h == 1 && stride_w == 1
-      && dilation_h == 1 && dilation_w == 1) {
+    // the neon 3x3 kernels accumulate into the output and are scalar
+    // without neon, the simd kernels write it
+    bool use_neon_3x3 = false;
+#if defined(MACE_ENABLE_NEON)
+    use_neon_3x3 = filter_h == 3 && filter_w == 3
+      && ((stride_h == 1 && stride_w == 1) || (stride_h == 2 && stride_w == 2))
+      && dilation_h == 1 && dilation_w == 1;
+#endif
+    DepthwiseConv2dSimdFunc simd_func =
+      DepthwiseConv2dSimdKernel(filter_h, filter_w, stride_h, stride_w);
+
+    if (use_neon_3x3) {
+      output->Clear();
+    }
+
+    if (use_neon_3x3 && stride_h == 1) {
       conv_func = [=](const float *input, float *output) {
         DepthwiseConv2dNeonK3x3S1(input,
                                   filter_data,
@@ -231,8 +381,7 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                                   valid_w_stop,
                                   output);
       };
-    } else if (filter_h == 3 && filter_w == 3 && stride_h == 2 && stride_w == 2
-      && dilation_h == 1 && dilation_w == 1) {
+    } else if (use_neon_3x3) {
       conv_func = [=](const float *input, float *output) {
         DepthwiseConv2dNeonK3x3S2(input,
                                   filter_data,
@@ -245,6 +394,16 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                                   valid_w_stop,
                                   output);
       };
+    } else if (simd_func != nullptr) {
+      conv_func = [=](const float *input, float *output) {
+        simd_func(input,
+                  filter_data,
+                  input_shape,
+                  output_shape.data(),
+                  dilations_,
+                  pad_hw,
+                  output);
+      };
     } else {
       conv_func = [=](const float *input, float *output) {
         DepthwiseConv2dGeneral(input,
@@ -278,6 +437,11 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
 
     return MACE_SUCCESS;
   }
+
+  // filter reordered for the NCHWc or NHWC kernel
+  Tensor reordered_filter_;
+  bool is_reordered_filter_ready_;
+  const DataFormat data_format_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
@@ -289,13 +453,17 @@ struct DepthwiseConv2dFunctor<DeviceType::GPU, T>
                          const std::vector<int> &paddings,
                          const int *dilations,
                          const ActivationType activation,
-                         const float relux_max_limit)
+                         const float relux_max_limit,
+                         const DataFormat data_format)
     : DepthwiseConv2dFunctorBase(strides,
                                  padding_type,
                                  paddings,
                                  dilations,
                                  activation,
-                                 relux_max_limit) {}
+                                 relux_max_limit) {
+    // images are always NHWC
+    MACE_UNUSED(data_format);
+  }
 
   MaceStatus operator()(const Tensor *input,
                   const Tensor *filter,
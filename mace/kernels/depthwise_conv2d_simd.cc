@@ -0,0 +1,397 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+
+#include "mace/kernels/depthwise_conv2d_simd.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// Eight outputs of a row are computed at once, one per lane.
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+typedef int BlockIndex __attribute__((vector_size(32)));
+const int kBlockSize = 8;
+// Blocks summed together, so each fma does not wait for the previous one.
+const int kUnrollBlocks = 4;
+// Planes padded within 16KB stay in l1 cache.
+const index_t kMaxPaddedPlaneSize = 4096;
+
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+// Eight inputs stride apart, reading nothing past the last of them.
+template <int S>
+__attribute__((always_inline))
+inline void LoadBlock(const float *ptr, Block *block);
+
+template <>
+__attribute__((always_inline))
+inline void LoadBlock<1>(const float *ptr, Block *block) {
+  *block = AsBlock(ptr);
+}
+
+template <>
+__attribute__((always_inline))
+inline void LoadBlock<2>(const float *ptr, Block *block) {
+#if defined(__clang__)
+  *block = __builtin_shufflevector(AsBlock(ptr), AsBlock(ptr + 7),
+                                   0, 2, 4, 6, 9, 11, 13, 15);
+#else
+  const BlockIndex even = {0, 2, 4, 6, 9, 11, 13, 15};
+  *block = __builtin_shuffle(AsBlock(ptr), AsBlock(ptr + 7), even);
+#endif
+}
+
+struct DepthwisePlan {
+  index_t in_height;
+  index_t in_width;
+  index_t out_height;
+  index_t out_width;
+  int dilation_h;
+  int dilation_w;
+  int pad_top;
+  int pad_left;
+};
+
+// First output past those whose window ends inside the input, at least
+// begin.
+index_t InteriorEnd(const index_t in_size,
+                    const index_t taps,
+                    const int dilation,
+                    const int stride,
+                    const int pad,
+                    const index_t out_size,
+                    const index_t begin) {
+  const index_t last_start = in_size - (taps - 1) * dilation - 1 + pad;
+  if (last_start < 0) {
+    return begin;
+  }
+  return std::max(begin, std::min(out_size, last_start / stride + 1));
+}
+
+template <int K>
+inline float BorderPixel(const DepthwisePlan &plan,
+                         const float *input,
+                         const float *filter,
+                         const index_t in_h,
+                         const index_t in_w) {
+  float sum = 0;
+  for (int kh = 0; kh < K; ++kh) {
+    const index_t h = in_h + kh * plan.dilation_h;
+    if (h < 0 || h >= plan.in_height) continue;
+    for (int kw = 0; kw < K; ++kw) {
+      const index_t w = in_w + kw * plan.dilation_w;
+      if (w >= 0 && w < plan.in_width) {
+        sum += input[h * plan.in_width + w] * filter[kh * K + kw];
+      }
+    }
+  }
+  return sum;
+}
+
+// U blocks of a row, input points at the window of the first output.
+template <int K, int S, int U>
+__attribute__((always_inline))
+inline void InteriorBlocks(const float *input,
+                           const index_t in_width,
+                           const int dilation_h,
+                           const int dilation_w,
+                           const float *filter,
+                           float *output) {
+  Block sum[U] = {};
+  for (int kh = 0; kh < K; ++kh) {
+    const float *in_row = input + kh * dilation_h * in_width;
+    for (int kw = 0; kw < K; ++kw) {
+      const float *in = in_row + kw * dilation_w;
+      const float f = filter[kh * K + kw];
+      for (int u = 0; u < U; ++u) {
+        Block in_block;
+        LoadBlock<S>(in + u * kBlockSize * S, &in_block);
+        sum[u] += in_block * f;
+      }
+    }
+  }
+  for (int u = 0; u < U; ++u) {
+    AsBlock(output + u * kBlockSize) = sum[u];
+  }
+}
+
+// count >= kBlockSize outputs of a row whose windows are all inside the
+// input; the last block overlaps the previous one instead of a scalar tail.
+template <int K, int S>
+__attribute__((always_inline))
+inline void InteriorRow(const float *input,
+                        const index_t in_width,
+                        const int dilation_h,
+                        const int dilation_w,
+                        const float *filter,
+                        const index_t count,
+                        float *output) {
+  index_t w = 0;
+  for (; w + kUnrollBlocks * kBlockSize <= count;
+       w += kUnrollBlocks * kBlockSize) {
+    InteriorBlocks<K, S, kUnrollBlocks>(input + w * S, in_width, dilation_h,
+                                        dilation_w, filter, output + w);
+  }
+  for (; w + kBlockSize <= count; w += kBlockSize) {
+    InteriorBlocks<K, S, 1>(input + w * S, in_width, dilation_h, dilation_w,
+                            filter, output + w);
+  }
+  if (w < count) {
+    w = count - kBlockSize;
+    InteriorBlocks<K, S, 1>(input + w * S, in_width, dilation_h, dilation_w,
+                            filter, output + w);
+  }
+}
+
+// Rows small enough are copied into a zero padded buffer, so the border
+// outputs are computed by the vector code too and rows shorter than a block
+// are padded to one.
+template <int K, int S>
+__attribute__((always_inline))
+inline void PaddedRows(const DepthwisePlan &plan,
+                       const index_t out_begin,
+                       const index_t out_end,
+                       const index_t padded_height,
+                       const index_t padded_width,
+                       const float *input,
+                       const float *filter,
+                       float *output) {
+  float padded[kMaxPaddedPlaneSize];
+  memset(padded, 0, padded_height * padded_width * sizeof(float));
+  const index_t in_begin = out_begin * S - plan.pad_top;
+  const index_t copy_width = std::max<index_t>(
+      0, std::min(plan.in_width, padded_width - plan.pad_left));
+  for (index_t h = std::max<index_t>(0, -in_begin);
+       h < padded_height && in_begin + h < plan.in_height; ++h) {
+    memcpy(padded + h * padded_width + plan.pad_left,
+           input + (in_begin + h) * plan.in_width,
+           copy_width * sizeof(float));
+  }
+
+  float row[kBlockSize];
+  for (index_t h = 0; h < out_end - out_begin; ++h) {
+    const float *in_row = padded + h * S * padded_width;
+    float *out_row = output + h * plan.out_width;
+    if (plan.out_width >= kBlockSize) {
+      InteriorRow<K, S>(in_row, padded_width, plan.dilation_h,
+                        plan.dilation_w, filter, plan.out_width, out_row);
+    } else {
+      InteriorBlocks<K, S, 1>(in_row, padded_width, plan.dilation_h,
+                              plan.dilation_w, filter, row);
+      memcpy(out_row, row, plan.out_width * sizeof(float));
+    }
+  }
+}
+
+// Output rows [out_begin, out_end) of a plane, output points at the first.
+template <int K, int S>
+__attribute__((always_inline))
+inline void DepthwiseRowsImpl(const DepthwisePlan &plan,
+                              const index_t out_begin,
+                              const index_t out_end,
+                              const float *input,
+                              const float *filter,
+                              float *output) {
+  // input the vector code reads for whole blocks of outputs
+  const index_t padded_height =
+      (out_end - out_begin - 1) * S + (K - 1) * plan.dilation_h + 1;
+  const index_t padded_width =
+      (RoundUp<index_t>(plan.out_width, kBlockSize) - 1) * S
+          + (K - 1) * plan.dilation_w + 1;
+  if (padded_height * padded_width <= kMaxPaddedPlaneSize) {
+    PaddedRows<K, S>(plan, out_begin, out_end, padded_height, padded_width,
+                     input, filter, output);
+    return;
+  }
+
+  const index_t h_begin =
+      std::min<index_t>(plan.out_height, RoundUpDiv(plan.pad_top, S));
+  const index_t h_end = InteriorEnd(plan.in_height, K, plan.dilation_h, S,
+                                    plan.pad_top, plan.out_height, h_begin);
+  const index_t w_begin =
+      std::min<index_t>(plan.out_width, RoundUpDiv(plan.pad_left, S));
+  const index_t w_end = InteriorEnd(plan.in_width, K, plan.dilation_w, S,
+                                    plan.pad_left, plan.out_width, w_begin);
+
+  for (index_t h = out_begin; h < out_end; ++h) {
+    float *out_row = output + (h - out_begin) * plan.out_width;
+    const index_t in_h = h * S - plan.pad_top;
+    if (h < h_begin || h >= h_end || w_end - w_begin < kBlockSize) {
+      for (index_t w = 0; w < plan.out_width; ++w) {
+        out_row[w] = BorderPixel<K>(plan, input, filter, in_h,
+                                    w * S - plan.pad_left);
+      }
+      continue;
+    }
+
+    for (index_t w = 0; w < w_begin; ++w) {
+      out_row[w] = BorderPixel<K>(plan, input, filter, in_h,
+                                  w * S - plan.pad_left);
+    }
+    InteriorRow<K, S>(input + (in_h * plan.in_width + w_begin * S
+                                   - plan.pad_left),
+                      plan.in_width, plan.dilation_h, plan.dilation_w,
+                      filter, w_end - w_begin, out_row + w_begin);
+    for (index_t w = w_end; w < plan.out_width; ++w) {
+      out_row[w] = BorderPixel<K>(plan, input, filter, in_h,
+                                  w * S - plan.pad_left);
+    }
+  }
+}
+
+template <int K, int S>
+void DepthwiseRows(const DepthwisePlan &plan,
+                   const index_t out_begin,
+                   const index_t out_end,
+                   const float *input,
+                   const float *filter,
+                   float *output) {
+  DepthwiseRowsImpl<K, S>(plan, out_begin, out_end, input, filter, output);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <int K, int S>
+MACE_AVX2_TARGET void DepthwiseRowsAvx2(const DepthwisePlan &plan,
+                                        const index_t out_begin,
+                                        const index_t out_end,
+                                        const float *input,
+                                        const float *filter,
+                                        float *output) {
+  DepthwiseRowsImpl<K, S>(plan, out_begin, out_end, input, filter, output);
+}
+#endif
+
+typedef void (*DepthwiseRowsFunc)(const DepthwisePlan &plan,
+                                  const index_t out_begin,
+                                  const index_t out_end,
+                                  const float *input,
+                                  const float *filter,
+                                  float *output);
+
+template <int K, int S>
+DepthwiseRowsFunc SelectDepthwiseRows() {
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuSupportsAvx2()) {
+    return DepthwiseRowsAvx2<K, S>;
+  }
+#endif
+  return DepthwiseRows<K, S>;
+}
+
+template <int K, int S>
+void DepthwiseConv2dSimd(const float *input,
+                         const float *filter,
+                         const index_t *in_shape,
+                         const index_t *out_shape,
+                         const int *dilation_hw,
+                         const int *pad_hw,
+                         float *output) {
+  const DepthwisePlan plan = {in_shape[2], in_shape[3],
+                              out_shape[2], out_shape[3],
+                              dilation_hw[0], dilation_hw[1],
+                              pad_hw[0], pad_hw[1]};
+  const DepthwiseRowsFunc rows_func = SelectDepthwiseRows<K, S>();
+
+  const index_t in_channels = in_shape[1];
+  const index_t out_channels = out_shape[1];
+  const index_t multiplier = out_channels / in_channels;
+  const index_t in_image_size = plan.in_height * plan.in_width;
+  const index_t out_image_size = plan.out_height * plan.out_width;
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t m = 0; m < out_channels; ++m) {
+      const index_t c = m / multiplier;
+      const index_t o = m % multiplier;
+      rows_func(plan, 0, plan.out_height,
+                input + (b * in_channels + c) * in_image_size,
+                filter + (o * in_channels + c) * K * K,
+                output + (b * out_channels + m) * out_image_size);
+    }
+  }
+}
+
+template <int K, int S>
+void DepthwiseConv2dRowsSimd(const float *input,
+                             const float *filter,
+                             const index_t *in_hw,
+                             const index_t *out_hw,
+                             const int *dilation_hw,
+                             const int *pad_hw,
+                             const index_t out_begin,
+                             const index_t out_end,
+                             float *output) {
+  const DepthwisePlan plan = {in_hw[0], in_hw[1], out_hw[0], out_hw[1],
+                              dilation_hw[0], dilation_hw[1],
+                              pad_hw[0], pad_hw[1]};
+  SelectDepthwiseRows<K, S>()(plan, out_begin, out_end, input, filter,
+                              output);
+}
+
+// Index into the kernel tables, or -1 if there is no kernel.
+int KernelIndex(const index_t filter_height,
+                const index_t filter_width,
+                const int stride_height,
+                const int stride_width) {
+  if (filter_height != filter_width || stride_height != stride_width
+      || (filter_height != 3 && filter_height != 5 && filter_height != 7)
+      || (stride_height != 1 && stride_height != 2)) {
+    return -1;
+  }
+  return static_cast<int>(filter_height - 3) + stride_height - 1;
+}
+}  // namespace
+
+DepthwiseConv2dSimdFunc DepthwiseConv2dSimdKernel(const index_t filter_height,
+                                                  const index_t filter_width,
+                                                  const int stride_height,
+                                                  const int stride_width) {
+  static const DepthwiseConv2dSimdFunc kKernels[] = {
+      DepthwiseConv2dSimd<3, 1>, DepthwiseConv2dSimd<3, 2>,
+      DepthwiseConv2dSimd<5, 1>, DepthwiseConv2dSimd<5, 2>,
+      DepthwiseConv2dSimd<7, 1>, DepthwiseConv2dSimd<7, 2>,
+  };
+  const int index =
+      KernelIndex(filter_height, filter_width, stride_height, stride_width);
+  return index < 0 ? nullptr : kKernels[index];
+}
+
+DepthwiseConv2dRowsSimdFunc DepthwiseConv2dRowsSimdKernel(
+    const index_t filter_height,
+    const index_t filter_width,
+    const int stride_height,
+    const int stride_width) {
+  static const DepthwiseConv2dRowsSimdFunc kKernels[] = {
+      DepthwiseConv2dRowsSimd<3, 1>, DepthwiseConv2dRowsSimd<3, 2>,
+      DepthwiseConv2dRowsSimd<5, 1>, DepthwiseConv2dRowsSimd<5, 2>,
+      DepthwiseConv2dRowsSimd<7, 1>, DepthwiseConv2dRowsSimd<7, 2>,
+  };
+  const int index =
+      KernelIndex(filter_height, filter_width, stride_height, stride_width);
+  return index < 0 ? nullptr : kKernels[index];
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,66 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_DEPTHWISE_CONV2D_SIMD_H_
+#define MACE_KERNELS_DEPTHWISE_CONV2D_SIMD_H_
+
+#include "mace/core/types.h"
+
+// Depthwise convolution on NCHW vectorized along the output width, for 3x3,
+// 5x5 and 7x7 filters at stride 1 or 2 and any dilation. Outputs whose
+// window lies inside the input are computed eight at a time without bounds
+// checks, only the border ones check every tap; planes that fit in l1 once
+// zero padded are copied so that all their outputs take the vector path.
+
+namespace mace {
+namespace kernels {
+
+// filter is [multiplier][C][H][W], output is written, not accumulated.
+typedef void (*DepthwiseConv2dSimdFunc)(const float *input,
+                                        const float *filter,
+                                        const index_t *in_shape,
+                                        const index_t *out_shape,
+                                        const int *dilation_hw,
+                                        const int *pad_hw,
+                                        float *output);
+
+// Return the kernel for the filter and strides, or nullptr if there is none.
+DepthwiseConv2dSimdFunc DepthwiseConv2dSimdKernel(const index_t filter_height,
+                                                  const index_t filter_width,
+                                                  const int stride_height,
+                                                  const int stride_width);
+
+// Output rows [out_begin, out_end) of the plane of one channel, filter holds
+// the taps of the channel and output points at row out_begin; in_hw and
+// out_hw are the plane sizes.
+typedef void (*DepthwiseConv2dRowsSimdFunc)(const float *input,
+                                            const float *filter,
+                                            const index_t *in_hw,
+                                            const index_t *out_hw,
+                                            const int *dilation_hw,
+                                            const int *pad_hw,
+                                            const index_t out_begin,
+                                            const index_t out_end,
+                                            float *output);
+
+DepthwiseConv2dRowsSimdFunc DepthwiseConv2dRowsSimdKernel(
+    const index_t filter_height,
+    const index_t filter_width,
+    const int stride_height,
+    const int stride_width);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_DEPTHWISE_CONV2D_SIMD_H_
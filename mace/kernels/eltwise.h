@@ -845,6 +845,10 @@ struct EltwiseFunctor : EltwiseFunctorBase {
                (input1->dim_size() == 1 && input1->dim(0) == input0->dim(1))),
           "only support broadcast channel dimension");
     } else {
+      // the channels of blocked tensors are split over two dims
+      MACE_CHECK(data_format_ != NCHWc || input1->size() <= 1 ||
+                     input1->shape() == input0->shape(),
+                 "NCHWc only supports scalar or same shape operands");
       for (uint32_t i = 0; i < input1->dim_size(); ++i) {
         MACE_CHECK(input0->dim(rank_diff + i) == 1 || input1->dim(i) == 1 ||
                        input0->dim(rank_diff + i) == input1->dim(i),
@@ -17,6 +17,7 @@
 
 #include "mace/core/tensor.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/x86/jit_gemm.h"
 
 #if defined(MACE_ENABLE_NEON)
 #include <arm_neon.h>
@@ -30,6 +31,9 @@ namespace mace {
 namespace kernels {
 
 namespace {
+// block size set for the gemm calls of each thread, 0 for the default
+thread_local index_t gemm_block_size = 0;
+
 inline void GemmBlock(const float *A,
                       const float *B,
                       const index_t height,
@@ -1245,6 +1249,24 @@ inline void GemmTile(const float *A,
     }
   }
 #else
+  // whole tiles run the kernel generated for the depth and strides
+  JitGemmTileFunc jit_func = GemmJitEnabled()
+      ? JitGemmTileKernel(K, stride_a, stride_b, stride_c) : nullptr;
+  if (jit_func != nullptr) {
+    const index_t jit_height =
+        height / kJitGemmTileHeight * kJitGemmTileHeight;
+    const index_t jit_width = width / kJitGemmTileWidth * kJitGemmTileWidth;
+    for (index_t h = 0; h < jit_height; h += kJitGemmTileHeight) {
+      for (index_t w = 0; w < jit_width; w += kJitGemmTileWidth) {
+        jit_func(A + h * stride_a, B + w, C + h * stride_c + w);
+      }
+    }
+    GemmBlock(A, B + jit_width, jit_height, K, width - jit_width, stride_a,
+              stride_b, stride_c, C + jit_width);
+    GemmBlock(A + jit_height * stride_a, B, height - jit_height, K, width,
+              stride_a, stride_b, stride_c, C + jit_height * stride_c);
+    return;
+  }
   GemmBlock(A, B, height, K, width, stride_a, stride_b, stride_c, C);
 #endif  // MACE_ENABLE_NEON
 }
@@ -1261,21 +1283,53 @@ void Transpose(const float *src,
   }
 }
 
-}  // namespace
+// B[k, iw_begin:iw_end] -> packed[k - ik_begin, :] for k in [ik_begin,
+// ik_end), reading column j of B at the strided pixel j of the image.
+void PackImageBlock(const float *images,
+                    const GemmImage &image,
+                    const index_t ik_begin,
+                    const index_t ik_end,
+                    const index_t iw_begin,
+                    const index_t iw_end,
+                    float *packed) {
+  const index_t image_size = image.height * image.width;
+  const index_t len = iw_end - iw_begin;
+  for (index_t k = ik_begin; k < ik_end; ++k) {
+    const float *in = images + k * image_size;
+    float *out = packed + (k - ik_begin) * len;
+    index_t h = iw_begin / image.out_width;
+    index_t w = iw_begin % image.out_width;
+    for (index_t j = 0; j < len; ++h, w = 0) {
+      const float *in_row =
+          in + h * image.strides[0] * image.width + w * image.strides[1];
+      const index_t row_len = std::min(image.out_width - w, len - j);
+      for (index_t i = 0; i < row_len; ++i) {
+        out[j + i] = in_row[i * image.strides[1]];
+      }
+      j += row_len;
+    }
+  }
+}
 
-// A: height x K, B: K x width, C: height x width
-void Gemm(const float *A,
-          const float *B,
-          const index_t batch,
-          const index_t height,
-          const index_t K,
-          const index_t width,
-          float *C,
-          const bool transpose_a,
-          const bool transpose_b) {
-  if (width == 1) {
+// Batches of A and B start batch_stride_a and batch_stride_b apart, B is
+// read through image if it is not null.
+void GemmImpl(const float *A,
+              const index_t batch_stride_a,
+              const float *B,
+              const index_t batch_stride_b,
+              const GemmImage *image,
+              const index_t batch,
+              const index_t height,
+              const index_t K,
+              const index_t width,
+              float *C,
+              const bool transpose_a,
+              const bool transpose_b,
+              ThreadScratchBuffer *scratch) {
+  if (width == 1 && image == nullptr) {
     for (index_t b = 0; b < batch; ++b) {
-      Gemv(A + b * height * K, B + b * K, 1, K, height, C + b * height);
+      Gemv(A + b * batch_stride_a, B + b * batch_stride_b, 1, K, height,
+           C + b * height);
     }
     return;
   }
@@ -1286,7 +1340,8 @@ void Gemm(const float *A,
   // the block size should be sqrt(32k / sizeof(T) / 3).
   // As number of input channels of convolution is normally power of 2, and
   // we have not optimized tiling remains, we use the following magic number
-  const index_t block_size = 64;
+  // unless the cpu tuner picked another one for the layer
+  const index_t block_size = gemm_block_size > 0 ? gemm_block_size : 64;
   const index_t block_tile_height = RoundUpDiv(height, block_size);
   const index_t block_tile_width = RoundUpDiv(width, block_size);
   const index_t block_tile_k = RoundUpDiv(K, block_size);
@@ -1297,12 +1352,22 @@ void Gemm(const float *A,
   const index_t remain_k = K % block_size;
   const index_t remain[3] = {remain_height, remain_width, remain_k};
 
+  // transposed blocks are packed to thread private scratch
+  ThreadScratchBuffer local_scratch(GetDeviceAllocator(DeviceType::CPU));
+  if (scratch == nullptr) {
+    scratch = &local_scratch;
+  }
+  if (transpose_a || transpose_b || image != nullptr) {
+    MACE_CHECK(scratch->GrowSize(2 * block_size * block_size * sizeof(float))
+                   == MaceStatus::MACE_SUCCESS);
+  }
+
 #pragma omp parallel for collapse(3)
   for (index_t n = 0; n < batch; ++n) {
     for (index_t bh = 0; bh < block_tile[0]; ++bh) {
       for (index_t bw = 0; bw < block_tile[1]; ++bw) {
-        const float *a_base = A + n * height * K;
-        const float *b_base = B + n * K * width;
+        const float *a_base = A + n * batch_stride_a;
+        const float *b_base = B + n * batch_stride_b;
         float *c_base = C + n * height * width;
 
         const index_t ih_begin = bh * block_size;
@@ -1321,8 +1386,6 @@ void Gemm(const float *A,
                                      ? remain[2]
                                      : block_size);
 
-          Tensor trans_a;
-          Tensor trans_b;
           const float *real_a = nullptr;
           const float *real_b = nullptr;
           float *real_c = c_base + (ih_begin * width + iw_begin);
@@ -1331,8 +1394,7 @@ void Gemm(const float *A,
           index_t stride_c = width;
 
           if (transpose_a) {
-            trans_a.Resize({block_size, block_size});
-            float *trans_a_data = trans_a.mutable_data<float>();
+            float *trans_a_data = scratch->Scratch<float>();
             // A[K, H] -> A[H, K]
             Transpose(a_base + (ik_begin * height + ih_begin),
                       ik_end - ik_begin, ih_end - ih_begin, height,
@@ -1344,9 +1406,16 @@ void Gemm(const float *A,
             stride_a = K;
           }
 
-          if (transpose_b) {
-            trans_b.Resize({block_size, block_size});
-            float *trans_b_data = trans_b.mutable_data<float>();
+          if (image != nullptr) {
+            float *packed_b_data =
+                scratch->Scratch<float>() + block_size * block_size;
+            PackImageBlock(b_base, *image, ik_begin, ik_end, iw_begin, iw_end,
+                           packed_b_data);
+            real_b = packed_b_data;
+            stride_b = iw_end - iw_begin;
+          } else if (transpose_b) {
+            float *trans_b_data =
+                scratch->Scratch<float>() + block_size * block_size;
             // B[W, K] -> B[K, W]
             Transpose(b_base + (iw_begin * K + ik_begin), iw_end - iw_begin,
                       ik_end - ik_begin, K, trans_b_data);
@@ -1367,6 +1436,47 @@ void Gemm(const float *A,
   }        // n
 }
 
+}  // namespace
+
+index_t GemmBlockSize() {
+  return gemm_block_size;
+}
+
+void SetGemmBlockSize(const index_t block_size) {
+  gemm_block_size = block_size;
+}
+
+// A: height x K, B: K x width, C: height x width
+void Gemm(const float *A,
+          const float *B,
+          const index_t batch,
+          const index_t height,
+          const index_t K,
+          const index_t width,
+          float *C,
+          const bool transpose_a,
+          const bool transpose_b,
+          ThreadScratchBuffer *scratch) {
+  GemmImpl(A, height * K, B, K * width, nullptr, batch, height, K, width, C,
+           transpose_a, transpose_b, scratch);
+}
+
+// A: height x K, B: batch x K x width, C: batch x height x width
+void GemmSharedA(const float *A,
+                 const float *B,
+                 const index_t batch,
+                 const index_t height,
+                 const index_t K,
+                 const index_t width,
+                 float *C,
+                 const GemmImage *image,
+                 ThreadScratchBuffer *scratch) {
+  const index_t batch_stride_b =
+      image == nullptr ? K * width : K * image->height * image->width;
+  GemmImpl(A, 0, B, batch_stride_b, image, batch, height, K, width, C, false,
+           false, scratch);
+}
+
 // A: height x K, B: K x width, C: height x width
 void GemmRef(const float *A,
              const float *B,
@@ -19,6 +19,7 @@
 #include <arm_neon.h>
 #endif
 
+#include "mace/core/buffer.h"
 #include "mace/core/types.h"
 
 namespace mace {
@@ -32,7 +33,37 @@ void Gemm(const float *A,
           const index_t width,
           float *C,
           const bool transpose_a = false,
-          const bool transpose_b = false);
+          const bool transpose_b = false,
+          ThreadScratchBuffer *scratch = nullptr);
+
+// Strided pixels of images read as the columns of a matrix, column j is
+// pixel (j / out_width * strides[0], j % out_width * strides[1]) of the
+// height x width images, one image per row.
+struct GemmImage {
+  index_t height;
+  index_t width;
+  index_t out_width;
+  int strides[2];
+};
+
+// Multiplies A by each of the batch matrices of B, e.g. 1x1 convolution of
+// all images of a batch with one filter. B is packed from image if it is
+// not null.
+void GemmSharedA(const float *A,
+                 const float *B,
+                 const index_t batch,
+                 const index_t height,
+                 const index_t K,
+                 const index_t width,
+                 float *C,
+                 const GemmImage *image = nullptr,
+                 ThreadScratchBuffer *scratch = nullptr);
+
+// Size of the square blocks that the gemm calls of the calling thread split
+// their operands into, 0 for the default size.
+index_t GemmBlockSize();
+
+void SetGemmBlockSize(const index_t block_size);
 
 void GemmRef(const float *A,
              const float *B,
@@ -28,7 +28,8 @@ void GemmTest(index_t batch,
               index_t K,
               index_t M,
               bool transpose_a,
-              bool transpose_b) {
+              bool transpose_b,
+              ThreadScratchBuffer *scratch = nullptr) {
   std::unique_ptr<float[]> A(new float[batch * N * K]);
   std::unique_ptr<float[]> B(new float[batch * K * M]);
   std::unique_ptr<float[]> C(new float[batch * N * M]);
@@ -43,7 +44,7 @@ void GemmTest(index_t batch,
   std::generate(B.get(), B.get() + batch * K * M,
                 [&gen, &nd] { return nd(gen); });
   kernels::Gemm(A.get(), B.get(), batch, N, K, M, C.get(), transpose_a,
-                transpose_b);
+                transpose_b, scratch);
   kernels::GemmRef(A.get(), B.get(), batch, N, K, M, C_ref.get(), transpose_a,
                    transpose_b);
 
@@ -107,6 +108,13 @@ TEST(GEMMTest, UnalignedWithBatch) {
   GemmTest(3, 17, 63, 127, true, true);
 }
 
+TEST(GEMMTest, ThreadScratch) {
+  ThreadScratchBuffer scratch(GetDeviceAllocator(DeviceType::CPU));
+  GemmTest(1, 130, 150, 200, false, true, &scratch);
+  GemmTest(2, 130, 150, 200, true, false, &scratch);
+  GemmTest(3, 17, 63, 127, true, true, &scratch);
+}
+
 TEST(GEMMTest, gemv) {
   GemvTest(1, 17, 63);
   GemvTest(3, 17, 63);
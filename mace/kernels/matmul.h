@@ -40,6 +40,8 @@ namespace kernels {
 
 template <DeviceType D, typename T>
 struct MatMulFunctor {
+  explicit MatMulFunctor(ThreadScratchBuffer *scratch) : scratch_(scratch) {}
+
   MaceStatus operator()(const Tensor *A,
                         const Tensor *B,
                         Tensor *C,
@@ -86,15 +88,21 @@ struct MatMulFunctor {
     memset(c_ptr_base, 0, batch * height * width * sizeof(T));
 
     Gemm(a_ptr_base, b_ptr_base, batch, height, K, width, c_ptr_base,
-         transpose_a, transpose_b);
+         transpose_a, transpose_b, scratch_);
 
     return MACE_SUCCESS;
   }
+
+  ThreadScratchBuffer *scratch_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
 template <typename T>
 struct MatMulFunctor<DeviceType::GPU, T> {
+  explicit MatMulFunctor(ThreadScratchBuffer *scratch) {
+    MACE_UNUSED(scratch);
+  }
+
   MaceStatus operator()(const Tensor *A,
                         const Tensor *B,
                         Tensor *C,
@@ -19,6 +19,7 @@
 
 #include "mace/core/testing/test_benchmark.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/x86/jit_gemm.h"
 
 namespace mace {
 namespace kernels {
@@ -29,17 +30,28 @@ namespace test {
 namespace {
 
 // Matmul with (m, k) x (k, n)
-void MatmulBenchmark_Mace(int iters, int m, int k, int n) {
+void MatmulBenchmark(int iters, int m, int k, int n, bool jit) {
   mace::testing::StopTiming();
   std::vector<float> lhs(m * k);
   std::vector<float> rhs(k * n);
   std::vector<float> result(m * n);
-  // warm up
+  const bool jit_enabled = GemmJitEnabled();
+  SetGemmJitEnabled(jit);
+  // warm up, which generates the jit kernels
   Gemm(lhs.data(), rhs.data(), 1, m, k, n, result.data());
   mace::testing::StartTiming();
   while (iters--) {
     Gemm(lhs.data(), rhs.data(), 1, m, k, n, result.data());
   }
+  SetGemmJitEnabled(jit_enabled);
+}
+
+void MatmulBenchmark_Mace(int iters, int m, int k, int n) {
+  MatmulBenchmark(iters, m, k, n, false);
+}
+
+void MatmulBenchmark_MaceJit(int iters, int m, int k, int n) {
+  MatmulBenchmark(iters, m, k, n, true);
 }
 
 void MatmulBenchmark_Eigen(int iters, int m, int k, int n) {
@@ -67,8 +79,9 @@ void MatmulBenchmark_Eigen(int iters, int m, int k, int n) {
   }                                                                \
   MACE_BENCHMARK(MACE_BM_MATMUL_##M##_##K##_##N##_##FUNC)
 
-#define MACE_BM_MATMUL(M, K, N)        \
-  MACE_BM_MATMUL_FUNC(M, K, N, Mace);  \
+#define MACE_BM_MATMUL(M, K, N)          \
+  MACE_BM_MATMUL_FUNC(M, K, N, Mace);    \
+  MACE_BM_MATMUL_FUNC(M, K, N, MaceJit); \
   MACE_BM_MATMUL_FUNC(M, K, N, Eigen);
 
 // Embedding size 384
@@ -89,6 +102,11 @@ MACE_BM_MATMUL(1, 384, 44678);
 MACE_BM_MATMUL(1, 128, 1536);
 MACE_BM_MATMUL(1, 128, 44678);
 
+// 1x1 convolutions, out channels x in channels x pixels
+MACE_BM_MATMUL(128, 128, 3136);
+MACE_BM_MATMUL(96, 24, 3136);
+MACE_BM_MATMUL(1024, 1024, 49);
+
 }  // namespace test
 }  // namespace kernels
 }  // namespace mace
@@ -0,0 +1,496 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "mace/kernels/nchwc.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// One channel block, the compiler lowers it to neon, sse or avx registers.
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+
+// Blocks are passed by reference only, passing them by value would depend
+// on the target's simd abi.
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+// Output columns [begin, end) whose filter taps are all inside the input
+// width, they run without bounds checks.
+void InnerRange(const index_t in_width,
+                const index_t out_width,
+                const index_t filter_w,
+                const int stride_w,
+                const int dilation_w,
+                const int pad_left,
+                index_t *begin,
+                index_t *end) {
+  *begin = std::min<index_t>((pad_left + stride_w - 1) / stride_w, out_width);
+  const index_t last = in_width - 1 + pad_left - (filter_w - 1) * dilation_w;
+  *end = last < 0 ? 0 : std::min<index_t>(last / stride_w + 1, out_width);
+  *end = std::max(*begin, *end);
+}
+
+void Conv2dNCHWcPixel(const float *input,
+                      const float *filter,
+                      const Block &init,
+                      const index_t in_blocks,
+                      const index_t in_height,
+                      const index_t in_width,
+                      const index_t filter_h,
+                      const index_t filter_w,
+                      const index_t ih_begin,
+                      const index_t iw_begin,
+                      const int *dilations,
+                      float *output) {
+  const index_t in_image_size = in_height * in_width * kNCHWcBlockSize;
+  const index_t filter_block_size =
+      filter_h * filter_w * kNCHWcBlockSize * kNCHWcBlockSize;
+  Block acc = init;
+  for (index_t ib = 0; ib < in_blocks; ++ib) {
+    for (index_t kh = 0; kh < filter_h; ++kh) {
+      const index_t ih = ih_begin + kh * dilations[0];
+      if (ih < 0 || ih >= in_height) continue;
+      for (index_t kw = 0; kw < filter_w; ++kw) {
+        const index_t iw = iw_begin + kw * dilations[1];
+        if (iw < 0 || iw >= in_width) continue;
+        const float *in = input + ib * in_image_size
+            + (ih * in_width + iw) * kNCHWcBlockSize;
+        const float *f = filter + ib * filter_block_size
+            + (kh * filter_w + kw) * kNCHWcBlockSize * kNCHWcBlockSize;
+        for (index_t i = 0; i < kNCHWcBlockSize; ++i) {
+          acc += AsBlock(f + i * kNCHWcBlockSize) * in[i];
+        }
+      }
+    }
+  }
+  AsBlock(output) = acc;
+}
+
+void DepthwiseConv2dNCHWcPixel(const float *input,
+                               const float *filter,
+                               const Block &init,
+                               const index_t in_height,
+                               const index_t in_width,
+                               const index_t filter_h,
+                               const index_t filter_w,
+                               const index_t ih_begin,
+                               const index_t iw_begin,
+                               const int *dilations,
+                               float *output) {
+  Block acc = init;
+  for (index_t kh = 0; kh < filter_h; ++kh) {
+    const index_t ih = ih_begin + kh * dilations[0];
+    if (ih < 0 || ih >= in_height) continue;
+    for (index_t kw = 0; kw < filter_w; ++kw) {
+      const index_t iw = iw_begin + kw * dilations[1];
+      if (iw < 0 || iw >= in_width) continue;
+      acc += AsBlock(input + (ih * in_width + iw) * kNCHWcBlockSize)
+          * AsBlock(filter + (kh * filter_w + kw) * kNCHWcBlockSize);
+    }
+  }
+  AsBlock(output) = acc;
+}
+}  // namespace
+
+std::vector<index_t> NCHWcShape(const std::vector<index_t> &nchw_shape) {
+  MACE_CHECK(nchw_shape.size() == 4 && nchw_shape[1] % kNCHWcBlockSize == 0,
+             "channels must be a multiple of ", kNCHWcBlockSize);
+  return {nchw_shape[0], nchw_shape[1] / kNCHWcBlockSize, nchw_shape[2],
+          nchw_shape[3], kNCHWcBlockSize};
+}
+
+std::vector<index_t> NCHWShape(const std::vector<index_t> &nchwc_shape) {
+  MACE_CHECK(nchwc_shape.size() == 5 && nchwc_shape[4] == kNCHWcBlockSize);
+  return {nchwc_shape[0], nchwc_shape[1] * kNCHWcBlockSize, nchwc_shape[2],
+          nchwc_shape[3]};
+}
+
+void ReorderNCHWToNCHWc(const float *input,
+                        const index_t *in_shape,
+                        float *output) {
+  const index_t channel_blocks = in_shape[1] / kNCHWcBlockSize;
+  const index_t image_size = in_shape[2] * in_shape[3];
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < in_shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      const float *in_base =
+          input + (b * in_shape[1] + cb * kNCHWcBlockSize) * image_size;
+      float *out_base = output + (b * channel_blocks + cb) * image_size
+          * kNCHWcBlockSize;
+      for (index_t i = 0; i < image_size; ++i) {
+        for (index_t c = 0; c < kNCHWcBlockSize; ++c) {
+          out_base[i * kNCHWcBlockSize + c] = in_base[c * image_size + i];
+        }
+      }
+    }
+  }
+}
+
+void ReorderNCHWcToNCHW(const float *input,
+                        const index_t *out_shape,
+                        float *output) {
+  const index_t channel_blocks = out_shape[1] / kNCHWcBlockSize;
+  const index_t image_size = out_shape[2] * out_shape[3];
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      const float *in_base = input + (b * channel_blocks + cb) * image_size
+          * kNCHWcBlockSize;
+      float *out_base =
+          output + (b * out_shape[1] + cb * kNCHWcBlockSize) * image_size;
+      for (index_t c = 0; c < kNCHWcBlockSize; ++c) {
+        for (index_t i = 0; i < image_size; ++i) {
+          out_base[c * image_size + i] = in_base[i * kNCHWcBlockSize + c];
+        }
+      }
+    }
+  }
+}
+
+void ReorderConv2dFilterToNCHWc(const float *filter,
+                                const index_t *filter_shape,
+                                float *output) {
+  const index_t out_blocks = filter_shape[0] / kNCHWcBlockSize;
+  const index_t in_blocks = filter_shape[1] / kNCHWcBlockSize;
+  const index_t filter_size = filter_shape[2] * filter_shape[3];
+
+  for (index_t ob = 0; ob < out_blocks; ++ob) {
+    for (index_t ib = 0; ib < in_blocks; ++ib) {
+      for (index_t k = 0; k < filter_size; ++k) {
+        for (index_t i = 0; i < kNCHWcBlockSize; ++i) {
+          for (index_t o = 0; o < kNCHWcBlockSize; ++o) {
+            const index_t oc = ob * kNCHWcBlockSize + o;
+            const index_t ic = ib * kNCHWcBlockSize + i;
+            *output++ = filter[(oc * filter_shape[1] + ic) * filter_size + k];
+          }
+        }
+      }
+    }
+  }
+}
+
+void ReorderDepthwiseFilterToNCHWc(const float *filter,
+                                   const index_t *filter_shape,
+                                   float *output) {
+  MACE_CHECK(filter_shape[0] == 1, "channel multiplier must be 1");
+  const index_t channel_blocks = filter_shape[1] / kNCHWcBlockSize;
+  const index_t filter_size = filter_shape[2] * filter_shape[3];
+
+  for (index_t cb = 0; cb < channel_blocks; ++cb) {
+    for (index_t k = 0; k < filter_size; ++k) {
+      for (index_t c = 0; c < kNCHWcBlockSize; ++c) {
+        *output++ = filter[(cb * kNCHWcBlockSize + c) * filter_size + k];
+      }
+    }
+  }
+}
+
+void Conv2dNCHWc(const float *input,
+                 const float *filter,
+                 const float *bias,
+                 const index_t *in_shape,
+                 const index_t *out_shape,
+                 const index_t *filter_shape,
+                 const int *strides,
+                 const int *dilations,
+                 const int *pad_hw,
+                 float *output) {
+  const index_t batch = out_shape[0];
+  const index_t out_blocks = out_shape[1] / kNCHWcBlockSize;
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t in_blocks = in_shape[1] / kNCHWcBlockSize;
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+  const index_t in_image_size = in_height * in_width * kNCHWcBlockSize;
+  const index_t filter_block_size =
+      filter_h * filter_w * kNCHWcBlockSize * kNCHWcBlockSize;
+  const index_t in_step = strides[1] * kNCHWcBlockSize;
+
+  index_t w_begin, w_end;
+  InnerRange(in_width, out_width, filter_w, strides[1], dilations[1],
+             pad_hw[1], &w_begin, &w_end);
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t ob = 0; ob < out_blocks; ++ob) {
+      for (index_t h = 0; h < out_height; ++h) {
+        const float *in_base = input + b * in_blocks * in_image_size;
+        const float *filter_base = filter + ob * in_blocks * filter_block_size;
+        float *out_row = output + ((b * out_blocks + ob) * out_height + h)
+            * out_width * kNCHWcBlockSize;
+        const Block init = bias == nullptr
+            ? Block{} : AsBlock(bias + ob * kNCHWcBlockSize);
+        const index_t ih_begin = h * strides[0] - pad_hw[0];
+
+        auto conv_pixel = [&](index_t w) {
+          Conv2dNCHWcPixel(in_base, filter_base, init, in_blocks, in_height,
+                           in_width, filter_h, filter_w, ih_begin,
+                           w * strides[1] - pad_hw[1], dilations,
+                           out_row + w * kNCHWcBlockSize);
+        };
+
+        index_t w = 0;
+        for (; w < w_begin; ++w) {
+          conv_pixel(w);
+        }
+        // 4 output pixels share every filter load
+        for (; w + 3 < w_end; w += 4) {
+          Block acc0 = init;
+          Block acc1 = init;
+          Block acc2 = init;
+          Block acc3 = init;
+          for (index_t ib = 0; ib < in_blocks; ++ib) {
+            const float *in_image = in_base + ib * in_image_size;
+            const float *filter_ptr = filter_base + ib * filter_block_size;
+            for (index_t kh = 0; kh < filter_h; ++kh) {
+              const index_t ih = ih_begin + kh * dilations[0];
+              if (ih < 0 || ih >= in_height) continue;
+              for (index_t kw = 0; kw < filter_w; ++kw) {
+                const float *in0 = in_image + (ih * in_width + w * strides[1]
+                    + kw * dilations[1] - pad_hw[1]) * kNCHWcBlockSize;
+                const float *in1 = in0 + in_step;
+                const float *in2 = in1 + in_step;
+                const float *in3 = in2 + in_step;
+                const float *f = filter_ptr
+                    + (kh * filter_w + kw) * kNCHWcBlockSize * kNCHWcBlockSize;
+                for (index_t i = 0; i < kNCHWcBlockSize; ++i) {
+                  const Block fv = AsBlock(f + i * kNCHWcBlockSize);
+                  acc0 += fv * in0[i];
+                  acc1 += fv * in1[i];
+                  acc2 += fv * in2[i];
+                  acc3 += fv * in3[i];
+                }
+              }
+            }
+          }
+          AsBlock(out_row + w * kNCHWcBlockSize) = acc0;
+          AsBlock(out_row + (w + 1) * kNCHWcBlockSize) = acc1;
+          AsBlock(out_row + (w + 2) * kNCHWcBlockSize) = acc2;
+          AsBlock(out_row + (w + 3) * kNCHWcBlockSize) = acc3;
+        }
+        for (; w < out_width; ++w) {
+          conv_pixel(w);
+        }
+      }
+    }
+  }
+}
+
+void DepthwiseConv2dNCHWc(const float *input,
+                          const float *filter,
+                          const float *bias,
+                          const index_t *in_shape,
+                          const index_t *out_shape,
+                          const index_t *filter_shape,
+                          const int *strides,
+                          const int *dilations,
+                          const int *pad_hw,
+                          float *output) {
+  const index_t batch = out_shape[0];
+  const index_t channel_blocks = out_shape[1] / kNCHWcBlockSize;
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+  const index_t in_image_size = in_height * in_width * kNCHWcBlockSize;
+
+  index_t w_begin, w_end;
+  InnerRange(in_width, out_width, filter_w, strides[1], dilations[1],
+             pad_hw[1], &w_begin, &w_end);
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      for (index_t h = 0; h < out_height; ++h) {
+        const float *in_image =
+            input + (b * channel_blocks + cb) * in_image_size;
+        const float *filter_ptr =
+            filter + cb * filter_h * filter_w * kNCHWcBlockSize;
+        float *out_row = output + ((b * channel_blocks + cb) * out_height + h)
+            * out_width * kNCHWcBlockSize;
+        const Block init = bias == nullptr
+            ? Block{} : AsBlock(bias + cb * kNCHWcBlockSize);
+        const index_t ih_begin = h * strides[0] - pad_hw[0];
+
+        auto conv_pixel = [&](index_t w) {
+          DepthwiseConv2dNCHWcPixel(in_image, filter_ptr, init, in_height,
+                                    in_width, filter_h, filter_w, ih_begin,
+                                    w * strides[1] - pad_hw[1], dilations,
+                                    out_row + w * kNCHWcBlockSize);
+        };
+
+        index_t w = 0;
+        for (; w < w_begin; ++w) {
+          conv_pixel(w);
+        }
+        for (; w < w_end; ++w) {
+          Block acc = init;
+          for (index_t kh = 0; kh < filter_h; ++kh) {
+            const index_t ih = ih_begin + kh * dilations[0];
+            if (ih < 0 || ih >= in_height) continue;
+            const float *in = in_image + (ih * in_width + w * strides[1]
+                - pad_hw[1]) * kNCHWcBlockSize;
+            const float *f = filter_ptr + kh * filter_w * kNCHWcBlockSize;
+            for (index_t kw = 0; kw < filter_w; ++kw) {
+              acc += AsBlock(in + kw * dilations[1] * kNCHWcBlockSize)
+                  * AsBlock(f + kw * kNCHWcBlockSize);
+            }
+          }
+          AsBlock(out_row + w * kNCHWcBlockSize) = acc;
+        }
+        for (; w < out_width; ++w) {
+          conv_pixel(w);
+        }
+      }
+    }
+  }
+}
+
+void MaxPoolingNCHWc(const float *input,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const int *filter_hw,
+                     const int *stride_hw,
+                     const int *dilation_hw,
+                     const int *pad_hw,
+                     float *output) {
+  const index_t channel_blocks = out_shape[1] / kNCHWcBlockSize;
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t in_image_size = in_height * in_width * kNCHWcBlockSize;
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      for (index_t h = 0; h < out_height; ++h) {
+        const float *in_image =
+            input + (b * channel_blocks + cb) * in_image_size;
+        float *out_row = output + ((b * channel_blocks + cb) * out_height + h)
+            * out_width * kNCHWcBlockSize;
+        for (index_t w = 0; w < out_width; ++w) {
+          float res[kNCHWcBlockSize];
+          std::fill_n(res, kNCHWcBlockSize,
+                      std::numeric_limits<float>::lowest());
+          for (int fh = 0; fh < filter_hw[0]; ++fh) {
+            const index_t inh =
+                h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
+            if (inh < 0 || inh >= in_height) continue;
+            for (int fw = 0; fw < filter_hw[1]; ++fw) {
+              const index_t inw =
+                  w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
+              if (inw < 0 || inw >= in_width) continue;
+              const float *in =
+                  in_image + (inh * in_width + inw) * kNCHWcBlockSize;
+              for (index_t c = 0; c < kNCHWcBlockSize; ++c) {
+                res[c] = std::max(res[c], in[c]);
+              }
+            }
+          }
+          std::copy_n(res, kNCHWcBlockSize, out_row + w * kNCHWcBlockSize);
+        }
+      }
+    }
+  }
+}
+
+void AvgPoolingNCHWc(const float *input,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const int *filter_hw,
+                     const int *stride_hw,
+                     const int *dilation_hw,
+                     const int *pad_hw,
+                     float *output) {
+  const index_t channel_blocks = out_shape[1] / kNCHWcBlockSize;
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t in_image_size = in_height * in_width * kNCHWcBlockSize;
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      for (index_t h = 0; h < out_height; ++h) {
+        const float *in_image =
+            input + (b * channel_blocks + cb) * in_image_size;
+        float *out_row = output + ((b * channel_blocks + cb) * out_height + h)
+            * out_width * kNCHWcBlockSize;
+        for (index_t w = 0; w < out_width; ++w) {
+          Block res = {};
+          int block_size = 0;
+          for (int fh = 0; fh < filter_hw[0]; ++fh) {
+            const index_t inh =
+                h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
+            if (inh < 0 || inh >= in_height) continue;
+            for (int fw = 0; fw < filter_hw[1]; ++fw) {
+              const index_t inw =
+                  w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
+              if (inw < 0 || inw >= in_width) continue;
+              res += AsBlock(
+                  in_image + (inh * in_width + inw) * kNCHWcBlockSize);
+              ++block_size;
+            }
+          }
+          AsBlock(out_row + w * kNCHWcBlockSize) =
+              res / static_cast<float>(block_size);
+        }
+      }
+    }
+  }
+}
+
+void BiasAddNCHWc(const float *input,
+                  const float *bias,
+                  const index_t *shape,
+                  float *output) {
+  const index_t channel_blocks = shape[1] / kNCHWcBlockSize;
+  const index_t image_size = shape[2] * shape[3];
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < shape[0]; ++b) {
+    for (index_t cb = 0; cb < channel_blocks; ++cb) {
+      const Block &bias_block = AsBlock(bias + cb * kNCHWcBlockSize);
+      const index_t offset =
+          (b * channel_blocks + cb) * image_size * kNCHWcBlockSize;
+      for (index_t i = 0; i < image_size; ++i) {
+        const index_t pos = offset + i * kNCHWcBlockSize;
+        AsBlock(output + pos) = AsBlock(input + pos) + bias_block;
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
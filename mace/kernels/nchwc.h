@@ -0,0 +1,114 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_NCHWC_H_
+#define MACE_KERNELS_NCHWC_H_
+
+#include <vector>
+
+#include "mace/core/types.h"
+
+// Blocked NCHWc layout: {N, C / kNCHWcBlockSize, H, W, kNCHWcBlockSize}.
+// The channels of one pixel are contiguous in blocks of eight, so the kernels
+// below vectorize over channels instead of over the (often odd) image width,
+// and chains of blocked ops need no reorder between them.
+
+namespace mace {
+namespace kernels {
+
+const index_t kNCHWcBlockSize = 8;
+
+// {N, C, H, W} => {N, C / 8, H, W, 8}
+std::vector<index_t> NCHWcShape(const std::vector<index_t> &nchw_shape);
+
+// {N, C / 8, H, W, 8} => {N, C, H, W}
+std::vector<index_t> NCHWShape(const std::vector<index_t> &nchwc_shape);
+
+// in_shape is NCHW, channels must be a multiple of the block size.
+void ReorderNCHWToNCHWc(const float *input,
+                        const index_t *in_shape,
+                        float *output);
+
+// out_shape is NCHW.
+void ReorderNCHWcToNCHW(const float *input,
+                        const index_t *out_shape,
+                        float *output);
+
+// OIHW => [O / 8][I / 8][H][W][8 i][8 o]
+void ReorderConv2dFilterToNCHWc(const float *filter,
+                                const index_t *filter_shape,
+                                float *output);
+
+// [1][C][H][W] => [C / 8][H][W][8 c]
+void ReorderDepthwiseFilterToNCHWc(const float *filter,
+                                   const index_t *filter_shape,
+                                   float *output);
+
+// in_shape and out_shape are NCHW, filter_shape is OIHW and the filter is
+// reordered by ReorderConv2dFilterToNCHWc. pad_hw is {top, left}, bias may
+// be nullptr.
+void Conv2dNCHWc(const float *input,
+                 const float *filter,
+                 const float *bias,
+                 const index_t *in_shape,
+                 const index_t *out_shape,
+                 const index_t *filter_shape,
+                 const int *strides,
+                 const int *dilations,
+                 const int *pad_hw,
+                 float *output);
+
+// Depthwise with channel multiplier 1, the filter is reordered by
+// ReorderDepthwiseFilterToNCHWc.
+void DepthwiseConv2dNCHWc(const float *input,
+                          const float *filter,
+                          const float *bias,
+                          const index_t *in_shape,
+                          const index_t *out_shape,
+                          const index_t *filter_shape,
+                          const int *strides,
+                          const int *dilations,
+                          const int *pad_hw,
+                          float *output);
+
+void MaxPoolingNCHWc(const float *input,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const int *filter_hw,
+                     const int *stride_hw,
+                     const int *dilation_hw,
+                     const int *pad_hw,
+                     float *output);
+
+// Averages over the pixels inside the input, as AvgPooling does.
+void AvgPoolingNCHWc(const float *input,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const int *filter_hw,
+                     const int *stride_hw,
+                     const int *dilation_hw,
+                     const int *pad_hw,
+                     float *output);
+
+// output[n][c / 8][h][w][c % 8] = input[n][c / 8][h][w][c % 8] + bias[c],
+// shape is NCHW.
+void BiasAddNCHWc(const float *input,
+                  const float *bias,
+                  const index_t *shape,
+                  float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_NCHWC_H_
@@ -0,0 +1,333 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/nhwc.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// Row buffer is sized for L2 cache, and tiles are aligned to gemm blocks.
+const index_t kIm2RowBufferBytes = 1024 * 1024;
+const index_t kIm2RowTileAlignment = 64;
+
+// 1x1 stride 1 convolution without padding multiplies the input as is.
+bool IsPointwiseGemm(const index_t *in_shape,
+                     const index_t *out_shape,
+                     const index_t *filter_shape,
+                     const int *strides,
+                     const int *pad_hw) {
+  return filter_shape[2] == 1 && filter_shape[3] == 1
+      && strides[0] == 1 && strides[1] == 1
+      && pad_hw[0] == 0 && pad_hw[1] == 0
+      && in_shape[1] == out_shape[1] && in_shape[2] == out_shape[2];
+}
+
+index_t Im2RowTileSize(const index_t *filter_shape, const index_t pixels) {
+  const index_t row_size = filter_shape[1] * filter_shape[2]
+      * filter_shape[3];
+  index_t tile_size = kIm2RowBufferBytes / (row_size * sizeof(float))
+      / kIm2RowTileAlignment * kIm2RowTileAlignment;
+  tile_size = std::max(tile_size, kIm2RowTileAlignment);
+  return std::min(tile_size, pixels);
+}
+
+// Output pixels [begin, end) of all images => rows of [KH][KW][C] taps,
+// taps falling on the padding are zero.
+void Im2Row(const float *input,
+            const index_t *in_shape,
+            const index_t *out_shape,
+            const index_t *filter_shape,
+            const int *strides,
+            const int *dilations,
+            const int *pad_hw,
+            const index_t begin,
+            const index_t end,
+            float *rows) {
+  const index_t in_height = in_shape[1];
+  const index_t in_width = in_shape[2];
+  const index_t channels = in_shape[3];
+  const index_t out_height = out_shape[1];
+  const index_t out_width = out_shape[2];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+  const index_t row_size = filter_h * filter_w * channels;
+
+#pragma omp parallel for
+  for (index_t p = begin; p < end; ++p) {
+    const index_t b = p / (out_height * out_width);
+    const index_t oh = p / out_width % out_height;
+    const index_t ow = p % out_width;
+    float *row = rows + (p - begin) * row_size;
+    for (index_t kh = 0; kh < filter_h; ++kh) {
+      const index_t ih = oh * strides[0] - pad_hw[0] + kh * dilations[0];
+      for (index_t kw = 0; kw < filter_w; ++kw) {
+        const index_t iw = ow * strides[1] - pad_hw[1] + kw * dilations[1];
+        float *tap = row + (kh * filter_w + kw) * channels;
+        if (ih < 0 || ih >= in_height || iw < 0 || iw >= in_width) {
+          std::fill(tap, tap + channels, 0.f);
+        } else {
+          memcpy(tap, input + ((b * in_height + ih) * in_width + iw) * channels,
+                 channels * sizeof(float));
+        }
+      }
+    }
+  }
+}
+}  // namespace
+
+void ReorderConv2dFilterToNHWC(const float *filter,
+                               const index_t *filter_shape,
+                               float *output) {
+  const index_t out_channels = filter_shape[0];
+  const index_t in_channels = filter_shape[1];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+
+#pragma omp parallel for collapse(2)
+  for (index_t o = 0; o < out_channels; ++o) {
+    for (index_t i = 0; i < in_channels; ++i) {
+      for (index_t k = 0; k < filter_h * filter_w; ++k) {
+        output[(k * in_channels + i) * out_channels + o] =
+            filter[(o * in_channels + i) * filter_h * filter_w + k];
+      }
+    }
+  }
+}
+
+void ReorderDepthwiseFilterToNHWC(const float *filter,
+                                  const index_t *filter_shape,
+                                  float *output) {
+  const index_t multiplier = filter_shape[0];
+  const index_t channels = filter_shape[1];
+  const index_t filter_size = filter_shape[2] * filter_shape[3];
+
+  for (index_t m = 0; m < multiplier; ++m) {
+    for (index_t c = 0; c < channels; ++c) {
+      for (index_t k = 0; k < filter_size; ++k) {
+        output[(k * channels + c) * multiplier + m] =
+            filter[(m * channels + c) * filter_size + k];
+      }
+    }
+  }
+}
+
+index_t Conv2dNHWCBufferSize(const index_t *in_shape,
+                             const index_t *out_shape,
+                             const index_t *filter_shape,
+                             const int *strides,
+                             const int *pad_hw) {
+  if (IsPointwiseGemm(in_shape, out_shape, filter_shape, strides, pad_hw)) {
+    return 0;
+  }
+  const index_t pixels = out_shape[0] * out_shape[1] * out_shape[2];
+  return Im2RowTileSize(filter_shape, pixels)
+      * filter_shape[1] * filter_shape[2] * filter_shape[3];
+}
+
+void Conv2dNHWC(const float *input,
+                const float *filter,
+                const float *bias,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *strides,
+                const int *dilations,
+                const int *pad_hw,
+                float *buffer,
+                float *output) {
+  const index_t pixels = out_shape[0] * out_shape[1] * out_shape[2];
+  const index_t out_channels = out_shape[3];
+  const index_t row_size = filter_shape[1] * filter_shape[2]
+      * filter_shape[3];
+
+  if (IsPointwiseGemm(in_shape, out_shape, filter_shape, strides, pad_hw)) {
+    Gemm(input, filter, 1, pixels, row_size, out_channels, output);
+  } else {
+    const index_t tile_size = Im2RowTileSize(filter_shape, pixels);
+    for (index_t begin = 0; begin < pixels; begin += tile_size) {
+      const index_t end = std::min(begin + tile_size, pixels);
+      Im2Row(input, in_shape, out_shape, filter_shape, strides, dilations,
+             pad_hw, begin, end, buffer);
+      // rows of a tile are contiguous output pixels, no scatter needed
+      Gemm(buffer, filter, 1, end - begin, row_size, out_channels,
+           output + begin * out_channels);
+    }
+  }
+
+  if (bias != nullptr) {
+#pragma omp parallel for
+    for (index_t p = 0; p < pixels; ++p) {
+      float *out = output + p * out_channels;
+      for (index_t o = 0; o < out_channels; ++o) {
+        out[o] += bias[o];
+      }
+    }
+  }
+}
+
+void DepthwiseConv2dNHWC(const float *input,
+                         const float *filter,
+                         const float *bias,
+                         const index_t *in_shape,
+                         const index_t *out_shape,
+                         const index_t *filter_shape,
+                         const int *strides,
+                         const int *dilations,
+                         const int *pad_hw,
+                         float *output) {
+  const index_t batch = in_shape[0];
+  const index_t in_height = in_shape[1];
+  const index_t in_width = in_shape[2];
+  const index_t in_channels = in_shape[3];
+  const index_t out_height = out_shape[1];
+  const index_t out_width = out_shape[2];
+  const index_t out_channels = out_shape[3];
+  const index_t multiplier = filter_shape[0] / filter_shape[1];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < out_height; ++h) {
+      for (index_t w = 0; w < out_width; ++w) {
+        float *out = output + ((b * out_height + h) * out_width + w)
+            * out_channels;
+        if (bias != nullptr) {
+          std::copy(bias, bias + out_channels, out);
+        } else {
+          std::fill(out, out + out_channels, 0.f);
+        }
+        for (index_t kh = 0; kh < filter_h; ++kh) {
+          const index_t ih = h * strides[0] - pad_hw[0] + kh * dilations[0];
+          if (ih < 0 || ih >= in_height) continue;
+          for (index_t kw = 0; kw < filter_w; ++kw) {
+            const index_t iw = w * strides[1] - pad_hw[1] + kw * dilations[1];
+            if (iw < 0 || iw >= in_width) continue;
+            const float *in = input + ((b * in_height + ih) * in_width + iw)
+                * in_channels;
+            const float *f = filter + (kh * filter_w + kw) * out_channels;
+            if (multiplier == 1) {
+              for (index_t c = 0; c < out_channels; ++c) {
+                out[c] += in[c] * f[c];
+              }
+            } else {
+              for (index_t c = 0; c < out_channels; ++c) {
+                out[c] += in[c / multiplier] * f[c];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void MaxPoolingNHWC(const float *input,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *filter_hw,
+                    const int *stride_hw,
+                    const int *dilation_hw,
+                    const int *pad_hw,
+                    float *output) {
+  const index_t batch = in_shape[0];
+  const index_t in_height = in_shape[1];
+  const index_t in_width = in_shape[2];
+  const index_t channels = in_shape[3];
+  const index_t out_height = out_shape[1];
+  const index_t out_width = out_shape[2];
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < out_height; ++h) {
+      for (index_t w = 0; w < out_width; ++w) {
+        float *out = output + ((b * out_height + h) * out_width + w)
+            * channels;
+        std::fill(out, out + channels, std::numeric_limits<float>::lowest());
+        for (int kh = 0; kh < filter_hw[0]; ++kh) {
+          const index_t ih = h * stride_hw[0] - pad_hw[0]
+              + kh * dilation_hw[0];
+          if (ih < 0 || ih >= in_height) continue;
+          for (int kw = 0; kw < filter_hw[1]; ++kw) {
+            const index_t iw = w * stride_hw[1] - pad_hw[1]
+                + kw * dilation_hw[1];
+            if (iw < 0 || iw >= in_width) continue;
+            const float *in = input + ((b * in_height + ih) * in_width + iw)
+                * channels;
+            for (index_t c = 0; c < channels; ++c) {
+              out[c] = std::max(out[c], in[c]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void AvgPoolingNHWC(const float *input,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *filter_hw,
+                    const int *stride_hw,
+                    const int *dilation_hw,
+                    const int *pad_hw,
+                    float *output) {
+  const index_t batch = in_shape[0];
+  const index_t in_height = in_shape[1];
+  const index_t in_width = in_shape[2];
+  const index_t channels = in_shape[3];
+  const index_t out_height = out_shape[1];
+  const index_t out_width = out_shape[2];
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < out_height; ++h) {
+      for (index_t w = 0; w < out_width; ++w) {
+        float *out = output + ((b * out_height + h) * out_width + w)
+            * channels;
+        std::fill(out, out + channels, 0.f);
+        int block_size = 0;
+        for (int kh = 0; kh < filter_hw[0]; ++kh) {
+          const index_t ih = h * stride_hw[0] - pad_hw[0]
+              + kh * dilation_hw[0];
+          if (ih < 0 || ih >= in_height) continue;
+          for (int kw = 0; kw < filter_hw[1]; ++kw) {
+            const index_t iw = w * stride_hw[1] - pad_hw[1]
+                + kw * dilation_hw[1];
+            if (iw < 0 || iw >= in_width) continue;
+            const float *in = input + ((b * in_height + ih) * in_width + iw)
+                * channels;
+            for (index_t c = 0; c < channels; ++c) {
+              out[c] += in[c];
+            }
+            ++block_size;
+          }
+        }
+        const float scale = 1.f / block_size;
+        for (index_t c = 0; c < channels; ++c) {
+          out[c] *= scale;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,95 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_NHWC_H_
+#define MACE_KERNELS_NHWC_H_
+
+#include "mace/core/types.h"
+
+// CPU kernels for NHWC tensors. The channels of a pixel are contiguous, so
+// convolution lowers to a gemm over rows of pixels and the other kernels
+// vectorize over channels.
+
+namespace mace {
+namespace kernels {
+
+// OIHW => [H][W][I][O], the right hand side of the convolution gemm.
+void ReorderConv2dFilterToNHWC(const float *filter,
+                               const index_t *filter_shape,
+                               float *output);
+
+// [M][C][H][W] => [H][W][C * M], output channel c * M + m reads channel c.
+void ReorderDepthwiseFilterToNHWC(const float *filter,
+                                  const index_t *filter_shape,
+                                  float *output);
+
+// Number of floats Conv2dNHWC needs in its buffer, 0 if the convolution is
+// a plain gemm of the input.
+index_t Conv2dNHWCBufferSize(const index_t *in_shape,
+                             const index_t *out_shape,
+                             const index_t *filter_shape,
+                             const int *strides,
+                             const int *pad_hw);
+
+// in_shape and out_shape are NHWC, filter_shape is OIHW and the filter is
+// reordered by ReorderConv2dFilterToNHWC. pad_hw is {top, left}, bias may be
+// nullptr.
+void Conv2dNHWC(const float *input,
+                const float *filter,
+                const float *bias,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *strides,
+                const int *dilations,
+                const int *pad_hw,
+                float *buffer,
+                float *output);
+
+// filter_shape is {C * M, C, H, W} and the filter is reordered by
+// ReorderDepthwiseFilterToNHWC.
+void DepthwiseConv2dNHWC(const float *input,
+                         const float *filter,
+                         const float *bias,
+                         const index_t *in_shape,
+                         const index_t *out_shape,
+                         const index_t *filter_shape,
+                         const int *strides,
+                         const int *dilations,
+                         const int *pad_hw,
+                         float *output);
+
+void MaxPoolingNHWC(const float *input,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *filter_hw,
+                    const int *stride_hw,
+                    const int *dilation_hw,
+                    const int *pad_hw,
+                    float *output);
+
+// Averages over the pixels inside the input, as AvgPooling does.
+void AvgPoolingNHWC(const float *input,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const int *filter_hw,
+                    const int *stride_hw,
+                    const int *dilation_hw,
+                    const int *pad_hw,
+                    float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_NHWC_H_
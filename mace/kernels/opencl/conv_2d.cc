@@ -70,8 +70,11 @@ template <typename T>
 MaceStatus Conv2dFunctor<DeviceType::GPU, T>::operator()(const Tensor *input,
                                                          const Tensor *filter,
                                                          const Tensor *bias,
+                                                         const Tensor *residual,
                                                          Tensor *output,
                                                          StatsFuture *future) {
+  MACE_CHECK(residual == nullptr, "OpenCL conv2d does not add a residual");
+  MACE_CHECK(group_ == 1, "OpenCL conv2d is not grouped");
   typedef MaceStatus (*Conv2dOpenclFunction)(
       cl::Kernel * kernel, const Tensor *input, const Tensor *filter,
       const Tensor *bias, const int stride, const int *padding,
@@ -212,7 +212,7 @@ MaceStatus DepthwiseConv2dFunctor<DeviceType::GPU, T>::operator()(
     // TODO(heliangliang) The CPU/NEON kernel should map the buffer
     return DepthwiseConv2dFunctor<DeviceType::CPU, float>(
         strides_, padding_type_, paddings_, dilations_, activation_,
-        relux_max_limit_)(input, filter, bias, output, future);
+        relux_max_limit_, NHWC)(input, filter, bias, output, future);
   }
 
   // Create a fake conv_2d filter to calculate the paddings and output size
@@ -23,6 +23,9 @@
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
 #include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/conv_pool_specialized.h"
+#include "mace/kernels/nchwc.h"
+#include "mace/kernels/nhwc.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/cl2_header.h"
@@ -69,120 +72,75 @@ struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
                  const int *strides,
                  const Padding padding_type,
                  const std::vector<int> &paddings,
-                 const int *dilations)
+                 const int *dilations,
+                 const DataFormat data_format)
       : PoolingFunctorBase(
-            pooling_type, kernels, strides, padding_type, paddings, dilations) {
+            pooling_type, kernels, strides, padding_type, paddings, dilations),
+        data_format_(data_format) {
   }
 
-  void MaxPooling(const float *input,
-                  const index_t *in_shape,
-                  const index_t *out_shape,
-                  const int *filter_hw,
-                  const int *stride_hw,
-                  const int *dilation_hw,
-                  const int *pad_hw,
-                  float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = in_shape[1] * in_image_size;
-    const index_t out_batch_size = out_shape[1] * out_image_size;
-
-#pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < out_shape[0]; ++b) {
-      for (index_t c = 0; c < out_shape[1]; ++c) {
-        const index_t out_base = b * out_batch_size + c * out_image_size;
-        const index_t in_base = b * in_batch_size + c * in_image_size;
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        const index_t in_height = in_shape[2];
-        const index_t in_width = in_shape[3];
-
-        for (index_t h = 0; h < out_height; ++h) {
-          for (index_t w = 0; w < out_width; ++w) {
-            const index_t out_offset = out_base + h * out_width + w;
-            float res = std::numeric_limits<float>::lowest();
-            for (int fh = 0; fh < filter_hw[0]; ++fh) {
-              for (int fw = 0; fw < filter_hw[1]; ++fw) {
-                index_t inh =
-                    h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
-                index_t inw =
-                    w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
-                if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
-                  index_t input_offset = in_base + inh * in_width + inw;
-                  res = std::max(res, input[input_offset]);
-                }
-              }
-            }
-            output[out_offset] = res;
-          }
-        }
-      }
-    }
+  static void MaxPooling(const float *input,
+                         const index_t *in_shape,
+                         const index_t *out_shape,
+                         const int *filter_hw,
+                         const int *stride_hw,
+                         const int *dilation_hw,
+                         const int *pad_hw,
+                         float *output) {
+    MaxPoolingKernel(filter_hw, stride_hw, dilation_hw)(
+        input, in_shape, out_shape, filter_hw, stride_hw, dilation_hw, pad_hw,
+        output);
   }
 
-  void AvgPooling(const float *input,
-                  const index_t *in_shape,
-                  const index_t *out_shape,
-                  const int *filter_hw,
-                  const int *stride_hw,
-                  const int *dilation_hw,
-                  const int *pad_hw,
-                  float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = in_shape[1] * in_image_size;
-    const index_t out_batch_size = out_shape[1] * out_image_size;
-
-#pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < out_shape[0]; ++b) {
-      for (index_t c = 0; c < out_shape[1]; ++c) {
-        const index_t out_base = b * out_batch_size + c * out_image_size;
-        const index_t in_base = b * in_batch_size + c * in_image_size;
-        const index_t in_height = in_shape[2];
-        const index_t in_width = in_shape[3];
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        for (index_t h = 0; h < out_height; ++h) {
-          for (index_t w = 0; w < out_width; ++w) {
-            const index_t out_offset = out_base + h * out_width + w;
-            float res = 0;
-            int block_size = 0;
-            for (int fh = 0; fh < filter_hw[0]; ++fh) {
-              for (int fw = 0; fw < filter_hw[1]; ++fw) {
-                index_t inh =
-                    h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
-                index_t inw =
-                    w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
-                if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
-                  index_t input_offset = in_base + inh * in_width + inw;
-                  res += input[input_offset];
-                  ++block_size;
-                }
-              }
-            }
-            output[out_offset] = res / block_size;
-          }
-        }
-      }
-    }
+  static void AvgPooling(const float *input,
+                         const index_t *in_shape,
+                         const index_t *out_shape,
+                         const int *filter_hw,
+                         const int *stride_hw,
+                         const int *dilation_hw,
+                         const int *pad_hw,
+                         float *output) {
+    AvgPoolingKernel(filter_hw, stride_hw, dilation_hw)(
+        input, in_shape, out_shape, filter_hw, stride_hw, dilation_hw, pad_hw,
+        output);
   }
 
   MaceStatus operator()(const Tensor *input_tensor,
                   Tensor *output_tensor,
                   StatsFuture *future) {
     MACE_UNUSED(future);
+    // NCHWc input is pooled in place of its NCHW view
+    const bool blocked = input_tensor->dim_size() == 5;
+    const bool nhwc = !blocked && data_format_ == NHWC;
+    const std::vector<index_t> input_shape_vec =
+        blocked ? NCHWShape(input_tensor->shape()) : input_tensor->shape();
+    const index_t channels =
+        nhwc ? input_shape_vec[3] : input_shape_vec[1];
     std::vector<index_t> output_shape(4);
     std::vector<index_t> filter_shape = {
-      input_tensor->dim(1), input_tensor->dim(1), kernels_[0], kernels_[1]};
+      channels, channels, kernels_[0], kernels_[1]};
 
     std::vector<int> paddings(2);
-    if (paddings_.empty()) {
+    if (paddings_.empty() && nhwc) {
+      kernels::CalcNHWCPaddingAndOutputSize(
+        input_shape_vec.data(), filter_shape.data(), dilations_,
+        strides_, padding_type_, output_shape.data(), paddings.data());
+    } else if (paddings_.empty()) {
       kernels::CalcNCHWPaddingAndOutputSize(
-        input_tensor->shape().data(), filter_shape.data(), dilations_,
+        input_shape_vec.data(), filter_shape.data(), dilations_,
         strides_, padding_type_, output_shape.data(), paddings.data());
+    } else if (nhwc) {
+      paddings = paddings_;
+      CalcOutputSize(input_shape_vec.data(),
+                     filter_shape.data(),
+                     paddings_.data(),
+                     dilations_,
+                     strides_,
+                     RoundType::CEIL,
+                     output_shape.data());
     } else {
       paddings = paddings_;
-      CalcNCHWOutputSize(input_tensor->shape().data(),
+      CalcNCHWOutputSize(input_shape_vec.data(),
                          filter_shape.data(),
                          paddings_.data(),
                          dilations_,
@@ -190,16 +148,53 @@ struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
                          RoundType::CEIL,
                          output_shape.data());
     }
-    MACE_RETURN_IF_ERROR(output_tensor->Resize(output_shape));
+    MACE_RETURN_IF_ERROR(output_tensor->Resize(
+        blocked ? NCHWcShape(output_shape) : output_shape));
 
     Tensor::MappingGuard input_guard(input_tensor);
     Tensor::MappingGuard output_guard(output_tensor);
     const float *input = input_tensor->data<float>();
     float *output = output_tensor->mutable_data<float>();
-    const index_t *input_shape = input_tensor->shape().data();
+    const index_t *input_shape = input_shape_vec.data();
     int pad_hw[2] = {paddings[0] / 2, paddings[1] / 2};
 
-    if (pooling_type_ == PoolingType::MAX) {
+    if (blocked && pooling_type_ == PoolingType::MAX) {
+      MaxPoolingNCHWc(input,
+                      input_shape,
+                      output_shape.data(),
+                      kernels_,
+                      strides_,
+                      dilations_,
+                      pad_hw,
+                      output);
+    } else if (blocked && pooling_type_ == PoolingType::AVG) {
+      AvgPoolingNCHWc(input,
+                      input_shape,
+                      output_shape.data(),
+                      kernels_,
+                      strides_,
+                      dilations_,
+                      pad_hw,
+                      output);
+    } else if (nhwc && pooling_type_ == PoolingType::MAX) {
+      MaxPoolingNHWC(input,
+                     input_shape,
+                     output_shape.data(),
+                     kernels_,
+                     strides_,
+                     dilations_,
+                     pad_hw,
+                     output);
+    } else if (nhwc && pooling_type_ == PoolingType::AVG) {
+      AvgPoolingNHWC(input,
+                     input_shape,
+                     output_shape.data(),
+                     kernels_,
+                     strides_,
+                     dilations_,
+                     pad_hw,
+                     output);
+    } else if (pooling_type_ == PoolingType::MAX) {
       MaxPooling(input,
                  input_shape,
                  output_shape.data(),
@@ -223,6 +218,8 @@ struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
 
     return MACE_SUCCESS;
   }
+
+  const DataFormat data_format_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
@@ -233,9 +230,12 @@ struct PoolingFunctor<DeviceType::GPU, T> : PoolingFunctorBase {
                  const int *strides,
                  const Padding padding_type,
                  const std::vector<int> &paddings,
-                 const int *dilations)
+                 const int *dilations,
+                 const DataFormat data_format)
       : PoolingFunctorBase(
             pooling_type, kernels, strides, padding_type, paddings, dilations) {
+    // images are always NHWC
+    MACE_UNUSED(data_format);
   }
   MaceStatus operator()(const Tensor *input_tensor,
                   Tensor *output_tensor,
@@ -0,0 +1,66 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_REORDER_H_
+#define MACE_KERNELS_REORDER_H_
+
+#include <vector>
+
+#include "mace/core/future.h"
+#include "mace/core/tensor.h"
+#include "mace/kernels/nchwc.h"
+
+namespace mace {
+namespace kernels {
+
+template<DeviceType D, typename T>
+struct ReorderFunctor;
+
+// Converts between NCHW and the blocked NCHWc layout, the converter inserts
+// it where blocked ops meet the rest of the graph.
+template<>
+struct ReorderFunctor<DeviceType::CPU, float> {
+  explicit ReorderFunctor(const DataFormat data_format)
+      : data_format_(data_format) {}
+
+  MaceStatus operator()(const Tensor *input,
+                        Tensor *output,
+                        StatsFuture *future) {
+    MACE_UNUSED(future);
+    Tensor::MappingGuard input_guard(input);
+    if (data_format_ == NCHWc) {
+      MACE_CHECK(input->dim_size() == 4, "input must be NCHW");
+      MACE_RETURN_IF_ERROR(output->Resize(NCHWcShape(input->shape())));
+      Tensor::MappingGuard output_guard(output);
+      ReorderNCHWToNCHWc(input->data<float>(), input->shape().data(),
+                         output->mutable_data<float>());
+    } else {
+      MACE_CHECK(data_format_ == NCHW && input->dim_size() == 5,
+                 "only NCHWc => NCHW or NCHW => NCHWc is supported");
+      const std::vector<index_t> output_shape = NCHWShape(input->shape());
+      MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+      Tensor::MappingGuard output_guard(output);
+      ReorderNCHWcToNCHW(input->data<float>(), output_shape.data(),
+                         output->mutable_data<float>());
+    }
+    return MACE_SUCCESS;
+  }
+
+  const DataFormat data_format_;
+};
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_REORDER_H_
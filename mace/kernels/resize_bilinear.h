@@ -113,6 +113,47 @@ inline void ResizeImage(const float *images,
   }
 }
 
+inline void ResizeImageNHWC(const float *images,
+                            const index_t batch_size,
+                            const index_t in_height,
+                            const index_t in_width,
+                            const index_t out_height,
+                            const index_t out_width,
+                            const index_t channels,
+                            const std::vector<CachedInterpolation> &xs_vec,
+                            const std::vector<CachedInterpolation> &ys,
+                            float *output) {
+  const CachedInterpolation *xs = xs_vec.data();
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch_size; ++b) {
+    for (index_t y = 0; y < out_height; ++y) {
+      const float *y_lower_input_ptr =
+          images + (b * in_height + ys[y].lower) * in_width * channels;
+      const float *y_upper_input_ptr =
+          images + (b * in_height + ys[y].upper) * in_width * channels;
+      const float ys_lerp = ys[y].lerp;
+      float *y_output_ptr =
+          output + (b * out_height + y) * out_width * channels;
+
+      for (index_t x = 0; x < out_width; ++x) {
+        const float xs_lerp = xs[x].lerp;
+        const float *top_left = y_lower_input_ptr + xs[x].lower * channels;
+        const float *top_right = y_lower_input_ptr + xs[x].upper * channels;
+        const float *bottom_left = y_upper_input_ptr + xs[x].lower * channels;
+        const float *bottom_right =
+            y_upper_input_ptr + xs[x].upper * channels;
+        float *output_ptr = y_output_ptr + x * channels;
+        for (index_t c = 0; c < channels; ++c) {
+          output_ptr[c] = ComputeLerp(top_left[c], top_right[c],
+                                      bottom_left[c], bottom_right[c],
+                                      xs_lerp, ys_lerp);
+        }
+      }
+    }
+  }
+}
+
 struct ResizeBilinearFunctorBase {
   ResizeBilinearFunctorBase(const std::vector<index_t> &size,
                             bool align_corners)
@@ -134,22 +175,28 @@ struct ResizeBilinearFunctor;
 template<>
 struct ResizeBilinearFunctor<DeviceType::CPU, float>
     : ResizeBilinearFunctorBase {
-  ResizeBilinearFunctor(const std::vector<index_t> &size, bool align_corners)
-      : ResizeBilinearFunctorBase(size, align_corners) {}
+  ResizeBilinearFunctor(const std::vector<index_t> &size,
+                        bool align_corners,
+                        const DataFormat data_format)
+      : ResizeBilinearFunctorBase(size, align_corners),
+        data_format_(data_format) {}
 
   MaceStatus operator()(const Tensor *input,
                         Tensor *output,
                         StatsFuture *future) {
     MACE_UNUSED(future);
+    const bool nhwc = data_format_ == NHWC;
     const index_t batch = input->dim(0);
-    const index_t channels = input->dim(1);
-    const index_t in_height = input->dim(2);
-    const index_t in_width = input->dim(3);
+    const index_t channels = input->dim(nhwc ? 3 : 1);
+    const index_t in_height = input->dim(nhwc ? 1 : 2);
+    const index_t in_width = input->dim(nhwc ? 2 : 3);
 
     index_t out_height = out_height_;
     index_t out_width = out_width_;
     MACE_CHECK(out_height > 0 && out_width > 0);
-    std::vector<index_t> out_shape{batch, channels, out_height, out_width};
+    std::vector<index_t> out_shape = nhwc
+        ? std::vector<index_t>{batch, out_height, out_width, channels}
+        : std::vector<index_t>{batch, channels, out_height, out_width};
     MACE_RETURN_IF_ERROR(output->Resize(out_shape));
 
     Tensor::MappingGuard input_mapper(input);
@@ -176,19 +223,31 @@ struct ResizeBilinearFunctor<DeviceType::CPU, float>
     ComputeInterpolationWeights(out_height, in_height, height_scale, ys.data());
     ComputeInterpolationWeights(out_width, in_width, width_scale, xs.data());
 
-    ResizeImage(input_data, batch, in_height, in_width, out_height, out_width,
-                channels, xs, ys, output_data);
+    if (nhwc) {
+      ResizeImageNHWC(input_data, batch, in_height, in_width, out_height,
+                      out_width, channels, xs, ys, output_data);
+    } else {
+      ResizeImage(input_data, batch, in_height, in_width, out_height,
+                  out_width, channels, xs, ys, output_data);
+    }
 
     return MACE_SUCCESS;
   }
+
+  const DataFormat data_format_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
 template<typename T>
 struct ResizeBilinearFunctor<DeviceType::GPU, T>
     : ResizeBilinearFunctorBase {
-  ResizeBilinearFunctor(const std::vector<index_t> &size, bool align_corners)
-      : ResizeBilinearFunctorBase(size, align_corners) {}
+  ResizeBilinearFunctor(const std::vector<index_t> &size,
+                        bool align_corners,
+                        const DataFormat data_format)
+      : ResizeBilinearFunctorBase(size, align_corners) {
+    // images are always NHWC
+    MACE_UNUSED(data_format);
+  }
 
   MaceStatus operator()(const Tensor *input,
                         Tensor *output,
@@ -0,0 +1,331 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/kernels/depthwise_conv2d_simd.h"
+#include "mace/kernels/separable_conv2d.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+const int kBlockSize = 8;
+
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+// The depthwise output of a tile stays in l2 cache next to the pointwise
+// filter until the gemm consumes it.
+const index_t kTileBytes = 64 * 1024;
+
+// At least one 16 column block of the gemm, small maps have narrow rows.
+index_t TileRows(const index_t *mid_shape) {
+  const index_t row_bytes = mid_shape[1] * mid_shape[3] * sizeof(float);
+  const index_t min_rows = RoundUpDiv<index_t>(2 * kBlockSize, mid_shape[3]);
+  return std::min(mid_shape[2],
+                  std::max(min_rows, kTileBytes / row_bytes));
+}
+
+// Activation of a tile, the whole op runs inside one parallel region.
+void Activate(const ActivationType type,
+              const float relux_max_limit,
+              const index_t size,
+              float *data) {
+  switch (type) {
+    case NOOP:
+      break;
+    case RELU:
+      for (index_t i = 0; i < size; ++i) {
+        data[i] = std::max(data[i], 0.f);
+      }
+      break;
+    case RELUX:
+      for (index_t i = 0; i < size; ++i) {
+        data[i] = std::min(std::max(data[i], 0.f), relux_max_limit);
+      }
+      break;
+    case TANH:
+      for (index_t i = 0; i < size; ++i) {
+        data[i] = std::tanh(data[i]);
+      }
+      break;
+    case SIGMOID:
+      for (index_t i = 0; i < size; ++i) {
+        data[i] = 1 / (1 + std::exp(-data[i]));
+      }
+      break;
+    default:
+      LOG(FATAL) << "Unknown activation type: " << type;
+  }
+}
+
+// Four output channels of 16 columns, the columns starting at col.
+__attribute__((always_inline))
+inline void PointwiseBlock4(const float *filter,
+                            const float *bias,
+                            const float *input,
+                            const index_t channels,
+                            const index_t tile_size,
+                            const index_t col,
+                            const index_t out_image_size,
+                            float *output) {
+  const float *f0 = filter;
+  const float *f1 = f0 + channels;
+  const float *f2 = f1 + channels;
+  const float *f3 = f2 + channels;
+  Block c00 = {}, c01 = {}, c10 = {}, c11 = {};
+  Block c20 = {}, c21 = {}, c30 = {}, c31 = {};
+  for (index_t c = 0; c < channels; ++c) {
+    const Block &v0 = AsBlock(input + c * tile_size + col);
+    const Block &v1 = AsBlock(input + c * tile_size + col + kBlockSize);
+    c00 += v0 * f0[c];
+    c01 += v1 * f0[c];
+    c10 += v0 * f1[c];
+    c11 += v1 * f1[c];
+    c20 += v0 * f2[c];
+    c21 += v1 * f2[c];
+    c30 += v0 * f3[c];
+    c31 += v1 * f3[c];
+  }
+  float *out0 = output + col;
+  float *out1 = out0 + out_image_size;
+  float *out2 = out1 + out_image_size;
+  float *out3 = out2 + out_image_size;
+  AsBlock(out0) = c00 + bias[0];
+  AsBlock(out0 + kBlockSize) = c01 + bias[0];
+  AsBlock(out1) = c10 + bias[1];
+  AsBlock(out1 + kBlockSize) = c11 + bias[1];
+  AsBlock(out2) = c20 + bias[2];
+  AsBlock(out2 + kBlockSize) = c21 + bias[2];
+  AsBlock(out3) = c30 + bias[3];
+  AsBlock(out3 + kBlockSize) = c31 + bias[3];
+}
+
+// One output channel of kBlockSize columns starting at col.
+__attribute__((always_inline))
+inline void PointwiseBlock1(const float *filter,
+                            const float bias,
+                            const float *input,
+                            const index_t channels,
+                            const index_t tile_size,
+                            const index_t col,
+                            float *output) {
+  Block sum = {};
+  for (index_t c = 0; c < channels; ++c) {
+    sum += AsBlock(input + c * tile_size + col) * filter[c];
+  }
+  AsBlock(output + col) = sum + bias;
+}
+
+// [O][C] * [C][tile_size] => the tile of each output plane; the last
+// columns overlap the previous block instead of a scalar tail.
+__attribute__((always_inline))
+inline void PointwiseTileImpl(const float *filter,
+                              const float *bias,
+                              const float *input,
+                              const index_t out_channels,
+                              const index_t channels,
+                              const index_t tile_size,
+                              const index_t out_image_size,
+                              float *output) {
+  if (tile_size < kBlockSize) {
+    for (index_t o = 0; o < out_channels; ++o) {
+      for (index_t t = 0; t < tile_size; ++t) {
+        float sum = bias[o];
+        for (index_t c = 0; c < channels; ++c) {
+          sum += filter[o * channels + c] * input[c * tile_size + t];
+        }
+        output[o * out_image_size + t] = sum;
+      }
+    }
+    return;
+  }
+
+  index_t o = 0;
+  if (tile_size >= 2 * kBlockSize) {
+    for (; o + 4 <= out_channels; o += 4) {
+      float *out = output + o * out_image_size;
+      index_t t = 0;
+      for (; t + 2 * kBlockSize <= tile_size; t += 2 * kBlockSize) {
+        PointwiseBlock4(filter + o * channels, bias + o, input, channels,
+                        tile_size, t, out_image_size, out);
+      }
+      if (t < tile_size) {
+        PointwiseBlock4(filter + o * channels, bias + o, input, channels,
+                        tile_size, tile_size - 2 * kBlockSize,
+                        out_image_size, out);
+      }
+    }
+  }
+  for (; o < out_channels; ++o) {
+    float *out = output + o * out_image_size;
+    index_t t = 0;
+    for (; t + kBlockSize <= tile_size; t += kBlockSize) {
+      PointwiseBlock1(filter + o * channels, bias[o], input, channels,
+                      tile_size, t, out);
+    }
+    if (t < tile_size) {
+      PointwiseBlock1(filter + o * channels, bias[o], input, channels,
+                      tile_size, tile_size - kBlockSize, out);
+    }
+  }
+}
+
+typedef void (*PointwiseTileFunc)(const float *filter,
+                                  const float *bias,
+                                  const float *input,
+                                  const index_t out_channels,
+                                  const index_t channels,
+                                  const index_t tile_size,
+                                  const index_t out_image_size,
+                                  float *output);
+
+void PointwiseTile(const float *filter,
+                   const float *bias,
+                   const float *input,
+                   const index_t out_channels,
+                   const index_t channels,
+                   const index_t tile_size,
+                   const index_t out_image_size,
+                   float *output) {
+  PointwiseTileImpl(filter, bias, input, out_channels, channels, tile_size,
+                    out_image_size, output);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+MACE_AVX2_TARGET void PointwiseTileAvx2(const float *filter,
+                                        const float *bias,
+                                        const float *input,
+                                        const index_t out_channels,
+                                        const index_t channels,
+                                        const index_t tile_size,
+                                        const index_t out_image_size,
+                                        float *output) {
+  PointwiseTileImpl(filter, bias, input, out_channels, channels, tile_size,
+                    out_image_size, output);
+}
+#endif
+}  // namespace
+
+bool SeparableConv2dSupported(const index_t *depthwise_filter_shape,
+                              const int *strides) {
+  return DepthwiseConv2dRowsSimdKernel(depthwise_filter_shape[2],
+                                       depthwise_filter_shape[3],
+                                       strides[0], strides[1]) != nullptr;
+}
+
+index_t SeparableConv2dBufferSize(const index_t *mid_shape) {
+  return GetOpenMPMaxThreads() * mid_shape[1] * TileRows(mid_shape)
+      * mid_shape[3];
+}
+
+void SeparableConv2d(const float *input,
+                     const float *depthwise_filter,
+                     const float *depthwise_bias,
+                     const float *pointwise_filter,
+                     const float *pointwise_bias,
+                     const index_t *in_shape,
+                     const index_t *depthwise_filter_shape,
+                     const index_t *mid_shape,
+                     const index_t *out_shape,
+                     const int *strides,
+                     const int *dilations,
+                     const int *pad_hw,
+                     const ActivationType depthwise_activation,
+                     const float depthwise_relux_max_limit,
+                     const ActivationType activation,
+                     const float relux_max_limit,
+                     float *buffer,
+                     float *output) {
+  const index_t filter_height = depthwise_filter_shape[2];
+  const index_t filter_width = depthwise_filter_shape[3];
+  const DepthwiseConv2dRowsSimdFunc depthwise_func =
+      DepthwiseConv2dRowsSimdKernel(filter_height, filter_width,
+                                    strides[0], strides[1]);
+  MACE_CHECK(depthwise_func != nullptr,
+             "separable convolution does not support the depthwise filter");
+  PointwiseTileFunc pointwise_func = PointwiseTile;
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuSupportsAvx2()) {
+    pointwise_func = PointwiseTileAvx2;
+  }
+#endif
+
+  const index_t in_channels = in_shape[1];
+  const index_t mid_channels = mid_shape[1];
+  const index_t multiplier = mid_channels / in_channels;
+  const index_t out_channels = out_shape[1];
+  const index_t height = mid_shape[2];
+  const index_t width = mid_shape[3];
+  const index_t in_hw[2] = {in_shape[2], in_shape[3]};
+  const index_t out_hw[2] = {height, width};
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_image_size = height * width;
+  const index_t tile_rows = TileRows(mid_shape);
+  const index_t tile_count = RoundUpDiv(height, tile_rows);
+  const index_t buffer_size = mid_channels * tile_rows * width;
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < in_shape[0]; ++b) {
+    for (index_t i = 0; i < tile_count; ++i) {
+      const index_t row_begin = i * tile_rows;
+      const index_t row_end = std::min(height, row_begin + tile_rows);
+      const index_t tile_size = (row_end - row_begin) * width;
+      float *tile = buffer + GetOpenMPThreadNum() * buffer_size;
+
+      for (index_t m = 0; m < mid_channels; ++m) {
+        const index_t c = m / multiplier;
+        const index_t o = m % multiplier;
+        float *mid = tile + m * tile_size;
+        depthwise_func(input + (b * in_channels + c) * in_image_size,
+                       depthwise_filter + (o * in_channels + c)
+                           * filter_height * filter_width,
+                       in_hw, out_hw, dilations, pad_hw, row_begin, row_end,
+                       mid);
+        for (index_t t = 0; t < tile_size; ++t) {
+          mid[t] += depthwise_bias[m];
+        }
+        Activate(depthwise_activation, depthwise_relux_max_limit, tile_size,
+                 mid);
+      }
+
+      float *out = output + b * out_channels * out_image_size
+          + row_begin * width;
+      pointwise_func(pointwise_filter, pointwise_bias, tile, out_channels,
+                     mid_channels, tile_size, out_image_size, out);
+      if (activation != NOOP) {
+        for (index_t o = 0; o < out_channels; ++o) {
+          Activate(activation, relux_max_limit, tile_size,
+                   out + o * out_image_size);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
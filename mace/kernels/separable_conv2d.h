@@ -0,0 +1,185 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_SEPARABLE_CONV2D_H_
+#define MACE_KERNELS_SEPARABLE_CONV2D_H_
+
+#include <vector>
+
+#include "mace/core/future.h"
+#include "mace/core/tensor.h"
+#include "mace/kernels/activation.h"
+#include "mace/kernels/conv_pool_2d_util.h"
+
+// Depthwise convolution followed by a 1x1 convolution, as the converter
+// fuses them. The depthwise output is computed a few rows at a time and
+// consumed by the pointwise gemm while it is still in cache, so the
+// intermediate tensor is never written to memory.
+
+namespace mace {
+namespace kernels {
+
+// Whether the depthwise filter ([multiplier][C][H][W]) and strides have a
+// kernel; the converter only fuses such pairs.
+bool SeparableConv2dSupported(const index_t *depthwise_filter_shape,
+                              const int *strides);
+
+// Number of floats SeparableConv2d needs in its buffer, for all threads;
+// mid_shape is the NCHW shape of the depthwise output.
+index_t SeparableConv2dBufferSize(const index_t *mid_shape);
+
+// input and output are NCHW, pointwise_filter is [O][C * multiplier].
+void SeparableConv2d(const float *input,
+                     const float *depthwise_filter,
+                     const float *depthwise_bias,
+                     const float *pointwise_filter,
+                     const float *pointwise_bias,
+                     const index_t *in_shape,
+                     const index_t *depthwise_filter_shape,
+                     const index_t *mid_shape,
+                     const index_t *out_shape,
+                     const int *strides,
+                     const int *dilations,
+                     const int *pad_hw,
+                     const ActivationType depthwise_activation,
+                     const float depthwise_relux_max_limit,
+                     const ActivationType activation,
+                     const float relux_max_limit,
+                     float *buffer,
+                     float *output);
+
+template<DeviceType D, typename T>
+struct SeparableConv2dFunctor;
+
+template<>
+struct SeparableConv2dFunctor<DeviceType::CPU, float> {
+  SeparableConv2dFunctor(const int *strides,
+                         const Padding padding_type,
+                         const std::vector<int> &paddings,
+                         const int *dilations,
+                         const ActivationType depthwise_activation,
+                         const float depthwise_relux_max_limit,
+                         const ActivationType activation,
+                         const float relux_max_limit,
+                         ScratchBuffer *scratch)
+    : strides_(strides),
+      padding_type_(padding_type),
+      paddings_(paddings),
+      dilations_(dilations),
+      depthwise_activation_(depthwise_activation),
+      depthwise_relux_max_limit_(depthwise_relux_max_limit),
+      activation_(activation),
+      relux_max_limit_(relux_max_limit),
+      scratch_(scratch) {}
+
+  MaceStatus operator()(const Tensor *input,
+                        const Tensor *depthwise_filter,
+                        const Tensor *depthwise_bias,
+                        const Tensor *pointwise_filter,
+                        const Tensor *pointwise_bias,
+                        Tensor *output,
+                        StatsFuture *future) {
+    MACE_UNUSED(future);
+    MACE_CHECK(input->dim_size() == 4, "separable convolution needs NCHW");
+    const std::vector<index_t> &in_shape = input->shape();
+    const std::vector<index_t> &depthwise_filter_shape =
+        depthwise_filter->shape();
+    MACE_CHECK(depthwise_filter_shape[1] == in_shape[1],
+               depthwise_filter_shape[1], " != ", in_shape[1]);
+    const index_t mid_channels =
+        depthwise_filter_shape[0] * depthwise_filter_shape[1];
+    MACE_CHECK(pointwise_filter->dim(1) == mid_channels
+                   && pointwise_filter->dim(2) == 1
+                   && pointwise_filter->dim(3) == 1,
+               "pointwise filter must be [O][", mid_channels, "][1][1]");
+    MACE_CHECK(SeparableConv2dSupported(depthwise_filter_shape.data(),
+                                        strides_),
+               "separable convolution does not support the depthwise filter");
+
+    std::vector<index_t> mid_shape(4);
+    std::vector<int> paddings(2);
+    const index_t filter_shape[4] = {mid_channels, in_shape[1],
+                                     depthwise_filter_shape[2],
+                                     depthwise_filter_shape[3]};
+    if (paddings_.empty()) {
+      CalcNCHWPaddingAndOutputSize(in_shape.data(),
+                                   filter_shape,
+                                   dilations_,
+                                   strides_,
+                                   padding_type_,
+                                   mid_shape.data(),
+                                   paddings.data());
+    } else {
+      paddings = paddings_;
+      CalcNCHWOutputSize(in_shape.data(),
+                         filter_shape,
+                         paddings_.data(),
+                         dilations_,
+                         strides_,
+                         RoundType::FLOOR,
+                         mid_shape.data());
+    }
+    std::vector<index_t> output_shape = mid_shape;
+    output_shape[1] = pointwise_filter->dim(0);
+    MACE_RETURN_IF_ERROR(output->Resize(output_shape));
+
+    const index_t buffer_size =
+        SeparableConv2dBufferSize(mid_shape.data()) * sizeof(float);
+    scratch_->Rewind();
+    MACE_RETURN_IF_ERROR(scratch_->GrowSize(buffer_size));
+    Tensor buffer(scratch_->Scratch(buffer_size), DT_FLOAT);
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard depthwise_filter_guard(depthwise_filter);
+    Tensor::MappingGuard depthwise_bias_guard(depthwise_bias);
+    Tensor::MappingGuard pointwise_filter_guard(pointwise_filter);
+    Tensor::MappingGuard pointwise_bias_guard(pointwise_bias);
+    Tensor::MappingGuard output_guard(output);
+    const int pad_hw[2] = {paddings[0] >> 1, paddings[1] >> 1};
+    SeparableConv2d(input->data<float>(),
+                    depthwise_filter->data<float>(),
+                    depthwise_bias->data<float>(),
+                    pointwise_filter->data<float>(),
+                    pointwise_bias->data<float>(),
+                    in_shape.data(),
+                    depthwise_filter_shape.data(),
+                    mid_shape.data(),
+                    output_shape.data(),
+                    strides_,
+                    dilations_,
+                    pad_hw,
+                    depthwise_activation_,
+                    depthwise_relux_max_limit_,
+                    activation_,
+                    relux_max_limit_,
+                    buffer.mutable_data<float>(),
+                    output->mutable_data<float>());
+    return MACE_SUCCESS;
+  }
+
+  const int *strides_;  // [stride_h, stride_w]
+  const Padding padding_type_;
+  std::vector<int> paddings_;
+  const int *dilations_;  // [dilation_h, dilation_w]
+  const ActivationType depthwise_activation_;
+  const float depthwise_relux_max_limit_;
+  const ActivationType activation_;
+  const float relux_max_limit_;
+  ScratchBuffer *scratch_;
+};
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_SEPARABLE_CONV2D_H_
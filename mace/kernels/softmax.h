@@ -38,6 +38,9 @@ struct SoftmaxFunctor;
 
 template<>
 struct SoftmaxFunctor<DeviceType::CPU, float> {
+  explicit SoftmaxFunctor(const DataFormat data_format)
+      : data_format_(data_format) {}
+
   MaceStatus operator()(const Tensor *input,
                         Tensor *output,
                         StatsFuture *future) {
@@ -48,7 +51,7 @@ struct SoftmaxFunctor<DeviceType::CPU, float> {
     float *output_data = output->mutable_data<float>();
 
     // softmax for nchw image
-    if (input->dim_size() == 4) {
+    if (input->dim_size() == 4 && data_format_ != NHWC) {
       const index_t batch = input->dim(0);
       const index_t class_count = input->dim(1);
       const index_t class_size = input->dim(2) * input->dim(3);
@@ -87,9 +90,10 @@ struct SoftmaxFunctor<DeviceType::CPU, float> {
           }
         }  // k
       }  // b
-    } else if (input->dim_size() == 2) {  // normal 2d softmax
-      const index_t class_size = input->dim(0);
-      const index_t class_count = input->dim(1);
+    } else if (input->dim_size() == 2 || input->dim_size() == 4) {
+      // normal 2d softmax, nhwc image is softmax of its pixel rows
+      const index_t class_count = input->dim(input->dim_size() - 1);
+      const index_t class_size = input->size() / class_count;
 #pragma omp parallel for
       for (index_t k = 0; k < class_size; ++k) {
         const float *input_ptr = input_data + k * class_count;
@@ -118,11 +122,18 @@ struct SoftmaxFunctor<DeviceType::CPU, float> {
 
     return MACE_SUCCESS;
   }
+
+  const DataFormat data_format_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
 template<typename T>
 struct SoftmaxFunctor<DeviceType::GPU, T> {
+  explicit SoftmaxFunctor(const DataFormat data_format) {
+    // images are always NHWC
+    MACE_UNUSED(data_format);
+  }
+
   MaceStatus operator()(const Tensor *logits,
                         Tensor *output,
                         StatsFuture *future);
@@ -0,0 +1,453 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/conv_epilogue.h"
+#include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/depthwise_conv2d_simd.h"
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/pooling.h"
+#include "mace/kernels/tiled_chain.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// Rows or columns [begin, end) of the input of a layer that its outputs
+// [out_begin, out_end) read, the rest of their windows is padding.
+void InputRange(const TiledChainLayer &layer,
+                const int axis,
+                const index_t out_begin,
+                const index_t out_end,
+                index_t *begin,
+                index_t *end) {
+  const int pad = layer.padding_hw[axis] >> 1;
+  const index_t in_size = layer.in_shape[2 + axis];
+  const index_t window =
+      (layer.kernel_hw[axis] - 1) * layer.dilation_hw[axis] + 1;
+  *begin = std::min(in_size, std::max<index_t>(
+      0, out_begin * layer.stride_hw[axis] - pad));
+  *end = std::max(*begin, std::min(
+      in_size, (out_end - 1) * layer.stride_hw[axis] - pad + window));
+}
+
+// Largest extent of the input window of a layer for extent outputs.
+index_t InputExtent(const TiledChainLayer &layer,
+                    const int axis,
+                    const index_t extent) {
+  const index_t window =
+      (layer.kernel_hw[axis] - 1) * layer.dilation_hw[axis] + 1;
+  return std::min(layer.in_shape[2 + axis],
+                  (extent - 1) * layer.stride_hw[axis] + window);
+}
+
+// Extents of the windows of all tensors of the chain for an output tile,
+// the input of layer i is tensor i and the output is the last.
+void WindowExtents(const std::vector<TiledChainLayer> &layers,
+                   const index_t *tile_hw,
+                   index_t (*extents)[2]) {
+  const size_t count = layers.size();
+  for (int axis = 0; axis < 2; ++axis) {
+    extents[count][axis] =
+        std::min(tile_hw[axis], layers.back().out_shape[2 + axis]);
+    for (size_t i = count; i > 0; --i) {
+      extents[i - 1][axis] =
+          InputExtent(layers[i - 1], axis, extents[i][axis]);
+    }
+  }
+}
+
+// 1x1 convolutions of stride 1 without padding read their input window as
+// it is, which needs no im2col.
+bool IsPointwise(const TiledChainLayer &layer) {
+  return layer.type == TILED_CONV_2D && layer.kernel_hw[0] == 1
+      && layer.kernel_hw[1] == 1 && layer.stride_hw[0] == 1
+      && layer.stride_hw[1] == 1 && layer.padding_hw[0] == 0
+      && layer.padding_hw[1] == 0;
+}
+
+index_t Im2ColSize(const TiledChainLayer &layer, const index_t out_size) {
+  return Im2ColBufferSize(layer.filter_shape, out_size,
+                          Im2ColTileSize(layer.filter_shape, out_size));
+}
+
+// Floats of the two window buffers, then of the im2col buffer of the
+// convolutions without an avx2 kernel.
+void ThreadBufferSizes(const std::vector<TiledChainLayer> &layers,
+                       const index_t *tile_hw,
+                       index_t *window_size,
+                       index_t *im2col_size) {
+  index_t extents[kTiledChainMaxLayers + 1][2];
+  WindowExtents(layers, tile_hw, extents);
+  *window_size = 0;
+  *im2col_size = 0;
+  for (size_t i = 0; i <= layers.size(); ++i) {
+    const index_t channels = i < layers.size() ? layers[i].in_shape[1]
+                                               : layers.back().out_shape[1];
+    *window_size = std::max(*window_size,
+                            channels * extents[i][0] * extents[i][1]);
+    if (i < layers.size() && layers[i].type == TILED_CONV_2D
+        && !IsPointwise(layers[i])
+        && Conv2dAvx2Kernel(layers[i].kernel_hw[0], layers[i].kernel_hw[1],
+                            layers[i].stride_hw[0], layers[i].stride_hw[1])
+            == nullptr) {
+      *im2col_size = std::max(
+          *im2col_size,
+          Im2ColSize(layers[i], extents[i + 1][0] * extents[i + 1][1]));
+    }
+  }
+}
+
+// Multiply-adds per output of a layer, pooling counts its compares.
+index_t LayerCost(const TiledChainLayer &layer) {
+  const index_t taps = layer.kernel_hw[0] * layer.kernel_hw[1];
+  const index_t channels = layer.out_shape[1];
+  return layer.type == TILED_CONV_2D ? channels * layer.filter_shape[1] * taps
+                                     : channels * taps;
+}
+
+// Rows of the channels of src to dst, each has its own channel and row
+// strides.
+void CopyRows(const float *src,
+              const index_t src_channel_stride,
+              const index_t src_row_stride,
+              const index_t channels,
+              const index_t height,
+              const index_t width,
+              const index_t dst_channel_stride,
+              const index_t dst_row_stride,
+              float *dst) {
+  for (index_t c = 0; c < channels; ++c) {
+    for (index_t h = 0; h < height; ++h) {
+      memcpy(dst + c * dst_channel_stride + h * dst_row_stride,
+             src + c * src_channel_stride + h * src_row_stride,
+             width * sizeof(float));
+    }
+  }
+}
+
+// One layer from the window of its input to the window of its output; both
+// are [1][C][H][W], pad_hw is how far the windows of the first outputs
+// start above and left of the input window.
+void RunLayer(const TiledChainLayer &layer,
+              const Conv2dAvx2Func avx2_func,
+              const float *input,
+              const index_t *in_shape,
+              const index_t *out_shape,
+              const int *pad_hw,
+              float *im2col,
+              float *output) {
+  ConvEpilogue epilogue;
+  epilogue.bias = layer.bias;
+  epilogue.activation = layer.activation;
+  epilogue.relux_max_limit = layer.relux_max_limit;
+  const ConvEpilogue *kernel_epilogue =
+      IsNoopEpilogue(epilogue) ? nullptr : &epilogue;
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+
+  switch (layer.type) {
+    case TILED_CONV_2D:
+      if (IsPointwise(layer)) {
+        // the window is the matrix of the input channels
+        Gemm(layer.filter, input, 1, out_shape[1], in_shape[1],
+             out_image_size, output);
+        break;
+      }
+      if (avx2_func != nullptr) {
+        avx2_func(input, layer.filter, in_shape, out_shape, pad_hw,
+                  layer.dilation_hw, kernel_epilogue, output);
+      } else {
+        Im2ColConv(input, layer.filter, in_shape, out_shape,
+                   layer.filter_shape, layer.stride_hw, layer.dilation_hw,
+                   pad_hw, Im2ColTileSize(layer.filter_shape,
+                                          out_image_size),
+                   im2col, output, kernel_epilogue);
+      }
+      // the kernels apply the epilogue
+      return;
+    case TILED_DEPTHWISE_CONV_2D:
+      DepthwiseConv2dSimdKernel(layer.kernel_hw[0], layer.kernel_hw[1],
+                                layer.stride_hw[0], layer.stride_hw[1])(
+          input, layer.filter, in_shape, out_shape, layer.dilation_hw,
+          pad_hw, output);
+      break;
+    case TILED_MAX_POOLING:
+      PoolingFunctor<DeviceType::CPU, float>::MaxPooling(
+          input, in_shape, out_shape, layer.kernel_hw, layer.stride_hw,
+          layer.dilation_hw, pad_hw, output);
+      break;
+    case TILED_AVG_POOLING:
+      PoolingFunctor<DeviceType::CPU, float>::AvgPooling(
+          input, in_shape, out_shape, layer.kernel_hw, layer.stride_hw,
+          layer.dilation_hw, pad_hw, output);
+      break;
+    default:
+      LOG(FATAL) << "Unknown tiled chain layer type: " << layer.type;
+  }
+  if (kernel_epilogue != nullptr) {
+    for (index_t c = 0; c < out_shape[1]; ++c) {
+      float *out = output + c * out_image_size;
+      ApplyConvEpilogue(epilogue, c, 0, out, out_image_size, out);
+    }
+  }
+}
+}  // namespace
+
+MaceStatus TiledChainLayers(
+    const std::vector<int> &types,
+    const std::vector<int> &kernels,
+    const std::vector<int> &strides,
+    const std::vector<int> &dilations,
+    const std::vector<int> &paddings,
+    const std::vector<int> &activations,
+    const std::vector<float> &max_limits,
+    const std::vector<std::vector<index_t>> &filter_shapes,
+    std::vector<TiledChainLayer> *layers) {
+  const size_t count = types.size();
+  if (count == 0 || count > kTiledChainMaxLayers
+      || kernels.size() != 2 * count || strides.size() != 2 * count
+      || dilations.size() != 2 * count || paddings.size() != 2 * count
+      || activations.size() != count || max_limits.size() != count) {
+    return MACE_INVALID_ARGS;
+  }
+  layers->resize(count);
+  size_t filter = 0;
+  for (size_t i = 0; i < count; ++i) {
+    TiledChainLayer &layer = (*layers)[i];
+    if (types[i] < TILED_CONV_2D || types[i] > TILED_AVG_POOLING) {
+      return MACE_INVALID_ARGS;
+    }
+    layer.type = static_cast<TiledChainLayerType>(types[i]);
+    for (int axis = 0; axis < 2; ++axis) {
+      layer.kernel_hw[axis] = kernels[2 * i + axis];
+      layer.stride_hw[axis] = strides[2 * i + axis];
+      layer.dilation_hw[axis] = dilations[2 * i + axis];
+      layer.padding_hw[axis] = paddings[2 * i + axis];
+    }
+    layer.activation = static_cast<ActivationType>(activations[i]);
+    layer.relux_max_limit = max_limits[i];
+    std::fill(layer.filter_shape, layer.filter_shape + 4, 0);
+    layer.filter = nullptr;
+    layer.bias = nullptr;
+    if (layer.type == TILED_CONV_2D
+        || layer.type == TILED_DEPTHWISE_CONV_2D) {
+      if (filter >= filter_shapes.size()
+          || filter_shapes[filter].size() != 4) {
+        return MACE_INVALID_ARGS;
+      }
+      std::copy(filter_shapes[filter].begin(), filter_shapes[filter].end(),
+                layer.filter_shape);
+      ++filter;
+    }
+    if (layer.type == TILED_DEPTHWISE_CONV_2D
+        && (layer.stride_hw[0] != layer.stride_hw[1]
+            || DepthwiseConv2dSimdKernel(layer.kernel_hw[0],
+                                         layer.kernel_hw[1],
+                                         layer.stride_hw[0],
+                                         layer.stride_hw[1]) == nullptr)) {
+      return MACE_INVALID_ARGS;
+    }
+  }
+  return MACE_SUCCESS;
+}
+
+MaceStatus TiledChainShapes(const index_t *in_shape,
+                            std::vector<TiledChainLayer> *layers) {
+  const index_t *shape = in_shape;
+  for (TiledChainLayer &layer : *layers) {
+    std::copy(shape, shape + 4, layer.in_shape);
+    const index_t channels = shape[1];
+    index_t out_channels = channels;
+    if (layer.type == TILED_CONV_2D
+        || layer.type == TILED_DEPTHWISE_CONV_2D) {
+      if (layer.filter_shape[1] != channels) {
+        return MACE_INVALID_ARGS;
+      }
+      out_channels = layer.type == TILED_CONV_2D
+                     ? layer.filter_shape[0]
+                     : layer.filter_shape[0] * channels;
+    }
+    const index_t filter_shape[4] = {out_channels, channels,
+                                     layer.kernel_hw[0], layer.kernel_hw[1]};
+    const bool pooling = layer.type == TILED_MAX_POOLING
+        || layer.type == TILED_AVG_POOLING;
+    CalcNCHWOutputSize(shape, filter_shape, layer.padding_hw,
+                       layer.dilation_hw, layer.stride_hw,
+                       pooling ? RoundType::CEIL : RoundType::FLOOR,
+                       layer.out_shape);
+    if (layer.out_shape[2] <= 0 || layer.out_shape[3] <= 0) {
+      return MACE_INVALID_ARGS;
+    }
+    shape = layer.out_shape;
+  }
+  return MACE_SUCCESS;
+}
+
+void TiledChainTileSize(const std::vector<TiledChainLayer> &layers,
+                        const index_t cache_bytes,
+                        index_t *tile_hw) {
+  const index_t out_height = layers.back().out_shape[2];
+  const index_t out_width = layers.back().out_shape[3];
+  const index_t budget = cache_bytes / 2 / sizeof(float);
+  index_t layer_costs = 0;
+  for (const TiledChainLayer &layer : layers) {
+    layer_costs += LayerCost(layer);
+  }
+
+  // the window buffers hold two windows, im2col buffers are not counted as
+  // their gemm streams them
+  tile_hw[0] = 1;
+  tile_hw[1] = std::min<index_t>(16, out_width);
+  double best_cost = std::numeric_limits<double>::max();
+  for (index_t width : {out_width, index_t(256), index_t(128), index_t(64),
+                        index_t(32), index_t(16)}) {
+    if (width > out_width || (width != out_width && width % 16 != 0)) {
+      continue;
+    }
+    index_t height = 0;
+    for (index_t h = 1; h <= out_height; ++h) {
+      const index_t candidate[2] = {h, width};
+      index_t window_size;
+      index_t im2col_size;
+      ThreadBufferSizes(layers, candidate, &window_size, &im2col_size);
+      if (2 * window_size > budget) break;
+      height = h;
+    }
+    if (height == 0) continue;
+
+    // work of all layers over the windows of a tile, per output
+    const index_t tile[2] = {height, width};
+    index_t extents[kTiledChainMaxLayers + 1][2];
+    WindowExtents(layers, tile, extents);
+    double cost = 0;
+    for (size_t i = 0; i < layers.size(); ++i) {
+      cost += static_cast<double>(LayerCost(layers[i])) * extents[i + 1][0]
+          * extents[i + 1][1];
+    }
+    cost /= static_cast<double>(height * width) * layer_costs;
+    if (cost < best_cost) {
+      best_cost = cost;
+      tile_hw[0] = height;
+      tile_hw[1] = width;
+    }
+  }
+}
+
+index_t TiledChainBufferSize(const std::vector<TiledChainLayer> &layers,
+                             const index_t *tile_hw) {
+  index_t window_size;
+  index_t im2col_size;
+  ThreadBufferSizes(layers, tile_hw, &window_size, &im2col_size);
+  return GetOpenMPMaxThreads() * (2 * window_size + im2col_size);
+}
+
+void TiledChain(const float *input,
+                const std::vector<TiledChainLayer> &layers,
+                const index_t *tile_hw,
+                float *buffer,
+                float *output) {
+  const size_t count = layers.size();
+  const TiledChainLayer &first = layers.front();
+  const TiledChainLayer &last = layers.back();
+  Conv2dAvx2Func avx2_funcs[kTiledChainMaxLayers];
+  for (size_t i = 0; i < count; ++i) {
+    const TiledChainLayer &layer = layers[i];
+    avx2_funcs[i] = layer.type != TILED_CONV_2D ? nullptr
+        : Conv2dAvx2Kernel(layer.kernel_hw[0], layer.kernel_hw[1],
+                           layer.stride_hw[0], layer.stride_hw[1]);
+  }
+  index_t window_size;
+  index_t im2col_size;
+  ThreadBufferSizes(layers, tile_hw, &window_size, &im2col_size);
+  const index_t thread_buffer_size = 2 * window_size + im2col_size;
+  const index_t in_batch_size =
+      first.in_shape[1] * first.in_shape[2] * first.in_shape[3];
+  const index_t out_batch_size =
+      last.out_shape[1] * last.out_shape[2] * last.out_shape[3];
+  const index_t tile_rows = RoundUpDiv(last.out_shape[2], tile_hw[0]);
+  const index_t tile_cols = RoundUpDiv(last.out_shape[3], tile_hw[1]);
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < first.in_shape[0]; ++b) {
+    for (index_t i = 0; i < tile_rows; ++i) {
+      for (index_t j = 0; j < tile_cols; ++j) {
+        float *thread_buffer =
+            buffer + GetOpenMPThreadNum() * thread_buffer_size;
+        float *windows[2] = {thread_buffer, thread_buffer + window_size};
+        float *im2col = thread_buffer + 2 * window_size;
+
+        // window [begin, end) of each tensor on each axis, from the output
+        // tile back to the input
+        index_t rows[kTiledChainMaxLayers + 1][2];
+        index_t cols[kTiledChainMaxLayers + 1][2];
+        rows[count][0] = i * tile_hw[0];
+        rows[count][1] = std::min(last.out_shape[2], rows[count][0]
+            + tile_hw[0]);
+        cols[count][0] = j * tile_hw[1];
+        cols[count][1] = std::min(last.out_shape[3], cols[count][0]
+            + tile_hw[1]);
+        for (size_t l = count; l > 0; --l) {
+          InputRange(layers[l - 1], 0, rows[l][0], rows[l][1],
+                     &rows[l - 1][0], &rows[l - 1][1]);
+          InputRange(layers[l - 1], 1, cols[l][0], cols[l][1],
+                     &cols[l - 1][0], &cols[l - 1][1]);
+        }
+
+        const index_t in_height = first.in_shape[2];
+        const index_t in_width = first.in_shape[3];
+        const index_t window_height = rows[0][1] - rows[0][0];
+        const index_t window_width = cols[0][1] - cols[0][0];
+        CopyRows(input + b * in_batch_size + rows[0][0] * in_width
+                     + cols[0][0],
+                 in_height * in_width, in_width, first.in_shape[1],
+                 window_height, window_width, window_height * window_width,
+                 window_width, windows[0]);
+        for (size_t l = 0; l < count; ++l) {
+          const TiledChainLayer &layer = layers[l];
+          const index_t in_shape[4] = {1, layer.in_shape[1],
+                                       rows[l][1] - rows[l][0],
+                                       cols[l][1] - cols[l][0]};
+          const index_t out_shape[4] = {1, layer.out_shape[1],
+                                        rows[l + 1][1] - rows[l + 1][0],
+                                        cols[l + 1][1] - cols[l + 1][0]};
+          const int pad_hw[2] = {
+              static_cast<int>((layer.padding_hw[0] >> 1) + rows[l][0]
+                  - rows[l + 1][0] * layer.stride_hw[0]),
+              static_cast<int>((layer.padding_hw[1] >> 1) + cols[l][0]
+                  - cols[l + 1][0] * layer.stride_hw[1])};
+          RunLayer(layer, avx2_funcs[l], windows[l % 2], in_shape, out_shape,
+                   pad_hw, im2col, windows[(l + 1) % 2]);
+        }
+        const index_t out_height = last.out_shape[2];
+        const index_t out_width = last.out_shape[3];
+        const index_t tile_height = rows[count][1] - rows[count][0];
+        const index_t tile_width = cols[count][1] - cols[count][0];
+        CopyRows(windows[count % 2], tile_height * tile_width, tile_width,
+                 last.out_shape[1], tile_height, tile_width,
+                 out_height * out_width, out_width,
+                 output + b * out_batch_size + rows[count][0] * out_width
+                     + cols[count][0]);
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,167 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_TILED_CHAIN_H_
+#define MACE_KERNELS_TILED_CHAIN_H_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "mace/core/future.h"
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/core/tensor.h"
+#include "mace/kernels/activation.h"
+
+// A chain of spatially local layers (convolution, depthwise convolution and
+// pooling, each with its bias and activation) as the converter fuses them
+// for large feature maps. The output is computed in tiles: a tile of the
+// last layer pulls the window of each earlier layer it reads, halo
+// included, through two buffers that fit in the l2 cache, so the
+// intermediate tensors are never written to memory. Halos shared by
+// neighbouring tiles are computed by each of them.
+
+namespace mace {
+namespace kernels {
+
+enum TiledChainLayerType {
+  TILED_CONV_2D = 0,
+  TILED_DEPTHWISE_CONV_2D = 1,
+  TILED_MAX_POOLING = 2,
+  TILED_AVG_POOLING = 3,
+};
+
+const int kTiledChainMaxLayers = 8;
+
+struct TiledChainLayer {
+  TiledChainLayerType type;
+  int kernel_hw[2];
+  int stride_hw[2];
+  int dilation_hw[2];
+  int padding_hw[2];  // total padding, top and left get half of it
+  ActivationType activation;
+  float relux_max_limit;
+  // OIHW, [multiplier][C][H][W] for depthwise; unused by pooling
+  index_t filter_shape[4];
+  const float *filter;
+  const float *bias;  // or nullptr
+  // NCHW, set by TiledChainShapes
+  index_t in_shape[4];
+  index_t out_shape[4];
+};
+
+// The layers the per-layer args of the op describe: kernels, strides,
+// dilations and paddings hold two values for each layer. Convolutions take
+// their filter shapes in the order of the layers from filter_shapes.
+MaceStatus TiledChainLayers(
+    const std::vector<int> &types,
+    const std::vector<int> &kernels,
+    const std::vector<int> &strides,
+    const std::vector<int> &dilations,
+    const std::vector<int> &paddings,
+    const std::vector<int> &activations,
+    const std::vector<float> &max_limits,
+    const std::vector<std::vector<index_t>> &filter_shapes,
+    std::vector<TiledChainLayer> *layers);
+
+// Set the shapes of the layers from the input shape of the first, as the
+// ops of the layers with explicit paddings compute them.
+MaceStatus TiledChainShapes(const index_t *in_shape,
+                            std::vector<TiledChainLayer> *layers);
+
+// Output tile {height, width} of the last layer whose windows fit in half of
+// cache_bytes and that computes the least halo work, widths are multiples of
+// 16 or the whole output width.
+void TiledChainTileSize(const std::vector<TiledChainLayer> &layers,
+                        const index_t cache_bytes,
+                        index_t *tile_hw);
+
+// Number of floats TiledChain needs in its buffer, for all threads.
+index_t TiledChainBufferSize(const std::vector<TiledChainLayer> &layers,
+                             const index_t *tile_hw);
+
+// input and output are NCHW, the shapes of the first and the last layer.
+void TiledChain(const float *input,
+                const std::vector<TiledChainLayer> &layers,
+                const index_t *tile_hw,
+                float *buffer,
+                float *output);
+
+template<DeviceType D, typename T>
+struct TiledChainFunctor;
+
+template<>
+struct TiledChainFunctor<DeviceType::CPU, float> {
+  // weighted layers take a filter and a bias from the inputs, in order
+  TiledChainFunctor(const std::vector<TiledChainLayer> &layers,
+                    ScratchBuffer *scratch)
+    : layers_(layers),
+      scratch_(scratch) {}
+
+  MaceStatus operator()(const Tensor *input,
+                        const std::vector<const Tensor *> &weights,
+                        Tensor *output,
+                        StatsFuture *future) {
+    MACE_UNUSED(future);
+    MACE_CHECK(input->dim_size() == 4, "tiled chain needs NCHW");
+    std::vector<std::unique_ptr<Tensor::MappingGuard>> guards;
+    size_t weight = 0;
+    for (TiledChainLayer &layer : layers_) {
+      if (layer.type != TILED_CONV_2D
+          && layer.type != TILED_DEPTHWISE_CONV_2D) {
+        continue;
+      }
+      MACE_CHECK(weight + 2 <= weights.size(),
+                 "tiled chain misses the weights of a layer");
+      const Tensor *filter = weights[weight++];
+      const Tensor *bias = weights[weight++];
+      MACE_CHECK(filter->dim_size() == 4 && bias->dim_size() == 1);
+      std::copy(filter->shape().begin(), filter->shape().end(),
+                layer.filter_shape);
+      guards.emplace_back(new Tensor::MappingGuard(filter));
+      guards.emplace_back(new Tensor::MappingGuard(bias));
+      layer.filter = filter->data<float>();
+      layer.bias = bias->data<float>();
+    }
+    MACE_RETURN_IF_ERROR(TiledChainShapes(input->shape().data(), &layers_));
+    const TiledChainLayer &last = layers_.back();
+    MACE_RETURN_IF_ERROR(output->Resize(std::vector<index_t>(
+        last.out_shape, last.out_shape + 4)));
+
+    index_t tile_hw[2];
+    TiledChainTileSize(layers_, GetCPUL2CacheSize(), tile_hw);
+    const index_t buffer_size =
+        TiledChainBufferSize(layers_, tile_hw) * sizeof(float);
+    scratch_->Rewind();
+    MACE_RETURN_IF_ERROR(scratch_->GrowSize(buffer_size));
+    Tensor buffer(scratch_->Scratch(buffer_size), DT_FLOAT);
+
+    Tensor::MappingGuard input_guard(input);
+    Tensor::MappingGuard output_guard(output);
+    TiledChain(input->data<float>(),
+               layers_,
+               tile_hw,
+               buffer.mutable_data<float>(),
+               output->mutable_data<float>());
+    return MACE_SUCCESS;
+  }
+
+  std::vector<TiledChainLayer> layers_;
+  ScratchBuffer *scratch_;
+};
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_TILED_CHAIN_H_
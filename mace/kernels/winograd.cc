@@ -0,0 +1,618 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/kernels/winograd.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+// Eight tiles are transformed at once, one per lane.
+typedef float Block
+    __attribute__((vector_size(32), aligned(4), __may_alias__));
+const int kBlockSize = 8;
+
+inline const Block &AsBlock(const float *ptr) {
+  return *reinterpret_cast<const Block *>(ptr);
+}
+
+inline Block &AsBlock(float *ptr) {
+  return *reinterpret_cast<Block *>(ptr);
+}
+
+const int kMaxAlpha = 8;
+// Finite interpolation points, infinity is the last one. Larger points lose
+// precision quickly, so alpha stays within 8.
+const float kPoints[kMaxAlpha - 1] = {0.f, 1.f, -1.f, 2.f, -2.f, 0.5f, -0.5f};
+
+// Transformed input and output of a block of tiles fit in half of a typical
+// l2 cache; blocks are multiples of the gemm tile.
+const index_t kTileBlockBytes = 256 * 1024;
+const index_t kTileBlockAlignment = 16;
+const index_t kMaxTileBlock = 256;
+
+// Winograd F(m, r) of one axis, Y = AT * ((G * g) . (BT * d)).
+struct WinogradAxis {
+  int m;
+  int r;
+  int alpha;
+  float AT[kMaxAlpha][kMaxAlpha];  // m x alpha
+  float G[kMaxAlpha][kMaxAlpha];   // alpha x r
+  float BT[kMaxAlpha][kMaxAlpha];  // alpha x alpha
+};
+
+// Toom-Cook: AT evaluates at the points, G scales by the lagrange
+// denominators and BT holds the coefficients of prod(x - p) over all the
+// other points.
+void MakeWinogradAxis(const int m, const int r, WinogradAxis *axis) {
+  const int alpha = m + r - 1;
+  const int points = alpha - 1;
+  axis->m = m;
+  axis->r = r;
+  axis->alpha = alpha;
+  memset(axis->AT, 0, sizeof(axis->AT));
+  memset(axis->G, 0, sizeof(axis->G));
+  memset(axis->BT, 0, sizeof(axis->BT));
+
+  for (int j = 0; j < points; ++j) {
+    double power = 1;
+    for (int i = 0; i < std::max(m, r); ++i) {
+      if (i < m) axis->AT[i][j] = static_cast<float>(power);
+      if (i < r) axis->G[j][i] = static_cast<float>(power);
+      power *= kPoints[j];
+    }
+  }
+  axis->AT[m - 1][alpha - 1] = 1.f;
+  axis->G[alpha - 1][r - 1] = 1.f;
+
+  for (int j = 0; j < alpha; ++j) {
+    double coefficients[kMaxAlpha + 1] = {1};
+    int degree = 0;
+    double denominator = 1;
+    for (int l = 0; l < points; ++l) {
+      if (l == j) continue;
+      // multiply by (x - p_l)
+      for (int i = degree + 1; i > 0; --i) {
+        coefficients[i] = coefficients[i - 1] - coefficients[i] * kPoints[l];
+      }
+      coefficients[0] *= -kPoints[l];
+      ++degree;
+      if (j < points) denominator *= kPoints[j] - kPoints[l];
+    }
+    for (int i = 0; i < alpha; ++i) {
+      axis->BT[j][i] = static_cast<float>(coefficients[i]);
+    }
+    for (int i = 0; i < r && j < points; ++i) {
+      axis->G[j][i] = static_cast<float>(axis->G[j][i] / denominator);
+    }
+  }
+}
+
+bool IsSupportedTaps(const index_t taps) {
+  return taps == 1 || taps == 3 || taps == 5 || taps == 7;
+}
+
+// A single tap axis is not transformed.
+void AxisTileSizes(const index_t taps, std::vector<int> *tile_sizes) {
+  tile_sizes->clear();
+  if (taps == 1) {
+    tile_sizes->push_back(1);
+    return;
+  }
+  for (int m = 2; m + taps - 1 <= kMaxAlpha; m += 2) {
+    tile_sizes->push_back(m);
+  }
+}
+
+index_t TileBlockSize(const index_t *filter_shape,
+                      const int *alpha) {
+  const index_t tile_bytes = alpha[0] * alpha[1]
+      * (filter_shape[0] + filter_shape[1]) * sizeof(float);
+  const index_t tile_block = kTileBlockBytes / tile_bytes
+      / kTileBlockAlignment * kTileBlockAlignment;
+  return std::min(std::max(tile_block, kTileBlockAlignment), kMaxTileBlock);
+}
+
+struct WinogradPlan {
+  WinogradAxis axis_h;
+  WinogradAxis axis_w;
+  index_t in_channels;
+  index_t in_height;
+  index_t in_width;
+  index_t out_channels;
+  index_t out_height;
+  index_t out_width;
+  index_t tile_h_count;
+  index_t tile_w_count;
+  index_t tile_count;
+  index_t tile_block;
+  int pad_top;
+  int pad_left;
+  const ConvEpilogue *epilogue;  // nullptr if there is none
+};
+
+// Where a tile reads and writes: the window starts at row in_h and column
+// in_w of the image at in_offset, both may be in the padding; out_h and out_w
+// outputs at out_offset are stored, fewer than m at the bottom and right.
+struct TileLocation {
+  index_t in_offset;
+  index_t in_h;
+  index_t in_w;
+  index_t out_offset;
+  index_t out_h;
+  index_t out_w;
+};
+
+inline void LocateTile(const WinogradPlan &plan,
+                       const index_t tile,
+                       TileLocation *location) {
+  const index_t tiles_per_image = plan.tile_h_count * plan.tile_w_count;
+  const index_t b = tile / tiles_per_image;
+  const index_t oh = tile % tiles_per_image / plan.tile_w_count
+      * plan.axis_h.m;
+  const index_t ow = tile % plan.tile_w_count * plan.axis_w.m;
+  location->in_offset = b * plan.in_channels * plan.in_height * plan.in_width;
+  location->in_h = oh - plan.pad_top;
+  location->in_w = ow - plan.pad_left;
+  location->out_offset = b * plan.out_channels * plan.out_height
+      * plan.out_width + oh * plan.out_width + ow;
+  location->out_h = std::min<index_t>(plan.axis_h.m, plan.out_height - oh);
+  location->out_w = std::min<index_t>(plan.axis_w.m, plan.out_width - ow);
+}
+
+// NCHW => [alpha_h * alpha_w][C][tile_block], columns [0, cols) with those
+// past the last tile zeroed. Windows crossing the border of the input read
+// zero outside it.
+__attribute__((always_inline))
+inline void TransformInputBlock(const WinogradPlan &plan,
+                                const float *input,
+                                const index_t tile_begin,
+                                const index_t tile_end,
+                                const index_t cols,
+                                float *output) {
+  const WinogradAxis &ah = plan.axis_h;
+  const WinogradAxis &aw = plan.axis_w;
+  const index_t channels = plan.in_channels;
+  const index_t in_image_size = plan.in_height * plan.in_width;
+  const index_t stride = channels * plan.tile_block;
+
+  for (index_t t = tile_begin; t < tile_begin + cols; t += kBlockSize) {
+    const index_t lanes =
+        std::max<index_t>(0, std::min<index_t>(kBlockSize, tile_end - t));
+    TileLocation location[kBlockSize];
+    bool inside[kBlockSize];
+    for (index_t l = 0; l < lanes; ++l) {
+      LocateTile(plan, t + l, &location[l]);
+      inside[l] = location[l].in_h >= 0 && location[l].in_w >= 0
+          && location[l].in_h + ah.alpha <= plan.in_height
+          && location[l].in_w + aw.alpha <= plan.in_width;
+    }
+    float d[kMaxAlpha][kMaxAlpha][kBlockSize];
+    if (lanes < kBlockSize) {
+      memset(d, 0, sizeof(d));
+    }
+    float *out_base = output + (t - tile_begin);
+
+    for (index_t c = 0; c < channels; ++c) {
+      for (index_t l = 0; l < lanes; ++l) {
+        const float *in = input + location[l].in_offset + c * in_image_size;
+        const index_t in_h = location[l].in_h;
+        const index_t in_w = location[l].in_w;
+        if (inside[l]) {
+          in += in_h * plan.in_width + in_w;
+          for (int i = 0; i < ah.alpha; ++i) {
+            for (int j = 0; j < aw.alpha; ++j) {
+              d[i][j][l] = in[i * plan.in_width + j];
+            }
+          }
+          continue;
+        }
+        for (int i = 0; i < ah.alpha; ++i) {
+          const index_t h = in_h + i;
+          for (int j = 0; j < aw.alpha; ++j) {
+            const index_t w = in_w + j;
+            d[i][j][l] = h >= 0 && h < plan.in_height && w >= 0
+                && w < plan.in_width ? in[h * plan.in_width + w] : 0;
+          }
+        }
+      }
+
+      // BT_h * d * BT_w'
+      Block s[kMaxAlpha][kMaxAlpha];
+      for (int i = 0; i < ah.alpha; ++i) {
+        for (int j = 0; j < aw.alpha; ++j) {
+          Block sum = {};
+          for (int k = 0; k < ah.alpha; ++k) {
+            if (ah.BT[i][k] != 0) sum += AsBlock(d[k][j]) * ah.BT[i][k];
+          }
+          s[i][j] = sum;
+        }
+      }
+      for (int i = 0; i < ah.alpha; ++i) {
+        for (int j = 0; j < aw.alpha; ++j) {
+          Block sum = {};
+          for (int k = 0; k < aw.alpha; ++k) {
+            if (aw.BT[j][k] != 0) sum += s[i][k] * aw.BT[j][k];
+          }
+          AsBlock(out_base + (i * aw.alpha + j) * stride
+                      + c * plan.tile_block) = sum;
+        }
+      }
+    }
+  }
+}
+
+// [alpha_h * alpha_w][O][C] * [alpha_h * alpha_w][C][tile_block] =>
+// [alpha_h * alpha_w][O][tile_block], columns [0, cols) only.
+__attribute__((always_inline))
+inline void BatchGemmBlock(const WinogradPlan &plan,
+                           const float *filter,
+                           const float *input,
+                           const index_t cols,
+                           float *output) {
+  const index_t area = plan.axis_h.alpha * plan.axis_w.alpha;
+  const index_t in_channels = plan.in_channels;
+  const index_t out_channels = plan.out_channels;
+  const index_t tile_block = plan.tile_block;
+
+  for (index_t a = 0; a < area; ++a) {
+    const float *f = filter + a * out_channels * in_channels;
+    const float *in = input + a * in_channels * tile_block;
+    float *out = output + a * out_channels * tile_block;
+    index_t o = 0;
+    for (; o + 4 <= out_channels; o += 4) {
+      const float *f0 = f + o * in_channels;
+      const float *f1 = f0 + in_channels;
+      const float *f2 = f1 + in_channels;
+      const float *f3 = f2 + in_channels;
+      for (index_t t = 0; t < cols; t += 2 * kBlockSize) {
+        Block c00 = {}, c01 = {}, c10 = {}, c11 = {};
+        Block c20 = {}, c21 = {}, c30 = {}, c31 = {};
+        for (index_t c = 0; c < in_channels; ++c) {
+          const Block &v0 = AsBlock(in + c * tile_block + t);
+          const Block &v1 = AsBlock(in + c * tile_block + t + kBlockSize);
+          c00 += v0 * f0[c];
+          c01 += v1 * f0[c];
+          c10 += v0 * f1[c];
+          c11 += v1 * f1[c];
+          c20 += v0 * f2[c];
+          c21 += v1 * f2[c];
+          c30 += v0 * f3[c];
+          c31 += v1 * f3[c];
+        }
+        float *out0 = out + o * tile_block + t;
+        AsBlock(out0) = c00;
+        AsBlock(out0 + kBlockSize) = c01;
+        AsBlock(out0 + tile_block) = c10;
+        AsBlock(out0 + tile_block + kBlockSize) = c11;
+        AsBlock(out0 + 2 * tile_block) = c20;
+        AsBlock(out0 + 2 * tile_block + kBlockSize) = c21;
+        AsBlock(out0 + 3 * tile_block) = c30;
+        AsBlock(out0 + 3 * tile_block + kBlockSize) = c31;
+      }
+    }
+    for (; o < out_channels; ++o) {
+      const float *f0 = f + o * in_channels;
+      for (index_t t = 0; t < cols; t += 2 * kBlockSize) {
+        Block c00 = {}, c01 = {};
+        for (index_t c = 0; c < in_channels; ++c) {
+          c00 += AsBlock(in + c * tile_block + t) * f0[c];
+          c01 += AsBlock(in + c * tile_block + t + kBlockSize) * f0[c];
+        }
+        AsBlock(out + o * tile_block + t) = c00;
+        AsBlock(out + o * tile_block + t + kBlockSize) = c01;
+      }
+    }
+  }
+}
+
+// [alpha_h * alpha_w][O][tile_block] => NCHW
+__attribute__((always_inline))
+inline void TransformOutputBlock(const WinogradPlan &plan,
+                                 const float *input,
+                                 const index_t tile_begin,
+                                 const index_t tile_end,
+                                 float *output) {
+  const WinogradAxis &ah = plan.axis_h;
+  const WinogradAxis &aw = plan.axis_w;
+  const index_t channels = plan.out_channels;
+  const index_t out_image_size = plan.out_height * plan.out_width;
+  const index_t stride = channels * plan.tile_block;
+
+  for (index_t t = tile_begin; t < tile_end; t += kBlockSize) {
+    const index_t lanes = std::min<index_t>(kBlockSize, tile_end - t);
+    TileLocation location[kBlockSize];
+    for (index_t l = 0; l < lanes; ++l) {
+      LocateTile(plan, t + l, &location[l]);
+    }
+    const float *in_base = input + (t - tile_begin);
+
+    for (index_t o = 0; o < channels; ++o) {
+      // AT_h * m * AT_w'
+      Block s[kMaxAlpha][kMaxAlpha];
+      for (int i = 0; i < ah.m; ++i) {
+        for (int j = 0; j < aw.alpha; ++j) {
+          Block sum = {};
+          for (int k = 0; k < ah.alpha; ++k) {
+            if (ah.AT[i][k] != 0) {
+              sum += AsBlock(in_base + (k * aw.alpha + j) * stride
+                                 + o * plan.tile_block) * ah.AT[i][k];
+            }
+          }
+          s[i][j] = sum;
+        }
+      }
+      float y[kMaxAlpha][kMaxAlpha][kBlockSize];
+      for (int i = 0; i < ah.m; ++i) {
+        for (int j = 0; j < aw.m; ++j) {
+          Block sum = {};
+          for (int k = 0; k < aw.alpha; ++k) {
+            if (aw.AT[j][k] != 0) sum += s[i][k] * aw.AT[j][k];
+          }
+          AsBlock(y[i][j]) = sum;
+        }
+      }
+
+      const ConvEpilogue *epilogue = plan.epilogue;
+      for (index_t l = 0; l < lanes; ++l) {
+        const index_t offset = location[l].out_offset + o * out_image_size;
+        float *out = output + offset;
+        for (index_t i = 0; i < location[l].out_h; ++i) {
+          for (index_t j = 0; j < location[l].out_w; ++j) {
+            const index_t k = i * plan.out_width + j;
+            if (epilogue == nullptr) {
+              out[k] = y[i][j][l];
+            } else {
+              out[k] = ApplyConvEpilogue(*epilogue, o, offset + k,
+                                         y[i][j][l]);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+__attribute__((always_inline))
+inline void WinogradBlockImpl(const WinogradPlan &plan,
+                              const float *input,
+                              const float *filter,
+                              const index_t tile_begin,
+                              float *buffer,
+                              float *output) {
+  const index_t area = plan.axis_h.alpha * plan.axis_w.alpha;
+  const index_t tile_end =
+      std::min(tile_begin + plan.tile_block, plan.tile_count);
+  float *transformed_input = buffer;
+  float *transformed_output =
+      buffer + area * plan.in_channels * plan.tile_block;
+
+  const index_t cols =
+      RoundUp<index_t>(tile_end - tile_begin, 2 * kBlockSize);
+
+  TransformInputBlock(plan, input, tile_begin, tile_end, cols,
+                      transformed_input);
+  BatchGemmBlock(plan, filter, transformed_input, cols, transformed_output);
+  TransformOutputBlock(plan, transformed_output, tile_begin, tile_end,
+                       output);
+}
+
+typedef void (*WinogradBlockFunc)(const WinogradPlan &plan,
+                                  const float *input,
+                                  const float *filter,
+                                  const index_t tile_begin,
+                                  float *buffer,
+                                  float *output);
+
+void WinogradBlock(const WinogradPlan &plan,
+                   const float *input,
+                   const float *filter,
+                   const index_t tile_begin,
+                   float *buffer,
+                   float *output) {
+  WinogradBlockImpl(plan, input, filter, tile_begin, buffer, output);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+MACE_AVX2_TARGET void WinogradBlockAvx2(const WinogradPlan &plan,
+                                        const float *input,
+                                        const float *filter,
+                                        const index_t tile_begin,
+                                        float *buffer,
+                                        float *output) {
+  WinogradBlockImpl(plan, input, filter, tile_begin, buffer, output);
+}
+#endif
+
+index_t PerThreadBufferSize(const index_t *filter_shape,
+                            const int *alpha) {
+  return alpha[0] * alpha[1] * (filter_shape[0] + filter_shape[1])
+      * TileBlockSize(filter_shape, alpha);
+}
+
+void Alphas(const index_t *filter_shape,
+            const int *out_tile_size,
+            int *alpha) {
+  alpha[0] = out_tile_size[0] + static_cast<int>(filter_shape[2]) - 1;
+  alpha[1] = out_tile_size[1] + static_cast<int>(filter_shape[3]) - 1;
+}
+}  // namespace
+
+bool WinogradOutTileSize(const index_t *filter_shape,
+                         const index_t out_height,
+                         const index_t out_width,
+                         int *out_tile_size) {
+  const index_t out_channels = filter_shape[0];
+  const index_t in_channels = filter_shape[1];
+  const index_t filter_h = filter_shape[2];
+  const index_t filter_w = filter_shape[3];
+  // too few channels to pay for the transforms
+  if (!IsSupportedTaps(filter_h) || !IsSupportedTaps(filter_w)
+      || filter_h * filter_w == 1 || in_channels < 8 || out_channels < 8) {
+    return false;
+  }
+
+  std::vector<int> tile_heights;
+  std::vector<int> tile_widths;
+  AxisTileSizes(filter_h, &tile_heights);
+  AxisTileSizes(filter_w, &tile_widths);
+  // Measured against the avx2 direct kernels: the transforms gather and
+  // scatter single floats, and every block of tiles reloads the transformed
+  // filter from memory, so they are weighted over the gemm; winograd has to
+  // save a tenth of the work at least.
+  double best_cost =
+      0.9 * out_height * out_width * in_channels * out_channels
+      * filter_h * filter_w;
+  bool found = false;
+  for (int mh : tile_heights) {
+    for (int mw : tile_widths) {
+      const int alpha[2] = {mh + static_cast<int>(filter_h) - 1,
+                            mw + static_cast<int>(filter_w) - 1};
+      const int ah = alpha[0];
+      const int aw = alpha[1];
+      const index_t tiles = RoundUpDiv<index_t>(out_height, mh)
+          * RoundUpDiv<index_t>(out_width, mw);
+      const index_t blocks =
+          RoundUpDiv(tiles, TileBlockSize(filter_shape, alpha));
+      // the separable passes of the transforms skip single tap axes
+      const double gemm = ah * aw * in_channels * out_channels;
+      const double input_transform =
+          ah * aw * ((ah > 1 ? ah : 0) + (aw > 1 ? aw : 0));
+      const double output_transform =
+          mh * aw * (ah > 1 ? ah : 0) + mh * mw * (aw > 1 ? aw : 0);
+      const double cost = tiles * (gemm + 3 * (in_channels * input_transform
+          + out_channels * output_transform)) + 4 * blocks * gemm;
+      if (cost < best_cost) {
+        best_cost = cost;
+        out_tile_size[0] = mh;
+        out_tile_size[1] = mw;
+        found = true;
+      }
+    }
+  }
+  return found;
+}
+
+index_t WinogradTransformedFilterSize(const index_t *filter_shape,
+                                      const int *out_tile_size) {
+  int alpha[2];
+  Alphas(filter_shape, out_tile_size, alpha);
+  return alpha[0] * alpha[1] * filter_shape[0] * filter_shape[1];
+}
+
+void WinogradTransformFilter(const float *filter,
+                             const index_t *filter_shape,
+                             const int *out_tile_size,
+                             float *output) {
+  const index_t out_channels = filter_shape[0];
+  const index_t in_channels = filter_shape[1];
+  const int filter_h = static_cast<int>(filter_shape[2]);
+  const int filter_w = static_cast<int>(filter_shape[3]);
+  WinogradAxis ah;
+  WinogradAxis aw;
+  MakeWinogradAxis(out_tile_size[0], filter_h, &ah);
+  MakeWinogradAxis(out_tile_size[1], filter_w, &aw);
+  const index_t stride = out_channels * in_channels;
+
+#pragma omp parallel for collapse(2)
+  for (index_t o = 0; o < out_channels; ++o) {
+    for (index_t c = 0; c < in_channels; ++c) {
+      const float *g = filter + (o * in_channels + c) * filter_h * filter_w;
+      // G_h * g * G_w'
+      float s[kMaxAlpha][kMaxAlpha];
+      for (int i = 0; i < ah.alpha; ++i) {
+        for (int j = 0; j < filter_w; ++j) {
+          float sum = 0;
+          for (int k = 0; k < filter_h; ++k) {
+            sum += ah.G[i][k] * g[k * filter_w + j];
+          }
+          s[i][j] = sum;
+        }
+      }
+      for (int i = 0; i < ah.alpha; ++i) {
+        for (int j = 0; j < aw.alpha; ++j) {
+          float sum = 0;
+          for (int k = 0; k < filter_w; ++k) {
+            sum += s[i][k] * aw.G[j][k];
+          }
+          output[(i * aw.alpha + j) * stride + o * in_channels + c] = sum;
+        }
+      }
+    }
+  }
+}
+
+index_t WinogradBufferSize(const index_t *filter_shape,
+                           const int *out_tile_size) {
+  int alpha[2];
+  Alphas(filter_shape, out_tile_size, alpha);
+  return PerThreadBufferSize(filter_shape, alpha) * GetOpenMPMaxThreads();
+}
+
+void WinogradConv2d(const float *input,
+                    const float *transformed_filter,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const index_t *filter_shape,
+                    const int *pad_hw,
+                    const int *out_tile_size,
+                    float *buffer,
+                    float *output,
+                    const ConvEpilogue *epilogue) {
+  WinogradPlan plan;
+  MakeWinogradAxis(out_tile_size[0], static_cast<int>(filter_shape[2]),
+                   &plan.axis_h);
+  MakeWinogradAxis(out_tile_size[1], static_cast<int>(filter_shape[3]),
+                   &plan.axis_w);
+  plan.in_channels = in_shape[1];
+  plan.in_height = in_shape[2];
+  plan.in_width = in_shape[3];
+  plan.out_channels = out_shape[1];
+  plan.out_height = out_shape[2];
+  plan.out_width = out_shape[3];
+  plan.pad_top = pad_hw[0];
+  plan.pad_left = pad_hw[1];
+  plan.tile_h_count = RoundUpDiv<index_t>(plan.out_height, out_tile_size[0]);
+  plan.tile_w_count = RoundUpDiv<index_t>(plan.out_width, out_tile_size[1]);
+  plan.tile_count = in_shape[0] * plan.tile_h_count * plan.tile_w_count;
+  const int alpha[2] = {plan.axis_h.alpha, plan.axis_w.alpha};
+  plan.tile_block = TileBlockSize(filter_shape, alpha);
+  plan.epilogue = epilogue;
+  const index_t buffer_size = PerThreadBufferSize(filter_shape, alpha);
+
+  WinogradBlockFunc block_func = WinogradBlock;
+#if defined(__x86_64__) || defined(__i386__)
+  if (CpuSupportsAvx2()) {
+    block_func = WinogradBlockAvx2;
+  }
+#endif
+
+  const index_t block_count = RoundUpDiv(plan.tile_count, plan.tile_block);
+#pragma omp parallel for
+  for (index_t i = 0; i < block_count; ++i) {
+    block_func(plan, input, transformed_filter, i * plan.tile_block,
+               buffer + GetOpenMPThreadNum() * buffer_size, output);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
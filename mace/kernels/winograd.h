@@ -0,0 +1,70 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_WINOGRAD_H_
+#define MACE_KERNELS_WINOGRAD_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/conv_epilogue.h"
+
+// Winograd F(m x n, r x s) for stride 1 convolutions whose filter has 1, 3, 5
+// or 7 taps on each axis: 3x3, 5x5, 1x7, 7x1 and so on. The transform
+// matrices are built from interpolation points for any tile size, and input
+// transform, gemm and output transform run per block of tiles, so the
+// transformed tiles stay in cache instead of going through memory.
+
+namespace mace {
+namespace kernels {
+
+// Picks the output tile size {height, width} with the least estimated cost
+// for the convolution; returns false if the filter is not supported or
+// direct convolution is expected to be faster.
+bool WinogradOutTileSize(const index_t *filter_shape,
+                         const index_t out_height,
+                         const index_t out_width,
+                         int *out_tile_size);
+
+// OIHW => [alpha_h * alpha_w][O][I], alpha is the out tile size plus the
+// number of taps minus one on each axis.
+index_t WinogradTransformedFilterSize(const index_t *filter_shape,
+                                      const int *out_tile_size);
+
+void WinogradTransformFilter(const float *filter,
+                             const index_t *filter_shape,
+                             const int *out_tile_size,
+                             float *output);
+
+// Number of floats WinogradConv2d needs in its buffer, for all threads.
+index_t WinogradBufferSize(const index_t *filter_shape,
+                           const int *out_tile_size);
+
+// in_shape and out_shape are NCHW. The input is not padded, pad_hw is the
+// top and left padding and windows past the input read zero; the last tiles
+// of a row or column store only the outputs inside out_shape. The output
+// tiles get epilogue as they are stored, unless it is nullptr.
+void WinogradConv2d(const float *input,
+                    const float *transformed_filter,
+                    const index_t *in_shape,
+                    const index_t *out_shape,
+                    const index_t *filter_shape,
+                    const int *pad_hw,
+                    const int *out_tile_size,
+                    float *buffer,
+                    float *output,
+                    const ConvEpilogue *epilogue = nullptr);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_WINOGRAD_H_
@@ -0,0 +1,172 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/winograd.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+void ConvRef(const float *input,
+             const float *filter,
+             const index_t *in_shape,
+             const index_t *out_shape,
+             const index_t *filter_shape,
+             const int pad,
+             float *output) {
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t o = 0; o < out_shape[1]; ++o) {
+      for (index_t h = 0; h < out_shape[2]; ++h) {
+        for (index_t w = 0; w < out_shape[3]; ++w) {
+          float sum = 0;
+          for (index_t c = 0; c < in_shape[1]; ++c) {
+            for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
+              for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
+                const index_t ih = h + kh - pad;
+                const index_t iw = w + kw - pad;
+                if (ih < 0 || ih >= in_shape[2] || iw < 0
+                    || iw >= in_shape[3]) {
+                  continue;
+                }
+                sum += input[((b * in_shape[1] + c) * in_shape[2] + ih)
+                    * in_shape[3] + iw]
+                    * filter[((o * filter_shape[1] + c) * filter_shape[2] + kh)
+                        * filter_shape[3] + kw];
+              }
+            }
+          }
+          output[((b * out_shape[1] + o) * out_shape[2] + h) * out_shape[3]
+              + w] = sum;
+        }
+      }
+    }
+  }
+}
+
+void TestWinograd(const index_t batch,
+                  const index_t in_channels,
+                  const index_t out_channels,
+                  const index_t tile_h_count,
+                  const index_t tile_w_count,
+                  const index_t filter_h,
+                  const index_t filter_w,
+                  const int tile_h,
+                  const int tile_w,
+                  const int pad = 0,
+                  const index_t crop = 0) {
+  // crop outputs off the bottom and right leave the last tiles partial
+  const int out_tile_size[2] = {tile_h, tile_w};
+  const int pad_hw[2] = {pad, pad};
+  const index_t filter_shape[4] = {out_channels, in_channels, filter_h,
+                                   filter_w};
+  const index_t out_shape[4] = {batch, out_channels,
+                                tile_h_count * tile_h - crop,
+                                tile_w_count * tile_w - crop};
+  const index_t in_shape[4] = {batch, in_channels,
+                               out_shape[2] + filter_h - 1 - 2 * pad,
+                               out_shape[3] + filter_w - 1 - 2 * pad};
+
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_shape[2]
+                               * in_shape[3]);
+  std::vector<float> filter(out_channels * in_channels * filter_h
+                                * filter_w);
+  std::vector<float> output(out_shape[0] * out_shape[1] * out_shape[2]
+                                * out_shape[3]);
+  std::vector<float> expected(output.size());
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> dist(-1, 1);
+  std::generate(input.begin(), input.end(), [&] { return dist(gen); });
+  std::generate(filter.begin(), filter.end(), [&] { return dist(gen); });
+
+  std::vector<float> transformed_filter(
+      WinogradTransformedFilterSize(filter_shape, out_tile_size));
+  std::vector<float> buffer(WinogradBufferSize(filter_shape, out_tile_size));
+  WinogradTransformFilter(filter.data(), filter_shape, out_tile_size,
+                          transformed_filter.data());
+  WinogradConv2d(input.data(), transformed_filter.data(), in_shape, out_shape,
+                 filter_shape, pad_hw, out_tile_size, buffer.data(),
+                 output.data());
+  ConvRef(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+          pad, expected.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    ASSERT_NEAR(expected[i], output[i], 1e-2)
+        << "F(" << tile_h << "x" << tile_w << ", " << filter_h << "x"
+        << filter_w << ") index " << i;
+  }
+}
+}  // namespace
+
+TEST(WinogradTest, TileSizes3x3) {
+  TestWinograd(1, 16, 24, 5, 7, 3, 3, 2, 2);
+  TestWinograd(2, 8, 16, 3, 4, 3, 3, 4, 4);
+  TestWinograd(1, 24, 8, 4, 3, 3, 3, 6, 6);
+  TestWinograd(1, 16, 13, 3, 2, 3, 3, 6, 4);
+}
+
+TEST(WinogradTest, TileSizes5x5) {
+  TestWinograd(1, 16, 16, 6, 5, 5, 5, 2, 2);
+  TestWinograd(1, 8, 19, 3, 3, 5, 5, 4, 4);
+}
+
+TEST(WinogradTest, OneDimensional) {
+  TestWinograd(1, 16, 16, 17, 6, 1, 7, 1, 2);
+  TestWinograd(2, 8, 12, 5, 9, 7, 1, 2, 1);
+  TestWinograd(1, 16, 8, 9, 4, 1, 3, 1, 6);
+  TestWinograd(1, 8, 16, 3, 11, 5, 1, 4, 1);
+}
+
+TEST(WinogradTest, ManyTileBlocks) {
+  // more tiles than one block holds, and a partial last block
+  TestWinograd(2, 32, 36, 15, 13, 3, 3, 2, 2);
+}
+
+TEST(WinogradTest, Padding) {
+  // the input is not padded, border windows read zero
+  TestWinograd(1, 16, 24, 5, 7, 3, 3, 2, 2, 1);
+  TestWinograd(2, 8, 16, 3, 4, 3, 3, 4, 4, 1, 3);
+  TestWinograd(1, 8, 19, 3, 3, 5, 5, 4, 4, 2, 1);
+  TestWinograd(1, 16, 16, 17, 6, 1, 7, 1, 2, 0, 1);
+  TestWinograd(1, 24, 8, 4, 3, 3, 3, 6, 6, 1, 5);
+}
+
+TEST(WinogradTest, OutTileSize) {
+  int tile[2];
+  const index_t conv3x3[4] = {64, 64, 3, 3};
+  EXPECT_TRUE(WinogradOutTileSize(conv3x3, 56, 56, tile));
+  EXPECT_EQ(4, tile[0]);
+  EXPECT_EQ(4, tile[1]);
+  // large tiles are half empty on small outputs
+  EXPECT_TRUE(WinogradOutTileSize(conv3x3, 8, 8, tile));
+  EXPECT_EQ(2, tile[0]);
+  const index_t conv1x7[4] = {128, 128, 1, 7};
+  EXPECT_TRUE(WinogradOutTileSize(conv1x7, 17, 17, tile));
+  EXPECT_EQ(1, tile[0]);
+  EXPECT_EQ(2, tile[1]);
+
+  const index_t few_channels[4] = {16, 16, 3, 3};
+  EXPECT_FALSE(WinogradOutTileSize(few_channels, 56, 56, tile));
+  const index_t conv1x1[4] = {64, 64, 1, 1};
+  EXPECT_FALSE(WinogradOutTileSize(conv1x1, 56, 56, tile));
+  const index_t conv1x15[4] = {64, 64, 1, 15};
+  EXPECT_FALSE(WinogradOutTileSize(conv1x15, 56, 56, tile));
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,484 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include <algorithm>
+
+#include "mace/core/macros.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+bool CpuSupportsAvx2() {
+  static const bool supported =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+}
+
+namespace {
+
+// load 8 inputs spaced by stride, never reading past the last one
+template <int S>
+MACE_AVX2_TARGET inline __m256 LoadInput(const float *ptr) {
+  return _mm256_i32gather_ps(ptr, _mm256_setr_epi32(0, S, 2 * S, 3 * S,
+                                                    4 * S, 5 * S, 6 * S,
+                                                    7 * S), 4);
+}
+
+template <>
+MACE_AVX2_TARGET inline __m256 LoadInput<1>(const float *ptr) {
+  return _mm256_loadu_ps(ptr);
+}
+
+template <>
+MACE_AVX2_TARGET inline __m256 LoadInput<2>(const float *ptr) {
+  __m256 vi0 = _mm256_loadu_ps(ptr);
+  __m256 vi1 = _mm256_loadu_ps(ptr + 7);
+  // [0 2 8 10 | 4 6 12 14] => [0 2 4 6 | 8 10 12 14]
+  __m256 vi = _mm256_shuffle_ps(vi0, vi1, _MM_SHUFFLE(3, 1, 2, 0));
+  return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(vi),
+                                                _MM_SHUFFLE(3, 1, 2, 0)));
+}
+
+// Lanes of 8 inputs spaced by S from column col that are inside
+// [0, in_width); col may be negative.
+template <int S>
+MACE_AVX2_TARGET inline __m256i BorderMask(const index_t col,
+                                           const index_t in_width) {
+  const __m256i vcol = _mm256_add_epi32(
+      _mm256_set1_epi32(static_cast<int>(col)),
+      _mm256_setr_epi32(0, S, 2 * S, 3 * S, 4 * S, 5 * S, 6 * S, 7 * S));
+  return _mm256_and_si256(
+      _mm256_cmpgt_epi32(vcol, _mm256_set1_epi32(-1)),
+      _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(in_width)),
+                         vcol));
+}
+
+// load the lanes of mask of 8 inputs spaced by stride, the others are zero;
+// ptr may be outside the row, only the lanes of mask are read
+template <int S>
+MACE_AVX2_TARGET inline __m256 LoadBorderInput(const float *ptr,
+                                               const __m256i mask) {
+  return _mm256_mask_i32gather_ps(
+      _mm256_setzero_ps(), ptr,
+      _mm256_setr_epi32(0, S, 2 * S, 3 * S, 4 * S, 5 * S, 6 * S, 7 * S),
+      _mm256_castsi256_ps(mask), 4);
+}
+
+template <>
+MACE_AVX2_TARGET inline __m256 LoadBorderInput<1>(const float *ptr,
+                                                  const __m256i mask) {
+  return _mm256_maskload_ps(ptr, mask);
+}
+
+// Bias, residual and relu/relux of the first lanes of 8 outputs at offset of
+// the output, in registers before they are stored.
+MACE_AVX2_TARGET inline void StoreOutput(const ConvEpilogue *epilogue,
+                                         const index_t channel,
+                                         const index_t offset,
+                                         const index_t lanes,
+                                         __m256 vo,
+                                         float *output) {
+  const __m256i mask = lanes == 8 ? _mm256_set1_epi32(-1)
+      : _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(lanes)),
+                           _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  if (epilogue != nullptr) {
+    if (epilogue->bias != nullptr) {
+      vo = _mm256_add_ps(vo, _mm256_broadcast_ss(epilogue->bias + channel));
+    }
+    if (epilogue->residual != nullptr) {
+      const float *residual = epilogue->residual + offset;
+      vo = _mm256_add_ps(vo, lanes == 8 ? _mm256_loadu_ps(residual)
+                                        : _mm256_maskload_ps(residual, mask));
+    }
+    if (epilogue->activation == RELU) {
+      vo = _mm256_max_ps(vo, _mm256_setzero_ps());
+    } else if (epilogue->activation == RELUX) {
+      vo = _mm256_min_ps(_mm256_max_ps(vo, _mm256_setzero_ps()),
+                         _mm256_set1_ps(epilogue->relux_max_limit));
+    }
+  }
+  if (lanes == 8) {
+    _mm256_storeu_ps(output + offset, vo);
+  } else {
+    _mm256_maskstore_ps(output + offset, mask, vo);
+  }
+}
+
+// What the blocks of a convolution share.
+struct Conv2dAvx2Plan {
+  index_t in_channels;
+  index_t in_height;
+  index_t in_width;
+  index_t in_image_size;
+  index_t filter_stride;  // between output channels
+  index_t out_width;
+  index_t out_image_size;
+  int dilation_h;
+  int dilation_w;
+  int pad_left;
+  index_t w_begin;  // outputs in [w_begin, w_end) have windows inside the
+  index_t w_end;    // input columns
+  const ConvEpilogue *epilogue;  // applied in registers, or nullptr
+};
+
+// M output channels of N * 8 outputs, the window of whose first starts at
+// column col of in_row, into vo[i * N + j]: 4 channels of 16 or 8 outputs,
+// or 1 channel of 32 or 8. All input channels are accumulated in registers.
+// Taps are dilation_h rows and dilation_w columns apart. Rows of the window
+// outside the input are skipped, in_row and filter point at the first of the
+// kh_count others, all KH of them for kFullRows. In
+// border blocks the loads with lanes outside the input columns go through
+// masks, which are computed once for all channels.
+template <int KH, int KW, int S, int M, int N, bool kFullRows, bool kBorder>
+__attribute__((always_inline))
+MACE_AVX2_TARGET inline void Conv2dAvx2Block(const Conv2dAvx2Plan &plan,
+                                             const float *in_row,
+                                             const float *filter,
+                                             const index_t col,
+                                             const int kh_count,
+                                             __m256 *vo) {
+  static_assert((M == 4 && N <= 2) || (M == 1 && N <= 4),
+                "unsupported avx2 convolution block");
+  const int dw = plan.dilation_w;
+  const index_t row_step = plan.dilation_h * plan.in_width;
+  __m256i mask[KW][4];
+  uint64_t masked = 0;  // bit kw * 4 + j
+  if (kBorder) {
+    for (int kw = 0; kw < KW; ++kw) {
+      for (int j = 0; j < N; ++j) {
+        mask[kw][j] =
+            BorderMask<S>(col + kw * dw + j * 8 * S, plan.in_width);
+        if (_mm256_movemask_epi8(mask[kw][j]) != -1) {
+          masked |= uint64_t(1) << (kw * 4 + j);
+        }
+      }
+    }
+  }
+  // output channel, block
+  __m256 vo00 = _mm256_setzero_ps();
+  __m256 vo01 = _mm256_setzero_ps();
+  __m256 vo02 = _mm256_setzero_ps();
+  __m256 vo03 = _mm256_setzero_ps();
+  __m256 vo10 = _mm256_setzero_ps();
+  __m256 vo11 = _mm256_setzero_ps();
+  __m256 vo20 = _mm256_setzero_ps();
+  __m256 vo21 = _mm256_setzero_ps();
+  __m256 vo30 = _mm256_setzero_ps();
+  __m256 vo31 = _mm256_setzero_ps();
+  const int rows = kFullRows ? KH : kh_count;
+  for (index_t c = 0; c < plan.in_channels; ++c) {
+    const float *in_ptr = in_row + c * plan.in_image_size + col;
+    const float *filter_ptr0 = filter + c * KH * KW;
+    const float *filter_ptr1 = filter_ptr0 + plan.filter_stride;
+    const float *filter_ptr2 = filter_ptr1 + plan.filter_stride;
+    const float *filter_ptr3 = filter_ptr2 + plan.filter_stride;
+    for (int kh = 0; kh < rows; ++kh) {
+      for (int kw = 0; kw < KW; ++kw) {
+#define MACE_Conv2dAvx2Load(j)                                           \
+  (kBorder && (masked >> (kw * 4 + (j)) & 1)                             \
+       ? LoadBorderInput<S>(in_ptr + kw * dw + (j) * 8 * S, mask[kw][j]) \
+       : LoadInput<S>(in_ptr + kw * dw + (j) * 8 * S))
+        const __m256 vi0 = MACE_Conv2dAvx2Load(0);
+        const __m256 vi1 = N > 1 ? MACE_Conv2dAvx2Load(1) : vi0;
+        const __m256 vi2 = N > 2 ? MACE_Conv2dAvx2Load(2) : vi0;
+        const __m256 vi3 = N > 3 ? MACE_Conv2dAvx2Load(3) : vi0;
+#undef MACE_Conv2dAvx2Load
+        const __m256 vf0 = _mm256_broadcast_ss(filter_ptr0 + kw);
+        vo00 = _mm256_fmadd_ps(vi0, vf0, vo00);
+        if (N > 1) vo01 = _mm256_fmadd_ps(vi1, vf0, vo01);
+        if (N > 2) vo02 = _mm256_fmadd_ps(vi2, vf0, vo02);
+        if (N > 3) vo03 = _mm256_fmadd_ps(vi3, vf0, vo03);
+        if (M > 1) {
+          const __m256 vf1 = _mm256_broadcast_ss(filter_ptr1 + kw);
+          const __m256 vf2 = _mm256_broadcast_ss(filter_ptr2 + kw);
+          const __m256 vf3 = _mm256_broadcast_ss(filter_ptr3 + kw);
+          vo10 = _mm256_fmadd_ps(vi0, vf1, vo10);
+          vo20 = _mm256_fmadd_ps(vi0, vf2, vo20);
+          vo30 = _mm256_fmadd_ps(vi0, vf3, vo30);
+          if (N > 1) {
+            vo11 = _mm256_fmadd_ps(vi1, vf1, vo11);
+            vo21 = _mm256_fmadd_ps(vi1, vf2, vo21);
+            vo31 = _mm256_fmadd_ps(vi1, vf3, vo31);
+          }
+        }
+      }  // kw
+      in_ptr += row_step;
+      filter_ptr0 += KW;
+      filter_ptr1 += KW;
+      filter_ptr2 += KW;
+      filter_ptr3 += KW;
+    }  // kh
+  }  // c
+  if (M == 1) {
+    vo[0] = vo00;
+    if (N > 1) vo[1] = vo01;
+    if (N > 2) vo[2] = vo02;
+    if (N > 3) vo[3] = vo03;
+  } else {
+    vo[0] = vo00;
+    vo[N] = vo10;
+    vo[2 * N] = vo20;
+    vo[3 * N] = vo30;
+    if (N > 1) {
+      vo[1] = vo01;
+      vo[N + 1] = vo11;
+      vo[2 * N + 1] = vo21;
+      vo[3 * N + 1] = vo31;
+    }
+  }
+}
+
+// N * 8 outputs of M output channels from column w, the first lanes of the
+// last block for a tail.
+template <int KH, int KW, int S, int M, int N, bool kFullRows>
+__attribute__((always_inline))
+MACE_AVX2_TARGET inline void Conv2dAvx2Outputs(const Conv2dAvx2Plan &plan,
+                                               const float *in_row,
+                                               const float *filter,
+                                               const int kh_count,
+                                               const index_t channel,
+                                               const index_t out_offset,
+                                               const index_t w,
+                                               float *output) {
+  __m256 vo[M * N];
+  const index_t col = w * S - plan.pad_left;
+  if (w >= plan.w_begin && w + N * 8 <= plan.w_end) {
+    Conv2dAvx2Block<KH, KW, S, M, N, kFullRows, false>(plan, in_row, filter,
+                                                       col, kh_count, vo);
+  } else {
+    Conv2dAvx2Block<KH, KW, S, M, N, kFullRows, true>(plan, in_row, filter,
+                                                      col, kh_count, vo);
+  }
+  for (int i = 0; i < M; ++i) {
+    for (int j = 0; j < N; ++j) {
+      const index_t begin = w + j * 8;
+      StoreOutput(plan.epilogue, channel + i,
+                  out_offset + i * plan.out_image_size + begin,
+                  std::min<index_t>(8, plan.out_width - begin),
+                  vo[i * N + j], output);
+    }
+  }
+}
+
+// One output row of M output channels: blocks of N * 8 outputs, then of 8,
+// the last masked.
+template <int KH, int KW, int S, int M, int N, bool kFullRows>
+MACE_AVX2_TARGET inline void Conv2dAvx2Row(const Conv2dAvx2Plan &plan,
+                                           const float *in_row,
+                                           const float *filter,
+                                           const int kh_count,
+                                           const index_t channel,
+                                           const index_t out_offset,
+                                           float *output) {
+  index_t w = 0;
+  for (; w + N * 8 <= plan.out_width; w += N * 8) {
+    Conv2dAvx2Outputs<KH, KW, S, M, N, kFullRows>(
+        plan, in_row, filter, kh_count, channel, out_offset, w, output);
+  }
+  for (; w < plan.out_width; w += 8) {
+    Conv2dAvx2Outputs<KH, KW, S, M, 1, kFullRows>(
+        plan, in_row, filter, kh_count, channel, out_offset, w, output);
+  }
+}
+
+// Ho = 1, Wo = 16 (then 8), Co = 4, and Wo = 32 (then 8) for the remaining
+// output channels, at any dilation. The input is not padded: rows of the
+// window above or below the input are skipped and columns left or right of
+// it read as zero.
+template <int KH, int KW, int S>
+MACE_AVX2_TARGET void Conv2dAvx2KHxKWSn(const float *input,
+                                        const float *filter,
+                                        const index_t *in_shape,
+                                        const index_t *out_shape,
+                                        const int *pad_hw,
+                                        const int *dilation_hw,
+                                        const ConvEpilogue *epilogue,
+                                        float *output) {
+  const index_t in_channels = in_shape[1];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t out_channels = out_shape[1];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t filter_size = KH * KW;
+  const int pad_top = pad_hw[0];
+  const int dilation_h = dilation_hw[0];
+  // tanh and sigmoid are not vectorized, they run over the stored row
+  const bool in_registers = epilogue != nullptr
+      && (epilogue->activation == NOOP || epilogue->activation == RELU
+          || epilogue->activation == RELUX);
+
+  Conv2dAvx2Plan plan;
+  plan.in_channels = in_channels;
+  plan.in_height = in_height;
+  plan.in_width = in_width;
+  plan.in_image_size = in_height * in_width;
+  plan.filter_stride = in_channels * filter_size;
+  plan.out_width = out_width;
+  plan.out_image_size = out_height * out_width;
+  plan.dilation_h = dilation_h;
+  plan.dilation_w = dilation_hw[1];
+  plan.pad_left = pad_hw[1];
+  plan.w_begin =
+      std::min<index_t>(out_width, RoundUpDiv<index_t>(plan.pad_left, S));
+  plan.w_end = std::max(plan.w_begin, std::min(
+      out_width,
+      (in_width + plan.pad_left - (KW - 1) * plan.dilation_w - 1) / S + 1));
+  plan.epilogue = in_registers ? epilogue : nullptr;
+  const index_t in_batch_size = in_channels * plan.in_image_size;
+  const index_t out_batch_size = out_channels * plan.out_image_size;
+
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t m = 0; m < out_channels; m += 4) {
+      for (index_t h = 0; h < out_height; ++h) {
+        const index_t ih = h * S - pad_top;
+        // taps kh of the window in [kh_begin, kh_end) are inside the input
+        const int kh_begin = static_cast<int>(
+            RoundUpDiv<index_t>(std::max<index_t>(0, -ih), dilation_h));
+        const int kh_end = static_cast<int>(std::min<index_t>(
+            KH, RoundUpDiv<index_t>(std::max<index_t>(0, in_height - ih),
+                                    dilation_h)));
+        const int kh_count = std::max(0, kh_end - kh_begin);
+        const float *in_row = kh_count == 0 ? input
+            : input + b * in_batch_size
+                + (ih + kh_begin * dilation_h) * in_width;
+        const index_t out_offset =
+            b * out_batch_size + m * plan.out_image_size + h * out_width;
+        const index_t channels = std::min<index_t>(4, out_channels - m);
+        for (index_t i = 0; i < channels; i += (channels == 4 ? 4 : 1)) {
+          const float *filter_ptr =
+              filter + (m + i) * plan.filter_stride + kh_begin * KW;
+          const index_t offset = out_offset + i * plan.out_image_size;
+          if (channels == 4 && kh_count == KH) {
+            Conv2dAvx2Row<KH, KW, S, 4, 2, true>(plan, in_row, filter_ptr,
+                                                 kh_count, m, offset, output);
+          } else if (channels == 4) {
+            Conv2dAvx2Row<KH, KW, S, 4, 2, false>(plan, in_row, filter_ptr,
+                                                  kh_count, m, offset,
+                                                  output);
+          } else if (kh_count == KH) {
+            Conv2dAvx2Row<KH, KW, S, 1, 4, true>(plan, in_row, filter_ptr,
+                                                 kh_count, m + i, offset,
+                                                 output);
+          } else {
+            Conv2dAvx2Row<KH, KW, S, 1, 4, false>(plan, in_row, filter_ptr,
+                                                  kh_count, m + i, offset,
+                                                  output);
+          }
+        }
+
+        if (epilogue != nullptr && !in_registers) {
+          for (index_t i = 0; i < channels; ++i) {
+            const index_t offset = out_offset + i * plan.out_image_size;
+            ApplyConvEpilogue(*epilogue, m + i, offset, output + offset,
+                              out_width, output + offset);
+          }
+        }
+      }  // h
+    }  // m
+  }  // b
+}
+
+}  // namespace
+
+#define MACE_DEFINE_CONV_2D_AVX2(KH, KW, STRIDE)                          \
+  void Conv2dAvx2K##KH##x##KW##S##STRIDE(const float *input,              \
+                                         const float *filter,             \
+                                         const index_t *in_shape,         \
+                                         const index_t *out_shape,        \
+                                         const int *pad_hw,               \
+                                         const int *dilation_hw,          \
+                                         const ConvEpilogue *epilogue,    \
+                                         float *output) {                 \
+    Conv2dAvx2KHxKWSn<KH, KW, STRIDE>(input, filter, in_shape, out_shape, \
+                                      pad_hw, dilation_hw, epilogue,      \
+                                      output);                            \
+  }
+
+MACE_DEFINE_CONV_2D_AVX2(3, 3, 1)
+MACE_DEFINE_CONV_2D_AVX2(3, 3, 2)
+MACE_DEFINE_CONV_2D_AVX2(5, 5, 1)
+MACE_DEFINE_CONV_2D_AVX2(1, 7, 1)
+MACE_DEFINE_CONV_2D_AVX2(7, 1, 1)
+MACE_DEFINE_CONV_2D_AVX2(7, 7, 1)
+MACE_DEFINE_CONV_2D_AVX2(7, 7, 2)
+MACE_DEFINE_CONV_2D_AVX2(7, 7, 3)
+MACE_DEFINE_CONV_2D_AVX2(1, 15, 1)
+MACE_DEFINE_CONV_2D_AVX2(15, 1, 1)
+
+#undef MACE_DEFINE_CONV_2D_AVX2
+
+Conv2dAvx2Func Conv2dAvx2Kernel(const index_t filter_height,
+                                const index_t filter_width,
+                                const int stride_height,
+                                const int stride_width) {
+  static const struct {
+    index_t filter_height;
+    index_t filter_width;
+    int stride;
+    Conv2dAvx2Func func;
+  } kKernels[] = {
+      {3, 3, 1, Conv2dAvx2K3x3S1},
+      {3, 3, 2, Conv2dAvx2K3x3S2},
+      {5, 5, 1, Conv2dAvx2K5x5S1},
+      {1, 7, 1, Conv2dAvx2K1x7S1},
+      {7, 1, 1, Conv2dAvx2K7x1S1},
+      {7, 7, 1, Conv2dAvx2K7x7S1},
+      {7, 7, 2, Conv2dAvx2K7x7S2},
+      {7, 7, 3, Conv2dAvx2K7x7S3},
+      {1, 15, 1, Conv2dAvx2K1x15S1},
+      {15, 1, 1, Conv2dAvx2K15x1S1},
+  };
+  if (!CpuSupportsAvx2() || stride_height != stride_width) {
+    return nullptr;
+  }
+  for (const auto &kernel : kKernels) {
+    if (kernel.filter_height == filter_height
+        && kernel.filter_width == filter_width
+        && kernel.stride == stride_height) {
+      return kernel.func;
+    }
+  }
+  return nullptr;
+}
+
+#else
+
+bool CpuSupportsAvx2() {
+  return false;
+}
+
+Conv2dAvx2Func Conv2dAvx2Kernel(const index_t filter_height,
+                                const index_t filter_width,
+                                const int stride_height,
+                                const int stride_width) {
+  MACE_UNUSED(filter_height);
+  MACE_UNUSED(filter_width);
+  MACE_UNUSED(stride_height);
+  MACE_UNUSED(stride_width);
+  return nullptr;
+}
+
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+}  // namespace kernels
+}  // namespace mace
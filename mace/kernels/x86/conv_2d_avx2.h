@@ -0,0 +1,148 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_CONV_2D_AVX2_H_
+#define MACE_KERNELS_X86_CONV_2D_AVX2_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/conv_epilogue.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+// Compiled for avx2 per function, so the library still runs on cpus without
+// it; callers only run such functions when CpuSupportsAvx2.
+#define MACE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+namespace mace {
+namespace kernels {
+
+// Whether the cpu runs avx2 and fma instructions, false on other than x86.
+bool CpuSupportsAvx2();
+
+// The kernels overwrite the output, and apply epilogue to it unless it is
+// nullptr; the residual of the epilogue has out_shape. The input is not
+// padded, pad_hw is the top and left padding and the rest of the windows
+// past the input are zero; taps are dilation_hw apart.
+typedef void (*Conv2dAvx2Func)(const float *input,
+                               const float *filter,
+                               const index_t *in_shape,
+                               const index_t *out_shape,
+                               const int *pad_hw,
+                               const int *dilation_hw,
+                               const ConvEpilogue *epilogue,
+                               float *output);
+
+// Return the avx2 port of the neon kernel for the filter and strides, or
+// nullptr if there is none or the cpu does not support avx2 and fma.
+Conv2dAvx2Func Conv2dAvx2Kernel(const index_t filter_height,
+                                const index_t filter_width,
+                                const int stride_height,
+                                const int stride_width);
+
+#if defined(__x86_64__) || defined(__i386__)
+void Conv2dAvx2K3x3S1(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K3x3S2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K5x5S1(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K1x7S1(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K7x1S1(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K7x7S1(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K7x7S2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K7x7S3(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const int *pad_hw,
+                      const int *dilation_hw,
+                      const ConvEpilogue *epilogue,
+                      float *output);
+
+void Conv2dAvx2K1x15S1(const float *input,
+                       const float *filter,
+                       const index_t *in_shape,
+                       const index_t *out_shape,
+                       const int *pad_hw,
+                       const int *dilation_hw,
+                       const ConvEpilogue *epilogue,
+                       float *output);
+
+void Conv2dAvx2K15x1S1(const float *input,
+                       const float *filter,
+                       const index_t *in_shape,
+                       const index_t *out_shape,
+                       const int *pad_hw,
+                       const int *dilation_hw,
+                       const ConvEpilogue *epilogue,
+                       float *output);
+#endif  // defined(__x86_64__) || defined(__i386__)
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_CONV_2D_AVX2_H_
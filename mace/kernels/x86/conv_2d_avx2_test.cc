@@ -0,0 +1,207 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/arm/conv_winograd.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+void RandomFill(std::vector<float> *data) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(data->begin(), data->end(), [&gen, &nd] {
+    return std::max(-1.0f, std::min(1.0f, nd(gen)));
+  });
+}
+
+void TestConv2dAvx2(const index_t filter_height,
+                    const index_t filter_width,
+                    const int stride,
+                    const index_t in_channels,
+                    const index_t out_channels,
+                    const index_t out_height,
+                    const index_t out_width,
+                    const bool fuse_epilogue,
+                    const ActivationType activation,
+                    const int pad = 0,
+                    const int dilation = 1) {
+  Conv2dAvx2Func func =
+      Conv2dAvx2Kernel(filter_height, filter_width, stride, stride);
+  if (func == nullptr) {
+    LOG(INFO) << "avx2 is not supported, skip";
+    return;
+  }
+  const index_t batch = 2;
+  const index_t window_height = (filter_height - 1) * dilation + 1;
+  const index_t window_width = (filter_width - 1) * dilation + 1;
+  const index_t padded_height = (out_height - 1) * stride + window_height;
+  const index_t padded_width = (out_width - 1) * stride + window_width;
+  // at most SAME padding on each axis
+  const int pad_h = std::min<int>(pad, window_height / 2);
+  const int pad_w = std::min<int>(pad, window_width / 2);
+  const index_t in_height = padded_height - 2 * pad_h;
+  const index_t in_width = padded_width - 2 * pad_w;
+  const index_t in_shape[4] = {batch, in_channels, in_height, in_width};
+  const int pad_hw[2] = {pad_h, pad_w};
+  const index_t out_shape[4] = {batch, out_channels, out_height, out_width};
+  const index_t filter_shape[4] = {out_channels, in_channels, filter_height,
+                                   filter_width};
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * in_channels * filter_height
+                                * filter_width);
+  std::vector<float> output(batch * out_channels * out_height * out_width);
+  std::vector<float> output_ref(output.size());
+  std::vector<float> bias(out_channels);
+  std::vector<float> residual(output.size());
+  RandomFill(&input);
+  RandomFill(&filter);
+  RandomFill(&bias);
+  RandomFill(&residual);
+  ConvEpilogue epilogue;
+  epilogue.bias = bias.data();
+  epilogue.residual = residual.data();
+  epilogue.activation = activation;
+  epilogue.relux_max_limit = 0.5f;
+
+  ConvRef(input.data(), filter.data(), in_shape, out_shape, filter_shape,
+          strides, dilations, pad_hw, output_ref.data());
+  if (fuse_epilogue) {
+    const index_t out_image_size = out_height * out_width;
+    for (size_t i = 0; i < output_ref.size(); ++i) {
+      output_ref[i] = ApplyConvEpilogue(
+          epilogue, i / out_image_size % out_channels, i, output_ref[i]);
+    }
+  }
+  func(input.data(), filter.data(), in_shape, out_shape, pad_hw, dilations,
+       fuse_epilogue ? &epilogue : nullptr, output.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3) << " with index " << i;
+  }
+}
+}  // namespace
+
+TEST(Conv2dAvx2Test, K3x3S1) {
+  Conv2dAvx2Func func = Conv2dAvx2Kernel(3, 3, 1, 1);
+  if (func == nullptr) {
+    LOG(INFO) << "avx2 is not supported, skip";
+    return;
+  }
+  const index_t batch = 1;
+  const index_t in_channels = 16;
+  const index_t out_channels = 10;
+  const index_t in_height = 23;
+  const index_t in_width = 30;
+  const index_t in_shape[4] = {batch, in_channels, in_height, in_width};
+  const index_t out_shape[4] =
+      {batch, out_channels, in_height - 2, in_width - 2};
+
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * in_channels * 9);
+  std::vector<float> output(batch * out_channels * out_shape[2]
+                                * out_shape[3]);
+  std::vector<float> output_ref(output.size());
+  RandomFill(&input);
+  RandomFill(&filter);
+
+  ConvRef3x3s1(input.data(), filter.data(), batch, in_height, in_width,
+               in_channels, out_channels, output_ref.data());
+  const int pad_hw[2] = {0, 0};
+  const int dilation_hw[2] = {1, 1};
+  func(input.data(), filter.data(), in_shape, out_shape, pad_hw, dilation_hw,
+       nullptr, output.data());
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3) << " with index " << i;
+  }
+}
+
+TEST(Conv2dAvx2Test, Kernels) {
+  // widths cover the 32, 16 and 8 wide blocks and the masked tail; channels
+  // cover the 4 output channel block and the remainder
+  for (index_t out_width : {16, 20, 28, 44}) {
+    TestConv2dAvx2(3, 3, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(3, 3, 2, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(5, 5, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(1, 7, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(7, 1, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(7, 7, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(7, 7, 2, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(7, 7, 3, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(1, 15, 1, 5, 6, 7, out_width, false, NOOP);
+    TestConv2dAvx2(15, 1, 1, 5, 6, 7, out_width, false, NOOP);
+  }
+}
+
+TEST(Conv2dAvx2Test, Padding) {
+  // the input is not padded, border blocks mask the columns outside it and
+  // rows outside it are skipped
+  for (index_t out_width : {5, 20, 44}) {
+    TestConv2dAvx2(3, 3, 1, 5, 6, 7, out_width, false, NOOP, 1);
+    TestConv2dAvx2(3, 3, 2, 5, 6, 7, out_width, false, NOOP, 1);
+    TestConv2dAvx2(5, 5, 1, 5, 6, 7, out_width, false, NOOP, 2);
+    TestConv2dAvx2(7, 7, 2, 5, 6, 7, out_width, false, NOOP, 3);
+    TestConv2dAvx2(7, 7, 3, 5, 6, 7, out_width, false, NOOP, 3);
+    TestConv2dAvx2(1, 15, 1, 5, 6, 7, out_width + 8, false, NOOP, 7);
+  }
+  TestConv2dAvx2(3, 3, 1, 5, 6, 7, 20, true, RELU, 1);
+  TestConv2dAvx2(7, 7, 1, 5, 7, 4, 44, true, TANH, 3);
+}
+
+TEST(Conv2dAvx2Test, Dilation) {
+  // rows of the window skip dilation - 1 input rows, at the borders some of
+  // the middle ones may be outside the input too
+  for (index_t out_width : {5, 20, 44}) {
+    TestConv2dAvx2(3, 3, 1, 5, 6, 7, out_width, false, NOOP, 0, 2);
+    TestConv2dAvx2(3, 3, 1, 5, 6, 7, out_width, false, NOOP, 4, 4);
+    TestConv2dAvx2(3, 3, 2, 5, 6, 7, out_width, false, NOOP, 2, 2);
+    TestConv2dAvx2(5, 5, 1, 5, 6, 7, out_width, false, NOOP, 6, 3);
+    TestConv2dAvx2(7, 1, 1, 5, 6, 7, out_width, false, NOOP, 6, 2);
+  }
+  // padding larger than the input, as in atrous pyramid pooling
+  TestConv2dAvx2(3, 3, 1, 5, 6, 9, 9, false, NOOP, 12, 12);
+  TestConv2dAvx2(3, 3, 1, 5, 6, 7, 20, true, RELU, 6, 6);
+}
+
+TEST(Conv2dAvx2Test, Epilogue) {
+  // relu and relux are applied in registers, tanh to the stored rows
+  for (ActivationType activation : {NOOP, RELU, RELUX, TANH}) {
+    for (index_t out_width : {20, 44}) {
+      TestConv2dAvx2(3, 3, 1, 5, 6, 7, out_width, true, activation);
+      TestConv2dAvx2(3, 3, 2, 5, 7, 7, out_width, true, activation);
+      TestConv2dAvx2(7, 1, 1, 5, 3, 7, out_width, true, activation);
+    }
+  }
+}
+
+TEST(Conv2dAvx2Test, NoKernel) {
+  EXPECT_EQ(nullptr, Conv2dAvx2Kernel(3, 3, 1, 2));
+  EXPECT_EQ(nullptr, Conv2dAvx2Kernel(11, 11, 1, 1));
+  EXPECT_EQ(nullptr, Conv2dAvx2Kernel(1, 1, 1, 1));
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,247 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#endif
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <tuple>
+#include <vector>
+
+#include "mace/core/macros.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
+#include "mace/kernels/x86/jit_gemm.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+#if defined(MACE_ENABLE_JIT)
+std::atomic<bool> gemm_jit_enabled(true);
+#else
+std::atomic<bool> gemm_jit_enabled(false);
+#endif
+}  // namespace
+
+bool GemmJitEnabled() {
+  return gemm_jit_enabled.load(std::memory_order_relaxed);
+}
+
+void SetGemmJitEnabled(const bool enabled) {
+  gemm_jit_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+#if defined(__x86_64__) && defined(__linux__)
+
+namespace {
+// Deeper blocks would not fit their unrolled code in the instruction cache.
+const index_t kMaxJitDepth = 256;
+
+// The arguments of the kernel in the System V calling convention.
+enum Register { RDX = 2, RSI = 6, RDI = 7 };
+const Register kRegA = RDI;
+const Register kRegB = RSI;
+const Register kRegC = RDX;
+
+// Encodes the few avx2 instructions the kernels use, with ymm registers
+// and [base + displacement] memory operands.
+class Emitter {
+ public:
+  const std::vector<uint8_t> &code() const { return code_; }
+
+  void VMovUpsLoad(int ymm, Register base, int32_t disp) {
+    Vex(ymm, 0, base, 1, 0);
+    Byte(0x10);
+    Memory(ymm, base, disp);
+  }
+
+  void VMovUpsStore(Register base, int32_t disp, int ymm) {
+    Vex(ymm, 0, base, 1, 0);
+    Byte(0x11);
+    Memory(ymm, base, disp);
+  }
+
+  void VBroadcastSs(int ymm, Register base, int32_t disp) {
+    Vex(ymm, 0, base, 2, 1);
+    Byte(0x18);
+    Memory(ymm, base, disp);
+  }
+
+  // ymm_dst += ymm_a * ymm_b
+  void VFmadd231Ps(int ymm_dst, int ymm_a, int ymm_b) {
+    Vex(ymm_dst, ymm_a, ymm_b, 2, 1);
+    Byte(0xB8);
+    Byte(0xC0 | ((ymm_dst & 7) << 3) | (ymm_b & 7));
+  }
+
+  void VZeroUpper() {
+    Byte(0xC5);
+    Byte(0xF8);
+    Byte(0x77);
+  }
+
+  void Ret() { Byte(0xC3); }
+
+ private:
+  void Byte(int byte) { code_.push_back(static_cast<uint8_t>(byte)); }
+
+  // Three byte vex prefix of a 256 bit, W0 instruction in the opcode map
+  // (1: 0f, 2: 0f38) with the implied prefix pp (0: none, 1: 66).
+  void Vex(int reg, int vvvv, int rm, int map, int pp) {
+    Byte(0xC4);
+    Byte(((~reg >> 3) & 1) << 7 | 1 << 6 | ((~rm >> 3) & 1) << 5 | map);
+    Byte((~vvvv & 15) << 3 | 1 << 2 | pp);
+  }
+
+  void Memory(int reg, Register base, int32_t disp) {
+    if (disp >= -128 && disp < 128) {
+      Byte(0x40 | (reg & 7) << 3 | base);
+      Byte(disp);
+    } else {
+      Byte(0x80 | (reg & 7) << 3 | base);
+      for (int i = 0; i < 4; ++i) {
+        Byte((static_cast<uint32_t>(disp) >> (8 * i)) & 0xFF);
+      }
+    }
+  }
+
+  std::vector<uint8_t> code_;
+};
+
+// ymm0-11 accumulate the tile, 2 per row, ymm12-13 hold a row of B and
+// ymm14 an element of A.
+std::vector<uint8_t> GenerateGemmTile(const index_t K,
+                                      const index_t stride_a,
+                                      const index_t stride_b,
+                                      const index_t stride_c) {
+  const int kFloat = sizeof(float);
+  Emitter emitter;
+  for (index_t h = 0; h < kJitGemmTileHeight; ++h) {
+    for (int w = 0; w < 2; ++w) {
+      emitter.VMovUpsLoad(2 * h + w, kRegC,
+                          static_cast<int32_t>((h * stride_c + w * 8)
+                                               * kFloat));
+    }
+  }
+  for (index_t k = 0; k < K; ++k) {
+    for (int w = 0; w < 2; ++w) {
+      emitter.VMovUpsLoad(12 + w, kRegB,
+                          static_cast<int32_t>((k * stride_b + w * 8)
+                                               * kFloat));
+    }
+    for (index_t h = 0; h < kJitGemmTileHeight; ++h) {
+      emitter.VBroadcastSs(14, kRegA,
+                           static_cast<int32_t>((h * stride_a + k) * kFloat));
+      emitter.VFmadd231Ps(2 * h, 14, 12);
+      emitter.VFmadd231Ps(2 * h + 1, 14, 13);
+    }
+  }
+  for (index_t h = 0; h < kJitGemmTileHeight; ++h) {
+    for (int w = 0; w < 2; ++w) {
+      emitter.VMovUpsStore(kRegC,
+                           static_cast<int32_t>((h * stride_c + w * 8)
+                                                * kFloat),
+                           2 * h + w);
+    }
+  }
+  emitter.VZeroUpper();
+  emitter.Ret();
+  return emitter.code();
+}
+
+// Executable copy of generated code.
+class JitCode {
+ public:
+  explicit JitCode(const std::vector<uint8_t> &code)
+      : size_(code.size()), data_(MAP_FAILED) {
+    data_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data_ == MAP_FAILED) {
+      return;
+    }
+    memcpy(data_, code.data(), size_);
+    if (mprotect(data_, size_, PROT_READ | PROT_EXEC) != 0) {
+      munmap(data_, size_);
+      data_ = MAP_FAILED;
+    }
+  }
+
+  ~JitCode() {
+    if (data_ != MAP_FAILED) {
+      munmap(data_, size_);
+    }
+  }
+
+  const void *data() const {
+    return data_ == MAP_FAILED ? nullptr : data_;
+  }
+
+ private:
+  size_t size_;
+  void *data_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(JitCode);
+};
+}  // namespace
+
+JitGemmTileFunc JitGemmTileKernel(const index_t K,
+                                  const index_t stride_a,
+                                  const index_t stride_b,
+                                  const index_t stride_c) {
+  // the displacements of the furthest operands must fit in 32 bits
+  const index_t kMaxStride = (1 << 24) / kMaxJitDepth;
+  if (!CpuSupportsAvx2() || K <= 0 || K > kMaxJitDepth
+      || stride_a > kMaxStride || stride_b > kMaxStride
+      || stride_c > kMaxStride) {
+    return nullptr;
+  }
+  typedef std::tuple<index_t, index_t, index_t, index_t> Key;
+  static std::mutex mutex;
+  static std::map<Key, std::unique_ptr<JitCode>> kernels;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<JitCode> &kernel =
+      kernels[Key(K, stride_a, stride_b, stride_c)];
+  if (kernel == nullptr) {
+    VLOG(2) << "Generate gemm kernel for K " << K << ", strides " << stride_a
+            << ", " << stride_b << ", " << stride_c;
+    kernel.reset(new JitCode(GenerateGemmTile(K, stride_a, stride_b,
+                                              stride_c)));
+  }
+  return reinterpret_cast<JitGemmTileFunc>(
+      const_cast<void *>(kernel->data()));
+}
+
+#else
+
+JitGemmTileFunc JitGemmTileKernel(const index_t K,
+                                  const index_t stride_a,
+                                  const index_t stride_b,
+                                  const index_t stride_c) {
+  MACE_UNUSED(K);
+  MACE_UNUSED(stride_a);
+  MACE_UNUSED(stride_b);
+  MACE_UNUSED(stride_c);
+  return nullptr;
+}
+
+#endif  // defined(__x86_64__) && defined(__linux__)
+
+}  // namespace kernels
+}  // namespace mace
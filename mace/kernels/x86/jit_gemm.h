@@ -0,0 +1,52 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_JIT_GEMM_H_
+#define MACE_KERNELS_X86_JIT_GEMM_H_
+
+#include "mace/core/types.h"
+
+// Gemm micro kernels generated at run time on x86-64 cpus with avx2 and
+// fma. Each one has the depth and the strides of the blocks it multiplies
+// built into its instructions and the depth loop fully unrolled, so the
+// convolutions lowered to gemm get a kernel for the exact shapes of their
+// layers. Kernels are generated on first use and kept for the process.
+
+namespace mace {
+namespace kernels {
+
+const index_t kJitGemmTileHeight = 6;
+const index_t kJitGemmTileWidth = 16;
+
+// C[6 x 16] += A[6 x K] * B[K x 16] for the K and strides it was generated
+// for.
+typedef void (*JitGemmTileFunc)(const float *A, const float *B, float *C);
+
+// Return the kernel for the depth and strides, which are in floats, or
+// nullptr if the cpu cannot run generated code or K is too deep to unroll.
+JitGemmTileFunc JitGemmTileKernel(const index_t K,
+                                  const index_t stride_a,
+                                  const index_t stride_b,
+                                  const index_t stride_c);
+
+// Whether Gemm runs the generated kernels. It is off unless the library is
+// built with --define jit=true.
+bool GemmJitEnabled();
+
+void SetGemmJitEnabled(const bool enabled);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_JIT_GEMM_H_
@@ -0,0 +1,105 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/x86/jit_gemm.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+void RandomFill(std::vector<float> *data) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(data->begin(), data->end(), [&gen, &nd] { return nd(gen); });
+}
+
+void TestJitGemmTile(const index_t K,
+                     const index_t stride_a,
+                     const index_t stride_b,
+                     const index_t stride_c) {
+  JitGemmTileFunc func = JitGemmTileKernel(K, stride_a, stride_b, stride_c);
+  if (func == nullptr) {
+    LOG(INFO) << "jit is not supported, skip";
+    return;
+  }
+  EXPECT_EQ(func, JitGemmTileKernel(K, stride_a, stride_b, stride_c));
+  std::vector<float> A(kJitGemmTileHeight * stride_a);
+  std::vector<float> B(K * stride_b);
+  std::vector<float> C(kJitGemmTileHeight * stride_c);
+  RandomFill(&A);
+  RandomFill(&B);
+  RandomFill(&C);
+  std::vector<float> C_ref(C);
+  for (index_t h = 0; h < kJitGemmTileHeight; ++h) {
+    for (index_t w = 0; w < kJitGemmTileWidth; ++w) {
+      for (index_t k = 0; k < K; ++k) {
+        C_ref[h * stride_c + w] += A[h * stride_a + k] * B[k * stride_b + w];
+      }
+    }
+  }
+  func(A.data(), B.data(), C.data());
+
+  for (size_t i = 0; i < C.size(); ++i) {
+    EXPECT_NEAR(C_ref[i], C[i], 1e-3) << " with index " << i;
+  }
+}
+
+// Gemm with the generated kernels, compared with the reference.
+void TestJitGemm(const index_t batch,
+                 const index_t height,
+                 const index_t K,
+                 const index_t width) {
+  std::vector<float> A(batch * height * K);
+  std::vector<float> B(batch * K * width);
+  std::vector<float> C(batch * height * width);
+  std::vector<float> C_ref(C.size());
+  RandomFill(&A);
+  RandomFill(&B);
+  const bool enabled = GemmJitEnabled();
+  SetGemmJitEnabled(true);
+  Gemm(A.data(), B.data(), batch, height, K, width, C.data());
+  SetGemmJitEnabled(enabled);
+  GemmRef(A.data(), B.data(), batch, height, K, width, C_ref.data());
+
+  for (size_t i = 0; i < C.size(); ++i) {
+    EXPECT_NEAR(C_ref[i], C[i], 1e-3) << " with index " << i;
+  }
+}
+}  // namespace
+
+TEST(JitGemmTest, Tile) {
+  // short displacements, and long ones past 128 bytes
+  TestJitGemmTile(1, 1, 16, 16);
+  TestJitGemmTile(5, 5, 16, 16);
+  TestJitGemmTile(64, 64, 64, 64);
+  TestJitGemmTile(37, 100, 40, 33);
+  TestJitGemmTile(256, 300, 19, 1000);
+}
+
+TEST(JitGemmTest, Gemm) {
+  // whole tiles, and the rows and columns left over
+  TestJitGemm(1, 12, 64, 32);
+  TestJitGemm(1, 65, 130, 70);
+  TestJitGemm(2, 32, 17, 49);
+}
+
+}  // namespace kernels
+}  // namespace mace
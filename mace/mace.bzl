@@ -47,3 +47,9 @@ def if_openmp_enabled(a):
       "//mace:openmp_enabled": a,
       "//conditions:default": [],
   })
+
+def if_jit_enabled(a):
+  return select({
+      "//mace:jit_enabled": a,
+      "//conditions:default": [],
+  })
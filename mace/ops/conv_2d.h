@@ -34,27 +34,39 @@ class Conv2dOp : public ConvPool2dOpBase<D, T> {
                  this->padding_type_,
                  this->paddings_,
                  this->dilations_.data(),
+                 OperatorBase::GetOptionalArg<int>("group", 1),
                  kernels::StringToActivationType(
                      OperatorBase::GetOptionalArg<std::string>("activation",
                                                                "NOOP")),
                  OperatorBase::GetOptionalArg<float>("max_limit", 0.0f),
                  static_cast<bool>(OperatorBase::GetOptionalArg<int>(
                      "is_filter_transformed", false)),
-                 ws->GetScratchBuffer(D)) {}
+                 ws->GetScratchBuffer(D),
+                 D == DeviceType::CPU
+                     ? ws->CreateDerivedTensor(
+                           op_def.name() + "_transformed_filter",
+                           GetDeviceAllocator(D), DataTypeToEnum<T>::v())
+                     : nullptr,
+                 this->data_format_) {}
 
   MaceStatus Run(StatsFuture *future) override {
     const Tensor *input = this->Input(INPUT);
     const Tensor *filter = this->Input(FILTER);
     const Tensor *bias = this->InputSize() >= 3 ? this->Input(BIAS) : nullptr;
+    // a residual add the converter folded into the convolution
+    const Tensor *residual =
+        this->InputSize() >= 4 ? this->Input(RESIDUAL) : nullptr;
     Tensor *output = this->Output(OUTPUT);
-    return functor_(input, filter, bias, output, future);
+    return functor_(input, filter, bias, residual, output, future);
   }
 
+  std::string Algorithm() const override { return functor_.algorithm_; }
+
  private:
   kernels::Conv2dFunctor<D, T> functor_;
 
  protected:
-  MACE_OP_INPUT_TAGS(INPUT, FILTER, BIAS);
+  MACE_OP_INPUT_TAGS(INPUT, FILTER, BIAS, RESIDUAL);
   MACE_OP_OUTPUT_TAGS(OUTPUT);
 };
 
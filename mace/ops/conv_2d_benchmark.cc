@@ -13,9 +13,11 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <string>
 
 #include "mace/core/operator.h"
 #include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/eltwise.h"
 #include "mace/ops/conv_2d.h"
 #include "mace/ops/ops_test_util.h"
 
@@ -151,11 +153,14 @@ MACE_BM_CONV_2D(1, 64, 32, 31, 1, 15, 1, 1, SAME, 128);
 MACE_BM_CONV_2D(1, 64, 32, 31, 7, 7, 1, 1, SAME, 128);
 MACE_BM_CONV_2D(1, 64, 32, 31, 7, 7, 2, 1, SAME, 128);
 MACE_BM_CONV_2D(1, 64, 32, 31, 7, 7, 3, 1, SAME, 128);
+MACE_BM_CONV_2D(1, 64, 56, 56, 3, 3, 2, 1, SAME, 128);
+MACE_BM_CONV_2D(1, 64, 32, 31, 1, 7, 1, 1, SAME, 128);
 
 // 3 channels input
 MACE_BM_CONV_2D(1, 3, 480, 480, 1, 1, 1, 1, VALID, 3);
 MACE_BM_CONV_2D(1, 3, 224, 224, 3, 3, 2, 1, SAME, 32);
 MACE_BM_CONV_2D(1, 3, 224, 224, 3, 3, 2, 1, VALID, 32);
+MACE_BM_CONV_2D(1, 3, 224, 224, 7, 7, 2, 1, SAME, 64);
 
 // Dilations
 MACE_BM_CONV_2D(1, 32, 256, 256, 3, 3, 1, 2, VALID, 32);
@@ -164,6 +169,10 @@ MACE_BM_CONV_2D(1, 32, 256, 256, 3, 3, 1, 4, VALID, 32);
 // MobileNet
 MACE_BM_CONV_2D(1, 128, 56, 56, 1, 1, 1, 1, SAME, 128);
 MACE_BM_CONV_2D(1, 1024, 7, 7, 1, 1, 1, 1, SAME, 1024);
+MACE_BM_CONV_2D(8, 1024, 7, 7, 1, 1, 1, 1, SAME, 1024);
+// ResNet projection shortcuts
+MACE_BM_CONV_2D(1, 256, 56, 56, 1, 1, 2, 1, VALID, 512);
+MACE_BM_CONV_2D(4, 512, 28, 28, 1, 1, 2, 1, VALID, 1024);
 
 MACE_BM_CONV_2D(64, 32, 34, 34, 3, 3, 1, 1, VALID, 32);
 MACE_BM_CONV_2D(1, 32, 34, 34, 3, 3, 1, 1, VALID, 32);
@@ -180,6 +189,328 @@ MACE_BM_CONV_2D(1, 3, 128, 128, 3, 3, 1, 1, SAME, 16);
 MACE_BM_CONV_2D(1, 3, 256, 256, 3, 3, 1, 1, SAME, 16);
 MACE_BM_CONV_2D(1, 3, 64, 64, 3, 3, 1, 1, SAME, 16);
 
+namespace {
+// A ResNet shortcut: fused runs one Conv2D with the residual input, otherwise
+// Conv2D, Eltwise sum and Activation.
+template <DeviceType D, typename T>
+void ResidualConv2d(int iters,
+                    int batch,
+                    int channels,
+                    int height,
+                    int width,
+                    int kernel,
+                    int output_channels,
+                    bool fused) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+  net.AddRandomInput<D, float>("Input", {batch, channels, height, width});
+  net.AddRandomInput<D, float>("Filter",
+                               {output_channels, channels, kernel, kernel});
+  net.AddRandomInput<D, float>("Bias", {output_channels});
+  net.AddRandomInput<D, float>("Residual",
+                               {batch, output_channels, height, width});
+
+  if (fused) {
+    OpDefBuilder("Conv2D", "Conv2dTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Input("Residual")
+        .Output("Output")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .AddStringArg("activation", "RELU")
+        .Finalize(net.AddNewOperatorDef());
+  } else {
+    // The net is created before it runs, the later ops need their inputs.
+    net.AddRandomInput<D, float>("ConvOutput",
+                                 {batch, output_channels, height, width});
+    net.AddRandomInput<D, float>("SumOutput",
+                                 {batch, output_channels, height, width});
+    OpDefBuilder("Conv2D", "Conv2dTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Output("ConvOutput")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(net.AddNewOperatorDef());
+    OpDefBuilder("Eltwise", "EltwiseTest")
+        .Input("ConvOutput")
+        .Input("Residual")
+        .Output("SumOutput")
+        .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+        .Finalize(net.AddNewOperatorDef());
+    OpDefBuilder("Activation", "ActivationTest")
+        .Input("SumOutput")
+        .Output("Output")
+        .AddStringArg("activation", "RELU")
+        .Finalize(net.AddNewOperatorDef());
+  }
+
+  net.Setup(D);
+
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+    net.Sync();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+    net.Sync();
+  }
+}
+}  // namespace
+
+#define MACE_BM_RESIDUAL_CONV_2D_MACRO(N, C, H, W, K, OC, FUSED, TYPE, DEVICE) \
+  static void                                                                 \
+      MACE_BM_RESIDUAL_CONV_2D_##N##_##C##_##H##_##W##_K##K##_##OC##_        \
+        ##FUSED##_##TYPE##_##DEVICE(int iters) {                              \
+    const int64_t macc = static_cast<int64_t>(iters) * N * OC * H * W        \
+        * (K * K * C + 3);                                                    \
+    mace::testing::MaccProcessed(macc);                                       \
+    mace::testing::BytesProcessed(static_cast<int64_t>(iters) * N            \
+                                  * (C + OC) * H * W * sizeof(TYPE));         \
+    ResidualConv2d<DEVICE, TYPE>(iters, N, C, H, W, K, OC, FUSED == 1);       \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_RESIDUAL_CONV_2D_##N##_##C##_##H##_##W##_K##K##_##OC##_        \
+        ##FUSED##_##TYPE##_##DEVICE)
+
+#define MACE_BM_RESIDUAL_CONV_2D(N, C, H, W, K, OC)                    \
+  MACE_BM_RESIDUAL_CONV_2D_MACRO(N, C, H, W, K, OC, 0, float, CPU);    \
+  MACE_BM_RESIDUAL_CONV_2D_MACRO(N, C, H, W, K, OC, 1, float, CPU);
+
+// ResNet blocks
+MACE_BM_RESIDUAL_CONV_2D(1, 64, 56, 56, 3, 64);
+MACE_BM_RESIDUAL_CONV_2D(1, 128, 28, 28, 3, 128);
+MACE_BM_RESIDUAL_CONV_2D(1, 64, 56, 56, 1, 256);
+MACE_BM_RESIDUAL_CONV_2D(1, 256, 14, 14, 1, 1024);
+
+namespace {
+// fused runs one grouped Conv2D, otherwise Slice, a Conv2D per group and
+// Concat.
+template <DeviceType D, typename T>
+void GroupedConv2d(int iters,
+                   int batch,
+                   int channels,
+                   int height,
+                   int width,
+                   int kernel,
+                   int group,
+                   int output_channels,
+                   bool fused) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+  net.AddRandomInput<D, float>("Input", {batch, channels, height, width});
+  net.AddRandomInput<D, float>(
+      "Filter", {output_channels, channels / group, kernel, kernel});
+  net.AddRandomInput<D, float>("Bias", {output_channels});
+
+  if (fused) {
+    OpDefBuilder("Conv2D", "Conv2dTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Output("Output")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .AddIntArg("group", group)
+        .Finalize(net.AddNewOperatorDef());
+  } else {
+    // The net is created before it runs, the later ops need their inputs.
+    OpDefBuilder slice("Slice", "SliceTest");
+    slice.Input("Input").AddIntArg("axis", 1);
+    OpDefBuilder concat("Concat", "ConcatTest");
+    concat.Output("Output").AddIntArg("axis", 1);
+    for (int g = 0; g < group; ++g) {
+      const std::string suffix = MakeString(g);
+      net.AddRandomInput<D, float>("SliceOutput" + suffix,
+                                   {batch, channels / group, height, width});
+      net.AddRandomInput<D, float>(
+          "ConvOutput" + suffix,
+          {batch, output_channels / group, height, width});
+      net.AddRandomInput<D, float>(
+          "Filter" + suffix,
+          {output_channels / group, channels / group, kernel, kernel});
+      net.AddRandomInput<D, float>("Bias" + suffix,
+                                   {output_channels / group});
+      slice.Output("SliceOutput" + suffix);
+      concat.Input("ConvOutput" + suffix);
+    }
+    slice.Finalize(net.AddNewOperatorDef());
+    for (int g = 0; g < group; ++g) {
+      const std::string suffix = MakeString(g);
+      OpDefBuilder("Conv2D", "Conv2dTest" + suffix)
+          .Input("SliceOutput" + suffix)
+          .Input("Filter" + suffix)
+          .Input("Bias" + suffix)
+          .Output("ConvOutput" + suffix)
+          .AddIntsArg("strides", {1, 1})
+          .AddIntArg("padding", Padding::SAME)
+          .AddIntsArg("dilations", {1, 1})
+          .Finalize(net.AddNewOperatorDef());
+    }
+    concat.Finalize(net.AddNewOperatorDef());
+  }
+
+  net.Setup(D);
+
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+    net.Sync();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+    net.Sync();
+  }
+}
+}  // namespace
+
+#define MACE_BM_GROUPED_CONV_2D_MACRO(N, C, H, W, K, G, OC, FUSED, TYPE,       \
+                                      DEVICE)                                 \
+  static void                                                                 \
+      MACE_BM_GROUPED_CONV_2D_##N##_##C##_##H##_##W##_K##K##_G##G##_##OC##_   \
+        ##FUSED##_##TYPE##_##DEVICE(int iters) {                              \
+    const int64_t macc = static_cast<int64_t>(iters) * N * OC * H * W        \
+        * (K * K * C / G + 1);                                                \
+    mace::testing::MaccProcessed(macc);                                       \
+    mace::testing::BytesProcessed(static_cast<int64_t>(iters) * N * C * H    \
+                                  * W * sizeof(TYPE));                        \
+    GroupedConv2d<DEVICE, TYPE>(iters, N, C, H, W, K, G, OC, FUSED == 1);     \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_GROUPED_CONV_2D_##N##_##C##_##H##_##W##_K##K##_G##G##_##OC##_   \
+        ##FUSED##_##TYPE##_##DEVICE)
+
+#define MACE_BM_GROUPED_CONV_2D(N, C, H, W, K, G, OC)                   \
+  MACE_BM_GROUPED_CONV_2D_MACRO(N, C, H, W, K, G, OC, 0, float, CPU);   \
+  MACE_BM_GROUPED_CONV_2D_MACRO(N, C, H, W, K, G, OC, 1, float, CPU);
+
+// ResNeXt-50 32x4d
+MACE_BM_GROUPED_CONV_2D(1, 128, 56, 56, 3, 32, 128);
+MACE_BM_GROUPED_CONV_2D(1, 256, 28, 28, 3, 32, 256);
+// ShuffleNet g = 3 pointwise
+MACE_BM_GROUPED_CONV_2D(1, 240, 28, 28, 1, 3, 60);
+MACE_BM_GROUPED_CONV_2D(1, 60, 28, 28, 1, 3, 240);
+
+namespace {
+// A SAME 3x3 convolution dilated by rate, as the blocks of atrous spatial
+// pyramid pooling run it: fused is one dilated Conv2D, otherwise the
+// SpaceToBatchND, Conv2D and BatchToSpaceND TensorFlow lowers it to.
+template <DeviceType D, typename T>
+void AtrousConv2d(int iters,
+                  int batch,
+                  int channels,
+                  int height,
+                  int width,
+                  int rate,
+                  int output_channels,
+                  bool fused) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+  net.AddRandomInput<D, float>("Input", {batch, channels, height, width});
+  net.AddRandomInput<D, float>("Filter", {output_channels, channels, 3, 3});
+  net.AddRandomInput<D, float>("Bias", {output_channels});
+
+  if (fused) {
+    OpDefBuilder("Conv2D", "Conv2dTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Output("Output")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {rate, rate})
+        .Finalize(net.AddNewOperatorDef());
+  } else {
+    // SAME padding, then up to the next multiple of rate, cropped at the end
+    const int pad_bottom = rate + (rate - (height + 2 * rate) % rate) % rate;
+    const int pad_right = rate + (rate - (width + 2 * rate) % rate) % rate;
+    const int block_height = (height + rate + pad_bottom) / rate;
+    const int block_width = (width + rate + pad_right) / rate;
+    net.AddRandomInput<D, float>(
+        "SpaceToBatchOutput",
+        {batch * rate * rate, channels, block_height, block_width});
+    net.AddRandomInput<D, float>(
+        "ConvOutput", {batch * rate * rate, output_channels,
+                       block_height - 2, block_width - 2});
+    OpDefBuilder("SpaceToBatchND", "SpaceToBatchNDTest")
+        .Input("Input")
+        .Output("SpaceToBatchOutput")
+        .AddIntsArg("paddings", {rate, pad_bottom, rate, pad_right})
+        .AddIntsArg("block_shape", {rate, rate})
+        .Finalize(net.AddNewOperatorDef());
+    OpDefBuilder("Conv2D", "Conv2dTest")
+        .Input("SpaceToBatchOutput")
+        .Input("Filter")
+        .Input("Bias")
+        .Output("ConvOutput")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::VALID)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(net.AddNewOperatorDef());
+    OpDefBuilder("BatchToSpaceND", "BatchToSpaceNDTest")
+        .Input("ConvOutput")
+        .Output("Output")
+        .AddIntsArg("crops", {0, pad_bottom - rate, 0, pad_right - rate})
+        .AddIntsArg("block_shape", {rate, rate})
+        .Finalize(net.AddNewOperatorDef());
+  }
+
+  net.Setup(D);
+
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+    net.Sync();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+    net.Sync();
+  }
+}
+}  // namespace
+
+#define MACE_BM_ATROUS_CONV_2D_MACRO(N, C, H, W, D, OC, FUSED, TYPE, DEVICE)  \
+  static void                                                                 \
+      MACE_BM_ATROUS_CONV_2D_##N##_##C##_##H##_##W##_D##D##_##OC##_           \
+        ##FUSED##_##TYPE##_##DEVICE(int iters) {                              \
+    const int64_t macc = static_cast<int64_t>(iters) * N * OC * H * W        \
+        * (9 * C + 1);                                                        \
+    mace::testing::MaccProcessed(macc);                                       \
+    mace::testing::BytesProcessed(static_cast<int64_t>(iters) * N * C * H    \
+                                  * W * sizeof(TYPE));                        \
+    AtrousConv2d<DEVICE, TYPE>(iters, N, C, H, W, D, OC, FUSED == 1);         \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_ATROUS_CONV_2D_##N##_##C##_##H##_##W##_D##D##_##OC##_           \
+        ##FUSED##_##TYPE##_##DEVICE)
+
+#define MACE_BM_ATROUS_CONV_2D(N, C, H, W, D, OC)                   \
+  MACE_BM_ATROUS_CONV_2D_MACRO(N, C, H, W, D, OC, 0, float, CPU);   \
+  MACE_BM_ATROUS_CONV_2D_MACRO(N, C, H, W, D, OC, 1, float, CPU);
+
+// DeepLab v3 ASPP at output stride 16 on 513x513
+MACE_BM_ATROUS_CONV_2D(1, 256, 33, 33, 6, 256);
+MACE_BM_ATROUS_CONV_2D(1, 256, 33, 33, 12, 256);
+MACE_BM_ATROUS_CONV_2D(1, 256, 33, 33, 18, 256);
+// DeepLab v2 ASPP at output stride 8 on 321x321
+MACE_BM_ATROUS_CONV_2D(1, 512, 41, 41, 12, 256);
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -12,9 +12,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdlib.h>
+#include <cstring>
 #include <fstream>
+#include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "mace/core/runtime/cpu/cpu_tuner.h"
+#include "mace/kernels/arm/conv_im2col.h"
+#include "mace/kernels/eltwise.h"
 #include "mace/ops/conv_2d.h"
 #include "mace/ops/ops_test_util.h"
 
@@ -1069,6 +1077,399 @@ TEST_F(Conv2dOpTest, OPENCLUnalignedPad4) {
   TestArbitraryPadConvNxN<DeviceType::GPU, float>({107, 113, 5, 7}, {4, 4});
 }
 
+namespace {
+void TestIm2ColConv(const std::vector<index_t> &input_shape,
+                    const std::vector<index_t> &filter_shape,
+                    const int stride,
+                    const int dilation) {
+  // Construct graph
+  OpsTestNet net;
+
+  // Add input data
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {filter_shape[0]});
+
+  OpDefBuilder("Conv2D", "Conv2DTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", Padding::VALID)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .Finalize(net.NewOperatorDef());
+  // Run
+  net.RunOp(DeviceType::CPU);
+
+  // Check
+  const index_t out_height =
+      (input_shape[2] - (filter_shape[2] - 1) * dilation - 1) / stride + 1;
+  const index_t out_width =
+      (input_shape[3] - (filter_shape[3] - 1) * dilation - 1) / stride + 1;
+  const std::vector<index_t> output_shape =
+      {input_shape[0], filter_shape[0], out_height, out_width};
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+  const int pad_hw[2] = {0, 0};
+  Tensor expected;
+  expected.Resize(output_shape);
+  float *expected_data = expected.mutable_data<float>();
+  kernels::ConvRef(net.GetTensor("Input")->data<float>(),
+                   net.GetTensor("Filter")->data<float>(),
+                   input_shape.data(), output_shape.data(),
+                   filter_shape.data(), strides, dilations, pad_hw,
+                   expected_data);
+  const float *bias_data = net.GetTensor("Bias")->data<float>();
+  const index_t image_size = out_height * out_width;
+  for (index_t i = 0; i < expected.size(); ++i) {
+    expected_data[i] += bias_data[(i / image_size) % filter_shape[0]];
+  }
+
+  ExpectTensorNear<float>(expected, *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUIm2ColConv) {
+  TestIm2ColConv({2, 16, 19, 21}, {32, 16, 1, 1}, 2, 1);
+  TestIm2ColConv({1, 8, 23, 17}, {16, 8, 5, 5}, 2, 1);
+  TestIm2ColConv({1, 8, 23, 17}, {12, 8, 3, 3}, 1, 2);
+}
+
+TEST_F(Conv2dOpTest, CPUBatchedConv1x1) {
+  TestIm2ColConv({3, 16, 9, 11}, {24, 16, 1, 1}, 1, 1);
+  TestIm2ColConv({3, 4, 37, 41}, {6, 4, 1, 1}, 2, 1);
+  TestIm2ColConv({2, 70, 31, 70}, {66, 70, 1, 1}, 3, 1);
+}
+
+namespace {
+typedef std::map<std::string, std::vector<unsigned char>> MemoryFile;
+
+// Keeps the tuned parameters in memory instead of files.
+class MemoryStorage : public KVStorage {
+ public:
+  explicit MemoryStorage(MemoryFile *data) : data_(data) {}
+
+  int Load() override { return 0; }
+
+  bool Insert(const std::string &key,
+              const std::vector<unsigned char> &value) override {
+    (*data_)[key] = value;
+    return true;
+  }
+
+  const std::vector<unsigned char> *Find(const std::string &key) override {
+    auto it = data_->find(key);
+    return it == data_->end() ? nullptr : &it->second;
+  }
+
+  int Flush() override { return 0; }
+
+ private:
+  MemoryFile *data_;
+};
+
+class MemoryStorageFactory : public KVStorageFactory {
+ public:
+  std::unique_ptr<KVStorage> CreateStorage(const std::string &name) override {
+    return std::unique_ptr<KVStorage>(new MemoryStorage(&files_[name]));
+  }
+
+  std::map<std::string, MemoryFile> files_;
+};
+
+// Returns the algorithm the convolution ran, after checking its output.
+std::string TestTunedConv(const std::vector<index_t> &input_shape,
+                          const std::vector<index_t> &filter_shape) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape);
+  OpDefBuilder("Conv2D", "Conv2DTest")
+      .Input("Input")
+      .Input("Filter")
+      .Output("Output")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::VALID)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net.NewOperatorDef());
+  net.Setup(DeviceType::CPU);
+  RunMetadata run_metadata;
+  EXPECT_EQ(MaceStatus::MACE_SUCCESS, net.net_->Run(&run_metadata));
+
+  const std::vector<index_t> output_shape =
+      {input_shape[0], filter_shape[0], input_shape[2] - filter_shape[2] + 1,
+       input_shape[3] - filter_shape[3] + 1};
+  const int strides[2] = {1, 1};
+  const int dilations[2] = {1, 1};
+  const int pad_hw[2] = {0, 0};
+  Tensor expected;
+  expected.Resize(output_shape);
+  kernels::ConvRef(net.GetTensor("Input")->data<float>(),
+                   net.GetTensor("Filter")->data<float>(),
+                   input_shape.data(), output_shape.data(),
+                   filter_shape.data(), strides, dilations, pad_hw,
+                   expected.mutable_data<float>());
+  ExpectTensorNear<float>(expected, *net.GetOutput("Output"), 1e-3, 1e-3);
+  EXPECT_EQ(1u, run_metadata.op_stats.size());
+  return run_metadata.op_stats.empty() ? ""
+                                       : run_metadata.op_stats[0].algorithm;
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUTunedAlgorithm) {
+  std::shared_ptr<MemoryStorageFactory> storage_factory(
+      new MemoryStorageFactory);
+  SetKVStorageFactory(storage_factory);
+  CPUTuner::Get()->Reload();
+  for (const std::vector<index_t> &filter_shape :
+       {std::vector<index_t>{16, 16, 3, 3},
+        std::vector<index_t>{24, 16, 1, 1}}) {
+    const std::vector<index_t> input_shape = {1, 16, 20, 21};
+    setenv("MACE_TUNING", "1", 1);
+    const std::string tuned = TestTunedConv(input_shape, filter_shape);
+    unsetenv("MACE_TUNING");
+    EXPECT_FALSE(tuned.empty());
+    // replayed from the storage
+    CPUTuner::Get()->Reload();
+    EXPECT_EQ(tuned, TestTunedConv(input_shape, filter_shape));
+  }
+  EXPECT_EQ(1u, storage_factory->files_.size());
+  SetKVStorageFactory(nullptr);
+  CPUTuner::Get()->Reload();
+}
+
+namespace {
+// SAME padding, the expected output convolves each group as its own tensor.
+void TestGroupedConv(const std::vector<index_t> &input_shape,
+                     const std::vector<index_t> &filter_shape,
+                     const int group,
+                     const int stride,
+                     const int dilation) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {filter_shape[0]});
+  const index_t out_height = (input_shape[2] + stride - 1) / stride;
+  const index_t out_width = (input_shape[3] + stride - 1) / stride;
+  const std::vector<index_t> output_shape =
+      {input_shape[0], filter_shape[0], out_height, out_width};
+  net.AddRandomInput<DeviceType::CPU, float>("Residual", output_shape);
+
+  OpDefBuilder("Conv2D", "Conv2DTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Input("Residual")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddIntArg("group", group)
+      .AddStringArg("activation", "RELU")
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  const index_t group_in_shape[4] = {1, filter_shape[1], input_shape[2],
+                                     input_shape[3]};
+  const index_t group_out_shape[4] = {1, filter_shape[0] / group, out_height,
+                                      out_width};
+  const index_t group_filter_shape[4] = {group_out_shape[1], filter_shape[1],
+                                         filter_shape[2], filter_shape[3]};
+  const index_t in_size = filter_shape[1] * input_shape[2] * input_shape[3];
+  const index_t out_size = group_out_shape[1] * out_height * out_width;
+  const index_t filter_size = group_filter_shape[0] * filter_shape[1]
+      * filter_shape[2] * filter_shape[3];
+  const int strides[2] = {stride, stride};
+  const int dilations[2] = {dilation, dilation};
+  const int pad_hw[2] = {
+      static_cast<int>(((out_height - 1) * stride
+          + (filter_shape[2] - 1) * dilation + 1 - input_shape[2]) / 2),
+      static_cast<int>(((out_width - 1) * stride
+          + (filter_shape[3] - 1) * dilation + 1 - input_shape[3]) / 2)};
+  Tensor expected;
+  expected.Resize(output_shape);
+  float *expected_data = expected.mutable_data<float>();
+  const float *input_data = net.GetTensor("Input")->data<float>();
+  const float *filter_data = net.GetTensor("Filter")->data<float>();
+  for (index_t b = 0; b < input_shape[0]; ++b) {
+    for (int g = 0; g < group; ++g) {
+      kernels::ConvRef(input_data + (b * group + g) * in_size,
+                       filter_data + g * filter_size,
+                       group_in_shape, group_out_shape, group_filter_shape,
+                       strides, dilations, pad_hw,
+                       expected_data + (b * group + g) * out_size);
+    }
+  }
+  const float *bias_data = net.GetTensor("Bias")->data<float>();
+  const float *residual_data = net.GetTensor("Residual")->data<float>();
+  const index_t image_size = out_height * out_width;
+  for (index_t i = 0; i < expected.size(); ++i) {
+    expected_data[i] = std::max(0.f, expected_data[i] + residual_data[i]
+        + bias_data[(i / image_size) % filter_shape[0]]);
+  }
+
+  ExpectTensorNear<float>(expected, *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUGrouped) {
+  // direct kernels where there are avx2 ones
+  TestGroupedConv({2, 16, 17, 19}, {32, 4, 3, 3}, 4, 1, 1);
+  TestGroupedConv({1, 12, 20, 15}, {12, 4, 3, 3}, 3, 2, 1);
+  // gemm
+  TestGroupedConv({2, 24, 11, 13}, {36, 8, 1, 1}, 3, 1, 1);
+  TestGroupedConv({1, 16, 21, 18}, {16, 2, 3, 3}, 8, 1, 2);
+  TestGroupedConv({1, 6, 9, 10}, {9, 2, 3, 5}, 3, 1, 1);
+}
+
+namespace {
+void TestNHWCConv(const std::vector<index_t> &input_shape,  // NHWC
+                  const std::vector<index_t> &filter_shape,  // OIHW
+                  const int stride,
+                  const int dilation,
+                  const Padding padding,
+                  const float error = 1e-4) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {filter_shape[0]},
+                                             false);
+  net.TransformDataFormat<DeviceType::CPU, float>("Input", NHWC, "InputNCHW",
+                                                  NCHW);
+
+  OpDefBuilder("Conv2D", "Conv2DNCHW")
+      .Input("InputNCHW")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("OutputNCHW")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("activation", "RELU")
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  net.TransformDataFormat<DeviceType::CPU, float>("OutputNCHW", NCHW,
+                                                  "Expected", NHWC);
+
+  OpDefBuilder("Conv2D", "Conv2DNHWC")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("activation", "RELU")
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), error, error);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUNHWC) {
+  TestNHWCConv({2, 13, 17, 16}, {24, 16, 1, 1}, 1, 1, VALID);
+  TestNHWCConv({1, 19, 21, 16}, {32, 16, 1, 1}, 2, 1, VALID);
+  TestNHWCConv({1, 15, 23, 3}, {16, 3, 3, 3}, 2, 1, SAME);
+  TestNHWCConv({1, 13, 17, 8}, {12, 8, 3, 3}, 1, 1, SAME);
+  TestNHWCConv({1, 19, 21, 8}, {8, 8, 5, 5}, 1, 2, SAME);
+  TestNHWCConv({1, 11, 11, 8}, {8, 8, 7, 7}, 3, 1, VALID);
+}
+
+TEST_F(Conv2dOpTest, CPUWinograd) {
+  // winograd runs the NCHW convolutions of these shapes, NHWC lowers them
+  // to gemm
+  TestNHWCConv({1, 28, 28, 64}, {64, 64, 3, 3}, 1, 1, SAME, 1e-3);
+  TestNHWCConv({2, 13, 19, 64}, {96, 64, 3, 3}, 1, 1, VALID, 1e-3);
+  TestNHWCConv({1, 14, 14, 64}, {64, 64, 5, 5}, 1, 1, SAME, 1e-3);
+  TestNHWCConv({1, 17, 17, 128}, {128, 128, 1, 7}, 1, 1, SAME, 1e-3);
+  TestNHWCConv({1, 17, 17, 128}, {128, 128, 7, 1}, 1, 1, SAME, 1e-3);
+}
+
+namespace {
+// Compare a convolution with a residual input to a convolution followed by
+// an Eltwise sum and the activation.
+void TestResidualConv(const std::vector<index_t> &input_shape,
+                      const std::vector<index_t> &filter_shape,
+                      const int stride,
+                      const int dilation,
+                      const Padding padding,
+                      const char *activation) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {filter_shape[0]});
+
+  OpDefBuilder("Conv2D", "Conv2DTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("ConvOutput")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Residual", net.GetTensor("ConvOutput")->shape());
+  OpDefBuilder("Eltwise", "EltwiseTest")
+      .Input("ConvOutput")
+      .Input("Residual")
+      .Output("SumOutput")
+      .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  OpDefBuilder("Activation", "ActivationTest")
+      .Input("SumOutput")
+      .Output("Expected")
+      .AddStringArg("activation", activation)
+      .AddFloatArg("max_limit", 1.5f)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  OpDefBuilder("Conv2D", "ResidualConv2DTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Input("Residual")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("activation", activation)
+      .AddFloatArg("max_limit", 1.5f)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  // the activation op does not write its output for NOOP
+  const char *expected =
+      std::strcmp(activation, "NOOP") == 0 ? "SumOutput" : "Expected";
+  ExpectTensorNear<float>(*net.GetOutput(expected),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUResidual) {
+  for (const char *activation : {"NOOP", "RELUX", "TANH"}) {
+    // direct kernels, with and without a padded output
+    TestResidualConv({1, 8, 20, 24}, {6, 8, 3, 3}, 1, 1, SAME, activation);
+    TestResidualConv({2, 5, 19, 21}, {7, 5, 3, 3}, 2, 1, SAME, activation);
+    TestResidualConv({1, 6, 23, 17}, {5, 6, 3, 3}, 1, 2, VALID, activation);
+    // 1x1 and gemm
+    TestResidualConv({2, 16, 14, 16}, {24, 16, 1, 1}, 1, 1, VALID,
+                     activation);
+    TestResidualConv({1, 16, 19, 21}, {32, 16, 1, 1}, 2, 1, VALID,
+                     activation);
+    // winograd
+    TestResidualConv({1, 32, 24, 24}, {32, 32, 3, 3}, 1, 1, SAME,
+                     activation);
+    TestResidualConv({1, 32, 29, 31}, {32, 32, 3, 3}, 1, 1, SAME,
+                     activation);
+  }
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
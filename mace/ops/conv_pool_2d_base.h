@@ -32,13 +32,17 @@ class ConvPool2dOpBase : public Operator<D, T> {
         padding_type_(static_cast<Padding>(OperatorBase::GetOptionalArg<int>(
             "padding", static_cast<int>(SAME)))),
         paddings_(OperatorBase::GetRepeatedArgs<int>("padding_values")),
-        dilations_(OperatorBase::GetRepeatedArgs<int>("dilations", {1, 1})) {}
+        dilations_(OperatorBase::GetRepeatedArgs<int>("dilations", {1, 1})),
+        data_format_(static_cast<DataFormat>(OperatorBase::GetOptionalArg<int>(
+            "data_format", static_cast<int>(NCHW)))) {}
 
  protected:
   std::vector<int> strides_;
   Padding padding_type_;
   std::vector<int> paddings_;
   std::vector<int> dilations_;
+  // layout of cpu tensors, gpu images are always NHWC
+  DataFormat data_format_;
 };
 
 }  // namespace ops
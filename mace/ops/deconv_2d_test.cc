@@ -402,6 +402,104 @@ void TestComplexDeconvNxNS12(const int batch,
 }
 }  // namespace
 
+namespace {
+// Compare the CPU op with the reference loop, with bias and activation.
+void TestCPUDeconv(const index_t batch,
+                   const std::vector<index_t> &shape,  // H, W, IC, OC
+                   const int kernel,
+                   const int stride,
+                   const Padding type,
+                   const int padding) {
+  OpsTestNet net;
+  const index_t height = shape[0];
+  const index_t width = shape[1];
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Input", {batch, shape[2], height, width});
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Filter", {shape[3], shape[2], kernel, kernel});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {shape[3]});
+
+  std::vector<int> paddings;
+  std::vector<int> output_shape;
+  if (padding < 0) {
+    index_t out_h, out_w;
+    if (type == Padding::SAME) {
+      out_h = height * stride;
+      out_w = width * stride;
+    } else {
+      out_h = (height - 1) * stride + kernel;
+      out_w = (width - 1) * stride + kernel;
+    }
+    output_shape = {static_cast<int>(batch), static_cast<int>(out_h),
+                    static_cast<int>(out_w), static_cast<int>(shape[3])};
+  } else {
+    paddings = {padding, padding};
+  }
+  OpDefBuilder("Deconv2D", "Deconv2dTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", type)
+      .AddIntsArg("padding_values", paddings)
+      .AddIntsArg("output_shape", output_shape)
+      .AddStringArg("activation", "RELUX")
+      .AddFloatArg("max_limit", 1.5f)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  Tensor *input = net.GetTensor("Input");
+  Tensor *filter = net.GetTensor("Filter");
+  Tensor *output = net.GetOutput("Output");
+  const int strides[2] = {stride, stride};
+  if (padding < 0) {
+    paddings.resize(2);
+    kernels::Deconv2dFunctorBase::CalcDeconvPaddingAndInputSize(
+        input->shape().data(), filter->shape().data(), strides, type,
+        output->shape().data(), paddings.data(), true);
+  }
+  const int pad_hw[2] = {(paddings[0] + 1) >> 1, (paddings[1] + 1) >> 1};
+  const index_t kernel_hw[2] = {kernel, kernel};
+  Tensor expected;
+  expected.Resize(output->shape());
+  float *expected_data = expected.mutable_data<float>();
+  kernels::deconv::Deconv2dNCHW(input->data<float>(), filter->data<float>(),
+                                net.GetTensor("Bias")->data<float>(),
+                                input->shape().data(),
+                                output->shape().data(), kernel_hw, strides,
+                                pad_hw, expected_data);
+  kernels::DoActivation(expected_data, expected_data, expected.size(),
+                        kernels::RELUX, 1.5f);
+
+  ExpectTensorNear<float>(expected, *output, 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Deconv2dOpTest, CPUComplexDeconvNxNS12) {
+  for (int stride : {1, 2}) {
+    for (int kernel : {1, 3, 4, 5}) {
+      TestCPUDeconv(1, {16, 16, 32, 32}, kernel, stride, VALID, -1);
+      TestCPUDeconv(1, {16, 16, 32, 32}, kernel, stride, SAME, -1);
+      TestCPUDeconv(1, {17, 23, 5, 7}, kernel, stride, VALID, 1);
+      TestCPUDeconv(2, {17, 23, 5, 7}, kernel, stride, VALID, 2);
+    }
+  }
+}
+
+TEST_F(Deconv2dOpTest, CPUComplexDeconvNxNS34) {
+  TestCPUDeconv(1, {9, 13, 8, 6}, 3, 3, SAME, -1);
+  TestCPUDeconv(1, {9, 13, 8, 6}, 7, 3, VALID, -1);
+  TestCPUDeconv(1, {16, 16, 16, 9}, 8, 4, SAME, -1);
+  TestCPUDeconv(2, {5, 3, 3, 5}, 8, 4, VALID, 2);
+}
+
+TEST_F(Deconv2dOpTest, CPUTiledDeconv) {
+  // several row tiles per image and a partial channel block
+  TestCPUDeconv(1, {64, 64, 16, 10}, 4, 2, SAME, -1);
+  TestCPUDeconv(1, {2, 3, 4, 3}, 3, 1, SAME, -1);
+}
+
 TEST_F(Deconv2dOpTest, OPENCLAlignedDeconvNxNS12) {
   TestComplexDeconvNxNS12<DeviceType::GPU, float>(1, {32, 16, 16, 32}, 1);
   TestComplexDeconvNxNS12<DeviceType::GPU, float>(1, {32, 16, 16, 32}, 2);
@@ -157,6 +157,19 @@ MACE_BM_DEPTHWISE_CONV_2D(1, 3, 112, 112, 3, 3, 2, VALID, 1);
 MACE_BM_DEPTHWISE_CONV_2D(1, 3, 224, 224, 3, 3, 2, SAME, 1);
 MACE_BM_DEPTHWISE_CONV_2D(1, 8, 224, 224, 3, 3, 2, SAME, 1);
 
+// MobileNet-v2
+MACE_BM_DEPTHWISE_CONV_2D(1, 96, 112, 112, 3, 3, 2, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 144, 56, 56, 3, 3, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 192, 28, 28, 3, 3, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 384, 14, 14, 3, 3, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 960, 7, 7, 3, 3, 1, SAME, 1);
+// EfficientNet
+MACE_BM_DEPTHWISE_CONV_2D(1, 144, 56, 56, 5, 5, 2, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 240, 28, 28, 5, 5, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 672, 14, 14, 5, 5, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 1152, 7, 7, 5, 5, 1, SAME, 1);
+MACE_BM_DEPTHWISE_CONV_2D(1, 96, 56, 56, 7, 7, 1, SAME, 1);
+
 
 }  // namespace test
 }  // namespace ops
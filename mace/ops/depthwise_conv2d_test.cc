@@ -112,7 +112,8 @@ void ComplexValidTest(index_t batch,
                       index_t width,
                       index_t kernel,
                       index_t multiplier,
-                      int stride) {
+                      int stride,
+                      int dilation = 1) {
   testing::internal::LogToStderr();
   // Construct graph
   OpsTestNet net;
@@ -141,7 +142,7 @@ void ComplexValidTest(index_t batch,
         .Output("OutputNCHW")
         .AddIntsArg("strides", {stride, stride})
         .AddIntArg("padding", Padding::SAME)
-        .AddIntsArg("dilations", {1, 1})
+        .AddIntsArg("dilations", {dilation, dilation})
         .AddIntArg("T", static_cast<int>(DataTypeToEnum<T>::value))
         .Finalize(net.NewOperatorDef());
     // Run
@@ -162,7 +163,7 @@ void ComplexValidTest(index_t batch,
         .Output("OutputImage")
         .AddIntsArg("strides", {stride, stride})
         .AddIntArg("padding", Padding::SAME)
-        .AddIntsArg("dilations", {1, 1})
+        .AddIntsArg("dilations", {dilation, dilation})
         .AddIntArg("T", static_cast<int>(DataTypeToEnum<T>::value))
         .Finalize(net.NewOperatorDef());
 
@@ -179,8 +180,9 @@ void ComplexValidTest(index_t batch,
   // expect
   index_t out_height = (height - 1) / stride + 1;
   index_t out_width = (width - 1) / stride + 1;
-  index_t pad_top = ((out_height - 1) * stride + kernel - height) >> 1;
-  index_t pad_left = ((out_width - 1) * stride + kernel - width) >> 1;
+  index_t k_extent = (kernel - 1) * dilation + 1;
+  index_t pad_top = ((out_height - 1) * stride + k_extent - height) >> 1;
+  index_t pad_left = ((out_width - 1) * stride + k_extent - width) >> 1;
   index_t out_channels = channel * multiplier;
   std::vector<T> expect(batch * out_height * out_width * out_channels);
   for (index_t b = 0; b < batch; ++b) {
@@ -194,8 +196,8 @@ void ComplexValidTest(index_t batch,
           float sum = 0;
           for (index_t kh = 0; kh < kernel; ++kh) {
             for (index_t kw = 0; kw < kernel; ++kw) {
-              index_t ih = h * stride - pad_top + kh;
-              index_t iw = w * stride - pad_left + kw;
+              index_t ih = h * stride - pad_top + kh * dilation;
+              index_t iw = w * stride - pad_left + kw * dilation;
               if (ih >= 0 && ih < height && iw >= 0 && iw < width) {
                 index_t in_offset =
                     ((b * height + ih) * width + iw) * channel + c;
@@ -212,7 +214,7 @@ void ComplexValidTest(index_t batch,
   }
 
   auto expected =
-      CreateTensor<T>({1, out_height, out_width, out_channels}, expect);
+      CreateTensor<T>({batch, out_height, out_width, out_channels}, expect);
 
   if (DataTypeToEnum<T>::value == DT_FLOAT) {
     ExpectTensorNear<T>(*expected, *net.GetOutput("Output"), 1e-5);
@@ -234,6 +236,27 @@ TEST_F(DepthwiseConv2dOpTest, ComplexCPU3x3s2) {
   ComplexValidTest<DeviceType::CPU, float>(1, 3, 10, 10, 3, 1, 2);
 }
 
+TEST_F(DepthwiseConv2dOpTest, ComplexCPUSimd) {
+  ComplexValidTest<DeviceType::CPU, float>(1, 3, 21, 45, 3, 1, 1);
+  ComplexValidTest<DeviceType::CPU, float>(2, 4, 19, 67, 3, 2, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 5, 14, 14, 5, 1, 1);
+  ComplexValidTest<DeviceType::CPU, float>(1, 3, 29, 37, 5, 1, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 3, 17, 26, 7, 1, 1);
+  ComplexValidTest<DeviceType::CPU, float>(1, 2, 23, 41, 7, 1, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 3, 7, 7, 3, 1, 1);
+  // planes too large to pad, split into interior and border
+  ComplexValidTest<DeviceType::CPU, float>(1, 2, 67, 71, 3, 1, 1);
+  ComplexValidTest<DeviceType::CPU, float>(1, 2, 131, 77, 5, 1, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 1, 70, 90, 7, 1, 1);
+}
+
+TEST_F(DepthwiseConv2dOpTest, ComplexCPUDilation) {
+  ComplexValidTest<DeviceType::CPU, float>(1, 3, 21, 40, 3, 1, 1, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 2, 25, 33, 5, 2, 1, 3);
+  ComplexValidTest<DeviceType::CPU, float>(1, 2, 16, 30, 7, 1, 1, 2);
+  ComplexValidTest<DeviceType::CPU, float>(1, 1, 70, 66, 3, 1, 1, 2);
+}
+
 TEST_F(DepthwiseConv2dOpTest, ComplexOpenCL) {
   ComplexValidTest<DeviceType::GPU, float>(1, 3, 10, 10, 5, 1, 2);
 }
@@ -351,6 +374,58 @@ TEST_F(DepthwiseConv2dOpTest, OpenCLUnalignedNxNS12Half) {
   TestNxNS12<half>(107, 113);
 }
 
+namespace {
+void TestNHWC(const std::vector<index_t> &input_shape,  // NHWC
+              const index_t multiplier,
+              const int kernel,
+              const int stride,
+              const Padding padding) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Filter", {multiplier, input_shape[3], kernel, kernel}, false);
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Bias", {multiplier * input_shape[3]}, false);
+  net.TransformDataFormat<DeviceType::CPU, float>("Input", NHWC, "InputNCHW",
+                                                  NCHW);
+
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2DNCHW")
+      .Input("InputNCHW")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("OutputNCHW")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  net.TransformDataFormat<DeviceType::CPU, float>("OutputNCHW", NCHW,
+                                                  "Expected", NHWC);
+
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2DNHWC")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(DepthwiseConv2dOpTest, CPUNHWC) {
+  TestNHWC({1, 13, 17, 16}, 1, 3, 1, SAME);
+  TestNHWC({2, 14, 9, 13}, 1, 3, 2, SAME);
+  TestNHWC({1, 10, 12, 24}, 1, 5, 1, VALID);
+  TestNHWC({1, 9, 11, 5}, 2, 3, 1, SAME);
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -26,6 +26,7 @@ class MatMulOp : public Operator<D, T> {
  public:
   MatMulOp(const OperatorDef &operator_def, Workspace *ws)
       : Operator<D, T>(operator_def, ws),
+        functor_(ws->GetThreadScratchBuffer(D)),
         transpose_a_(OperatorBase::GetOptionalArg<bool>("transpose_a", false)),
         transpose_b_(OperatorBase::GetOptionalArg<bool>("transpose_b", false)) {
   }
@@ -462,6 +462,54 @@ TEST_F(PoolingOpTest, OPENCLUnAlignedLargeKernelAvgPooling) {
   AvgPoolingTest<GPU, float>({3, 31, 37, 128}, {8, 8}, {8, 8}, Padding::SAME);
 }
 
+namespace {
+void TestNHWC(const std::vector<index_t> &input_shape,  // NHWC
+              const PoolingType pooling_type,
+              const int kernel,
+              const int stride,
+              const Padding padding) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  net.TransformDataFormat<DeviceType::CPU, float>("Input", NHWC, "InputNCHW",
+                                                  NCHW);
+
+  OpDefBuilder("Pooling", "PoolingNCHW")
+      .Input("InputNCHW")
+      .Output("OutputNCHW")
+      .AddIntArg("pooling_type", pooling_type)
+      .AddIntsArg("kernels", {kernel, kernel})
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  net.TransformDataFormat<DeviceType::CPU, float>("OutputNCHW", NCHW,
+                                                  "Expected", NHWC);
+
+  OpDefBuilder("Pooling", "PoolingNHWC")
+      .Input("Input")
+      .Output("Output")
+      .AddIntArg("pooling_type", pooling_type)
+      .AddIntsArg("kernels", {kernel, kernel})
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-5, 1e-5);
+}
+}  // namespace
+
+TEST_F(PoolingOpTest, CPUNHWC) {
+  TestNHWC({1, 13, 17, 16}, PoolingType::MAX, 3, 2, SAME);
+  TestNHWC({2, 12, 12, 5}, PoolingType::MAX, 2, 2, VALID);
+  TestNHWC({1, 13, 17, 16}, PoolingType::AVG, 3, 1, SAME);
+  TestNHWC({1, 9, 11, 7}, PoolingType::AVG, 3, 2, VALID);
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -0,0 +1,278 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mace/core/operator.h"
+#include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/tiled_chain.h"
+
+// Windows of the inputs read by each output index of CPU ops, which must be
+// kept consistent with the padding the ops apply. Ops reading whole axes of
+// their inputs, e.g. fully connected, are not registered.
+
+namespace mace {
+namespace ops {
+
+namespace {
+typedef std::vector<std::vector<index_t>> Shapes;
+typedef std::vector<AxisWindow> Windows;
+
+template <typename T>
+T GetArg(const OperatorDef &op_def, const std::string &name,
+         const T &default_value) {
+  return ProtoArgHelper::GetOptionalArg<OperatorDef, T>(
+      op_def, name, default_value);
+}
+
+template <typename T>
+std::vector<T> GetArgs(const OperatorDef &op_def, const std::string &name,
+                       const std::vector<T> &default_value = {}) {
+  return ProtoArgHelper::GetRepeatedArgs<OperatorDef, T>(
+      op_def, name, default_value);
+}
+
+Windows PointwiseWindows(size_t rank) {
+  Windows windows;
+  for (size_t i = 0; i < rank; ++i) {
+    windows.push_back({static_cast<int>(i), 1, 0, 0});
+  }
+  return windows;
+}
+
+MaceStatus PointwiseReceptiveField(const OperatorDef &op_def,
+                                   const Shapes &input_shapes,
+                                   Windows *windows) {
+  MACE_UNUSED(op_def);
+  MACE_CHECK(!input_shapes.empty());
+  size_t rank = 0;
+  for (const std::vector<index_t> &input_shape : input_shapes) {
+    rank = std::max(rank, input_shape.size());
+  }
+  *windows = PointwiseWindows(rank);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+// Pointwise along all axes but channels.
+MaceStatus ChannelReceptiveField(const OperatorDef &op_def,
+                                 const Shapes &input_shapes,
+                                 Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  const size_t rank = input_shapes[0].size();
+  *windows = PointwiseWindows(rank);
+  if (rank == 4 && GetArg<int>(op_def, "data_format", NCHW) != NHWC) {
+    (*windows)[1].axis = -1;
+  } else if (rank > 0) {
+    windows->back().axis = -1;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+// Shared by convolution and pooling, filter_shape is OIHW.
+MaceStatus ConvPoolReceptiveField(const OperatorDef &op_def,
+                                  const std::vector<index_t> &input_shape,
+                                  const std::vector<index_t> &filter_shape,
+                                  Windows *windows) {
+  const std::vector<int> strides = GetArgs<int>(op_def, "strides");
+  const std::vector<int> dilations =
+      GetArgs<int>(op_def, "dilations", {1, 1});
+  std::vector<int> paddings = GetArgs<int>(op_def, "padding_values");
+  const Padding padding_type = static_cast<Padding>(
+      GetArg<int>(op_def, "padding", static_cast<int>(SAME)));
+  if (input_shape.size() != 4 || strides.size() != 2
+      || dilations.size() != 2) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+
+  const bool nhwc = GetArg<int>(op_def, "data_format", NCHW) == NHWC;
+  if (paddings.empty()) {
+    std::vector<index_t> output_shape(4);
+    paddings.resize(2);
+    if (nhwc) {
+      kernels::CalcNHWCPaddingAndOutputSize(input_shape.data(),
+                                            filter_shape.data(),
+                                            dilations.data(),
+                                            strides.data(),
+                                            padding_type,
+                                            output_shape.data(),
+                                            paddings.data());
+    } else {
+      kernels::CalcNCHWPaddingAndOutputSize(input_shape.data(),
+                                            filter_shape.data(),
+                                            dilations.data(),
+                                            strides.data(),
+                                            padding_type,
+                                            output_shape.data(),
+                                            paddings.data());
+    }
+  }
+  if (paddings.size() != 2) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+
+  const int height_axis = nhwc ? 1 : 2;
+  *windows = PointwiseWindows(4);
+  (*windows)[nhwc ? 3 : 1].axis = -1;
+  for (int i = 0; i < 2; ++i) {
+    // the ops pad half of the total padding before the input
+    const index_t pad = paddings[i] / 2;
+    AxisWindow *window = &(*windows)[height_axis + i];
+    window->stride = strides[i];
+    window->begin = -pad;
+    window->end = (filter_shape[2 + i] - 1) * dilations[i] - pad;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus Conv2DReceptiveField(const OperatorDef &op_def,
+                                const Shapes &input_shapes,
+                                Windows *windows) {
+  MACE_CHECK(input_shapes.size() >= 2);
+  const std::vector<index_t> &filter = input_shapes[1];
+  if (filter.size() != 4
+      || GetArg<int>(op_def, "is_filter_transformed", 0)) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  return ConvPoolReceptiveField(op_def, input_shapes[0], filter, windows);
+}
+
+MaceStatus PoolingReceptiveField(const OperatorDef &op_def,
+                                 const Shapes &input_shapes,
+                                 Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> kernels = GetArgs<int>(op_def, "kernels");
+  if (kernels.size() != 2 || input_shapes[0].size() != 4) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  const index_t channels =
+      GetArg<int>(op_def, "data_format", NCHW) == NHWC ? input_shapes[0][3]
+                                                        : input_shapes[0][1];
+  return ConvPoolReceptiveField(op_def, input_shapes[0],
+                                {channels, channels, kernels[0], kernels[1]},
+                                windows);
+}
+
+MaceStatus ConcatReceptiveField(const OperatorDef &op_def,
+                                const Shapes &input_shapes,
+                                Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  const int32_t input_dims = static_cast<int32_t>(input_shapes[0].size());
+  int32_t axis = GetArg<int>(op_def, "axis", 3);
+  axis = axis < 0 ? axis + input_dims : axis;
+  if (axis < 0 || axis >= input_dims) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  *windows = PointwiseWindows(input_dims);
+  (*windows)[axis].axis = -1;
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus PadReceptiveField(const OperatorDef &op_def,
+                             const Shapes &input_shapes,
+                             Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> paddings = GetArgs<int>(op_def, "paddings");
+  if (input_shapes[0].size() != 4 || paddings.size() != 8) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  *windows = PointwiseWindows(4);
+  for (size_t i = 0; i < 4; ++i) {
+    (*windows)[i].begin = -paddings[2 * i];
+    (*windows)[i].end = -paddings[2 * i];
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus TiledChainReceptiveField(const OperatorDef &op_def,
+                                    const Shapes &input_shapes,
+                                    Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  if (input_shapes[0].size() != 4) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  Shapes filter_shapes;
+  for (size_t i = 1; i < input_shapes.size(); i += 2) {
+    filter_shapes.push_back(input_shapes[i]);
+  }
+  std::vector<kernels::TiledChainLayer> layers;
+  MACE_RETURN_IF_ERROR(kernels::TiledChainLayers(
+      GetArgs<int>(op_def, "layer_types"), GetArgs<int>(op_def, "kernels"),
+      GetArgs<int>(op_def, "strides"), GetArgs<int>(op_def, "dilations"),
+      GetArgs<int>(op_def, "padding_values"),
+      GetArgs<int>(op_def, "activations"),
+      GetArgs<float>(op_def, "max_limits"), filter_shapes, &layers));
+  *windows = PointwiseWindows(4);
+  (*windows)[1].axis = -1;
+  for (const kernels::TiledChainLayer &layer : layers) {
+    for (int i = 0; i < 2; ++i) {
+      // a layer reads windows of the windows the layers before it read
+      const index_t pad = layer.padding_hw[i] / 2;
+      AxisWindow *window = &(*windows)[2 + i];
+      window->begin = -pad * window->stride + window->begin;
+      window->end =
+          ((layer.kernel_hw[i] - 1) * layer.dilation_hw[i] - pad)
+              * window->stride + window->end;
+      window->stride *= layer.stride_hw[i];
+    }
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus TransposeReceptiveField(const OperatorDef &op_def,
+                                   const Shapes &input_shapes,
+                                   Windows *windows) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> dims = GetArgs<int>(op_def, "dims");
+  if (dims.size() != input_shapes[0].size()) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  windows->clear();
+  for (int dim : dims) {
+    windows->push_back({dim, 1, 0, 0});
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+}  // namespace
+
+void Register_ReceptiveField(OperatorRegistry *op_registry) {
+  // Keep in lexicographical order
+  op_registry->RegisterReceptiveField("Activation", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("AddN", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("BatchNorm", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("BiasAdd", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("ChannelShuffle",
+                                      ChannelReceptiveField);
+  op_registry->RegisterReceptiveField("Concat", ConcatReceptiveField);
+  op_registry->RegisterReceptiveField("Conv2D", Conv2DReceptiveField);
+  op_registry->RegisterReceptiveField("DepthwiseConv2d",
+                                      Conv2DReceptiveField);
+  op_registry->RegisterReceptiveField("Eltwise", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("FoldedBatchNorm",
+                                      PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("Identity", PointwiseReceptiveField);
+  op_registry->RegisterReceptiveField("LocalResponseNorm",
+                                      ChannelReceptiveField);
+  op_registry->RegisterReceptiveField("Pad", PadReceptiveField);
+  op_registry->RegisterReceptiveField("Pooling", PoolingReceptiveField);
+  op_registry->RegisterReceptiveField("SeparableConv2d",
+                                      Conv2DReceptiveField);
+  op_registry->RegisterReceptiveField("Softmax", ChannelReceptiveField);
+  op_registry->RegisterReceptiveField("TiledChain", TiledChainReceptiveField);
+  op_registry->RegisterReceptiveField("Transpose", TransposeReceptiveField);
+}
+
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,148 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+
+#include "mace/core/operator.h"
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/pooling.h"
+#include "mace/ops/ops_test_util.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+// conv3x3 + relu => depthwise3x3 => conv1x1 => max pool, end to end in NCHW,
+// in NHWC, or in NCHWc with a reorder at each end.
+void LayoutChainBenchmark(int iters,
+                          const index_t batch,
+                          const index_t channels,
+                          const index_t height,
+                          const index_t width,
+                          const DataFormat data_format) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+  const bool nhwc = data_format == NHWC;
+  if (nhwc) {
+    net.AddRandomInput<DeviceType::CPU, float>(
+        "Input", {batch, height, width, channels});
+  } else {
+    net.AddRandomInput<DeviceType::CPU, float>(
+        "Input", {batch, channels, height, width});
+  }
+  net.AddRandomInput<DeviceType::CPU, float>("Filter",
+                                             {channels, channels, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {channels});
+  net.AddRandomInput<DeviceType::CPU, float>("DWFilter",
+                                             {1, channels, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("PWFilter",
+                                             {2 * channels, channels, 1, 1});
+
+  const bool blocked = data_format == NCHWc;
+  std::string input = "Input";
+  if (blocked) {
+    OpDefBuilder("Reorder", "ToNCHWc")
+        .Input("Input")
+        .Output("InputNCHWc")
+        .AddIntArg("data_format", NCHWc)
+        .Finalize(net.AddNewOperatorDef());
+    input = "InputNCHWc";
+  }
+  OpDefBuilder("Conv2D", "Conv3x3")
+      .Input(input)
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Conv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .AddStringArg("activation", "RELU")
+      .AddIntArg("data_format", nhwc ? NHWC : NCHW)
+      .Finalize(net.AddNewOperatorDef());
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv3x3")
+      .Input("Conv")
+      .Input("DWFilter")
+      .Output("DWConv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", nhwc ? NHWC : NCHW)
+      .Finalize(net.AddNewOperatorDef());
+  OpDefBuilder("Conv2D", "Conv1x1")
+      .Input("DWConv")
+      .Input("PWFilter")
+      .Output("PWConv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::VALID)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", nhwc ? NHWC : NCHW)
+      .Finalize(net.AddNewOperatorDef());
+  OpDefBuilder("Pooling", "MaxPool")
+      .Input("PWConv")
+      .Output(blocked ? "PoolNCHWc" : "Output")
+      .AddIntArg("pooling_type", PoolingType::MAX)
+      .AddIntsArg("kernels", {2, 2})
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::VALID)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", nhwc ? NHWC : NCHW)
+      .Finalize(net.AddNewOperatorDef());
+  if (blocked) {
+    OpDefBuilder("Reorder", "ToNCHW")
+        .Input("PoolNCHWc")
+        .Output("Output")
+        .AddIntArg("data_format", NCHW)
+        .Finalize(net.AddNewOperatorDef());
+  }
+
+  net.Setup(DeviceType::CPU);
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+  }
+}
+}  // namespace
+
+#define MACE_BM_LAYOUT_CHAIN(N, C, H, W, LAYOUT)                             \
+  static void MACE_BM_LAYOUT_CHAIN_##N##_##C##_##H##_##W##_##LAYOUT(         \
+      int iters) {                                                           \
+    const int64_t macs = static_cast<int64_t>(iters) * N * H * W * C *       \
+        (C * 9 + 9 + 2 * C);                                                 \
+    mace::testing::MaccProcessed(macs);                                      \
+    mace::testing::BytesProcessed(                                           \
+        static_cast<int64_t>(iters) * N * C * H * W * sizeof(float));        \
+    LayoutChainBenchmark(iters, N, C, H, W, LAYOUT);                         \
+  }                                                                          \
+  MACE_BENCHMARK(MACE_BM_LAYOUT_CHAIN_##N##_##C##_##H##_##W##_##LAYOUT)
+
+#define MACE_BM_LAYOUT_CHAINS(N, C, H, W)                                    \
+  MACE_BM_LAYOUT_CHAIN(N, C, H, W, NCHW);                                    \
+  MACE_BM_LAYOUT_CHAIN(N, C, H, W, NHWC);                                    \
+  MACE_BM_LAYOUT_CHAIN(N, C, H, W, NCHWc)
+
+MACE_BM_LAYOUT_CHAINS(1, 32, 56, 56);
+MACE_BM_LAYOUT_CHAINS(1, 64, 28, 28);
+MACE_BM_LAYOUT_CHAINS(1, 128, 14, 14);
+MACE_BM_LAYOUT_CHAINS(1, 24, 37, 53);
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,214 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mace/core/operator.h"
+#include "mace/kernels/eltwise.h"
+#include "mace/kernels/pooling.h"
+#include "mace/ops/ops_test_util.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class ReorderOpTest : public OpsTestBase {};
+
+namespace {
+typedef std::function<void(OpDefBuilder *, DataFormat)> ArgSetter;
+
+// Runs the op on NCHW tensors and again on their NCHWc reorders, the results
+// must match. activations are reordered, params (filters, bias) are not.
+void TestNCHWc(OpsTestNet *net,
+               const std::string &type,
+               const std::vector<std::string> &activations,
+               const std::vector<std::string> &params,
+               const ArgSetter &set_args) {
+  OpDefBuilder reference(type.c_str(), type + "Reference");
+  for (const std::string &name : activations) {
+    reference.Input(name);
+  }
+  for (const std::string &name : params) {
+    reference.Input(name);
+  }
+  reference.Output("Expected");
+  set_args(&reference, NCHW);
+  reference.Finalize(net->NewOperatorDef());
+  net->RunOp();
+
+  OpDefBuilder blocked(type.c_str(), type + "NCHWc");
+  for (size_t i = 0; i < activations.size(); ++i) {
+    const std::string &name = activations[i];
+    OpDefBuilder("Reorder", name + "Reorder")
+        .Input(name)
+        .Output(name + "NCHWc")
+        .AddIntArg("data_format", NCHWc)
+        .Finalize(i == 0 ? net->NewOperatorDef() : net->AddNewOperatorDef());
+    blocked.Input(name + "NCHWc");
+  }
+  for (const std::string &name : params) {
+    blocked.Input(name);
+  }
+  blocked.Output("OutputNCHWc");
+  set_args(&blocked, NCHWc);
+  blocked.Finalize(net->AddNewOperatorDef());
+  OpDefBuilder("Reorder", "OutputReorder")
+      .Input("OutputNCHWc")
+      .Output("Output")
+      .AddIntArg("data_format", NCHW)
+      .Finalize(net->AddNewOperatorDef());
+  net->RunOp();
+
+  EXPECT_EQ(5u, net->GetOutput("OutputNCHWc")->dim_size());
+  ExpectTensorNear<float>(*net->GetOutput("Expected"),
+                          *net->GetOutput("Output"), 1e-4, 1e-4);
+}
+
+void TestConv2d(const std::vector<index_t> &input_shape,
+                const std::vector<index_t> &filter_shape,
+                const int stride,
+                const int dilation,
+                const Padding padding) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", filter_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {filter_shape[0]},
+                                             false);
+  TestNCHWc(&net, "Conv2D", {"Input"}, {"Filter", "Bias"},
+            [&](OpDefBuilder *builder, DataFormat data_format) {
+              MACE_UNUSED(data_format);
+              builder->AddIntsArg("strides", {stride, stride});
+              builder->AddIntArg("padding", padding);
+              builder->AddIntsArg("dilations", {dilation, dilation});
+              builder->AddStringArg("activation", "RELU");
+            });
+}
+
+void TestDepthwiseConv2d(const std::vector<index_t> &input_shape,
+                         const int kernel,
+                         const int stride,
+                         const Padding padding) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "Filter", {1, input_shape[1], kernel, kernel}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {input_shape[1]}, false);
+  TestNCHWc(&net, "DepthwiseConv2d", {"Input"}, {"Filter", "Bias"},
+            [&](OpDefBuilder *builder, DataFormat data_format) {
+              MACE_UNUSED(data_format);
+              builder->AddIntsArg("strides", {stride, stride});
+              builder->AddIntArg("padding", padding);
+              builder->AddIntsArg("dilations", {1, 1});
+            });
+}
+
+void TestPooling(const std::vector<index_t> &input_shape,
+                 const PoolingType pooling_type,
+                 const int kernel,
+                 const int stride,
+                 const Padding padding) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape, false);
+  TestNCHWc(&net, "Pooling", {"Input"}, {},
+            [&](OpDefBuilder *builder, DataFormat data_format) {
+              MACE_UNUSED(data_format);
+              builder->AddIntArg("pooling_type", pooling_type);
+              builder->AddIntsArg("kernels", {kernel, kernel});
+              builder->AddIntsArg("strides", {stride, stride});
+              builder->AddIntArg("padding", padding);
+              builder->AddIntsArg("dilations", {1, 1});
+            });
+}
+}  // namespace
+
+TEST_F(ReorderOpTest, RoundTrip) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {2, 16, 5, 7});
+  OpDefBuilder("Reorder", "ToNCHWc")
+      .Input("Input")
+      .Output("Blocked")
+      .AddIntArg("data_format", NCHWc)
+      .Finalize(net.NewOperatorDef());
+  OpDefBuilder("Reorder", "ToNCHW")
+      .Input("Blocked")
+      .Output("Output")
+      .AddIntArg("data_format", NCHW)
+      .Finalize(net.AddNewOperatorDef());
+  net.RunOp();
+
+  const Tensor *input = net.GetTensor("Input");
+  const Tensor *blocked = net.GetTensor("Blocked");
+  EXPECT_EQ(std::vector<index_t>({2, 2, 5, 7, 8}), blocked->shape());
+  // channel 11 of batch 1, pixel (3, 4) is lane 3 of channel block 1
+  EXPECT_EQ(input->data<float>()[((1 * 16 + 11) * 5 + 3) * 7 + 4],
+            blocked->data<float>()[(((1 * 2 + 1) * 5 + 3) * 7 + 4) * 8 + 3]);
+  ExpectTensorNear<float>(*input, *net.GetOutput("Output"), 0, 0);
+}
+
+TEST_F(ReorderOpTest, Conv2d) {
+  TestConv2d({1, 16, 13, 17}, {8, 16, 3, 3}, 1, 1, SAME);
+  TestConv2d({2, 8, 12, 9}, {16, 8, 1, 1}, 1, 1, VALID);
+  TestConv2d({1, 16, 15, 23}, {24, 16, 3, 3}, 2, 1, SAME);
+  TestConv2d({1, 8, 19, 21}, {8, 8, 5, 5}, 1, 2, SAME);
+  TestConv2d({1, 8, 11, 11}, {8, 8, 7, 7}, 3, 1, VALID);
+}
+
+TEST_F(ReorderOpTest, DepthwiseConv2d) {
+  TestDepthwiseConv2d({1, 16, 13, 17}, 3, 1, SAME);
+  TestDepthwiseConv2d({2, 8, 14, 9}, 3, 2, SAME);
+  TestDepthwiseConv2d({1, 24, 10, 12}, 5, 1, VALID);
+}
+
+TEST_F(ReorderOpTest, Pooling) {
+  TestPooling({1, 16, 13, 17}, PoolingType::MAX, 3, 2, SAME);
+  TestPooling({2, 8, 12, 12}, PoolingType::MAX, 2, 2, VALID);
+  TestPooling({1, 16, 13, 17}, PoolingType::AVG, 3, 1, SAME);
+  TestPooling({1, 8, 9, 11}, PoolingType::AVG, 3, 2, VALID);
+}
+
+TEST_F(ReorderOpTest, ElementWise) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 16, 7, 9}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Input1", {1, 16, 7, 9}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {16}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Alpha", {16}, false);
+
+  TestNCHWc(&net, "Eltwise", {"Input", "Input1"}, {},
+            [](OpDefBuilder *builder, DataFormat data_format) {
+              builder->AddIntArg("type",
+                                 static_cast<int>(kernels::EltwiseType::PROD));
+              builder->AddIntArg("data_format", data_format);
+            });
+  TestNCHWc(&net, "BiasAdd", {"Input"}, {"Bias"},
+            [](OpDefBuilder *builder, DataFormat data_format) {
+              builder->AddIntArg("data_format", data_format);
+            });
+  TestNCHWc(&net, "Activation", {"Input"}, {"Alpha"},
+            [](OpDefBuilder *builder, DataFormat data_format) {
+              MACE_UNUSED(data_format);
+              builder->AddStringArg("activation", "PRELU");
+            });
+  TestNCHWc(&net, "Activation", {"Input"}, {},
+            [](OpDefBuilder *builder, DataFormat data_format) {
+              MACE_UNUSED(data_format);
+              builder->AddStringArg("activation", "RELUX");
+              builder->AddFloatArg("max_limit", 0.5f);
+            });
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -27,7 +27,9 @@ class ResizeBilinearOp : public Operator<D, T> {
   ResizeBilinearOp(const OperatorDef &operator_def, Workspace *ws)
       : Operator<D, T>(operator_def, ws),
         functor_(OperatorBase::GetRepeatedArgs<index_t>("size", {-1, -1}),
-                 OperatorBase::GetOptionalArg<bool>("align_corners", false)) {}
+                 OperatorBase::GetOptionalArg<bool>("align_corners", false),
+                 static_cast<DataFormat>(OperatorBase::GetOptionalArg<int>(
+                     "data_format", static_cast<int>(NCHW)))) {}
 
   MaceStatus Run(StatsFuture *future) override {
     const Tensor *input = this->Input(0);
@@ -146,6 +146,37 @@ TEST_F(ResizeBilinearTest, OPENCLRandomResizeBilinear) {
   TestRandomResizeBilinear<DeviceType::GPU>();
 }
 
+TEST_F(ResizeBilinearTest, CPUResizeBilinearNHWC) {
+  for (bool align_corners : {false, true}) {
+    OpsTestNet net;
+    net.AddRandomInput<DeviceType::CPU, float>("Input", {2, 7, 9, 5});
+    net.TransformDataFormat<DeviceType::CPU, float>("Input", NHWC,
+                                                    "InputNCHW", NCHW);
+
+    OpDefBuilder("ResizeBilinear", "ResizeBilinearNCHW")
+        .Input("InputNCHW")
+        .Output("OutputNCHW")
+        .AddIntsArg("size", {12, 5})
+        .AddIntArg("align_corners", align_corners)
+        .Finalize(net.NewOperatorDef());
+    net.RunOp();
+    net.TransformDataFormat<DeviceType::CPU, float>("OutputNCHW", NCHW,
+                                                    "Expected", NHWC);
+
+    OpDefBuilder("ResizeBilinear", "ResizeBilinearNHWC")
+        .Input("Input")
+        .Output("Output")
+        .AddIntsArg("size", {12, 5})
+        .AddIntArg("align_corners", align_corners)
+        .AddIntArg("data_format", NHWC)
+        .Finalize(net.NewOperatorDef());
+    net.RunOp();
+
+    ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                            *net.GetOutput("Output"), 1e-5);
+  }
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
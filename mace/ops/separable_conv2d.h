@@ -0,0 +1,70 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_SEPARABLE_CONV2D_H_
+#define MACE_OPS_SEPARABLE_CONV2D_H_
+
+#include <string>
+
+#include "mace/core/operator.h"
+#include "mace/kernels/separable_conv2d.h"
+#include "mace/ops/conv_pool_2d_base.h"
+
+namespace mace {
+namespace ops {
+
+template <DeviceType D, typename T>
+class SeparableConv2dOp : public ConvPool2dOpBase<D, T> {
+ public:
+  SeparableConv2dOp(const OperatorDef &op_def, Workspace *ws)
+      : ConvPool2dOpBase<D, T>(op_def, ws),
+        functor_(this->strides_.data(),
+                 this->padding_type_,
+                 this->paddings_,
+                 this->dilations_.data(),
+                 kernels::StringToActivationType(
+                     OperatorBase::GetOptionalArg<std::string>(
+                         "depthwise_activation", "NOOP")),
+                 OperatorBase::GetOptionalArg<float>("depthwise_max_limit",
+                                                     0.0f),
+                 kernels::StringToActivationType(
+                     OperatorBase::GetOptionalArg<std::string>("activation",
+                                                               "NOOP")),
+                 OperatorBase::GetOptionalArg<float>("max_limit", 0.0f),
+                 ws->GetScratchBuffer(D)) {}
+
+  MaceStatus Run(StatsFuture *future) override {
+    const Tensor *input = this->Input(INPUT);
+    const Tensor *depthwise_filter = this->Input(DEPTHWISE_FILTER);
+    const Tensor *depthwise_bias = this->Input(DEPTHWISE_BIAS);
+    const Tensor *pointwise_filter = this->Input(POINTWISE_FILTER);
+    const Tensor *pointwise_bias = this->Input(POINTWISE_BIAS);
+    Tensor *output = this->Output(OUTPUT);
+    return functor_(input, depthwise_filter, depthwise_bias,
+                    pointwise_filter, pointwise_bias, output, future);
+  }
+
+ private:
+  kernels::SeparableConv2dFunctor<D, T> functor_;
+
+ protected:
+  MACE_OP_INPUT_TAGS(INPUT, DEPTHWISE_FILTER, DEPTHWISE_BIAS,
+                     POINTWISE_FILTER, POINTWISE_BIAS);
+  MACE_OP_OUTPUT_TAGS(OUTPUT);
+};
+
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_SEPARABLE_CONV2D_H_
@@ -0,0 +1,137 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/core/operator.h"
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/separable_conv2d.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+// fused runs SeparableConv2d, otherwise DepthwiseConv2d then a 1x1 Conv2D.
+template <DeviceType D, typename T>
+void SeparableConv2d(int iters,
+                     int batch,
+                     int channels,
+                     int height,
+                     int width,
+                     int kernel,
+                     int stride,
+                     int out_channels,
+                     bool fused) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+  net.AddRandomInput<D, float>("Input", {batch, channels, height, width});
+  net.AddRandomInput<D, float>("DWFilter", {1, channels, kernel, kernel});
+  net.AddRandomInput<D, float>("DWBias", {channels});
+  net.AddRandomInput<D, float>("PWFilter", {out_channels, channels, 1, 1});
+  net.AddRandomInput<D, float>("PWBias", {out_channels});
+
+  if (fused) {
+    OpDefBuilder("SeparableConv2d", "SeparableConv2dTest")
+        .Input("Input")
+        .Input("DWFilter")
+        .Input("DWBias")
+        .Input("PWFilter")
+        .Input("PWBias")
+        .Output("Output")
+        .AddIntsArg("strides", {stride, stride})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .AddStringArg("depthwise_activation", "RELUX")
+        .AddFloatArg("depthwise_max_limit", 6.f)
+        .Finalize(net.NewOperatorDef());
+  } else {
+    // The net is created before it runs, the 1x1 conv needs its input.
+    net.AddRandomInput<D, float>(
+        "DWOutput", {batch, channels, (height + stride - 1) / stride,
+                     (width + stride - 1) / stride});
+    OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2dTest")
+        .Input("Input")
+        .Input("DWFilter")
+        .Input("DWBias")
+        .Output("DWOutput")
+        .AddIntsArg("strides", {stride, stride})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .AddStringArg("activation", "RELUX")
+        .AddFloatArg("max_limit", 6.f)
+        .Finalize(net.AddNewOperatorDef());
+    OpDefBuilder("Conv2D", "PointwiseConv2dTest")
+        .Input("DWOutput")
+        .Input("PWFilter")
+        .Input("PWBias")
+        .Output("Output")
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::VALID)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(net.AddNewOperatorDef());
+  }
+
+  net.Setup(D);
+
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+    net.Sync();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+    net.Sync();
+  }
+}
+}  // namespace
+
+#define MACE_BM_SEPARABLE_CONV_2D_MACRO(N, C, H, W, K, S, O, FUSED, TYPE,     \
+                                        DEVICE)                               \
+  static void                                                                 \
+      MACE_BM_SEPARABLE_CONV_2D_##N##_##C##_##H##_##W##_K##K##S##S##_##O##_   \
+        ##FUSED##_##TYPE##_##DEVICE(int iters) {                              \
+    const int64_t oh = (H + S - 1) / S;                                       \
+    const int64_t ow = (W + S - 1) / S;                                       \
+    const int64_t macc = static_cast<int64_t>(iters) * N * oh * ow           \
+        * (C * (K * K + 1) + O * (C + 1));                                    \
+    mace::testing::MaccProcessed(macc);                                       \
+    mace::testing::BytesProcessed(static_cast<int64_t>(iters) * N * C * H    \
+                                  * W * sizeof(TYPE));                        \
+    SeparableConv2d<DEVICE, TYPE>(iters, N, C, H, W, K, S, O,                 \
+                                  FUSED == 1);                                \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_SEPARABLE_CONV_2D_##N##_##C##_##H##_##W##_K##K##S##S##_##O##_   \
+        ##FUSED##_##TYPE##_##DEVICE)
+
+#define MACE_BM_SEPARABLE_CONV_2D(N, C, H, W, K, S, O)                        \
+  MACE_BM_SEPARABLE_CONV_2D_MACRO(N, C, H, W, K, S, O, 0, float, CPU);        \
+  MACE_BM_SEPARABLE_CONV_2D_MACRO(N, C, H, W, K, S, O, 1, float, CPU);
+
+// MobileNet-v1
+MACE_BM_SEPARABLE_CONV_2D(1, 32, 112, 112, 3, 1, 64);
+MACE_BM_SEPARABLE_CONV_2D(1, 128, 56, 56, 3, 1, 128);
+MACE_BM_SEPARABLE_CONV_2D(1, 256, 28, 28, 3, 1, 256);
+MACE_BM_SEPARABLE_CONV_2D(1, 512, 14, 14, 3, 1, 512);
+MACE_BM_SEPARABLE_CONV_2D(1, 1024, 7, 7, 3, 1, 1024);
+// MobileNet-v2 / EfficientNet projections
+MACE_BM_SEPARABLE_CONV_2D(1, 144, 56, 56, 3, 1, 24);
+MACE_BM_SEPARABLE_CONV_2D(1, 240, 28, 28, 5, 1, 40);
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,123 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/separable_conv2d.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class SeparableConv2dOpTest : public OpsTestBase {};
+
+namespace {
+// Compare the fused op with a depthwise convolution followed by a 1x1
+// convolution.
+void TestSeparable(const std::vector<index_t> &input_shape,  // NCHW
+                   const index_t multiplier,
+                   const int kernel,
+                   const int stride,
+                   const int dilation,
+                   const index_t out_channels,
+                   const Padding padding) {
+  const index_t channels = input_shape[1];
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "DWFilter", {multiplier, channels, kernel, kernel});
+  net.AddRandomInput<DeviceType::CPU, float>("DWBias",
+                                             {multiplier * channels});
+  net.AddRandomInput<DeviceType::CPU, float>(
+      "PWFilter", {out_channels, multiplier * channels, 1, 1});
+  net.AddRandomInput<DeviceType::CPU, float>("PWBias", {out_channels});
+
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2dTest")
+      .Input("Input")
+      .Input("DWFilter")
+      .Input("DWBias")
+      .Output("DWOutput")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("activation", "RELUX")
+      .AddFloatArg("max_limit", 1.5f)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  OpDefBuilder("Conv2D", "PointwiseConv2dTest")
+      .Input("DWOutput")
+      .Input("PWFilter")
+      .Input("PWBias")
+      .Output("Expected")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", VALID)
+      .AddIntsArg("dilations", {1, 1})
+      .AddStringArg("activation", "RELU")
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  OpDefBuilder("SeparableConv2d", "SeparableConv2dTest")
+      .Input("Input")
+      .Input("DWFilter")
+      .Input("DWBias")
+      .Input("PWFilter")
+      .Input("PWBias")
+      .Output("Output")
+      .AddIntsArg("strides", {stride, stride})
+      .AddIntArg("padding", padding)
+      .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("depthwise_activation", "RELUX")
+      .AddFloatArg("depthwise_max_limit", 1.5f)
+      .AddStringArg("activation", "RELU")
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(SeparableConv2dOpTest, CPU3x3) {
+  TestSeparable({1, 16, 15, 17}, 1, 3, 1, 1, 24, SAME);
+  TestSeparable({1, 13, 24, 21}, 1, 3, 2, 1, 13, SAME);
+  TestSeparable({2, 8, 19, 20}, 2, 3, 1, 1, 7, VALID);
+}
+
+TEST_F(SeparableConv2dOpTest, CPULargeFilter) {
+  TestSeparable({1, 12, 20, 23}, 1, 5, 1, 1, 16, SAME);
+  TestSeparable({1, 10, 27, 25}, 1, 5, 2, 1, 9, SAME);
+  TestSeparable({1, 6, 18, 18}, 1, 7, 1, 1, 8, SAME);
+  TestSeparable({1, 5, 21, 19}, 1, 7, 2, 1, 5, VALID);
+}
+
+TEST_F(SeparableConv2dOpTest, CPUDilation) {
+  TestSeparable({1, 8, 23, 22}, 1, 3, 1, 2, 12, SAME);
+  TestSeparable({1, 7, 30, 29}, 1, 5, 1, 2, 6, VALID);
+}
+
+TEST_F(SeparableConv2dOpTest, CPUSmallMap) {
+  TestSeparable({1, 32, 2, 3}, 1, 3, 1, 1, 20, SAME);
+  TestSeparable({2, 24, 3, 4}, 1, 3, 1, 1, 17, SAME);
+  TestSeparable({1, 40, 7, 7}, 1, 3, 1, 1, 33, SAME);
+}
+
+TEST_F(SeparableConv2dOpTest, CPUMultiTile) {
+  TestSeparable({1, 96, 64, 64}, 1, 3, 1, 1, 24, SAME);
+  TestSeparable({2, 144, 57, 57}, 1, 3, 2, 1, 32, SAME);
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
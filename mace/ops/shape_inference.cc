@@ -0,0 +1,427 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "mace/core/operator.h"
+#include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/nchwc.h"
+#include "mace/kernels/tiled_chain.h"
+
+// Output shapes of CPU ops, which must be kept consistent with the shapes
+// the ops resize their outputs to.
+
+namespace mace {
+namespace ops {
+
+namespace {
+typedef std::vector<std::vector<index_t>> Shapes;
+
+template <typename T>
+T GetArg(const OperatorDef &op_def, const std::string &name,
+         const T &default_value) {
+  return ProtoArgHelper::GetOptionalArg<OperatorDef, T>(
+      op_def, name, default_value);
+}
+
+template <typename T>
+std::vector<T> GetArgs(const OperatorDef &op_def, const std::string &name,
+                       const std::vector<T> &default_value = {}) {
+  return ProtoArgHelper::GetRepeatedArgs<OperatorDef, T>(
+      op_def, name, default_value);
+}
+
+MaceStatus InferSameAsInput(const OperatorDef &op_def,
+                            const Shapes &input_shapes,
+                            Shapes *output_shapes) {
+  MACE_UNUSED(op_def);
+  MACE_CHECK(!input_shapes.empty());
+  output_shapes->push_back(input_shapes[0]);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+// Shared by convolution and pooling, filter_shape is OIHW.
+MaceStatus InferConvPoolShape(const OperatorDef &op_def,
+                              const std::vector<index_t> &input_shape,
+                              const std::vector<index_t> &filter_shape,
+                              RoundType round_type,
+                              Shapes *output_shapes) {
+  const std::vector<int> strides = GetArgs<int>(op_def, "strides");
+  const std::vector<int> dilations =
+      GetArgs<int>(op_def, "dilations", {1, 1});
+  const std::vector<int> paddings = GetArgs<int>(op_def, "padding_values");
+  const Padding padding_type = static_cast<Padding>(
+      GetArg<int>(op_def, "padding", static_cast<int>(SAME)));
+  if (input_shape.size() == 5) {
+    // blocked NCHWc in, blocked NCHWc out
+    Shapes nchw_output_shapes;
+    MACE_RETURN_IF_ERROR(InferConvPoolShape(
+        op_def, kernels::NCHWShape(input_shape), filter_shape, round_type,
+        &nchw_output_shapes));
+    output_shapes->push_back(kernels::NCHWcShape(nchw_output_shapes[0]));
+    return MaceStatus::MACE_SUCCESS;
+  }
+  if (input_shape.size() != 4 || strides.size() != 2
+      || dilations.size() != 2) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+
+  std::vector<index_t> output_shape(4);
+  const bool nhwc = GetArg<int>(op_def, "data_format", NCHW) == NHWC;
+  if (paddings.empty() && nhwc) {
+    std::vector<int> padding_size(2);
+    kernels::CalcNHWCPaddingAndOutputSize(input_shape.data(),
+                                          filter_shape.data(),
+                                          dilations.data(),
+                                          strides.data(),
+                                          padding_type,
+                                          output_shape.data(),
+                                          padding_size.data());
+  } else if (paddings.empty()) {
+    std::vector<int> padding_size(2);
+    kernels::CalcNCHWPaddingAndOutputSize(input_shape.data(),
+                                          filter_shape.data(),
+                                          dilations.data(),
+                                          strides.data(),
+                                          padding_type,
+                                          output_shape.data(),
+                                          padding_size.data());
+  } else if (nhwc) {
+    kernels::CalcOutputSize(input_shape.data(),
+                            filter_shape.data(),
+                            paddings.data(),
+                            dilations.data(),
+                            strides.data(),
+                            round_type,
+                            output_shape.data());
+  } else {
+    kernels::CalcNCHWOutputSize(input_shape.data(),
+                                filter_shape.data(),
+                                paddings.data(),
+                                dilations.data(),
+                                strides.data(),
+                                round_type,
+                                output_shape.data());
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferConv2DShape(const OperatorDef &op_def,
+                            const Shapes &input_shapes,
+                            Shapes *output_shapes) {
+  MACE_CHECK(input_shapes.size() >= 2);
+  std::vector<index_t> filter_shape = input_shapes[1];
+  if (GetArg<int>(op_def, "is_filter_transformed", 0)) {
+    // TOC -> OIHW
+    filter_shape = {input_shapes[1][1], input_shapes[1][2], 3, 3};
+  }
+  return InferConvPoolShape(op_def, input_shapes[0], filter_shape,
+                            RoundType::FLOOR, output_shapes);
+}
+
+MaceStatus InferDepthwiseConv2dShape(const OperatorDef &op_def,
+                                     const Shapes &input_shapes,
+                                     Shapes *output_shapes) {
+  MACE_CHECK(input_shapes.size() >= 2);
+  const std::vector<index_t> &filter = input_shapes[1];
+  if (filter.size() != 4) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  return InferConvPoolShape(op_def, input_shapes[0],
+                            {filter[0] * filter[1], filter[1], filter[2],
+                             filter[3]},
+                            RoundType::FLOOR, output_shapes);
+}
+
+MaceStatus InferPoolingShape(const OperatorDef &op_def,
+                             const Shapes &input_shapes,
+                             Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> kernels = GetArgs<int>(op_def, "kernels");
+  if (kernels.size() != 2
+      || (input_shapes[0].size() != 4 && input_shapes[0].size() != 5)) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  index_t channels = input_shapes[0][1];
+  if (input_shapes[0].size() == 5) {
+    channels *= input_shapes[0][4];
+  } else if (GetArg<int>(op_def, "data_format", NCHW) == NHWC) {
+    channels = input_shapes[0][3];
+  }
+  return InferConvPoolShape(op_def, input_shapes[0],
+                            {channels, channels, kernels[0], kernels[1]},
+                            RoundType::CEIL, output_shapes);
+}
+
+MaceStatus InferEltwiseShape(const OperatorDef &op_def,
+                             const Shapes &input_shapes,
+                             Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  if (input_shapes.size() == 1) {
+    output_shapes->push_back(input_shapes[0]);
+    return MaceStatus::MACE_SUCCESS;
+  }
+  auto size_of = [](const std::vector<index_t> &shape) {
+    return std::accumulate(shape.begin(), shape.end(), 1,
+                           std::multiplies<index_t>());
+  };
+  const std::vector<index_t> *input0 = &input_shapes[0];
+  const std::vector<index_t> *input1 = &input_shapes[1];
+  if (size_of(*input0) < size_of(*input1)) {
+    std::swap(input0, input1);
+  }
+  if (input0->size() < input1->size()) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  const DataFormat data_format =
+      static_cast<DataFormat>(GetArg<int>(op_def, "data_format", 0));
+  if (data_format == NCHW && !input1->empty()
+      && size_of(*input1) < size_of(*input0)) {
+    // broadcast along channel
+    output_shapes->push_back(*input0);
+    return MaceStatus::MACE_SUCCESS;
+  }
+  std::vector<index_t> output_shape = *input0;
+  const size_t rank_diff = input0->size() - input1->size();
+  for (size_t i = 0; i < input1->size(); ++i) {
+    output_shape[rank_diff + i] =
+        std::max(output_shape[rank_diff + i], (*input1)[i]);
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferConcatShape(const OperatorDef &op_def,
+                            const Shapes &input_shapes,
+                            Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const int32_t input_dims = static_cast<int32_t>(input_shapes[0].size());
+  int32_t axis = GetArg<int>(op_def, "axis", 3);
+  axis = axis < 0 ? axis + input_dims : axis;
+  if (axis < 0 || axis >= input_dims) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  std::vector<index_t> output_shape = input_shapes[0];
+  for (size_t i = 1; i < input_shapes.size(); ++i) {
+    if (input_shapes[i].size() != input_shapes[0].size()) {
+      return MaceStatus::MACE_INVALID_ARGS;
+    }
+    output_shape[axis] += input_shapes[i][axis];
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferFullyConnectedShape(const OperatorDef &op_def,
+                                    const Shapes &input_shapes,
+                                    Shapes *output_shapes) {
+  MACE_UNUSED(op_def);
+  MACE_CHECK(input_shapes.size() >= 2);
+  if (input_shapes[0].empty() || input_shapes[1].empty()) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  output_shapes->push_back({input_shapes[0][0], input_shapes[1][0], 1, 1});
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferMatMulShape(const OperatorDef &op_def,
+                            const Shapes &input_shapes,
+                            Shapes *output_shapes) {
+  MACE_CHECK(input_shapes.size() >= 2);
+  const std::vector<index_t> &a = input_shapes[0];
+  const std::vector<index_t> &b = input_shapes[1];
+  const size_t rank = a.size();
+  if (rank < 2 || b.size() != rank) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  const bool transpose_a = GetArg<bool>(op_def, "transpose_a", false);
+  const bool transpose_b = GetArg<bool>(op_def, "transpose_b", false);
+  std::vector<index_t> output_shape = a;
+  output_shape[rank - 2] = transpose_a ? a[rank - 1] : a[rank - 2];
+  output_shape[rank - 1] = transpose_b ? b[rank - 2] : b[rank - 1];
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferPadShape(const OperatorDef &op_def,
+                         const Shapes &input_shapes,
+                         Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> paddings = GetArgs<int>(op_def, "paddings");
+  const std::vector<index_t> &input_shape = input_shapes[0];
+  if (input_shape.size() != 4 || paddings.size() != 8) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  std::vector<index_t> output_shape(4);
+  for (size_t i = 0; i < 4; ++i) {
+    output_shape[i] = input_shape[i] + paddings[2 * i] + paddings[2 * i + 1];
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferReorderShape(const OperatorDef &op_def,
+                             const Shapes &input_shapes,
+                             Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const DataFormat data_format =
+      static_cast<DataFormat>(GetArg<int>(op_def, "data_format", NCHWc));
+  const std::vector<index_t> &input_shape = input_shapes[0];
+  if (data_format == NCHWc && input_shape.size() == 4
+      && input_shape[1] % kernels::kNCHWcBlockSize == 0) {
+    output_shapes->push_back(kernels::NCHWcShape(input_shape));
+  } else if (data_format == NCHW && input_shape.size() == 5) {
+    output_shapes->push_back(kernels::NCHWShape(input_shape));
+  } else {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferResizeBilinearShape(const OperatorDef &op_def,
+                                    const Shapes &input_shapes,
+                                    Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<index_t> size =
+      GetArgs<index_t>(op_def, "size", {-1, -1});
+  const std::vector<index_t> &input_shape = input_shapes[0];
+  if (input_shape.size() != 4 || size.size() != 2
+      || size[0] <= 0 || size[1] <= 0) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  if (GetArg<int>(op_def, "data_format", NCHW) == NHWC) {
+    output_shapes->push_back(
+        {input_shape[0], size[0], size[1], input_shape[3]});
+  } else {
+    output_shapes->push_back(
+        {input_shape[0], input_shape[1], size[0], size[1]});
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferSeparableConv2dShape(const OperatorDef &op_def,
+                                     const Shapes &input_shapes,
+                                     Shapes *output_shapes) {
+  MACE_CHECK(input_shapes.size() >= 4);
+  Shapes depthwise_output_shapes;
+  MACE_RETURN_IF_ERROR(InferDepthwiseConv2dShape(op_def, input_shapes,
+                                                 &depthwise_output_shapes));
+  std::vector<index_t> output_shape = depthwise_output_shapes[0];
+  output_shape[1] = input_shapes[3][0];
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferSqueezeShape(const OperatorDef &op_def,
+                             const Shapes &input_shapes,
+                             Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> axis = GetArgs<int>(op_def, "axis");
+  const std::unordered_set<int> axis_set(axis.begin(), axis.end());
+  const std::vector<index_t> &input_shape = input_shapes[0];
+  std::vector<index_t> output_shape;
+  for (size_t i = 0; i < input_shape.size(); ++i) {
+    if (input_shape[i] > 1
+        || (!axis_set.empty()
+            && axis_set.find(static_cast<int>(i)) == axis_set.end())) {
+      output_shape.push_back(input_shape[i]);
+    }
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferTiledChainShape(const OperatorDef &op_def,
+                                const Shapes &input_shapes,
+                                Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  if (input_shapes[0].size() != 4) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  Shapes filter_shapes;
+  for (size_t i = 1; i < input_shapes.size(); i += 2) {
+    filter_shapes.push_back(input_shapes[i]);
+  }
+  std::vector<kernels::TiledChainLayer> layers;
+  MACE_RETURN_IF_ERROR(kernels::TiledChainLayers(
+      GetArgs<int>(op_def, "layer_types"), GetArgs<int>(op_def, "kernels"),
+      GetArgs<int>(op_def, "strides"), GetArgs<int>(op_def, "dilations"),
+      GetArgs<int>(op_def, "padding_values"),
+      GetArgs<int>(op_def, "activations"),
+      GetArgs<float>(op_def, "max_limits"), filter_shapes, &layers));
+  MACE_RETURN_IF_ERROR(
+      kernels::TiledChainShapes(input_shapes[0].data(), &layers));
+  output_shapes->push_back(std::vector<index_t>(
+      layers.back().out_shape, layers.back().out_shape + 4));
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus InferTransposeShape(const OperatorDef &op_def,
+                               const Shapes &input_shapes,
+                               Shapes *output_shapes) {
+  MACE_CHECK(!input_shapes.empty());
+  const std::vector<int> dims = GetArgs<int>(op_def, "dims");
+  const std::vector<index_t> &input_shape = input_shapes[0];
+  if (dims.size() != input_shape.size()) {
+    return MaceStatus::MACE_INVALID_ARGS;
+  }
+  std::vector<index_t> output_shape;
+  for (int dim : dims) {
+    output_shape.push_back(input_shape[dim]);
+  }
+  output_shapes->push_back(output_shape);
+  return MaceStatus::MACE_SUCCESS;
+}
+}  // namespace
+
+void Register_ShapeInference(OperatorRegistry *op_registry) {
+  // Keep in lexicographical order
+  op_registry->RegisterShapeInference("Activation", InferSameAsInput);
+  op_registry->RegisterShapeInference("AddN", InferSameAsInput);
+  op_registry->RegisterShapeInference("BatchNorm", InferSameAsInput);
+  op_registry->RegisterShapeInference("BiasAdd", InferSameAsInput);
+  op_registry->RegisterShapeInference("ChannelShuffle", InferSameAsInput);
+  op_registry->RegisterShapeInference("Concat", InferConcatShape);
+  op_registry->RegisterShapeInference("Conv2D", InferConv2DShape);
+  op_registry->RegisterShapeInference("DepthwiseConv2d",
+                                      InferDepthwiseConv2dShape);
+  op_registry->RegisterShapeInference("Eltwise", InferEltwiseShape);
+  op_registry->RegisterShapeInference("FoldedBatchNorm", InferSameAsInput);
+  op_registry->RegisterShapeInference("FullyConnected",
+                                      InferFullyConnectedShape);
+  op_registry->RegisterShapeInference("Identity", InferSameAsInput);
+  op_registry->RegisterShapeInference("LocalResponseNorm", InferSameAsInput);
+  op_registry->RegisterShapeInference("MatMul", InferMatMulShape);
+  op_registry->RegisterShapeInference("Pad", InferPadShape);
+  op_registry->RegisterShapeInference("Pooling", InferPoolingShape);
+  op_registry->RegisterShapeInference("Reorder", InferReorderShape);
+  op_registry->RegisterShapeInference("ResizeBilinear",
+                                      InferResizeBilinearShape);
+  op_registry->RegisterShapeInference("SeparableConv2d",
+                                      InferSeparableConv2dShape);
+  op_registry->RegisterShapeInference("Softmax", InferSameAsInput);
+  op_registry->RegisterShapeInference("Squeeze", InferSqueezeShape);
+  op_registry->RegisterShapeInference("TiledChain", InferTiledChainShape);
+  op_registry->RegisterShapeInference("Transpose", InferTransposeShape);
+}
+
+}  // namespace ops
+}  // namespace mace
@@ -0,0 +1,271 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mace/core/net.h"
+#include "mace/kernels/eltwise.h"
+#include "mace/kernels/pooling.h"
+#include "mace/ops/ops_test_util.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class ShapeInferenceTest : public OpsTestBase {};
+
+TEST_F(ShapeInferenceTest, MatchRunShapes) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 3, 17, 15});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {8, 3, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("DWFilter", {1, 8, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {8});
+  net.AddRandomInput<DeviceType::CPU, float>("Weight", {10, 16, 4, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("FCBias", {10});
+  net.AddRandomInput<DeviceType::CPU, float>("PWFilter", {6, 8, 1, 1});
+  net.AddRandomInput<DeviceType::CPU, float>("PWBias", {6});
+
+  NetDef net_def;
+  OpDefBuilder("Conv2D", "Conv2D")
+      .Input("Input")
+      .Input("Filter")
+      .Output("Conv")
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2d")
+      .Input("Conv")
+      .Input("DWFilter")
+      .Output("DWConv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntsArg("padding_values", {2, 2})
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("SeparableConv2d", "SeparableConv2d")
+      .Input("Conv")
+      .Input("DWFilter")
+      .Input("Bias")
+      .Input("PWFilter")
+      .Input("PWBias")
+      .Output("SeparableConv")
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Eltwise", "BiasEltwise")
+      .Input("DWConv")
+      .Input("Bias")
+      .Output("Eltwise")
+      .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+      .AddIntArg("data_format", NCHW)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Pooling", "Pooling")
+      .Input("Eltwise")
+      .Output("Pool")
+      .AddIntsArg("kernels", {3, 3})
+      .AddIntsArg("strides", {3, 3})
+      .AddIntsArg("padding_values", {1, 1})
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("pooling_type", PoolingType::MAX)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Concat", "Concat")
+      .Input("Pool")
+      .Input("Pool")
+      .Output("Concat")
+      .AddIntArg("axis", 1)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("FullyConnected", "FullyConnected")
+      .Input("Concat")
+      .Input("Weight")
+      .Input("FCBias")
+      .Output("FC")
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Softmax", "Softmax")
+      .Input("FC")
+      .Output("Output")
+      .Finalize(net_def.add_op());
+
+  std::map<std::string, std::vector<index_t>> shapes;
+  for (const char *name : {"Input", "Filter", "DWFilter", "Bias", "Weight",
+                           "FCBias", "PWFilter", "PWBias"}) {
+    shapes[name] = net.GetTensor(name)->shape();
+  }
+  OperatorRegistry op_registry;
+  InferNetShapes(op_registry, net_def, DeviceType::CPU, &shapes);
+
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, net.RunNet(net_def, DeviceType::CPU));
+  for (auto &op : net_def.op()) {
+    const std::string &output = op.output(0);
+    ASSERT_TRUE(shapes.find(output) != shapes.end()) << output;
+    EXPECT_EQ(net.GetTensor(output.c_str())->shape(), shapes[output])
+        << output;
+  }
+}
+
+TEST_F(ShapeInferenceTest, NHWCShapes) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 17, 15, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {8, 3, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("DWFilter", {1, 8, 3, 3});
+
+  NetDef net_def;
+  OpDefBuilder("Conv2D", "Conv2D")
+      .Input("Input")
+      .Input("Filter")
+      .Output("Conv")
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2d")
+      .Input("Conv")
+      .Input("DWFilter")
+      .Output("DWConv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntsArg("padding_values", {2, 2})
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Pooling", "Pooling")
+      .Input("DWConv")
+      .Output("Pool")
+      .AddIntsArg("kernels", {3, 3})
+      .AddIntsArg("strides", {3, 3})
+      .AddIntsArg("padding_values", {1, 1})
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("pooling_type", PoolingType::AVG)
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("ResizeBilinear", "ResizeBilinear")
+      .Input("Pool")
+      .Output("Resize")
+      .AddIntsArg("size", {7, 5})
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Concat", "Concat")
+      .Input("Resize")
+      .Input("Resize")
+      .Output("Concat")
+      .AddIntArg("axis", 3)
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Softmax", "Softmax")
+      .Input("Concat")
+      .Output("Output")
+      .AddIntArg("data_format", NHWC)
+      .Finalize(net_def.add_op());
+
+  std::map<std::string, std::vector<index_t>> shapes;
+  for (const char *name : {"Input", "Filter", "DWFilter"}) {
+    shapes[name] = net.GetTensor(name)->shape();
+  }
+  OperatorRegistry op_registry;
+  InferNetShapes(op_registry, net_def, DeviceType::CPU, &shapes);
+
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, net.RunNet(net_def, DeviceType::CPU));
+  EXPECT_EQ(std::vector<index_t>({1, 7, 5, 16}),
+            net.GetTensor("Output")->shape());
+  for (auto &op : net_def.op()) {
+    const std::string &output = op.output(0);
+    ASSERT_TRUE(shapes.find(output) != shapes.end()) << output;
+    EXPECT_EQ(net.GetTensor(output.c_str())->shape(), shapes[output])
+        << output;
+  }
+}
+
+TEST_F(ShapeInferenceTest, NCHWcShapes) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 8, 17, 15});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {16, 8, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("DWFilter", {1, 16, 3, 3});
+
+  NetDef net_def;
+  OpDefBuilder("Reorder", "ToNCHWc")
+      .Input("Input")
+      .Output("Blocked")
+      .AddIntArg("data_format", NCHWc)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Conv2D", "Conv2D")
+      .Input("Blocked")
+      .Input("Filter")
+      .Output("Conv")
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("DepthwiseConv2d", "DepthwiseConv2d")
+      .Input("Conv")
+      .Input("DWFilter")
+      .Output("DWConv")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntsArg("padding_values", {2, 2})
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Pooling", "Pooling")
+      .Input("DWConv")
+      .Output("Pool")
+      .AddIntsArg("kernels", {3, 3})
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::VALID)
+      .AddIntsArg("dilations", {1, 1})
+      .AddIntArg("pooling_type", PoolingType::AVG)
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Reorder", "ToNCHW")
+      .Input("Pool")
+      .Output("Output")
+      .AddIntArg("data_format", NCHW)
+      .Finalize(net_def.add_op());
+
+  std::map<std::string, std::vector<index_t>> shapes;
+  for (const char *name : {"Input", "Filter", "DWFilter"}) {
+    shapes[name] = net.GetTensor(name)->shape();
+  }
+  OperatorRegistry op_registry;
+  InferNetShapes(op_registry, net_def, DeviceType::CPU, &shapes);
+
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, net.RunNet(net_def, DeviceType::CPU));
+  for (auto &op : net_def.op()) {
+    const std::string &output = op.output(0);
+    ASSERT_TRUE(shapes.find(output) != shapes.end()) << output;
+    EXPECT_EQ(net.GetTensor(output.c_str())->shape(), shapes[output])
+        << output;
+  }
+}
+
+TEST_F(ShapeInferenceTest, UnknownOpStopsPropagation) {
+  NetDef net_def;
+  OpDefBuilder("Shape", "Shape")
+      .Input("Input")
+      .Output("Shape")
+      .Finalize(net_def.add_op());
+  OpDefBuilder("Activation", "Relu")
+      .Input("Shape")
+      .Output("Output")
+      .AddStringArg("activation", "RELU")
+      .Finalize(net_def.add_op());
+
+  std::map<std::string, std::vector<index_t>> shapes;
+  shapes["Input"] = {1, 2, 3, 4};
+  OperatorRegistry op_registry;
+  InferNetShapes(op_registry, net_def, DeviceType::CPU, &shapes);
+  EXPECT_EQ(1u, shapes.size());
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -25,7 +25,9 @@ template <DeviceType D, class T>
 class SoftmaxOp : public Operator<D, T> {
  public:
   SoftmaxOp(const OperatorDef &operator_def, Workspace *ws)
-      : Operator<D, T>(operator_def, ws) {}
+      : Operator<D, T>(operator_def, ws),
+        functor_(static_cast<DataFormat>(OperatorBase::GetOptionalArg<int>(
+            "data_format", static_cast<int>(NCHW)))) {}
 
   MaceStatus Run(StatsFuture *future) override {
     const Tensor *logits = this->Input(LOGITS);
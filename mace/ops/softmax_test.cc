@@ -47,6 +47,17 @@ void Simple() {
 
     ExpectTensorNear<float>(*expected, *net.GetOutput("Output"), 1e-5);
 
+    // check 4d nhwc softmax
+    OpDefBuilder("Softmax", "SoftmaxTest")
+        .Input("Input")
+        .Output("Output")
+        .AddIntArg("data_format", NHWC)
+        .Finalize(net.NewOperatorDef());
+
+    // Run
+    net.RunOp(D);
+    ExpectTensorNear<float>(*expected, *net.GetOutput("Output"), 1e-5);
+
     // check 2d softmax
     net.AddInputFromArray<D, float>("Input2d", {2, 4},
                                     {1, 1, 1, 1, 1, 2, 3, 4});
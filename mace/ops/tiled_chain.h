@@ -0,0 +1,75 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_OPS_TILED_CHAIN_H_
+#define MACE_OPS_TILED_CHAIN_H_
+
+#include <vector>
+
+#include "mace/core/operator.h"
+#include "mace/kernels/tiled_chain.h"
+
+namespace mace {
+namespace ops {
+
+// Inputs are the input, then a filter and a bias for each convolution of
+// the chain in order.
+template <DeviceType D, typename T>
+class TiledChainOp : public Operator<D, T> {
+ public:
+  TiledChainOp(const OperatorDef &op_def, Workspace *ws)
+      : Operator<D, T>(op_def, ws),
+        functor_(Layers(), ws->GetScratchBuffer(D)) {}
+
+  MaceStatus Run(StatsFuture *future) override {
+    const Tensor *input = this->Input(INPUT);
+    const std::vector<const Tensor *> weights(
+        this->Inputs().begin() + WEIGHTS, this->Inputs().end());
+    Tensor *output = this->Output(OUTPUT);
+    return functor_(input, weights, output, future);
+  }
+
+ private:
+  std::vector<kernels::TiledChainLayer> Layers() {
+    std::vector<std::vector<index_t>> filter_shapes;
+    for (int i = WEIGHTS; i < this->InputSize(); i += 2) {
+      filter_shapes.push_back(this->Input(i)->shape());
+    }
+    std::vector<kernels::TiledChainLayer> layers;
+    MaceStatus status = kernels::TiledChainLayers(
+        OperatorBase::GetRepeatedArgs<int>("layer_types"),
+        OperatorBase::GetRepeatedArgs<int>("kernels"),
+        OperatorBase::GetRepeatedArgs<int>("strides"),
+        OperatorBase::GetRepeatedArgs<int>("dilations"),
+        OperatorBase::GetRepeatedArgs<int>("padding_values"),
+        OperatorBase::GetRepeatedArgs<int>("activations"),
+        OperatorBase::GetRepeatedArgs<float>("max_limits"),
+        filter_shapes,
+        &layers);
+    MACE_CHECK(status == MaceStatus::MACE_SUCCESS,
+               "invalid tiled chain: ", OperatorBase::debug_def().name());
+    return layers;
+  }
+
+  kernels::TiledChainFunctor<D, T> functor_;
+
+ protected:
+  MACE_OP_INPUT_TAGS(INPUT, WEIGHTS);
+  MACE_OP_OUTPUT_TAGS(OUTPUT);
+};
+
+}  // namespace ops
+}  // namespace mace
+
+#endif  // MACE_OPS_TILED_CHAIN_H_
@@ -0,0 +1,212 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "mace/core/operator.h"
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/pooling.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/tiled_chain.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+namespace {
+struct Layer {
+  kernels::TiledChainLayerType type;
+  int kernel;
+  int stride;
+  index_t channels;  // out channels of conv, multiplier of depthwise
+};
+
+// The stem of a detection net, then an inverted residual block without
+// its residual, both at full resolution.
+std::vector<Layer> ChainLayers(const std::string &name) {
+  if (name == "CONV") {
+    return {{kernels::TILED_CONV_2D, 3, 1, 16},
+            {kernels::TILED_CONV_2D, 3, 1, 16},
+            {kernels::TILED_MAX_POOLING, 2, 2, 0}};
+  }
+  return {{kernels::TILED_CONV_2D, 1, 1, 32},
+          {kernels::TILED_DEPTHWISE_CONV_2D, 3, 1, 1},
+          {kernels::TILED_CONV_2D, 1, 1, 16}};
+}
+
+// fused runs the layers as a TiledChain, otherwise as separate ops. The
+// bytes are those of the tensors each writes to and reads from memory.
+template <DeviceType D, typename T>
+void TiledChain(int iters,
+                const std::string &name,
+                int batch,
+                int channels,
+                int height,
+                int width,
+                bool fused) {
+  mace::testing::StopTiming();
+
+  const std::vector<Layer> layers = ChainLayers(name);
+  OpsTestNet net;
+  net.AddRandomInput<D, float>("Input", {batch, channels, height, width});
+  std::vector<int> types, kernel_sizes, strides, dilations, paddings;
+  std::vector<std::vector<index_t>> filter_shapes;
+  for (size_t i = 0; i < layers.size(); ++i) {
+    const Layer &layer = layers[i];
+    types.push_back(layer.type);
+    kernel_sizes.insert(kernel_sizes.end(), 2, layer.kernel);
+    strides.insert(strides.end(), 2, layer.stride);
+    dilations.insert(dilations.end(), 2, 1);
+    paddings.insert(paddings.end(), 2,
+                    layer.stride == 1 ? layer.kernel - 1 : 0);
+  }
+  const std::vector<int> activations(layers.size(), kernels::RELU);
+  const std::vector<float> max_limits(layers.size(), 0.f);
+
+  index_t in_channels = channels;
+  for (const Layer &layer : layers) {
+    if (layer.type == kernels::TILED_CONV_2D
+        || layer.type == kernels::TILED_DEPTHWISE_CONV_2D) {
+      filter_shapes.push_back(
+          {layer.channels, in_channels, layer.kernel, layer.kernel});
+      in_channels = layer.type == kernels::TILED_CONV_2D
+                    ? layer.channels : layer.channels * in_channels;
+    }
+  }
+  std::vector<kernels::TiledChainLayer> chain;
+  const index_t in_shape[4] = {batch, channels, height, width};
+  MACE_CHECK(kernels::TiledChainLayers(types, kernel_sizes, strides,
+                                       dilations, paddings, activations,
+                                       max_limits, filter_shapes, &chain)
+                 == MaceStatus::MACE_SUCCESS
+             && kernels::TiledChainShapes(in_shape, &chain)
+                 == MaceStatus::MACE_SUCCESS);
+
+  int64_t macc = 0;
+  int64_t bytes = batch * channels * height * width;
+  std::vector<std::string> weights;
+  for (size_t i = 0; i < chain.size(); ++i) {
+    const kernels::TiledChainLayer &layer = chain[i];
+    const index_t *out_shape = layer.out_shape;
+    const int64_t out_size =
+        out_shape[0] * out_shape[1] * out_shape[2] * out_shape[3];
+    const std::string input =
+        i == 0 ? std::string("Input") : MakeString("Layer", i - 1);
+    const std::string output =
+        i + 1 == chain.size() ? std::string("Output") : MakeString("Layer", i);
+    // intermediates are written then read, the output is written
+    bytes += out_size * (i + 1 == chain.size() || fused ? 1 : 2);
+    if (!fused && i + 1 < chain.size()) {
+      // the net is created before it runs, later ops need their inputs
+      net.AddRandomInput<D, float>(
+          output, std::vector<index_t>(out_shape, out_shape + 4));
+    }
+    if (layer.type == kernels::TILED_CONV_2D
+        || layer.type == kernels::TILED_DEPTHWISE_CONV_2D) {
+      const bool depthwise = layer.type == kernels::TILED_DEPTHWISE_CONV_2D;
+      const std::string filter = MakeString("Filter", i);
+      const std::string bias = MakeString("Bias", i);
+      net.AddRandomInput<D, float>(
+          filter, std::vector<index_t>(layer.filter_shape,
+                                       layer.filter_shape + 4));
+      net.AddRandomInput<D, float>(bias, {out_shape[1]});
+      weights.push_back(filter);
+      weights.push_back(bias);
+      macc += out_size * layer.kernel_hw[0] * layer.kernel_hw[1]
+          * (depthwise ? 1 : layer.filter_shape[1]);
+      if (!fused) {
+        OpDefBuilder(depthwise ? "DepthwiseConv2d" : "Conv2D",
+                     MakeString("Conv", i))
+            .Input(input)
+            .Input(filter)
+            .Input(bias)
+            .Output(output)
+            .AddIntsArg("strides", {layer.stride_hw[0], layer.stride_hw[1]})
+            .AddIntsArg("padding_values",
+                        {layer.padding_hw[0], layer.padding_hw[1]})
+            .AddIntsArg("dilations", {1, 1})
+            .AddStringArg("activation", "RELU")
+            .Finalize(net.AddNewOperatorDef());
+      }
+    } else if (!fused) {
+      // max pooling of relu outputs is relu'd already
+      OpDefBuilder("Pooling", MakeString("Pooling", i))
+          .Input(input)
+          .Output(output)
+          .AddIntsArg("kernels", {layer.kernel_hw[0], layer.kernel_hw[1]})
+          .AddIntsArg("strides", {layer.stride_hw[0], layer.stride_hw[1]})
+          .AddIntsArg("padding_values",
+                      {layer.padding_hw[0], layer.padding_hw[1]})
+          .AddIntsArg("dilations", {1, 1})
+          .AddIntArg("pooling_type", PoolingType::MAX)
+          .Finalize(net.AddNewOperatorDef());
+    }
+  }
+  if (fused) {
+    OpDefBuilder builder("TiledChain", "TiledChainTest");
+    builder.Input("Input");
+    for (const std::string &weight : weights) {
+      builder.Input(weight);
+    }
+    builder.Output("Output")
+        .AddIntsArg("layer_types", types)
+        .AddIntsArg("kernels", kernel_sizes)
+        .AddIntsArg("strides", strides)
+        .AddIntsArg("dilations", dilations)
+        .AddIntsArg("padding_values", paddings)
+        .AddIntsArg("activations", activations)
+        .AddFloatsArg("max_limits", max_limits)
+        .Finalize(net.NewOperatorDef());
+  }
+  mace::testing::MaccProcessed(macc * iters);
+  mace::testing::BytesProcessed(bytes * sizeof(T) * iters);
+
+  net.Setup(D);
+
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+    net.Sync();
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+    net.Sync();
+  }
+}
+}  // namespace
+
+#define MACE_BM_TILED_CHAIN_MACRO(NAME, N, C, H, W, FUSED, TYPE, DEVICE)      \
+  static void                                                                 \
+      MACE_BM_TILED_CHAIN_##NAME##_##N##_##C##_##H##_##W##_##FUSED##_##TYPE\
+        ##_##DEVICE(int iters) {                                              \
+    TiledChain<DEVICE, TYPE>(iters, #NAME, N, C, H, W, FUSED == 1);          \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_TILED_CHAIN_##NAME##_##N##_##C##_##H##_##W##_##FUSED##_##TYPE\
+        ##_##DEVICE)
+
+#define MACE_BM_TILED_CHAIN(NAME, N, C, H, W)                                 \
+  MACE_BM_TILED_CHAIN_MACRO(NAME, N, C, H, W, 0, float, CPU);                 \
+  MACE_BM_TILED_CHAIN_MACRO(NAME, N, C, H, W, 1, float, CPU);
+
+// 1080p
+MACE_BM_TILED_CHAIN(CONV, 1, 3, 1080, 1920);
+MACE_BM_TILED_CHAIN(INVERTED_RESIDUAL, 1, 16, 540, 960);
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
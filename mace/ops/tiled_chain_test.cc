@@ -0,0 +1,195 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+
+#include "mace/kernels/pooling.h"
+#include "mace/ops/ops_test_util.h"
+#include "mace/ops/tiled_chain.h"
+
+namespace mace {
+namespace ops {
+namespace test {
+
+class TiledChainOpTest : public OpsTestBase {};
+
+namespace {
+struct Layer {
+  kernels::TiledChainLayerType type;
+  int kernel;
+  int stride;
+  int dilation;
+  int padding;  // total
+  index_t channels;  // out channels of conv, multiplier of depthwise
+  const char *activation;
+};
+
+// Compare the chain with its layers run as separate ops, then the kernel
+// with tiles smaller than the output.
+void TestTiledChain(const std::vector<index_t> &input_shape,  // NCHW
+                    const std::vector<Layer> &layers) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", input_shape);
+
+  std::vector<int> types, kernel_sizes, strides, dilations, paddings;
+  std::vector<int> activations;
+  std::vector<float> max_limits;
+  std::vector<std::string> weights;
+  std::string input = "Input";
+  index_t channels = input_shape[1];
+  for (size_t i = 0; i < layers.size(); ++i) {
+    const Layer &layer = layers[i];
+    const std::string output = MakeString("Layer", i);
+    const std::string filter = MakeString("Filter", i);
+    const std::string bias = MakeString("Bias", i);
+    if (layer.type == kernels::TILED_CONV_2D
+        || layer.type == kernels::TILED_DEPTHWISE_CONV_2D) {
+      const bool depthwise = layer.type == kernels::TILED_DEPTHWISE_CONV_2D;
+      const index_t out_channels =
+          depthwise ? layer.channels * channels : layer.channels;
+      net.AddRandomInput<DeviceType::CPU, float>(
+          filter, {layer.channels, channels, layer.kernel, layer.kernel});
+      net.AddRandomInput<DeviceType::CPU, float>(bias, {out_channels});
+      OpDefBuilder(depthwise ? "DepthwiseConv2d" : "Conv2D",
+                   MakeString("Conv", i))
+          .Input(input)
+          .Input(filter)
+          .Input(bias)
+          .Output(output)
+          .AddIntsArg("strides", {layer.stride, layer.stride})
+          .AddIntsArg("padding_values", {layer.padding, layer.padding})
+          .AddIntsArg("dilations", {layer.dilation, layer.dilation})
+          .AddStringArg("activation", layer.activation)
+          .AddFloatArg("max_limit", 1.5f)
+          .Finalize(net.AddNewOperatorDef());
+      weights.push_back(filter);
+      weights.push_back(bias);
+      channels = out_channels;
+    } else {
+      // the activation of a pooling layer is a separate op
+      const bool activated = std::string(layer.activation) != "NOOP";
+      OpDefBuilder("Pooling", MakeString("Pooling", i))
+          .Input(input)
+          .Output(activated ? output + "Pooling" : output)
+          .AddIntsArg("kernels", {layer.kernel, layer.kernel})
+          .AddIntsArg("strides", {layer.stride, layer.stride})
+          .AddIntsArg("padding_values", {layer.padding, layer.padding})
+          .AddIntsArg("dilations", {layer.dilation, layer.dilation})
+          .AddIntArg("pooling_type",
+                     layer.type == kernels::TILED_MAX_POOLING
+                     ? PoolingType::MAX : PoolingType::AVG)
+          .Finalize(net.AddNewOperatorDef());
+      if (activated) {
+        OpDefBuilder("Activation", MakeString("Activation", i))
+            .Input(output + "Pooling")
+            .Output(output)
+            .AddStringArg("activation", layer.activation)
+            .AddFloatArg("max_limit", 1.5f)
+            .Finalize(net.AddNewOperatorDef());
+      }
+    }
+    input = output;
+    types.push_back(layer.type);
+    kernel_sizes.insert(kernel_sizes.end(), 2, layer.kernel);
+    strides.insert(strides.end(), 2, layer.stride);
+    dilations.insert(dilations.end(), 2, layer.dilation);
+    paddings.insert(paddings.end(), 2, layer.padding);
+    activations.push_back(kernels::StringToActivationType(layer.activation));
+    max_limits.push_back(1.5f);
+  }
+  net.RunOp(DeviceType::CPU);
+
+  OpDefBuilder builder("TiledChain", "TiledChainTest");
+  builder.Input("Input");
+  for (const std::string &weight : weights) {
+    builder.Input(weight);
+  }
+  builder.Output("Output")
+      .AddIntsArg("layer_types", types)
+      .AddIntsArg("kernels", kernel_sizes)
+      .AddIntsArg("strides", strides)
+      .AddIntsArg("dilations", dilations)
+      .AddIntsArg("padding_values", paddings)
+      .AddIntsArg("activations", activations)
+      .AddFloatsArg("max_limits", max_limits)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+  const Tensor *expected = net.GetOutput(input.c_str());
+  ExpectTensorNear<float>(*expected, *net.GetOutput("Output"), 1e-4, 1e-4);
+
+  // tiles of a row or column, odd and one output
+  std::vector<std::vector<index_t>> filter_shapes;
+  for (size_t i = 0; i < weights.size(); i += 2) {
+    filter_shapes.push_back(net.GetTensor(weights[i].c_str())->shape());
+  }
+  std::vector<kernels::TiledChainLayer> chain;
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+            kernels::TiledChainLayers(types, kernel_sizes, strides, dilations,
+                                      paddings, activations, max_limits,
+                                      filter_shapes, &chain));
+  for (size_t i = 0, w = 0; i < chain.size(); ++i) {
+    if (chain[i].type == kernels::TILED_CONV_2D
+        || chain[i].type == kernels::TILED_DEPTHWISE_CONV_2D) {
+      chain[i].filter = net.GetTensor(weights[w].c_str())->data<float>();
+      chain[i].bias = net.GetTensor(weights[w + 1].c_str())->data<float>();
+      w += 2;
+    }
+  }
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+            kernels::TiledChainShapes(input_shape.data(), &chain));
+  const index_t *out_shape = chain.back().out_shape;
+  for (const std::vector<index_t> &tile : std::vector<std::vector<index_t>>{
+           {1, out_shape[3]}, {out_shape[2], 16}, {3, 5}, {1, 1}}) {
+    std::vector<float> buffer(
+        kernels::TiledChainBufferSize(chain, tile.data()));
+    Tensor output;
+    output.Resize(expected->shape());
+    kernels::TiledChain(net.GetTensor("Input")->data<float>(), chain,
+                        tile.data(), buffer.data(),
+                        output.mutable_data<float>());
+    ExpectTensorNear<float>(*expected, output, 1e-4, 1e-4);
+  }
+}
+}  // namespace
+
+TEST_F(TiledChainOpTest, CPUConvChain) {
+  TestTiledChain({1, 3, 37, 41},
+                 {{kernels::TILED_CONV_2D, 3, 1, 1, 2, 8, "RELU"},
+                  {kernels::TILED_CONV_2D, 3, 1, 1, 2, 8, "RELUX"},
+                  {kernels::TILED_MAX_POOLING, 2, 2, 1, 0, 0, "NOOP"}});
+  TestTiledChain({2, 5, 30, 29},
+                 {{kernels::TILED_CONV_2D, 5, 2, 1, 4, 7, "NOOP"},
+                  {kernels::TILED_CONV_2D, 1, 1, 1, 0, 6, "SIGMOID"}});
+}
+
+TEST_F(TiledChainOpTest, CPUDepthwiseChain) {
+  TestTiledChain({1, 8, 33, 27},
+                 {{kernels::TILED_DEPTHWISE_CONV_2D, 3, 1, 1, 2, 1, "RELU"},
+                  {kernels::TILED_CONV_2D, 1, 1, 1, 0, 12, "RELU"},
+                  {kernels::TILED_DEPTHWISE_CONV_2D, 5, 2, 1, 4, 2, "NOOP"},
+                  {kernels::TILED_AVG_POOLING, 3, 1, 1, 2, 0, "TANH"}});
+}
+
+TEST_F(TiledChainOpTest, CPUStridesAndDilations) {
+  TestTiledChain({1, 4, 45, 38},
+                 {{kernels::TILED_CONV_2D, 3, 2, 1, 1, 8, "RELU"},
+                  {kernels::TILED_CONV_2D, 3, 1, 2, 4, 8, "RELU"},
+                  {kernels::TILED_MAX_POOLING, 3, 2, 1, 1, 0, "NOOP"},
+                  {kernels::TILED_CONV_2D, 7, 1, 1, 6, 5, "NOOP"}});
+}
+
+}  // namespace test
+}  // namespace ops
+}  // namespace mace
@@ -49,6 +49,12 @@ struct OperatorStats {
   std::vector<std::vector<int64_t>> output_shape;
   ConvPoolArgs args;
   CallStats stats;
+  // Bytes of activations that are alive while the operator runs,
+  // including its inputs and outputs.
+  int64_t live_activation_bytes;
+  // Kernels the operator ran, such as the convolution algorithm picked by
+  // shape or by the cpu tuner; empty if it has only one.
+  std::string algorithm;
 };
 
 class RunMetadata {
@@ -56,6 +62,26 @@ class RunMetadata {
   std::vector<OperatorStats> op_stats;
 };
 
+struct MemoryUsage {
+  int64_t current_bytes;
+  int64_t peak_bytes;
+};
+
+// Memory held by an engine, broken down by usage.
+struct MemoryStats {
+  // Model weights loaded from model data.
+  MemoryUsage model_weights;
+  // Tensors computed from model weights and kept across runs,
+  // e.g. transformed filters or weight images.
+  MemoryUsage derived_tensors;
+  // Activation arena and other operator outputs.
+  MemoryUsage activations;
+  // Temporary buffers shared by operators within one run.
+  MemoryUsage scratch;
+  // OpenCL images, which are not counted in the categories above.
+  MemoryUsage opencl_images;
+};
+
 const char *MaceVersion();
 
 enum MaceStatus {
@@ -107,6 +133,15 @@ class MaceEngine {
                   const std::vector<std::string> &output_nodes,
                   const unsigned char *model_data);
 
+  // input_shapes - shapes of inputs in the order of input_nodes, which are
+  //                used to infer the shapes of all tensors and preallocate
+  //                them at initialization, only on CPU for now
+  MaceStatus Init(const NetDef *net_def,
+                  const std::vector<std::string> &input_nodes,
+                  const std::vector<std::string> &output_nodes,
+                  const unsigned char *model_data,
+                  const std::vector<std::vector<int64_t>> &input_shapes);
+
   MaceStatus Run(const std::map<std::string, MaceTensor> &inputs,
                  std::map<std::string, MaceTensor> *outputs);
 
@@ -114,6 +149,26 @@ class MaceEngine {
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata);
 
+  // Run a fully convolutional model on an input larger than the input shape
+  // it was converted for, in tiles of at most that shape so the activations
+  // are bounded by the memory of a tile. The tiles overlap by the receptive
+  // field of the outputs, which are stitched to equal those of running the
+  // whole input at once. Only on CPU with a single input for now.
+  MaceStatus RunTiled(const std::map<std::string, MaceTensor> &inputs,
+                      std::map<std::string, MaceTensor> *outputs);
+
+  // Report current and peak memory usage of this engine.
+  MaceStatus GetMemoryStats(MemoryStats *stats) const;
+
+  // Release activations, scratch buffers and caches derived from weights
+  // while the engine is idle, model weights and outputs of init net are
+  // kept. The memory is allocated again by the next Run.
+  MaceStatus Trim();
+
+  // Allocate the memory arena released by Trim ahead of the next Run. It is
+  // safe to be called from a background thread.
+  MaceStatus Prewarm();
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
@@ -113,6 +113,9 @@ def main(unused_args):
         else:
             option = cvt.ConverterOption()
         option.winograd = FLAGS.winograd
+        option.cpu_blocked_layout = FLAGS.cpu_blocked_layout
+        option.cpu_tiled_chain = FLAGS.cpu_tiled_chain
+        option.cpu_data_format = FLAGS.cpu_data_format
 
         input_node_names = FLAGS.input_node.split(',')
         input_node_shapes = FLAGS.input_shape.split(':')
@@ -264,6 +267,24 @@ def parse_args():
         type=int,
         default=0,
         help="Which version of winograd convolution to use. [2 | 4]")
+    parser.add_argument(
+        "--cpu_blocked_layout",
+        type=str2bool,
+        default=False,
+        help="Run CPU convolution chains in the blocked NCHWc layout.")
+    parser.add_argument(
+        "--cpu_tiled_chain",
+        type=str2bool,
+        default=False,
+        help="Run CPU convolution chains on large feature maps in tiles "
+             "that keep their intermediate tensors in cache.")
+    parser.add_argument(
+        "--cpu_data_format",
+        type=str,
+        default="NCHW",
+        choices=["NCHW", "NHWC", "auto"],
+        help="Data format of CPU models, auto picks NHWC for models made "
+             "of pointwise and depthwise convolutions.")
     parser.add_argument(
         "--dsp_mode", type=int, default=0, help="dsp run mode, defalut=0")
     parser.add_argument(
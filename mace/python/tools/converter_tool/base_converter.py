@@ -27,6 +27,7 @@ class DeviceType(Enum):
 class DataFormat(Enum):
     NHWC = 0
     NCHW = 1
+    NCHWc = 5
 
 
 class FilterFormat(Enum):
@@ -96,9 +97,11 @@ MaceSupportedOps = [
     'Proposal',
     'Quantize',
     'ReduceMean',
+    'Reorder',
     'Requantize',
     'Reshape',
     'ResizeBilinear',
+    'SeparableConv2d',
     'Slice',
     'Shape',
     'Squeeze',
@@ -107,6 +110,7 @@ MaceSupportedOps = [
     'Softmax',
     'SpaceToBatchND',
     'SpaceToDepth',
+    'TiledChain',
     'Transpose',
     'WinogradInverseTransform',
     'WinogradTransform',
@@ -128,14 +132,18 @@ class MaceKeyword(object):
     mace_padding_values_str = 'padding_values'
     mace_strides_str = 'strides'
     mace_dilations_str = 'dilations'
+    mace_group_str = 'group'
     mace_pooling_type_str = 'pooling_type'
     mace_global_pooling_str = 'global_pooling'
     mace_kernel_str = 'kernels'
     mace_data_format_str = 'data_format'
     mace_filter_format_str = 'filter_format'
     mace_element_type_str = 'type'
+    mace_coeff_str = 'coeff'
     mace_activation_type_str = 'activation'
     mace_activation_max_limit_str = 'max_limit'
+    mace_depthwise_activation_type_str = 'depthwise_activation'
+    mace_depthwise_activation_max_limit_str = 'depthwise_max_limit'
     mace_resize_size_str = 'size'
     mace_batch_to_space_crops_str = 'crops'
     mace_paddings_str = 'paddings'
@@ -185,6 +193,10 @@ class TransformerRule(Enum):
     ADD_IN_OUT_TENSOR_INFO = 20
     ADD_MACE_INPUT_AND_OUTPUT_NODES = 21
     UPDATE_FLOAT_OP_DATA_TYPE = 22
+    TRANSFORM_CPU_BLOCKED_LAYOUT = 23
+    FOLD_SEPARABLE_CONV = 24
+    FOLD_RESIDUAL_ADD = 25
+    FUSE_CPU_TILED_CHAIN = 26
 
 
 class ConverterInterface(object):
@@ -230,6 +242,9 @@ class ConverterOption(object):
         self._data_type = mace_pb2.DT_FLOAT
         self._device = DeviceType.CPU.value
         self._winograd = 0
+        self._cpu_blocked_layout = False
+        self._cpu_tiled_chain = False
+        self._cpu_data_format = 'NCHW'
         if transformers:
             self._transformer_option = [TransformerRule[transformer]
                                         for transformer in transformers]
@@ -246,12 +261,16 @@ class ConverterOption(object):
                 TransformerRule.TRANSFORM_ADD_TO_BIASADD,
                 TransformerRule.FOLD_BIASADD,
                 TransformerRule.FLATTEN_ATROUS_CONV,
+                TransformerRule.FOLD_RESIDUAL_ADD,
                 TransformerRule.FOLD_ACTIVATION,
                 TransformerRule.TRANSPOSE_FILTERS,
                 TransformerRule.TRANSPOSE_DATA_FORMAT,
                 TransformerRule.ADD_IN_OUT_TENSOR_INFO,
                 TransformerRule.TRANSFORM_GLOBAL_CONV_TO_FC,
                 TransformerRule.RESHAPE_FC_WEIGHT,
+                TransformerRule.TRANSFORM_CPU_BLOCKED_LAYOUT,
+                TransformerRule.FUSE_CPU_TILED_CHAIN,
+                TransformerRule.FOLD_SEPARABLE_CONV,
                 TransformerRule.TRANSFORM_BUFFER_IMAGE,
                 TransformerRule.ADD_DEVICE,
                 TransformerRule.UPDATE_FLOAT_OP_DATA_TYPE,
@@ -279,6 +298,18 @@ class ConverterOption(object):
     def winograd(self):
         return self._winograd
 
+    @property
+    def cpu_blocked_layout(self):
+        return self._cpu_blocked_layout
+
+    @property
+    def cpu_tiled_chain(self):
+        return self._cpu_tiled_chain
+
+    @property
+    def cpu_data_format(self):
+        return self._cpu_data_format
+
     @property
     def transformer_option(self):
         return self._transformer_option
@@ -311,6 +342,18 @@ class ConverterOption(object):
     def winograd(self, winograd):
         self._winograd = winograd
 
+    @cpu_blocked_layout.setter
+    def cpu_blocked_layout(self, cpu_blocked_layout):
+        self._cpu_blocked_layout = cpu_blocked_layout
+
+    @cpu_tiled_chain.setter
+    def cpu_tiled_chain(self, cpu_tiled_chain):
+        self._cpu_tiled_chain = cpu_tiled_chain
+
+    @cpu_data_format.setter
+    def cpu_data_format(self, cpu_data_format):
+        self._cpu_data_format = cpu_data_format
+
     def disable_transpose_filters(self):
         if TransformerRule.TRANSPOSE_FILTERS in self._transformer_option:
             self._transformer_option.remove(TransformerRule.TRANSPOSE_FILTERS)
@@ -343,6 +386,8 @@ class ConverterUtil(object):
             return DataFormat.NHWC
         elif arg.i == DataFormat.NCHW.value:
             return DataFormat.NCHW
+        elif arg.i == DataFormat.NCHWc.value:
+            return DataFormat.NCHWc
         else:
             return None
 
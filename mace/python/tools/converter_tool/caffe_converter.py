@@ -353,21 +353,24 @@ class CaffeConverter(base_converter.ConverterInterface):
         op = self.convert_general_op(caffe_op)
         param = caffe_op.layer.convolution_param
         is_depthwise = False
-        if param.HasField(caffe_group_str):
+        group = param.group if param.HasField(caffe_group_str) else 1
+        if group > 1:
             filter_data = caffe_op.blobs[0]
-            mace_check(param.group == filter_data.shape[0] and
-                       filter_data.shape[1] == 1,
-                       "Mace do not support group convolution yet")
-            is_depthwise = True
-            caffe_op.blobs[0] = filter_data.reshape(1,
-                                                    filter_data.shape[0],
-                                                    filter_data.shape[2],
-                                                    filter_data.shape[3])
+            if group == filter_data.shape[0] and filter_data.shape[1] == 1:
+                is_depthwise = True
+                caffe_op.blobs[0] = filter_data.reshape(1,
+                                                        filter_data.shape[0],
+                                                        filter_data.shape[2],
+                                                        filter_data.shape[3])
 
         if is_depthwise:
             op.type = MaceOp.DepthwiseConv2d.name
         else:
             op.type = MaceOp.Conv2D.name
+            if group > 1:
+                group_arg = op.arg.add()
+                group_arg.name = MaceKeyword.mace_group_str
+                group_arg.i = group
 
         self.add_stride_pad_kernel_arg(param, op)
         # dilation is specific for convolution in caffe
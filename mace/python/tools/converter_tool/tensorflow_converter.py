@@ -336,6 +336,18 @@ class TensorflowConverter(base_converter.ConverterInterface):
             op.type = MaceOp.Deconv2D.name
         else:
             op.type = MaceOp.Conv2D.name
+            # a filter of fewer input channels than the input is grouped
+            in_channels = self.infer_tensor_shape(tf_op.inputs[0])[3]
+            filter_channels = self.infer_tensor_shape(tf_op.inputs[1])[2]
+            if in_channels > 0 and filter_channels > 0 \
+                    and in_channels != filter_channels:
+                mace_check(in_channels % filter_channels == 0,
+                           "%s: input channels %d are not a multiple of "
+                           "filter channels %d"
+                           % (tf_op.name, in_channels, filter_channels))
+                group_arg = op.arg.add()
+                group_arg.name = MaceKeyword.mace_group_str
+                group_arg.i = in_channels // filter_channels
 
         padding_arg = op.arg.add()
         padding_arg.name = MaceKeyword.mace_padding_str
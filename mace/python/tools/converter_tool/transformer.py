@@ -27,6 +27,7 @@ from mace.python.tools.converter_tool.base_converter import FilterFormat
 from mace.python.tools.converter_tool.base_converter import MaceKeyword
 from mace.python.tools.converter_tool.base_converter import MaceOp
 from mace.python.tools.converter_tool.base_converter import PaddingMode
+from mace.python.tools.converter_tool.base_converter import PoolingType
 from mace.python.tools.converter_tool.base_converter import TransformerRule
 from mace.python.tools.convert_util import mace_check
 
@@ -72,6 +73,7 @@ class Transformer(base_converter.ConverterInterface):
                 self.transform_add_to_biasadd,
             TransformerRule.FOLD_BIASADD: self.fold_biasadd,
             TransformerRule.FLATTEN_ATROUS_CONV: self.flatten_atrous_conv,
+            TransformerRule.FOLD_RESIDUAL_ADD: self.fold_residual_add,
             TransformerRule.FOLD_ACTIVATION: self.fold_activation,
             TransformerRule.TRANSPOSE_FILTERS: self.transpose_filters,
             TransformerRule.TRANSPOSE_DATA_FORMAT: self.transpose_data_format,
@@ -80,6 +82,10 @@ class Transformer(base_converter.ConverterInterface):
             TransformerRule.TRANSFORM_GLOBAL_CONV_TO_FC:
                 self.transform_global_conv_to_fc,
             TransformerRule.RESHAPE_FC_WEIGHT: self.reshape_fc_weight,
+            TransformerRule.TRANSFORM_CPU_BLOCKED_LAYOUT:
+                self.transform_cpu_blocked_layout,
+            TransformerRule.FUSE_CPU_TILED_CHAIN: self.fuse_cpu_tiled_chain,
+            TransformerRule.FOLD_SEPARABLE_CONV: self.fold_separable_conv,
             TransformerRule.TRANSFORM_BUFFER_IMAGE:
                 self.transform_buffer_image,
             TransformerRule.ADD_DEVICE:
@@ -444,10 +450,15 @@ class Transformer(base_converter.ConverterInterface):
             mace_check(False, "filter format %s not supported" % filter_format)
         return filter_height, filter_width, in_channels, out_channels
 
+    @staticmethod
+    def is_grouped_conv(op):
+        group_arg = ConverterUtil.get_arg(op, MaceKeyword.mace_group_str)
+        return group_arg is not None and group_arg.i > 1
+
     def check_if_gpu_use_winograd_conv(self, op):
         if not self._option.winograd:
             return False
-        if op.type != MaceOp.Conv2D.name:
+        if op.type != MaceOp.Conv2D.name or self.is_grouped_conv(op):
             return False
 
         filter_shape = self._consts[op.input[1]].dims
@@ -618,7 +629,11 @@ class Transformer(base_converter.ConverterInterface):
         return False
 
     def flatten_atrous_conv(self):
-        if self._option.device != DeviceType.GPU.value:
+        """Fold SpaceToBatchND, conv and BatchToSpaceND back into one
+        dilated conv, the GPU and CPU kernels take the dilation directly
+        instead of reshuffling the whole tensor twice."""
+        if self._option.device not in [DeviceType.GPU.value,
+                                       DeviceType.CPU.value]:
             return
 
         net = self._model
@@ -676,6 +691,65 @@ class Transformer(base_converter.ConverterInterface):
                         return True
         return False
 
+    def residual_conv_supported(self, op):
+        if op.type != MaceOp.Conv2D.name \
+                or len(op.input) > 3 \
+                or self.consumer_count(op.output[0]) != 1 \
+                or op.output[0] in self._option.output_nodes \
+                or ConverterUtil.get_arg(
+                    op, MaceKeyword.mace_winograd_filter_transformed) \
+                is not None:
+            return False
+        # the activation has to follow the residual add
+        activation_arg = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_activation_type_str)
+        return activation_arg is None \
+            or activation_arg.s == ActivationType.NOOP.name
+
+    def fold_residual_add(self):
+        """Fold an Eltwise sum of a CPU convolution and another feature map
+        of its shape into the convolution, which adds the residual to the
+        output tiles while they are in cache. It runs before FOLD_ACTIVATION
+        so the activation after the sum is folded as well."""
+        if self._option.device != DeviceType.CPU.value:
+            return False
+
+        net = self._model
+        for op in net.op:
+            type_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_element_type_str)
+            if op.type != MaceOp.Eltwise.name \
+                    or len(op.input) != 2 \
+                    or op.input[0] == op.input[1] \
+                    or type_arg is None \
+                    or type_arg.i != EltwiseType.SUM.value \
+                    or ConverterUtil.get_arg(
+                        op, MaceKeyword.mace_coeff_str) is not None \
+                    or op.input[0] not in self._producer \
+                    or op.input[1] not in self._producer:
+                continue
+            for i in xrange(2):
+                conv_op = self._producer[op.input[i]]
+                residual = op.input[1 - i]
+                conv_shape = self.get_tensor_shape(conv_op.output[0])
+                if not self.residual_conv_supported(conv_op) \
+                        or conv_shape != self.get_tensor_shape(residual):
+                    continue
+                print("Fold residual add: %s(%s)"
+                      % (conv_op.name, conv_op.type))
+                if len(conv_op.input) == 2:
+                    _, _, _, channels = self.sort_feature_map_shape(
+                        conv_shape, ConverterUtil.data_format(conv_op))
+                    conv_op.input.append(self.add_zero_bias(
+                        conv_op.input[1] + '_residual_bias', channels))
+                conv_op.input.append(residual)
+                conv_op.name = op.name
+                conv_op.output[0] = op.output[0]
+                self.safe_remove_node(op, conv_op)
+                return True
+
+        return False
+
     def fold_activation(self):
         net = self._model
         for op in net.op:
@@ -704,9 +778,84 @@ class Transformer(base_converter.ConverterInterface):
 
         return False
 
+    cpu_nhwc_ops = [MaceOp.Activation.name,
+                    MaceOp.BiasAdd.name,
+                    MaceOp.Concat.name,
+                    MaceOp.Conv2D.name,
+                    MaceOp.DepthwiseConv2d.name,
+                    MaceOp.Eltwise.name,
+                    MaceOp.Identity.name,
+                    MaceOp.Pooling.name,
+                    MaceOp.Reshape.name,
+                    MaceOp.ResizeBilinear.name,
+                    MaceOp.Softmax.name,
+                    MaceOp.Squeeze.name]
+
+    def cpu_nhwc_supported(self, op):
+        if op.type not in self.cpu_nhwc_ops \
+                or ConverterUtil.data_format(op) == DataFormat.NCHW:
+            return False
+        if op.type == MaceOp.Conv2D.name:
+            # the residual add is only folded into NCHW convolutions, which
+            # are the only grouped ones too
+            return len(op.input) <= 3 and not self.is_grouped_conv(op)
+        if op.type == MaceOp.Activation.name:
+            # prelu alpha is indexed by the NCHW channel
+            activation_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_activation_type_str)
+            return activation_arg is None \
+                or activation_arg.s != ActivationType.PRELU.name
+        return True
+
+    def cpu_data_format(self):
+        """NHWC if every op of the model has an NHWC CPU kernel, for 'auto'
+        only if pointwise and depthwise convolutions do most of the work,
+        the direct NCHW kernels are faster on the other shapes."""
+        option = self._option.cpu_data_format
+        if option == 'NCHW':
+            return DataFormat.NCHW
+        unsupported = [op for op in self._model.op
+                       if not self.cpu_nhwc_supported(op)]
+        if option == 'NHWC':
+            mace_check(not unsupported,
+                       "ops have no NHWC CPU kernel: %s"
+                       % ', '.join(['%s(%s)' % (op.name, op.type)
+                                    for op in unsupported]))
+            return DataFormat.NHWC
+        if unsupported:
+            return DataFormat.NCHW
+
+        pointwise_macs = 0
+        total_macs = 0
+        for op in self._model.op:
+            if op.type not in [MaceOp.Conv2D.name,
+                               MaceOp.DepthwiseConv2d.name]:
+                continue
+            filter = self._consts.get(op.input[1], None)
+            if filter is None:
+                return DataFormat.NCHW
+            filter_height, filter_width, in_channels, out_channels = \
+                self.sort_filter_shape(filter.dims, self.filter_format())
+            output_dims = op.output_shape[0].dims
+            macs = output_dims[0] * output_dims[1] * output_dims[2] \
+                * output_dims[3] * filter_height * filter_width
+            if op.type == MaceOp.Conv2D.name:
+                macs *= in_channels
+            total_macs += macs
+            if op.type == MaceOp.DepthwiseConv2d.name \
+                    or filter_height * filter_width == 1:
+                pointwise_macs += macs
+        if total_macs > 0 and pointwise_macs * 2 >= total_macs:
+            return DataFormat.NHWC
+        return DataFormat.NCHW
+
     def transpose_data_format(self):
         net = self._model
 
+        if self._option.device == DeviceType.CPU.value:
+            self._target_data_format = self.cpu_data_format()
+            print("CPU data format: %s" % self._target_data_format.name)
+
         for op in net.op:
             # transpose args
             if op.type == MaceOp.Pad.name:
@@ -923,6 +1072,441 @@ class Transformer(base_converter.ConverterInterface):
 
         return False
 
+    cpu_channel_block = 8
+
+    def cpu_blocked_inputs(self, op):
+        """Input indices of the feature maps the op reads, or None if the op
+        has no NCHWc kernel for its shapes."""
+        block = self.cpu_channel_block
+        if len(op.output_shape) != 1 \
+                or len(op.output_shape[0].dims) != 4 \
+                or op.output_shape[0].dims[1] % block != 0:
+            return None
+        if op.input[0] not in self._producer:
+            return None
+        if op.type == MaceOp.Conv2D.name:
+            filter = self._consts.get(op.input[1], None)
+            if filter is None or filter.dims[1] % block != 0 \
+                    or len(op.input) > 3 \
+                    or self.is_grouped_conv(op) \
+                    or ConverterUtil.get_arg(
+                        op, MaceKeyword.mace_winograd_filter_transformed) \
+                    is not None:
+                return None
+            return [0]
+        elif op.type == MaceOp.DepthwiseConv2d.name:
+            filter = self._consts.get(op.input[1], None)
+            if filter is None or filter.dims[0] != 1:
+                return None
+            return [0]
+        elif op.type in [MaceOp.Pooling.name, MaceOp.Activation.name,
+                         MaceOp.BiasAdd.name]:
+            return [0]
+        elif op.type == MaceOp.Eltwise.name:
+            # channel broadcast has no blocked kernel
+            output_dims = list(op.output_shape[0].dims)
+            for input_tensor in op.input:
+                if input_tensor in self._consts \
+                        or input_tensor not in self._producer \
+                        or self.get_tensor_shape(input_tensor) \
+                        != output_dims:
+                    return None
+            return range(len(op.input))
+        return None
+
+    def add_reorder(self, input_name, output_name, data_format, output_dims):
+        op = self._model.op.add()
+        op.name = self.normalize_op_name(output_name) + '_reorder'
+        op.type = MaceOp.Reorder.name
+        op.input.extend([input_name])
+        op.output.extend([output_name])
+        op.output_shape.add().dims.extend(output_dims)
+        ConverterUtil.add_data_format_arg(op, data_format)
+
+    def transform_cpu_blocked_layout(self):
+        """Run chains of CPU conv, depthwise conv, pooling and element-wise
+        ops in the blocked NCHWc layout, with reorders only where a chain
+        meets the rest of the graph."""
+        if self._option.device != DeviceType.CPU.value \
+                or not self._option.cpu_blocked_layout \
+                or self._target_data_format != DataFormat.NCHW:
+            return False
+
+        print("Transform CPU ops to NCHWc layout")
+        net = self._model
+        block = self.cpu_channel_block
+
+        candidates = {}
+        for op in net.op:
+            inputs = self.cpu_blocked_inputs(op)
+            if inputs is not None:
+                candidates[op.name] = inputs
+
+        # group connected candidates, a chain without any convolution would
+        # spend more on reorders than it saves
+        group = {name: name for name in candidates}
+
+        def find(name):
+            while group[name] != name:
+                name = group[name]
+            return name
+
+        for op in net.op:
+            for i in candidates.get(op.name, []):
+                producer = self._producer.get(op.input[i], None)
+                if producer is not None and producer.name in candidates:
+                    group[find(op.name)] = find(producer.name)
+        conv_groups = set([find(op.name) for op in net.op
+                           if op.name in candidates
+                           and op.type in [MaceOp.Conv2D.name,
+                                           MaceOp.DepthwiseConv2d.name]])
+        blocked_ops = [op for op in net.op if op.name in candidates
+                       and find(op.name) in conv_groups]
+        blocked_names = set([op.name for op in blocked_ops])
+        if not blocked_ops:
+            return False
+
+        reordered = {}
+        for op in blocked_ops:
+            for i in candidates[op.name]:
+                tensor = op.input[i]
+                producer = self._producer[tensor]
+                if producer.name in blocked_names:
+                    continue
+                if tensor not in reordered:
+                    dims = self.get_tensor_shape(tensor)
+                    reordered[tensor] = tensor + '_nchwc'
+                    self.add_reorder(tensor, reordered[tensor],
+                                     DataFormat.NCHWc,
+                                     [dims[0], dims[1] // block,
+                                      dims[2], dims[3], block])
+                op.input[i] = reordered[tensor]
+
+        for op in blocked_ops:
+            output = op.output[0]
+            blocked_output = output + '_nchwc'
+            op.output[0] = blocked_output
+            need_nchw = output in self._option.output_nodes
+            for consumer in self._consumers.get(output, []):
+                if consumer.name in blocked_names:
+                    self.replace(consumer.input, output, blocked_output)
+                else:
+                    need_nchw = True
+            dims = list(op.output_shape[0].dims)
+            if need_nchw:
+                self.add_reorder(blocked_output, output, DataFormat.NCHW,
+                                 dims)
+            op.output_shape[0].dims[:] = [dims[0], dims[1] // block,
+                                          dims[2], dims[3], block]
+            data_format_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_data_format_str)
+            if data_format_arg is None:
+                ConverterUtil.add_data_format_arg(op, DataFormat.NCHWc)
+            else:
+                data_format_arg.i = DataFormat.NCHWc.value
+            print("NCHWc: %s(%s)" % (op.name, op.type))
+
+        return False
+
+    # layer types of the TiledChain op
+    tiled_chain_layer_types = {MaceOp.Conv2D.name: 0,
+                               MaceOp.DepthwiseConv2d.name: 1,
+                               PoolingType.MAX.value: 2,
+                               PoolingType.AVG.value: 3}
+    tiled_chain_max_layers = 8
+    # chains whose intermediates fit in the caches anyway gain nothing
+    tiled_chain_min_bytes = 1024 * 1024
+
+    def tiled_chain_layer(self, op):
+        """The TiledChain layer of an NCHW CPU op as a dict of its args, or
+        None if the op cannot be chained."""
+        if op.type not in [MaceOp.Conv2D.name, MaceOp.DepthwiseConv2d.name,
+                           MaceOp.Pooling.name] \
+                or ConverterUtil.data_format(op) != DataFormat.NCHW \
+                or len(op.output_shape) != 1 \
+                or op.input[0] not in self._producer:
+            return None
+        layer = {}
+        if op.type == MaceOp.Pooling.name:
+            pooling_type = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_pooling_type_str).i
+            layer['type'] = self.tiled_chain_layer_types[pooling_type]
+            layer['kernels'] = list(ConverterUtil.get_arg(
+                op, MaceKeyword.mace_kernel_str).ints)
+        else:
+            if len(op.input) > 3 \
+                    or op.input[1] not in self._consts \
+                    or (len(op.input) > 2
+                        and op.input[2] not in self._consts) \
+                    or self.is_grouped_conv(op) \
+                    or ConverterUtil.get_arg(
+                        op, MaceKeyword.mace_winograd_filter_transformed) \
+                    is not None:
+                return None
+            filter = self._consts[op.input[1]]
+            layer['type'] = self.tiled_chain_layer_types[op.type]
+            layer['kernels'] = list(filter.dims[2:])
+        strides_arg = ConverterUtil.get_arg(op, MaceKeyword.mace_strides_str)
+        dilations_arg = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_dilations_str)
+        layer['strides'] = [1, 1] if strides_arg is None \
+            else list(strides_arg.ints)
+        layer['dilations'] = [1, 1] if dilations_arg is None \
+            else list(dilations_arg.ints)
+        if op.type == MaceOp.DepthwiseConv2d.name \
+                and (layer['kernels'][0] != layer['kernels'][1]
+                     or layer['kernels'][0] not in [3, 5, 7]
+                     or layer['strides'] not in [[1, 1], [2, 2]]):
+            return None
+        activation_arg = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_activation_type_str)
+        max_limit_arg = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_activation_max_limit_str)
+        layer['activation'] = ActivationType.NOOP.value \
+            if activation_arg is None \
+            else ActivationType[activation_arg.s].value
+        layer['max_limit'] = 0.0 if max_limit_arg is None \
+            else max_limit_arg.f
+        if layer['activation'] == ActivationType.PRELU.value:
+            return None
+
+        # total paddings, with the rounding of the op on explicit paddings;
+        # ops whose output shape that does not reproduce are not chained
+        in_shape = self.get_tensor_shape(op.input[0])
+        out_shape = list(op.output_shape[0].dims)
+        padding_values_arg = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_padding_values_str)
+        layer['padding_values'] = []
+        for i in xrange(2):
+            stride = layer['strides'][i]
+            window = (layer['kernels'][i] - 1) * layer['dilations'][i] + 1
+            if padding_values_arg is not None:
+                padding = padding_values_arg.ints[i]
+            else:
+                padding = max(0, (out_shape[2 + i] - 1) * stride + window
+                              - in_shape[2 + i])
+            size = in_shape[2 + i] + padding - window
+            if op.type == MaceOp.Pooling.name:
+                size = (size + stride - 1) // stride + 1
+            else:
+                size = size // stride + 1
+            if size != out_shape[2 + i]:
+                return None
+            layer['padding_values'].append(padding)
+        return layer
+
+    def tiled_chain(self, op):
+        """The ops and layers of the longest chain starting at op, standalone
+        activations fold into the layer before them."""
+        layer = self.tiled_chain_layer(op)
+        if layer is None:
+            return None, None
+        ops = [op]
+        layers = [layer]
+        while len(layers) < self.tiled_chain_max_layers:
+            output = ops[-1].output[0]
+            if self.consumer_count(output) != 1 \
+                    or output in self._option.output_nodes:
+                break
+            consumer_op = self._consumers[output][0]
+            if consumer_op.input[0] != output:
+                break
+            if consumer_op.type == MaceOp.Activation.name:
+                activation_arg = ConverterUtil.get_arg(
+                    consumer_op, MaceKeyword.mace_activation_type_str)
+                max_limit_arg = ConverterUtil.get_arg(
+                    consumer_op, MaceKeyword.mace_activation_max_limit_str)
+                if layers[-1]['activation'] != ActivationType.NOOP.value \
+                        or len(consumer_op.input) != 1 \
+                        or activation_arg.s == ActivationType.PRELU.name:
+                    break
+                layers[-1]['activation'] = \
+                    ActivationType[activation_arg.s].value
+                if max_limit_arg is not None:
+                    layers[-1]['max_limit'] = max_limit_arg.f
+                ops.append(consumer_op)
+                continue
+            layer = self.tiled_chain_layer(consumer_op)
+            if layer is None:
+                break
+            ops.append(consumer_op)
+            layers.append(layer)
+        return ops, layers
+
+    def fuse_cpu_tiled_chain(self):
+        """Fuse chains of CPU convolutions, depthwise convolutions and
+        pooling on large feature maps into TiledChain ops, which compute
+        the output in tiles and keep the intermediate tensors in cache.
+        It runs before FOLD_SEPARABLE_CONV so chains take the separable
+        convolutions of large maps as well."""
+        if self._option.device != DeviceType.CPU.value \
+                or not self._option.cpu_tiled_chain \
+                or self._target_data_format != DataFormat.NCHW:
+            return False
+
+        net = self._model
+        for op in net.op:
+            ops, layers = self.tiled_chain(op)
+            if ops is None:
+                continue
+            # only chains with a convolution and a large intermediate gain
+            intermediate_bytes = [
+                np.prod(member.output_shape[0].dims) * 4
+                for member in ops[:-1]
+                if member.type != MaceOp.Activation.name]
+            if len(layers) < 2 \
+                    or all(layer['type'] > 1 for layer in layers) \
+                    or max(intermediate_bytes) < self.tiled_chain_min_bytes:
+                continue
+            print("Fuse tiled chain: %s" % ', '.join(
+                '%s(%s)' % (member.name, member.type) for member in ops))
+
+            last_op = ops[-1]
+            inputs = [op.input[0]]
+            for member, layer in zip([member for member in ops
+                                      if member.type
+                                      != MaceOp.Activation.name], layers):
+                if member.type == MaceOp.Pooling.name:
+                    continue
+                inputs.append(member.input[1])
+                if len(member.input) > 2:
+                    inputs.append(member.input[2])
+                else:
+                    filter = self._consts[member.input[1]]
+                    channels = filter.dims[0]
+                    if member.type == MaceOp.DepthwiseConv2d.name:
+                        channels *= filter.dims[1]
+                    inputs.append(self.add_zero_bias(
+                        member.input[1] + '_tiled_chain_bias', channels))
+
+            op.type = MaceOp.TiledChain.name
+            op.name = last_op.name
+            op.input[:] = inputs
+            op.output[0] = last_op.output[0]
+            op.output_shape[0].dims[:] = last_op.output_shape[0].dims
+            del op.arg[:]
+            ConverterUtil.add_data_format_arg(op, DataFormat.NCHW)
+            for name in ['kernels', 'strides', 'dilations', 'padding_values']:
+                arg = op.arg.add()
+                arg.name = name
+                for layer in layers:
+                    arg.ints.extend(layer[name])
+            arg = op.arg.add()
+            arg.name = 'layer_types'
+            arg.ints.extend([layer['type'] for layer in layers])
+            arg = op.arg.add()
+            arg.name = 'activations'
+            arg.ints.extend([layer['activation'] for layer in layers])
+            arg = op.arg.add()
+            arg.name = 'max_limits'
+            arg.floats.extend([layer['max_limit'] for layer in layers])
+
+            for member in ops[1:]:
+                net.op.remove(member)
+            return True
+
+        return False
+
+    def separable_depthwise_supported(self, op):
+        if op.type != MaceOp.DepthwiseConv2d.name \
+                or ConverterUtil.data_format(op) != DataFormat.NCHW \
+                or op.input[1] not in self._consts \
+                or (len(op.input) > 2 and op.input[2] not in self._consts):
+            return False
+        filter = self._consts[op.input[1]]
+        strides = ConverterUtil.get_arg(op, MaceKeyword.mace_strides_str)
+        return filter.dims[2] == filter.dims[3] \
+            and filter.dims[2] in [3, 5, 7] \
+            and strides is not None \
+            and list(strides.ints) in [[1, 1], [2, 2]]
+
+    def separable_pointwise_supported(self, op):
+        if op.type != MaceOp.Conv2D.name \
+                or ConverterUtil.data_format(op) != DataFormat.NCHW \
+                or op.input[1] not in self._consts \
+                or (len(op.input) > 2 and op.input[2] not in self._consts) \
+                or len(op.input) > 3 \
+                or self.is_grouped_conv(op) \
+                or ConverterUtil.get_arg(
+                    op, MaceKeyword.mace_winograd_filter_transformed) \
+                is not None:
+            return False
+        filter = self._consts[op.input[1]]
+        if filter.dims[2] != 1 or filter.dims[3] != 1:
+            return False
+        for arg_name in [MaceKeyword.mace_strides_str,
+                         MaceKeyword.mace_dilations_str]:
+            arg = ConverterUtil.get_arg(op, arg_name)
+            if arg is not None and list(arg.ints) != [1, 1]:
+                return False
+        padding_values = ConverterUtil.get_arg(
+            op, MaceKeyword.mace_padding_values_str)
+        return padding_values is None or not any(padding_values.ints)
+
+    def add_zero_bias(self, name, channels):
+        tensor = self._model.tensors.add()
+        tensor.name = name
+        tensor.dims.extend([channels])
+        tensor.data_type = mace_pb2.DT_FLOAT
+        tensor.float_data.extend([0.0] * channels)
+        return name
+
+    def fold_separable_conv(self):
+        """Fold a CPU depthwise conv and the 1x1 conv consuming it into one
+        SeparableConv2d, the depthwise output then never leaves the cache.
+        """
+        if self._option.device != DeviceType.CPU.value:
+            return False
+
+        net = self._model
+        for op in net.op:
+            if not self.separable_depthwise_supported(op) \
+                    or self.consumer_count(op.output[0]) != 1 \
+                    or op.output[0] in self._option.output_nodes:
+                continue
+            consumer_op = self._consumers[op.output[0]][0]
+            if not self.separable_pointwise_supported(consumer_op) \
+                    or consumer_op.input[0] != op.output[0]:
+                continue
+            print("Fold separable conv: %s(%s)" % (op.name, op.type))
+
+            depthwise_filter = self._consts[op.input[1]]
+            pointwise_filter = self._consts[consumer_op.input[1]]
+            if len(op.input) > 2:
+                depthwise_bias = op.input[2]
+            else:
+                depthwise_bias = self.add_zero_bias(
+                    op.input[1] + '_separable_bias',
+                    depthwise_filter.dims[0] * depthwise_filter.dims[1])
+            if len(consumer_op.input) > 2:
+                pointwise_bias = consumer_op.input[2]
+            else:
+                pointwise_bias = self.add_zero_bias(
+                    consumer_op.input[1] + '_separable_bias',
+                    pointwise_filter.dims[0])
+
+            op.type = MaceOp.SeparableConv2d.name
+            op.name = consumer_op.name
+            op.input[:] = [op.input[0], op.input[1], depthwise_bias,
+                           consumer_op.input[1], pointwise_bias]
+            op.output[0] = consumer_op.output[0]
+            op.output_shape[0].dims[:] = consumer_op.output_shape[0].dims
+            for arg in op.arg:
+                if arg.name == MaceKeyword.mace_activation_type_str:
+                    arg.name = MaceKeyword.mace_depthwise_activation_type_str
+                elif arg.name == MaceKeyword.mace_activation_max_limit_str:
+                    arg.name = \
+                        MaceKeyword.mace_depthwise_activation_max_limit_str
+            for arg in consumer_op.arg:
+                if arg.name == MaceKeyword.mace_activation_type_str \
+                        or arg.name == MaceKeyword.mace_activation_max_limit_str:  # noqa
+                    op.arg.extend([arg])
+
+            self.safe_remove_node(consumer_op, op)
+            return True
+
+        return False
+
     def buffer_to_image(self, op, input_idx, input_type):
         net = self._model
         input_name = op.input[input_idx]
@@ -959,6 +1543,8 @@ class Transformer(base_converter.ConverterInterface):
         for op in net.op:
             if op.type == MaceOp.Conv2D.name \
                     or op.type == MaceOp.Deconv2D.name:
+                mace_check(not self.is_grouped_conv(op),
+                           "%s: GPU convolution is not grouped" % op.name)
                 self.buffer_to_image(op, 1, OpenCLBufferType.CONV2D_FILTER)
                 if len(op.input) >= 3:
                     self.buffer_to_image(op, 2, OpenCLBufferType.ARGUMENT)
@@ -1109,10 +1695,16 @@ class Transformer(base_converter.ConverterInterface):
         input/output and filter"""
         # if self._option.device == DeviceType.GPU.value:
         # return False
+        if self._option.device == DeviceType.CPU.value \
+                and self._target_data_format == DataFormat.NHWC:
+            # the OIHW filter does not match the NHWC flattened input
+            return False
 
         net = self._model
         for op in net.op:
-            if op.type == MaceOp.Conv2D.name:
+            # fc has no residual input and no groups
+            if op.type == MaceOp.Conv2D.name and len(op.input) <= 3 \
+                    and not self.is_grouped_conv(op):
                 producer = self._producer[op.input[0]]
                 input_shape = producer.output_shape[0].dims
                 batch, height, width, channels = self.sort_feature_map_shape(
@@ -26,6 +26,7 @@ class MemoryOptimizer(object):
         self.total_mem_count = 0
         self.input_ref_counter = {}
         self.mem_ref_counter = {}
+        self.tensor_size = {}  # tensor_name->element count
 
         consumers = {}
         for op in net_def.op:
@@ -90,6 +91,27 @@ class MemoryOptimizer(object):
         return op.type == 'Reshape' or op.type == 'Identity' \
                or op.type == 'Squeeze'
 
+    def is_inplace_op(self, op):
+        # keep consistent with CanRunInPlace in mace/core/workspace.cc
+        return op.type in ['Activation', 'BatchNorm', 'BiasAdd', 'Eltwise',
+                           'FoldedBatchNorm']
+
+    def get_inplace_mem_id(self, op, output_shape):
+        # an op can write its output to the memory of an input which has the
+        # same size, if the input is the only tensor alive in that memory and
+        # this op is its only consumer.
+        if not self.is_inplace_op(op) or len(op.output) != 1:
+            return -1
+        output_size = reduce(operator.mul, output_shape, 1)
+        for ipt in op.input:
+            mem_id = self.op_mem.get(ipt, -1)
+            if mem_id != -1 \
+                    and self.input_ref_counter.get(ipt, 0) == 1 \
+                    and self.mem_ref_counter[mem_id] == 1 \
+                    and self.tensor_size.get(ipt, -1) == output_size:
+                return mem_id
+        return -1
+
     def optimize(self):
         for op in self.net_def.op:
             if not self.op_need_optimize_memory(op):
@@ -103,9 +125,14 @@ class MemoryOptimizer(object):
                       'the number of output.')
                 return
             for i in range(len(op.output)):
+                inplace_mem_id = self.get_inplace_mem_id(
+                    op, op.output_shape[i].dims)
                 if self.is_memory_reuse_op(op):
                     # make these ops reuse memory of input tensor
                     mem_id = self.op_mem.get(op.input[0], -1)
+                elif inplace_mem_id != -1:
+                    # run in place to save memory and bandwidth
+                    mem_id = inplace_mem_id
                 else:
                     op_mem_block = self.get_op_mem_block(
                         op.type,
@@ -145,6 +172,8 @@ class MemoryOptimizer(object):
                         self.total_mem_count += 1
                         self.mem_block[mem_id] = op_mem_block
 
+                self.tensor_size[op.output[i]] = reduce(
+                    operator.mul, op.output_shape[i].dims, 1)
                 if mem_id != -1:
                     op.mem_id.extend([mem_id])
                     self.op_mem[op.output[i]] = mem_id
@@ -179,6 +208,10 @@ class MemoryOptimizer(object):
 
 
 class GPUMemoryOptimizer(MemoryOptimizer):
+    def is_inplace_op(self, op):
+        # OpenCL image can not be read and written in the same kernel
+        return False
+
     def op_need_optimize_memory(self, op):
         if op.type == 'BufferToImage':
             for arg in op.arg:
@@ -13,10 +13,15 @@
 // limitations under the License.
 
 
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 
 #include "mace/core/operator.h"
 #include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/eltwise.h"
+#include "mace/kernels/pooling.h"
+#include "mace/kernels/x86/conv_2d_avx2.h"
 #include "mace/ops/ops_test_util.h"
 #include "mace/public/mace_runtime.h"
 
@@ -352,6 +357,84 @@ void MaceRun(const int in_out_size,
   CheckOutputs<DeviceType::GPU, T>(*net_def, inputs, outputs, data);
 }
 
+// A fully convolutional net on an NHWC input of a max_tile_shape model,
+// with strided, dilated, pooled, merged and unpadded windows. Returns the
+// size of its weights.
+int64_t TiledNet(const std::vector<int64_t> &max_tile_shape,
+                 NetDef *net_def) {
+  const std::vector<std::vector<int64_t>> filter_shapes = {
+      {8, 3, 3, 3}, {1, 8, 3, 3}, {8, 3, 1, 1}, {5, 8, 5, 5}};
+  int64_t offset = 0;
+  for (size_t i = 0; i < filter_shapes.size(); ++i) {
+    const int64_t size =
+        std::accumulate(filter_shapes[i].begin(), filter_shapes[i].end(), 1,
+                        std::multiplies<int64_t>());
+    AddTensor<float>(MakeString("filter", i), filter_shapes[i], offset, size,
+                     net_def);
+    offset += size;
+  }
+  ops::test::OpDefBuilder("Transpose", "InputTranspose")
+      .Input("mace_input_node_input")
+      .Output("input")
+      .AddIntsArg("dims", {0, 3, 1, 2})
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Conv2D", "Conv")
+      .Input("input")
+      .Input("filter0")
+      .Output("conv")
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddStringArg("activation", "RELU")
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("DepthwiseConv2d", "Depthwise")
+      .Input("conv")
+      .Input("filter1")
+      .Output("depthwise")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntsArg("padding_values", {4, 4})
+      .AddIntsArg("dilations", {2, 2})
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Pooling", "Pooling")
+      .Input("input")
+      .Output("pooling")
+      .AddIntsArg("kernels", {3, 3})
+      .AddIntsArg("strides", {2, 2})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntArg("pooling_type", PoolingType::MAX)
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Conv2D", "Pointwise")
+      .Input("pooling")
+      .Input("filter2")
+      .Output("pointwise")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::SAME)
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Eltwise", "Eltwise")
+      .Input("depthwise")
+      .Input("pointwise")
+      .Output("eltwise")
+      .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Conv2D", "Valid")
+      .Input("eltwise")
+      .Input("filter3")
+      .Output("output")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::VALID)
+      .Finalize(net_def->add_op());
+  ops::test::OpDefBuilder("Transpose", "OutputTranspose")
+      .Input("output")
+      .Output("mace_output_node_output")
+      .AddIntsArg("dims", {0, 2, 3, 1})
+      .Finalize(net_def->add_op());
+  InputInfo *input_info = net_def->add_input_info();
+  input_info->set_name("input");
+  for (int64_t dim : max_tile_shape) {
+    input_info->add_dims(dim);
+  }
+  net_def->add_output_info()->set_name("output");
+  return offset;
+}
 }  // namespace
 
 TEST_F(MaceAPITest, GPUSingleInputOutput) {
@@ -381,5 +464,303 @@ TEST_F(MaceAPITest, GPUVariableInputShape) {
                 {16, 16, 3, 3});
 }
 
+TEST_F(MaceAPITest, CPUMemoryStats) {
+  const std::vector<int64_t> shape = {1, 16, 32, 32};
+  const std::vector<int64_t> filter_shape = {16, 16, 3, 3};
+  const int64_t activation_bytes =
+      std::accumulate(shape.begin(), shape.end(), 1,
+                      std::multiplies<int64_t>()) * sizeof(float);
+  const DeviceType device = DeviceType::CPU;
+
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  MemoryBlock *mem_blk_ptr = net_def->mutable_mem_arena()->add_mem_block();
+  mem_blk_ptr->set_mem_id(0);
+  mem_blk_ptr->set_x(activation_bytes / sizeof(float));
+  mem_blk_ptr->set_y(1);
+
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input", "filter", "conv_output", {0},
+                 device, net_def.get());
+  Relu<float>("conv_output", "mace_output_node_output", device,
+              net_def.get());
+  net_def->add_input_info()->set_name("input");
+  net_def->add_output_info()->set_name("output");
+
+  MaceEngine engine(device);
+  ASSERT_EQ(engine.Init(net_def.get(), {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data())),
+            MaceStatus::MACE_SUCCESS);
+  MemoryStats stats;
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(static_cast<int64_t>(data.size() * sizeof(float)),
+            stats.model_weights.current_bytes);
+  EXPECT_EQ(0, stats.derived_tensors.current_bytes);
+  EXPECT_LE(activation_bytes, stats.activations.current_bytes);
+
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  RunMetadata run_metadata;
+  ASSERT_EQ(engine.Run(inputs, &outputs, &run_metadata),
+            MaceStatus::MACE_SUCCESS);
+
+  // Each op has its input and output alive.
+  ASSERT_EQ(2u, run_metadata.op_stats.size());
+  EXPECT_EQ(2 * activation_bytes,
+            run_metadata.op_stats[0].live_activation_bytes);
+  EXPECT_EQ(2 * activation_bytes,
+            run_metadata.op_stats[1].live_activation_bytes);
+
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  // Winograd filter is transformed in the first run and its tiles go through
+  // scratch, avx2 cpus take the direct kernel on the unpadded input instead.
+  if (kernels::Conv2dAvx2Kernel(3, 3, 1, 1) == nullptr) {
+    EXPECT_LT(0, stats.derived_tensors.current_bytes);
+    EXPECT_LT(0, stats.scratch.current_bytes);
+  }
+  EXPECT_LE(3 * activation_bytes, stats.activations.current_bytes);
+  EXPECT_EQ(0, stats.opencl_images.current_bytes);
+  for (const MemoryUsage &usage : {stats.model_weights, stats.derived_tensors,
+                                   stats.activations, stats.scratch}) {
+    EXPECT_LE(usage.current_bytes, usage.peak_bytes);
+  }
+}
+
+TEST_F(MaceAPITest, CPUInPlaceExecution) {
+  const std::vector<int64_t> shape = {1, 16, 32, 32};
+  const std::vector<int64_t> filter_shape = {16, 16, 3, 3};
+  const int64_t activation_bytes =
+      std::accumulate(shape.begin(), shape.end(), 1,
+                      std::multiplies<int64_t>()) * sizeof(float);
+  const DeviceType device = DeviceType::CPU;
+
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  MemoryBlock *mem_blk_ptr = net_def->mutable_mem_arena()->add_mem_block();
+  mem_blk_ptr->set_mem_id(0);
+  mem_blk_ptr->set_x(activation_bytes / sizeof(float));
+  mem_blk_ptr->set_y(1);
+
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input", "filter", "conv_output", {0},
+                 device, net_def.get());
+  // Relu runs in place on the memory of conv output
+  Relu<float>("conv_output", "relu_output", device, net_def.get());
+  net_def->mutable_op(1)->add_mem_id(0);
+  OperatorDef operator_def;
+  ops::test::OpDefBuilder("Eltwise", "EltwiseTest")
+      .Input("relu_output")
+      .Input("mace_input_node_input")
+      .Output("mace_output_node_output")
+      .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+      .AddIntArg("device", static_cast<int>(device))
+      .Finalize(&operator_def);
+  net_def->add_op()->CopyFrom(operator_def);
+  net_def->add_input_info()->set_name("input");
+  net_def->add_output_info()->set_name("output");
+
+  MaceEngine engine(device);
+  ASSERT_EQ(engine.Init(net_def.get(), {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data())),
+            MaceStatus::MACE_SUCCESS);
+
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  RunMetadata run_metadata;
+  ASSERT_EQ(engine.Run(inputs, &outputs, &run_metadata),
+            MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(3u, run_metadata.op_stats.size());
+  // Input and output of relu share the same buffer.
+  EXPECT_EQ(2 * activation_bytes,
+            run_metadata.op_stats[1].live_activation_bytes);
+
+  CheckOutputs<DeviceType::CPU, float>(*net_def, inputs, outputs, data);
+}
+
+TEST_F(MaceAPITest, CPUTrim) {
+  const std::vector<int64_t> shape = {1, 16, 32, 32};
+  const std::vector<int64_t> filter_shape = {16, 16, 3, 3};
+  const int64_t activation_bytes =
+      std::accumulate(shape.begin(), shape.end(), 1,
+                      std::multiplies<int64_t>()) * sizeof(float);
+  const DeviceType device = DeviceType::CPU;
+
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  MemoryBlock *mem_blk_ptr = net_def->mutable_mem_arena()->add_mem_block();
+  mem_blk_ptr->set_mem_id(0);
+  mem_blk_ptr->set_x(activation_bytes / sizeof(float));
+  mem_blk_ptr->set_y(1);
+
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input", "filter", "conv_output", {0},
+                 device, net_def.get());
+  Relu<float>("conv_output", "mace_output_node_output", device,
+              net_def.get());
+  net_def->add_input_info()->set_name("input");
+  net_def->add_output_info()->set_name("output");
+
+  MaceEngine engine(device);
+  ASSERT_EQ(engine.Init(net_def.get(), {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data())),
+            MaceStatus::MACE_SUCCESS);
+
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+  const int64_t output_size = activation_bytes / sizeof(float);
+  const float *output_data = outputs["output"].data().get();
+  const std::vector<float> expected(output_data, output_data + output_size);
+
+  MemoryStats before_trim;
+  ASSERT_EQ(engine.GetMemoryStats(&before_trim), MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(engine.Trim(), MaceStatus::MACE_SUCCESS);
+  MemoryStats stats;
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(before_trim.model_weights.current_bytes,
+            stats.model_weights.current_bytes);
+  EXPECT_EQ(0, stats.derived_tensors.current_bytes);
+  EXPECT_EQ(0, stats.activations.current_bytes);
+  EXPECT_EQ(0, stats.scratch.current_bytes);
+  EXPECT_EQ(before_trim.activations.peak_bytes, stats.activations.peak_bytes);
+
+  // Prewarm only brings back the memory arena.
+  ASSERT_EQ(engine.Prewarm(), MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  EXPECT_LE(activation_bytes, stats.activations.current_bytes);
+  EXPECT_GT(before_trim.activations.current_bytes,
+            stats.activations.current_bytes);
+
+  ASSERT_EQ(engine.Trim(), MaceStatus::MACE_SUCCESS);
+  std::fill(outputs["output"].data().get(),
+            outputs["output"].data().get() + output_size, 0.f);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(before_trim.derived_tensors.current_bytes,
+            stats.derived_tensors.current_bytes);
+  EXPECT_EQ(before_trim.activations.current_bytes,
+            stats.activations.current_bytes);
+  output_data = outputs["output"].data().get();
+  for (int64_t i = 0; i < output_size; ++i) {
+    EXPECT_EQ(expected[i], output_data[i]);
+  }
+}
+
+TEST_F(MaceAPITest, CPUPreallocateTensors) {
+  const std::vector<int64_t> shape = {1, 16, 32, 32};
+  const std::vector<int64_t> filter_shape = {16, 16, 3, 3};
+  const int64_t activation_bytes =
+      std::accumulate(shape.begin(), shape.end(), 1,
+                      std::multiplies<int64_t>()) * sizeof(float);
+  const DeviceType device = DeviceType::CPU;
+
+  // Without memory arena, all tensors are sized at runtime by default.
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input", "filter", "conv_output", {},
+                 device, net_def.get());
+  Relu<float>("conv_output", "mace_output_node_output", device,
+              net_def.get());
+  net_def->add_input_info()->set_name("input");
+  net_def->add_output_info()->set_name("output");
+
+  MaceEngine engine(device);
+  ASSERT_EQ(engine.Init(net_def.get(), {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data()),
+                        {shape}),
+            MaceStatus::MACE_SUCCESS);
+  MemoryStats stats;
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  // input, conv output and relu output
+  EXPECT_LE(3 * activation_bytes, stats.activations.current_bytes);
+  const int64_t preallocated_bytes = stats.activations.current_bytes;
+
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  GenerateInputs({"input"}, shape, &inputs);
+  GenerateOutputs({"output"}, shape, &outputs);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(preallocated_bytes, stats.activations.current_bytes);
+
+  CheckOutputs<DeviceType::CPU, float>(*net_def, inputs, outputs, data);
+}
+
+TEST_F(MaceAPITest, CPUTiledRun) {
+  const std::vector<int64_t> input_shape = {2, 57, 70, 3};
+  // outputs read [-5, 13] of the rows of 2 strided inputs
+  const std::vector<int64_t> output_shape = {2, 25, 31, 5};
+  const DeviceType device = DeviceType::CPU;
+
+  NetDef net_def;
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(
+      {TiledNet(input_shape, &net_def)}, &data);
+  MaceEngine engine(device);
+  ASSERT_EQ(engine.Init(&net_def, {"input"}, {"output"},
+                        reinterpret_cast<unsigned char *>(data.data())),
+            MaceStatus::MACE_SUCCESS);
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> outputs;
+  GenerateInputs({"input"}, input_shape, &inputs);
+  GenerateOutputs({"output"}, output_shape, &outputs);
+  ASSERT_EQ(engine.Run(inputs, &outputs), MaceStatus::MACE_SUCCESS);
+  MemoryStats stats;
+  ASSERT_EQ(engine.GetMemoryStats(&stats), MaceStatus::MACE_SUCCESS);
+  const float *expected = outputs["output"].data().get();
+  const int64_t output_size =
+      std::accumulate(output_shape.begin(), output_shape.end(), 1,
+                      std::multiplies<int64_t>());
+
+  // tiles of odd and even sizes along both axes, one along batch
+  for (const std::vector<int64_t> &max_tile_shape :
+           std::vector<std::vector<int64_t>>{{2, 32, 30, 3},
+                                             {1, 24, 70, 3},
+                                             {2, 57, 21, 3}}) {
+    NetDef tiled_net_def;
+    TiledNet(max_tile_shape, &tiled_net_def);
+    MaceEngine tiled_engine(device);
+    ASSERT_EQ(tiled_engine.Init(&tiled_net_def, {"input"}, {"output"},
+                                reinterpret_cast<unsigned char *>(
+                                    data.data())),
+              MaceStatus::MACE_SUCCESS);
+    std::map<std::string, mace::MaceTensor> tiled_outputs;
+    GenerateOutputs({"output"}, output_shape, &tiled_outputs);
+    ASSERT_EQ(tiled_engine.RunTiled(inputs, &tiled_outputs),
+              MaceStatus::MACE_SUCCESS);
+    const float *actual = tiled_outputs["output"].data().get();
+    for (int64_t i = 0; i < output_size; ++i) {
+      ASSERT_NEAR(expected[i], actual[i], 1e-4 + 1e-4 * std::abs(expected[i]))
+          << "at " << i;
+    }
+    MemoryStats tiled_stats;
+    ASSERT_EQ(tiled_engine.GetMemoryStats(&tiled_stats),
+              MaceStatus::MACE_SUCCESS);
+    EXPECT_GT(stats.activations.peak_bytes,
+              tiled_stats.activations.peak_bytes);
+  }
+
+  // tiles must hold the receptive field and the stride
+  NetDef small_net_def;
+  TiledNet({2, 18, 70, 3}, &small_net_def);
+  MaceEngine small_engine(device);
+  ASSERT_EQ(small_engine.Init(&small_net_def, {"input"}, {"output"},
+                              reinterpret_cast<unsigned char *>(data.data())),
+            MaceStatus::MACE_SUCCESS);
+  EXPECT_EQ(small_engine.RunTiled(inputs, &outputs),
+            MaceStatus::MACE_INVALID_ARGS);
+}
+
 }  // namespace test
 }  // namespace mace
@@ -114,6 +114,8 @@ DSPDataType = Enum('DSPDataType', [(ele, ele) for ele in DSPDataTypeStrs],
 
 WinogradParameters = [0, 2, 4]
 
+CPUDataFormats = ["NCHW", "NHWC", "auto"]
+
 
 class DefaultValues(object):
     omp_num_threads = -1,
@@ -147,6 +149,9 @@ class YAMLKeyword(object):
     nnlib_graph_mode = 'nnlib_graph_mode'
     obfuscate = 'obfuscate'
     winograd = 'winograd'
+    cpu_blocked_layout = 'cpu_blocked_layout'
+    cpu_tiled_chain = 'cpu_tiled_chain'
+    cpu_data_format = 'cpu_data_format'
     validation_inputs_data = 'validation_inputs_data'
     transformers = 'transformers'  # keep it private for now
 
@@ -420,11 +425,20 @@ def format_model_config(flags):
         for key in [YAMLKeyword.limit_opencl_kernel_time,
                     YAMLKeyword.nnlib_graph_mode,
                     YAMLKeyword.obfuscate,
-                    YAMLKeyword.winograd]:
+                    YAMLKeyword.winograd,
+                    YAMLKeyword.cpu_blocked_layout,
+                    YAMLKeyword.cpu_tiled_chain]:
             value = model_config.get(key, "")
             if value == "":
                 model_config[key] = 0
 
+        model_config[YAMLKeyword.cpu_data_format] = model_config.get(
+            YAMLKeyword.cpu_data_format, "NCHW")
+        mace_check(model_config[YAMLKeyword.cpu_data_format]
+                   in CPUDataFormats,
+                   ModuleName.YAML_CONFIG,
+                   "'cpu_data_format' must be in " + str(CPUDataFormats))
+
         mace_check(model_config[YAMLKeyword.winograd] in WinogradParameters,
                    ModuleName.YAML_CONFIG,
                    "'winograd' parameters must be in "
@@ -654,6 +668,9 @@ def convert_model(configs):
             model_config[YAMLKeyword.nnlib_graph_mode],
             embed_model_data,
             model_config[YAMLKeyword.winograd],
+            model_config[YAMLKeyword.cpu_blocked_layout],
+            model_config[YAMLKeyword.cpu_tiled_chain],
+            model_config[YAMLKeyword.cpu_data_format],
             model_config[YAMLKeyword.obfuscate],
             configs[YAMLKeyword.build_type],
             data_type,
@@ -487,6 +487,9 @@ def gen_model_code(model_codegen_dir,
                    dsp_mode,
                    embed_model_data,
                    winograd,
+                   cpu_blocked_layout,
+                   cpu_tiled_chain,
+                   cpu_data_format,
                    obfuscate,
                    model_build_type,
                    data_type,
@@ -513,6 +516,9 @@ def gen_model_code(model_codegen_dir,
               "--dsp_mode=%s" % dsp_mode,
               "--embed_model_data=%s" % embed_model_data,
               "--winograd=%s" % winograd,
+              "--cpu_blocked_layout=%s" % bool(cpu_blocked_layout),
+              "--cpu_tiled_chain=%s" % bool(cpu_tiled_chain),
+              "--cpu_data_format=%s" % cpu_data_format,
               "--obfuscate=%s" % obfuscate,
               "--output_dir=%s" % model_codegen_dir,
               "--model_build_type=%s" % model_build_type,